@@ -121,13 +121,6 @@ build_cubecell() {
     cp .pio/build/cubecell_lora/firmware.cyacd "$RELEASE_DIR/cubecell/cubecell_production_${VERSION}.cyacd"
     print_success "Production mode built"
     
-    # Original simple version
-    print_status "Building CubeCell original version..."
-    pio run -e cubecell_original --silent
-    cp .pio/build/cubecell_original/firmware.hex "$RELEASE_DIR/cubecell/cubecell_original_${VERSION}.hex"
-    cp .pio/build/cubecell_original/firmware.cyacd "$RELEASE_DIR/cubecell/cubecell_original_${VERSION}.cyacd"
-    print_success "Original version built"
-    
     print_success "All CubeCell variants built successfully"
 }
 
@@ -201,7 +194,6 @@ pio run -e cubecell_testmode --target upload --upload-port /dev/cu.usbserial-XXX
 ### Firmware Variants
 - `cubecell_testmode_*.hex` - Test mode, 5-second intervals
 - `cubecell_production_*.hex` - Production mode, 60-second intervals with deep sleep
-- `cubecell_original_*.hex` - Simple working version
 
 ## LoRa32 Gateway (LilyGo T3)
 
@@ -251,7 +243,6 @@ create_release_notes() {
 ### CubeCell Transmitter
 - \`cubecell_testmode_${VERSION}.hex\` - Test mode (5s intervals)
 - \`cubecell_production_${VERSION}.hex\` - Production mode (60s intervals, deep sleep)
-- \`cubecell_original_${VERSION}.hex\` - Simplified working version
 
 ### LoRa32 Gateway
 - \`lora32_gateway_${VERSION}.bin\` - OTA update file
@@ -0,0 +1,41 @@
+/*
+ * Bench Common
+ * Meter readings and per-frame timing shared by the host benches, so
+ * bench_payload, bench_auth and bench_meshtastic time the same frames
+ * the same way.
+ */
+
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include "lora_payload.h"
+
+// Reading i of nodes sending in turn: every field varies, the packet
+// counter counts the frames of node i % nodes
+inline MeterData benchReading(size_t i, size_t nodes) {
+  MeterData data;
+  data.power_mw = (int32_t)(i * 7919) - 5000000;
+  data.total_consumption_mwh = 123456789012LL + (int64_t)i * 1000;
+  data.total_generation_mwh = 98765432LL * (int64_t)(i % 13);
+  data.battery_mv = (uint16_t)(3000 + i % 1200);
+  data.packet_counter = (uint32_t)(i / nodes);
+  return data;
+}
+
+// Mean time of work(i) over rounds passes of i = 0 .. frames - 1
+template <class Work>
+double nsPerFrame(int rounds, size_t frames, Work work) {
+  auto start = std::chrono::steady_clock::now();
+  for(int round = 0; round < rounds; round++) {
+    for(size_t i = 0; i < frames; i++) {
+      work(i);
+    }
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / ((double)rounds * frames);
+}
+
+#endif
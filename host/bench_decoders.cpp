@@ -0,0 +1,200 @@
+/*
+ * Meter Decoder Benchmark
+ * Known SML and D0 telegrams through the node's decoders (src/
+ * sml_decoder.h, src/d0_decoder.h): register values in mW / mWh, the
+ * optional SML fields, D0 mode C block check and mode D push lines,
+ * import/export without 16.7.0, and lines that must be refused. Fails on
+ * any mismatch, then times a telegram of each.
+ *
+ *   make -C host bench
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "d0_decoder.h"
+#include "fixed_point.h"
+#include "sml_decoder.h"
+
+#define ROUNDS 20000
+
+static const uint8_t SML_START[] = {0x1B, 0x1B, 0x1B, 0x1B, 0x01, 0x01, 0x01, 0x01};
+
+// 1-0:1.8.0 with status and unit, scaler -1: 11008198 * 0.1 Wh
+static const uint8_t SML_CONSUMPTION[] = {
+  0x77, 0x07, 0x01, 0x00, 0x01, 0x08, 0x00, 0xFF, 0x65, 0x00, 0x00, 0x01, 0x82, 0x01, 0x62, 0x1E,
+  0x52, 0xFF, 0x59, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA7, 0xF8, 0xC6, 0x01};
+// 1-0:2.8.0 without status, scaler -1: 100 * 0.1 Wh
+static const uint8_t SML_GENERATION[] = {
+  0x77, 0x07, 0x01, 0x00, 0x02, 0x08, 0x00, 0xFF, 0x01, 0x01, 0x62, 0x1E, 0x52, 0xFF, 0x59, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x64, 0x01};
+// 1-0:16.7.0 as int32 without scaler: -200 W
+static const uint8_t SML_POWER[] = {
+  0x77, 0x07, 0x01, 0x00, 0x10, 0x07, 0x00, 0xFF, 0x01, 0x01, 0x62, 0x1B, 0x01, 0x55, 0xFF, 0xFF,
+  0xFF, 0x38, 0x01};
+// 1-0:16.7.0 whose value runs past the end of the telegram
+static const uint8_t SML_POWER_TRUNCATED[] = {
+  0x77, 0x07, 0x01, 0x00, 0x10, 0x07, 0x00, 0xFF, 0x01, 0x01, 0x62, 0x1B, 0x01, 0x59, 0x00};
+// 1-0:1.8.0 as uint64 with the top bit set: clamped, never negative
+static const uint8_t SML_CONSUMPTION_HUGE[] = {
+  0x77, 0x07, 0x01, 0x00, 0x01, 0x08, 0x00, 0xFF, 0x01, 0x01, 0x62, 0x1E, 0x01, 0x69, 0x80, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01};
+
+struct Part {
+  const uint8_t *data;
+  size_t length;
+};
+
+static std::vector<uint8_t> smlTelegram(const std::vector<Part> &parts) {
+  std::vector<uint8_t> telegram(SML_START, SML_START + sizeof(SML_START));
+  for(const Part &part : parts) {
+    telegram.insert(telegram.end(), part.data, part.data + part.length);
+  }
+  telegram.insert(telegram.end(), SML_END, SML_END + sizeof(SML_END));
+  return telegram;
+}
+
+static bool feedSml(SmlDecoder &decoder, const std::vector<uint8_t> &telegram) {
+  bool complete = false;
+  for(size_t i = 0; i < telegram.size(); i++) {
+    complete = decoder.feed(telegram[i]);
+  }
+  return complete;
+}
+
+// Mode C data block: STX, lines, "!", ETX and the XOR of everything after STX
+static std::string d0ModeC(const char *ident, const char *lines) {
+  std::string block = std::string(lines) + "!\r\n" + (char)D0_ETX;
+  uint8_t bcc = 0;
+  for(char c : block) {
+    bcc ^= (uint8_t)c;
+  }
+  return std::string(ident) + "\r\n" + (char)D0_STX + block + (char)bcc;
+}
+
+static D0Decoder::Event feedD0(D0Decoder &decoder, const std::string &text) {
+  D0Decoder::Event last = D0Decoder::EVENT_NONE;
+  for(char c : text) {
+    D0Decoder::Event event = decoder.feed((uint8_t)c);
+    if(event != D0Decoder::EVENT_NONE) {
+      last = event;
+    }
+  }
+  return last;
+}
+
+static bool expect(const char *what, const MeterRegisters &got, int64_t power, int64_t consumption,
+                   int64_t generation) {
+  if(got.power_mw == power && got.consumption_mwh == consumption && got.generation_mwh == generation) {
+    return true;
+  }
+  fprintf(stderr, "FAIL: %s: %lld mW, %lld / %lld mWh, expected %lld mW, %lld / %lld mWh\n", what,
+          (long long)got.power_mw, (long long)got.consumption_mwh, (long long)got.generation_mwh, (long long)power,
+          (long long)consumption, (long long)generation);
+  return false;
+}
+
+template <class Work>
+static double nsPerTelegram(Work work) {
+  auto start = std::chrono::steady_clock::now();
+  for(int round = 0; round < ROUNDS; round++) {
+    work();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / ROUNDS;
+}
+
+int main() {
+  // SML: all three registers, optional fields present and absent
+  std::vector<uint8_t> sml = smlTelegram({{SML_CONSUMPTION, sizeof(SML_CONSUMPTION)},
+                                          {SML_GENERATION, sizeof(SML_GENERATION)},
+                                          {SML_POWER, sizeof(SML_POWER)}});
+  SmlDecoder smlDecoder;
+  if(!feedSml(smlDecoder, sml) ||
+     !expect("SML telegram", smlDecoder.registers(), -200000, 1100819800LL, 10000)) {
+    return 1;
+  }
+  // A malformed entry keeps the register's last value
+  std::vector<uint8_t> truncated = smlTelegram({{SML_CONSUMPTION_HUGE, sizeof(SML_CONSUMPTION_HUGE)},
+                                                {SML_POWER_TRUNCATED, sizeof(SML_POWER_TRUNCATED)}});
+  if(!feedSml(smlDecoder, truncated) ||
+     !expect("SML malformed entries", smlDecoder.registers(), -200000, INT64_MAX, 10000)) {
+    return 1;
+  }
+
+  // D0 mode C, block check included
+  const char *modeCLines =
+      "0-0:96.1.0*255(1ESY1160123456)\r\n"
+      "1-0:1.8.0*255(001234.5678*kWh)\r\n"
+      "1-0:2.8.0*255(000012.3456*kWh)\r\n"
+      "1-0:16.7.0*255(-000123*W)\r\n";
+  std::string modeC = d0ModeC("/ESY5Q3DA1024 V3.04", modeCLines);
+  D0Decoder d0;
+  d0.reset();
+  if(feedD0(d0, modeC) != D0Decoder::EVENT_TELEGRAM || d0.baudChar() != '5' ||
+     !expect("D0 mode C", d0.registers(), -123000, 1234567800LL, 12345600LL)) {
+    return 1;
+  }
+  std::string corrupted = modeC;
+  corrupted[corrupted.size() - 1] ^= 0x01;
+  if(feedD0(d0, corrupted) != D0Decoder::EVENT_ERROR) {
+    fprintf(stderr, "FAIL: D0 block with a wrong BCC accepted\n");
+    return 1;
+  }
+
+  // D0 mode D push, separate import and export power, comma decimals
+  D0Decoder push;
+  push.reset();
+  if(feedD0(push, "/EBZ5DD3BZ06ETA_107\r\n"
+                  "1-0:1.8.0(000987,654*kWh)\r\n"
+                  "1-0:1.7.0(0001.250*kW)\r\n"
+                  "1-0:2.7.0(0000.050*kW)\r\n"
+                  "!\r\n") != D0Decoder::EVENT_TELEGRAM ||
+     !expect("D0 mode D", push.registers(), 1200000, 987654000LL, 0)) {
+    return 1;
+  }
+
+  // Refused lines keep the last value: 19 digits, letters, two decimal
+  // points, no value, no closing bracket
+  if(feedD0(push, "/EBZ5DD3BZ06ETA_107\r\n"
+                  "1-0:1.8.0(1234567890123456789*Wh)\r\n"
+                  "1-0:2.8.0(12a4.5*kWh)\r\n"
+                  "1-0:16.7.0(1.2.3*W)\r\n"
+                  "1-0:2.8.0(*kWh)\r\n"
+                  "1-0:2.8.0(000001.000\r\n"
+                  "!\r\n") != D0Decoder::EVENT_TELEGRAM ||
+     !expect("D0 refused lines", push.registers(), 1200000, 987654000LL, 0)) {
+    return 1;
+  }
+  // 18 digits still fit
+  if(feedD0(push, "1-0:1.8.0(123456789012.345678*kWh)\r\n!\r\n") != D0Decoder::EVENT_TELEGRAM ||
+     push.registers().consumption_mwh != 123456789012345678LL) {
+    fprintf(stderr, "FAIL: D0 value of 18 digits refused\n");
+    return 1;
+  }
+
+  // Power beyond the int32 mW of the radio frame saturates
+  if(saturateInt32(3000000000LL) != INT32_MAX || saturateInt32(-3000000000LL) != INT32_MIN ||
+     saturateInt32(-123000) != -123000) {
+    fprintf(stderr, "FAIL: saturateInt32\n");
+    return 1;
+  }
+
+  // Timing
+  volatile int64_t sink = 0;
+  double smlNs = nsPerTelegram([&]() {
+    feedSml(smlDecoder, sml);
+    sink = sink + smlDecoder.registers().power_mw;
+  });
+  double d0Ns = nsPerTelegram([&]() {
+    feedD0(d0, modeC);
+    sink = sink + d0.registers().power_mw;
+  });
+
+  printf("meter decoders (%d telegrams each)\n", ROUNDS);
+  printf("  SML telegram, %3zu bytes  %7.1f ns\n", sml.size(), smlNs);
+  printf("  D0 mode C,    %3zu bytes  %7.1f ns\n", modeC.size(), d0Ns);
+  return 0;
+}
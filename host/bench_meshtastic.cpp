@@ -0,0 +1,186 @@
+/*
+ * Meshtastic Telemetry Benchmark
+ * Cost of TRANSPORT_LORA_MESHTASTIC (src/meshtastic_telemetry.h) against
+ * the raw MeterData struct and the meter frames of src/lora_payload.h:
+ * protobuf layout, nonce and channel hash checks, round trip error,
+ * encode/decode time per frame and time-on-air. Fails on a wrong byte,
+ * a lost reading or a foreign frame that gets through.
+ *
+ *   make -C host bench
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "bench_common.h"
+#include "lora_airtime.h"
+#include "meshtastic_telemetry.h"
+#include "meter_auth.h"
+
+#define FRAME_COUNT 1024
+#define ROUNDS      200
+#define NODES       64
+#define MESHTASTIC_ESTIMATE 125  // meshtastic/README.md before this codec: ~100-150 bytes
+
+static const uint8_t DEFAULT_KEY[AES_KEY_SIZE] = {MESHTASTIC_DEFAULT_KEY};
+
+static uint32_t nodeNum(size_t i) { return 0x1000 + (uint32_t)(i % NODES); }
+
+static uint8_t *putFloat(uint8_t *p, uint8_t field, float value) {
+  *p++ = (uint8_t)(field << 3 | PB_WIRE_FIXED32);
+  memcpy(p, &value, 4);  // Little-endian host
+  return p + 4;
+}
+
+int main() {
+  MeshtasticChannel longFast;
+  longFast.set(MESHTASTIC_DEFAULT_CHANNEL, DEFAULT_KEY);
+  if(longFast.hash() != 8) {
+    fprintf(stderr, "FAIL: LongFast channel hash %u, Meshtastic uses 8\n", longFast.hash());
+    return 1;
+  }
+
+  // Keystream: AES of packet id (64 bit LE), sender (LE), block counter (BE)
+  Aes128 aes;
+  aes.setKey(DEFAULT_KEY);
+  uint8_t zeros[40] = {0};
+  longFast.crypt(0x01020304, 0xA1B2C3D4, zeros, sizeof(zeros));
+  for(uint8_t block = 0; block < 3; block++) {
+    uint8_t nonce[AES_BLOCK_SIZE] = {0x04, 0x03, 0x02, 0x01, 0, 0, 0, 0, 0xD4, 0xC3, 0xB2, 0xA1, 0, 0, 0, block};
+    aes.encrypt(nonce);
+    size_t length = block < 2 ? AES_BLOCK_SIZE : sizeof(zeros) - 2 * AES_BLOCK_SIZE;
+    if(memcmp(zeros + block * AES_BLOCK_SIZE, nonce, length) != 0) {
+      fprintf(stderr, "FAIL: keystream block %u\n", block);
+      return 1;
+    }
+  }
+
+  // Layout: header, then Data{portnum, payload: Telemetry{power_metrics}}
+  MeterData sample = benchReading(12345, NODES);
+  uint8_t frame[MESHTASTIC_MAX_SIZE];
+  size_t length = encodeMeshtasticTelemetry(frame, longFast, 0xA1B2C3D4, 3, sample);
+  uint8_t expected[MESHTASTIC_MAX_SIZE];
+  uint8_t *p = expected;
+  p = payloadStore<uint32_t>(p, MESHTASTIC_BROADCAST);
+  p = payloadStore<uint32_t>(p, 0xA1B2C3D4);
+  p = payloadStore<uint32_t>(p, sample.packet_counter);
+  *p++ = 0x63;  // hop_start 3, hop_limit 3
+  *p++ = 8;
+  *p++ = 0;
+  *p++ = 0;
+  uint8_t *data = p;
+  const uint8_t dataHead[] = {0x08, 67, 0x12, 22, 0x2a, 20};
+  memcpy(p, dataHead, sizeof(dataHead));
+  p += sizeof(dataHead);
+  p = putFloat(p, PB_POWER_CH1_VOLTAGE, meterBatteryVolts(sample.battery_mv));
+  p = putFloat(p, PB_POWER_CH1_CURRENT, meterPowerWatts(sample.power_mw));
+  p = putFloat(p, PB_POWER_CH2_VOLTAGE, meterEnergyKwh(sample.total_consumption_mwh));
+  p = putFloat(p, PB_POWER_CH2_CURRENT, meterEnergyKwh(sample.total_generation_mwh));
+  longFast.crypt(sample.packet_counter, 0xA1B2C3D4, data, (size_t)(p - data));
+  if(length != (size_t)(p - expected) || memcmp(frame, expected, length) != 0) {
+    fprintf(stderr, "FAIL: frame layout, %zu bytes\n", length);
+    return 1;
+  }
+
+  // Round trip: float resolution of the channels
+  std::vector<uint8_t> frames(FRAME_COUNT * MESHTASTIC_MAX_SIZE);
+  std::vector<uint8_t> lengths(FRAME_COUNT);
+  double maxPowerError = 0;
+  double maxEnergyError = 0;
+  for(size_t i = 0; i < FRAME_COUNT; i++) {
+    uint8_t *f = &frames[i * MESHTASTIC_MAX_SIZE];
+    MeterData data = benchReading(i, NODES);
+    lengths[i] = (uint8_t)encodeMeshtasticTelemetry(f, longFast, nodeNum(i), 0, data);
+    MeshtasticReading out;
+    if(parseMeshtasticTelemetry(f, lengths[i], longFast, out) != PAYLOAD_OK || out.from != nodeNum(i) ||
+       out.data.packet_counter != data.packet_counter || out.data.battery_mv != data.battery_mv) {
+      fprintf(stderr, "FAIL: frame %zu lost\n", i);
+      return 1;
+    }
+    maxPowerError = fmax(maxPowerError, fabs((double)out.data.power_mw - data.power_mw));
+    maxEnergyError = fmax(maxEnergyError, fabs((double)out.data.total_consumption_mwh - data.total_consumption_mwh));
+    maxEnergyError = fmax(maxEnergyError, fabs((double)out.data.total_generation_mwh - data.total_generation_mwh));
+  }
+
+  // Foreign frames: other channel, other key with the same hash, meter
+  // frames, flipped ciphertext
+  MeshtasticChannel other;
+  other.set("Meter", DEFAULT_KEY);
+  MeshtasticReading out;
+  if(parseMeshtasticTelemetry(frame, length, other, out) != PAYLOAD_UNKNOWN_SCHEMA) {
+    fprintf(stderr, "FAIL: frame of another channel accepted\n");
+    return 1;
+  }
+  uint8_t collidingKey[AES_KEY_SIZE];
+  memcpy(collidingKey, DEFAULT_KEY, AES_KEY_SIZE);
+  collidingKey[0] ^= 0x5A;
+  collidingKey[1] ^= 0x5A;
+  MeshtasticChannel colliding;
+  colliding.set(MESHTASTIC_DEFAULT_CHANNEL, collidingKey);
+  size_t garbled = 0;
+  for(size_t i = 0; i < FRAME_COUNT; i++) {
+    if(parseMeshtasticTelemetry(&frames[i * MESHTASTIC_MAX_SIZE], lengths[i], colliding, out) == PAYLOAD_OK) {
+      fprintf(stderr, "FAIL: frame %zu accepted under the wrong key\n", i);
+      return 1;
+    }
+    uint8_t flipped[MESHTASTIC_MAX_SIZE];
+    memcpy(flipped, &frames[i * MESHTASTIC_MAX_SIZE], lengths[i]);
+    flipped[MESHTASTIC_HEADER_SIZE + i % (lengths[i] - MESHTASTIC_HEADER_SIZE)] ^= 0x80;
+    if(parseMeshtasticTelemetry(flipped, lengths[i], longFast, out) == PAYLOAD_OK) {
+      garbled++;  // A float bit: CTR has no integrity, the value changes
+    }
+  }
+  uint8_t meter[PAYLOAD_METER_SIZE];
+  encodeMeterPayload(meter, 1, sample);
+  if(parseMeshtasticTelemetry(meter, sizeof(meter), longFast, out) == PAYLOAD_OK) {
+    fprintf(stderr, "FAIL: meter frame parsed as Meshtastic\n");
+    return 1;
+  }
+
+  // Timing
+  volatile uint32_t sink = 0;
+  uint8_t buffer[MESHTASTIC_MAX_SIZE];
+  double rawNs = nsPerFrame(ROUNDS, FRAME_COUNT, [&](size_t i) {
+    MeterData data = benchReading(i, NODES);
+    memcpy(buffer, &data, sizeof(data));
+    sink = sink + buffer[sizeof(data) - 1];
+  });
+  double meterNs = nsPerFrame(ROUNDS, FRAME_COUNT, [&](size_t i) {
+    MeterData data = benchReading(i, NODES);
+    encodeMeterPayload(buffer, (uint16_t)(i % NODES), data);
+    sink = sink + buffer[PAYLOAD_METER_SIZE - 1];
+  });
+  double encodeNs = nsPerFrame(ROUNDS, FRAME_COUNT, [&](size_t i) {
+    MeterData data = benchReading(i, NODES);
+    size_t n = encodeMeshtasticTelemetry(buffer, longFast, nodeNum(i), 0, data);
+    sink = sink + buffer[n - 1];
+  });
+  double decodeNs = nsPerFrame(ROUNDS, FRAME_COUNT, [&](size_t i) {
+    MeshtasticReading r;
+    if(parseMeshtasticTelemetry(&frames[i * MESHTASTIC_MAX_SIZE], lengths[i], longFast, r) == PAYLOAD_OK) {
+      sink = sink + r.data.packet_counter;
+    }
+  });
+
+  printf("meshtastic telemetry (%d frames x %d rounds, software AES-CTR)\n", FRAME_COUNT, ROUNDS);
+  printf("  raw struct memcpy      %7.1f ns/frame\n", rawNs);
+  printf("  meter frame            %7.1f ns/frame\n", meterNs);
+  printf("  meshtastic encode      %7.1f ns/frame\n", encodeNs);
+  printf("  meshtastic decode      %7.1f ns/frame\n", decodeNs);
+  printf("  round trip error       %.0f mW, %.0f mWh (float channels)\n", maxPowerError, maxEnergyError);
+  printf("  flipped ciphertext     %zu of %d frames still parse (no integrity)\n", garbled, FRAME_COUNT);
+  printf("  frame size             raw %zu / meter %zu / signed %zu / meshtastic %zu bytes (estimate was %d)\n",
+         sizeof(MeterData), (size_t)PAYLOAD_METER_SIZE, (size_t)PAYLOAD_SIGNED_SIZE, length, MESHTASTIC_ESTIMATE);
+  printf("  time on air, 125 kHz CR 4/5: raw / meter / signed / meshtastic\n");
+  for(uint8_t sf = 7; sf <= 12; sf++) {
+    LoRaProfile profile = {sf, 0, 1, 14};
+    uint32_t rawUs = loraTimeOnAirUs(profile, sizeof(MeterData));
+    uint32_t meterUs = loraTimeOnAirUs(profile, PAYLOAD_METER_SIZE);
+    uint32_t signedUs = loraTimeOnAirUs(profile, PAYLOAD_SIGNED_SIZE);
+    uint32_t meshUs = loraTimeOnAirUs(profile, length);
+    printf("    SF%-2u %8.1f / %8.1f / %8.1f / %8.1f ms (+%5.1f%% over meter)\n", sf, rawUs / 1000.0,
+           meterUs / 1000.0, signedUs / 1000.0, meshUs / 1000.0, 100.0 * (meshUs - meterUs) / meterUs);
+  }
+  return 0;
+}
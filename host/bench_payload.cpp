@@ -0,0 +1,166 @@
+/*
+ * Payload Decoder Benchmark
+ * Encodes meter frames from many nodes and decodes them in place at odd
+ * buffer offsets, as a gateway sees them. Fails on any field mismatch.
+ * Then the same frames through PayloadRegistry, once with the schemas
+ * the gateway registers today and once with the table full, to show
+ * that more schemas do not slow the meter path down.
+ *
+ *   make -C host bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "bench_common.h"
+#include "lora_payload.h"
+#include "payload_registry.h"
+
+#define FRAME_COUNT 4096
+#define ROUNDS      2000
+#define NODES       64
+
+// Old gateway path for comparison: copy into a vector, then memcpy fields
+static int64_t decodeWithCopy(const uint8_t *data, size_t length) {
+  std::vector<uint8_t> x(data, data + length);
+  if(x.size() != PAYLOAD_METER_SIZE) {
+    return 0;
+  }
+  int32_t power;
+  int64_t consumption;
+  memcpy(&power, &x[PAYLOAD_HEADER_SIZE], 4);
+  memcpy(&consumption, &x[PAYLOAD_HEADER_SIZE + 4], 8);
+  return power + consumption;
+}
+
+static int64_t decodeInPlace(const uint8_t *data, size_t length) {
+  MeterPayloadView view;
+  if(MeterPayloadView::parse(data, length, view) != PAYLOAD_OK) {
+    return 0;
+  }
+  return view.powerMw() + view.consumptionMwh();
+}
+
+using esphome::lora_receiver::PayloadRegistry;
+using esphome::lora_receiver::RxPacket;
+
+#define REGISTRY_SCHEMAS 16
+
+struct RegistryDecoder {
+  PayloadStatus meter(const RxPacket &packet) {
+    MeterPayloadView view;
+    PayloadStatus status = MeterPayloadView::parse(packet.data, packet.length, view);
+    if(status == PAYLOAD_OK) {
+      checksum += view.powerMw() + view.consumptionMwh();
+    }
+    return status;
+  }
+  PayloadStatus other(const RxPacket &packet) {
+    checksum -= packet.length;
+    return PAYLOAD_OK;
+  }
+  int64_t checksum = 0;
+};
+
+typedef PayloadRegistry<RegistryDecoder, REGISTRY_SCHEMAS> Registry;
+
+// RxPacket slots like the gateway's queue, frames at the start of each
+static double nsPerDispatch(Registry &registry, const std::vector<RxPacket> &packets, int64_t &checksum) {
+  RegistryDecoder decoder;
+  double ns = nsPerFrame(ROUNDS, FRAME_COUNT, [&](size_t i) { registry.dispatch(&decoder, packets[i]); });
+  checksum = decoder.checksum;
+  return ns;
+}
+
+int main() {
+  // Odd stride so most frames start unaligned
+  const size_t stride = PAYLOAD_METER_SIZE + 1;
+  std::vector<uint8_t> frames(FRAME_COUNT * stride);
+  std::vector<MeterData> sent(FRAME_COUNT);
+
+  for(size_t i = 0; i < FRAME_COUNT; i++) {
+    sent[i] = benchReading(i, NODES);
+    encodeMeterPayload(&frames[i * stride], (uint16_t)(i % NODES), sent[i]);
+  }
+
+  // Correctness: every field, header and rejection paths
+  for(size_t i = 0; i < FRAME_COUNT; i++) {
+    MeterPayloadView view;
+    const MeterData &data = sent[i];
+    if(MeterPayloadView::parse(&frames[i * stride], PAYLOAD_METER_SIZE, view) != PAYLOAD_OK ||
+       view.nodeId() != i % NODES || view.version() != PAYLOAD_METER_VERSION ||
+       view.powerMw() != data.power_mw || view.consumptionMwh() != data.total_consumption_mwh ||
+       view.generationMwh() != data.total_generation_mwh || view.batteryMv() != data.battery_mv ||
+       view.packetCounter() != data.packet_counter) {
+      fprintf(stderr, "FAIL: frame %zu decoded wrong\n", i);
+      return 1;
+    }
+  }
+  MeterPayloadView view;
+  uint8_t bad[PAYLOAD_METER_SIZE];
+  memcpy(bad, &frames[0], sizeof(bad));
+  bad[1] = PAYLOAD_METER_SIGNED_VERSION + 1;
+  if(MeterPayloadView::parse(bad, sizeof(bad), view) != PAYLOAD_UNSUPPORTED_VERSION ||
+     MeterPayloadView::parse(bad, 3, view) != PAYLOAD_TOO_SHORT ||
+     MeterPayloadView::parse(&frames[0], PAYLOAD_METER_SIZE - 1, view) != PAYLOAD_BAD_LENGTH ||
+     MeterPayloadView::parse((const uint8_t *)&sent[5], sizeof(MeterData), view) == PAYLOAD_OK) {
+    fprintf(stderr, "FAIL: validation paths\n");
+    return 1;
+  }
+
+  int64_t checksumCopy = 0;
+  int64_t checksumView = 0;
+  double copyNs = nsPerFrame(ROUNDS, FRAME_COUNT, [&](size_t i) {
+    checksumCopy += decodeWithCopy(&frames[i * stride], PAYLOAD_METER_SIZE);
+  });
+  double viewNs = nsPerFrame(ROUNDS, FRAME_COUNT, [&](size_t i) {
+    checksumView += decodeInPlace(&frames[i * stride], PAYLOAD_METER_SIZE);
+  });
+  if(checksumCopy != checksumView) {
+    fprintf(stderr, "FAIL: checksum mismatch\n");
+    return 1;
+  }
+
+  // Registry: the gateway's schemas, then every slot taken
+  std::vector<RxPacket> packets(FRAME_COUNT);
+  for(size_t i = 0; i < FRAME_COUNT; i++) {
+    packets[i].length = PAYLOAD_METER_SIZE;
+    memcpy(packets[i].data, &frames[i * stride], PAYLOAD_METER_SIZE);
+  }
+  Registry few;
+  few.add(PAYLOAD_SCHEMA_METER, "meter", PAYLOAD_METER_VERSION, PAYLOAD_METER_SIGNED_VERSION,
+          &RegistryDecoder::meter);
+  few.add(PAYLOAD_SCHEMA_CONFIG_ACK, "config_ack", 1, 1, &RegistryDecoder::other);
+  few.add_unversioned(0xA5, "sweep_announce", &RegistryDecoder::other);
+  few.add_unversioned(0xA6, "sweep_probe", &RegistryDecoder::other);
+  Registry full;
+  for(uint8_t schema = 0x80; full.count() < REGISTRY_SCHEMAS - 1; schema++) {
+    full.add(schema, "filler", 1, 1, &RegistryDecoder::other);
+  }
+  full.add(PAYLOAD_SCHEMA_METER, "meter", PAYLOAD_METER_VERSION, PAYLOAD_METER_SIGNED_VERSION,
+           &RegistryDecoder::meter);
+  int64_t checksumFew = 0;
+  int64_t checksumFull = 0;
+  double fewNs = nsPerDispatch(few, packets, checksumFew);
+  double fullNs = nsPerDispatch(full, packets, checksumFull);
+  RegistryDecoder decoder;
+  uint8_t unknown[PAYLOAD_METER_SIZE];
+  memcpy(unknown, &frames[0], sizeof(unknown));
+  unknown[0] = 0x42;
+  packets[0].length = sizeof(unknown);
+  memcpy(packets[0].data, unknown, sizeof(unknown));
+  if(checksumFew != checksumView || checksumFull != checksumView ||
+     few.dispatch(&decoder, packets[0]) != PAYLOAD_UNKNOWN_SCHEMA || few.rejected() != 1 ||
+     few.stats(0).frames.value() != (uint32_t)ROUNDS * FRAME_COUNT) {
+    fprintf(stderr, "FAIL: registry dispatch\n");
+    return 1;
+  }
+
+  printf("payload decode (%d frames x %d rounds, %zu bytes, unaligned)\n", FRAME_COUNT, ROUNDS,
+         (size_t)PAYLOAD_METER_SIZE);
+  printf("  vector copy + memcpy   %7.2f ns/frame\n", copyNs);
+  printf("  MeterPayloadView       %7.2f ns/frame\n", viewNs);
+  printf("  registry, %2zu schemas  %7.2f ns/frame\n", few.count(), fewNs);
+  printf("  registry, %2zu schemas  %7.2f ns/frame\n", full.count(), fullNs);
+  return 0;
+}
@@ -0,0 +1,369 @@
+/*
+ * Gateway Pipeline Benchmark
+ * Load generator for the host gateway's per-packet path
+ * (gateway_pipeline.h: decode, per-node state, link stats, MQTT/VZ
+ * formatting). Outputs are stand-ins that only consume what the
+ * pipeline built, so sockets and brokers do not blur the numbers.
+ *
+ *   1. throughput: unpaced on one thread, with heap allocations per packet
+ *   2. latency: a producer thread injects at fixed rates through the
+ *      component's SPSC PacketQueue, the consumer runs the pipeline;
+ *      latency is injection to end of processing
+ *
+ * Packets are simulated meter frames from --nodes node IDs, or frames
+ * recorded with lora_gatewayd --record (--replay FILE). Exits non-zero
+ * when a result crosses its regression limit.
+ *
+ *   make -C host bench
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+#include <vector>
+#include "gateway_pipeline.h"
+#include "packet_source.h"
+
+using esphome::lora_receiver::PacketQueue;
+
+// Regression limits; allocations are deterministic, timings are loose
+// enough for a busy single-core CI runner
+#define MAX_ALLOCS_PER_PACKET 6.0
+#define MIN_THROUGHPUT_PPS    100000.0
+#define MAX_P99_US            20000.0
+#define MAX_DROP_PERCENT      0.1
+
+static std::atomic<uint64_t> allocations(0);
+
+void *operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void *p = malloc(size == 0 ? 1 : size);
+  if(p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// Output stand-ins with the MqttClient / VzPush signatures
+struct NullMqtt {
+  void publish(const char *topic, const uint8_t *, size_t length, bool) {
+    bytes += strlen(topic) + length;
+    count++;
+  }
+  uint64_t bytes = 0;
+  uint64_t count = 0;
+};
+
+struct NullVz {
+  int channel(const std::string &) { return channels++; }
+  void add(int, uint64_t timestampMs, int64_t valueMilli) {
+    bytes += sizeof(timestampMs) + sizeof(valueMilli);
+    count++;
+  }
+  int channels = 0;
+  uint64_t bytes = 0;
+  uint64_t count = 0;
+};
+
+typedef GatewayPipeline<NullMqtt, NullVz> BenchPipeline;
+
+struct Setup {
+  NullMqtt mqtt;
+  NullVz vz;
+  BenchPipeline pipeline;
+
+  Setup(const std::vector<uint16_t> &nodes, ReadingFormat format) {
+    pipeline.setMqtt(&mqtt, "lora_gateway", format);
+    pipeline.setVz(&vz);
+    // Typical Volkszähler setup: power and consumption per meter
+    for(size_t i = 0; i < nodes.size(); i++) {
+      char uuid[40];
+      snprintf(uuid, sizeof(uuid), "00000000-0000-4000-8000-%012x", nodes[i]);
+      pipeline.addVzChannel(nodes[i], VzChannel{VZ_POWER, uuid, -1});
+      uuid[0] = '1';
+      pipeline.addVzChannel(nodes[i], VzChannel{VZ_CONSUMPTION, uuid, -1});
+    }
+  }
+};
+
+// Every node sends every 60 s; about 2% of the counters are skipped as loss
+static void simulatePackets(size_t nodeCount, size_t count, std::vector<RxPacket> &packets,
+                            std::vector<uint16_t> &nodes) {
+  packets.resize(count);
+  nodes.clear();
+  for(size_t n = 0; n < nodeCount; n++) {
+    nodes.push_back((uint16_t)(0x1000 + n * 7));
+  }
+  uint32_t seed = 12345;
+  for(size_t i = 0; i < count; i++) {
+    seed = seed * 1103515245u + 12345u;
+    size_t n = i % nodeCount;
+    uint32_t round = (uint32_t)(i / nodeCount);
+    MeterData data;
+    data.power_mw = (int32_t)((seed >> 8) % 4000000) - 500000;
+    data.total_consumption_mwh = 4200000000LL + (int64_t)round * 5000 + (int64_t)n;
+    data.total_generation_mwh = 1000000LL * (int64_t)(n % 5);
+    data.battery_mv = (uint16_t)(3300 + seed % 900);
+    data.packet_counter = round + 1 + round / 50;
+    RxPacket &packet = packets[i];
+    packet.length = (uint8_t)encodeMeterPayload(packet.data, nodes[n], data);
+    packet.rssi = (int16_t)(-60 - (int)(seed % 60));
+    packet.snr = (int)(seed % 40) / 4.0f - 2.0f;
+  }
+}
+
+static bool replayPackets(const char *path, std::vector<RxPacket> &packets, std::vector<uint16_t> &nodes) {
+  FILE *file = fopen(path, "rb");
+  if(file == nullptr) {
+    perror(path);
+    return false;
+  }
+  std::vector<uint8_t> bytes;
+  uint8_t buffer[4096];
+  size_t n;
+  while((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    bytes.insert(bytes.end(), buffer, buffer + n);
+  }
+  fclose(file);
+  size_t pos = 0;
+  RxPacket packet;
+  while(size_t used = decodeSimFrame(bytes.data() + pos, bytes.size() - pos, packet)) {
+    packets.push_back(packet);
+    pos += used;
+    MeterPayloadView view;
+    if(MeterPayloadView::parse(packet.data, packet.length, view) == PAYLOAD_OK &&
+       std::find(nodes.begin(), nodes.end(), view.nodeId()) == nodes.end()) {
+      nodes.push_back(view.nodeId());
+    }
+  }
+  return !packets.empty();
+}
+
+// Receive time advances by one send interval per round of all nodes
+static uint32_t receiveTimeMs(size_t index, size_t nodeCount) {
+  return (uint32_t)((uint64_t)index * 60000 / nodeCount);
+}
+
+static uint64_t nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct LatencyResult {
+  uint32_t rate;
+  uint64_t injected;
+  uint64_t dropped;
+  double p50Us;
+  double p99Us;
+  double maxUs;
+};
+
+static LatencyResult runAtRate(const std::vector<RxPacket> &packets, const std::vector<uint16_t> &nodes,
+                               ReadingFormat format,
+                               uint32_t rate, double seconds) {
+  Setup setup(nodes, format);
+  static PacketQueue<256> queue;
+  while(queue.peek() != nullptr) {
+    queue.release();
+  }
+  uint64_t total = (uint64_t)(rate * seconds);
+  std::vector<uint64_t> injectedAt(total);
+  std::vector<double> latencies;
+  latencies.reserve(total);
+  std::atomic<uint64_t> injected(0);
+  std::atomic<bool> done(false);
+  uint32_t droppedBefore = queue.dropped();
+
+  std::thread consumer([&]() {
+    uint64_t sequence = 0;
+    while(true) {
+      const RxPacket *packet = queue.peek();
+      if(packet == nullptr) {
+        if(done.load(std::memory_order_acquire) && sequence == injected.load(std::memory_order_acquire)) {
+          break;
+        }
+        std::this_thread::yield();
+        continue;
+      }
+      setup.pipeline.process(*packet);
+      queue.release();
+      latencies.push_back((nowNs() - injectedAt[sequence++]) / 1000.0);
+    }
+  });
+
+  // Sleep while ahead of schedule, catch up in bursts when behind
+  uint64_t start = nowNs();
+  uint64_t intervalNs = 1000000000ull / rate;
+  for(uint64_t i = 0; i < total; i++) {
+    uint64_t due = start + i * intervalNs;
+    uint64_t now = nowNs();
+    if(due > now + 50000) {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+    }
+    RxPacket *slot = queue.acquire();
+    if(slot == nullptr) {
+      continue;
+    }
+    *slot = packets[i % packets.size()];
+    slot->timestamp_ms = receiveTimeMs(i, nodes.size());
+    injectedAt[injected.load(std::memory_order_relaxed)] = nowNs();
+    queue.commit();
+    injected.fetch_add(1, std::memory_order_release);
+  }
+  done.store(true, std::memory_order_release);
+  consumer.join();
+
+  LatencyResult result;
+  result.rate = rate;
+  result.injected = injected.load();
+  result.dropped = queue.dropped() - droppedBefore;
+  std::sort(latencies.begin(), latencies.end());
+  result.p50Us = latencies.empty() ? 0 : latencies[latencies.size() / 2];
+  result.p99Us = latencies.empty() ? 0 : latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+  result.maxUs = latencies.empty() ? 0 : latencies.back();
+  return result;
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  --nodes N            simulated node IDs (default 50)\n"
+          "  --replay FILE        frames recorded with lora_gatewayd --record\n"
+          "  --format F           MQTT payload: json, cbor or binary (json)\n"
+          "  --packets N          packets for the throughput run (default 500000)\n"
+          "  --rates LIST         injection rates in packets/s (default 1000,20000)\n"
+          "  --seconds S          duration per rate (default 1)\n"
+          "  --max-allocs N       allocations per packet limit (%.0f)\n"
+          "  --min-pps N          throughput limit (%.0f)\n"
+          "  --max-p99-us N       p99 latency limit at every rate (%.0f)\n",
+          name, MAX_ALLOCS_PER_PACKET, MIN_THROUGHPUT_PPS, MAX_P99_US);
+}
+
+int main(int argc, char **argv) {
+  static const struct option options[] = {
+    {"nodes", required_argument, nullptr, 'n'},
+    {"replay", required_argument, nullptr, 'r'},
+    {"format", required_argument, nullptr, 'f'},
+    {"packets", required_argument, nullptr, 'p'},
+    {"rates", required_argument, nullptr, 'R'},
+    {"seconds", required_argument, nullptr, 's'},
+    {"max-allocs", required_argument, nullptr, 'a'},
+    {"min-pps", required_argument, nullptr, 't'},
+    {"max-p99-us", required_argument, nullptr, 'l'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  size_t nodeCount = 50;
+  const char *replay = nullptr;
+  ReadingFormat format = esphome::lora_receiver::READING_JSON;
+  size_t packetCount = 500000;
+  std::vector<uint32_t> rates = {1000, 20000};
+  double seconds = 1.0;
+  double maxAllocs = MAX_ALLOCS_PER_PACKET;
+  double minPps = MIN_THROUGHPUT_PPS;
+  double maxP99Us = MAX_P99_US;
+
+  int opt;
+  while((opt = getopt_long(argc, argv, "", options, nullptr)) != -1) {
+    switch(opt) {
+      case 'n': nodeCount = std::max(1, atoi(optarg)); break;
+      case 'r': replay = optarg; break;
+      case 'f':
+        if(!esphome::lora_receiver::parse_reading_format(optarg, format)) {
+          usage(argv[0]);
+          return 2;
+        }
+        break;
+      case 'p': packetCount = std::max(1L, atol(optarg)); break;
+      case 'R': {
+        rates.clear();
+        for(char *p = optarg; *p != '\0';) {
+          char *end;
+          unsigned long rate = strtoul(p, &end, 10);
+          if(end == p || rate == 0) {
+            usage(argv[0]);
+            return 2;
+          }
+          rates.push_back((uint32_t)rate);
+          p = *end == ',' ? end + 1 : end;
+        }
+        break;
+      }
+      case 's': seconds = atof(optarg); break;
+      case 'a': maxAllocs = atof(optarg); break;
+      case 't': minPps = atof(optarg); break;
+      case 'l': maxP99Us = atof(optarg); break;
+      default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+    }
+  }
+
+  std::vector<RxPacket> packets;
+  std::vector<uint16_t> nodes;
+  if(replay != nullptr) {
+    if(!replayPackets(replay, packets, nodes) || nodes.empty()) {
+      fprintf(stderr, "FAIL: no meter frames in %s\n", replay);
+      return 1;
+    }
+  } else {
+    simulatePackets(nodeCount, 4096 - 4096 % nodeCount, packets, nodes);
+  }
+
+  // 1. Throughput and allocations; the first pass fills the node table
+  Setup setup(nodes, format);
+  for(size_t i = 0; i < packets.size(); i++) {
+    RxPacket &packet = packets[i];
+    packet.timestamp_ms = receiveTimeMs(i, nodes.size());
+    setup.pipeline.process(packet);
+  }
+  uint64_t allocationsBefore = allocations.load();
+  uint64_t start = nowNs();
+  for(size_t i = 0; i < packetCount; i++) {
+    RxPacket &packet = packets[i % packets.size()];
+    packet.timestamp_ms = receiveTimeMs(packets.size() + i, nodes.size());
+    setup.pipeline.process(packet);
+  }
+  double elapsedS = (nowNs() - start) / 1e9;
+  double allocsPerPacket = (double)(allocations.load() - allocationsBefore) / packetCount;
+  double pps = packetCount / elapsedS;
+
+  printf("gateway pipeline (%zu nodes, %s, %zu B %s mqtt + %zu B vz per packet)\n", nodes.size(),
+         replay != nullptr ? replay : "simulated", (size_t)(setup.mqtt.bytes / setup.pipeline.stats().packets),
+         esphome::lora_receiver::reading_format_name(format),
+         (size_t)(setup.vz.bytes / setup.pipeline.stats().packets));
+  printf("  throughput    %10.0f packets/s  %7.1f ns/packet  %5.1f allocs/packet\n", pps, 1e9 / pps, allocsPerPacket);
+
+  // 2. Latency under paced load
+  bool failed = false;
+  for(size_t i = 0; i < rates.size(); i++) {
+    LatencyResult result = runAtRate(packets, nodes, format, rates[i], seconds);
+    double dropPercent = 100.0 * result.dropped / std::max<uint64_t>(result.injected + result.dropped, 1);
+    printf("  %7u/s       p50 %8.1f us  p99 %8.1f us  max %9.1f us  dropped %.2f%%\n", result.rate, result.p50Us,
+           result.p99Us, result.maxUs, dropPercent);
+    if(result.p99Us > maxP99Us) {
+      fprintf(stderr, "FAIL: p99 %.1f us at %u/s over %.0f us\n", result.p99Us, result.rate, maxP99Us);
+      failed = true;
+    }
+    if(dropPercent > MAX_DROP_PERCENT) {
+      fprintf(stderr, "FAIL: %.2f%% dropped at %u/s\n", dropPercent, result.rate);
+      failed = true;
+    }
+  }
+
+  if(allocsPerPacket > maxAllocs) {
+    fprintf(stderr, "FAIL: %.1f allocations per packet over %.1f\n", allocsPerPacket, maxAllocs);
+    failed = true;
+  }
+  if(pps < minPps) {
+    fprintf(stderr, "FAIL: %.0f packets/s under %.0f\n", pps, minPps);
+    failed = true;
+  }
+  return failed ? 1 : 0;
+}
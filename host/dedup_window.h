@@ -0,0 +1,286 @@
+/*
+ * Dedup Window
+ * Multi-gateway diversity for the host aggregator. Every gateway that
+ * hears a packet forwards it; the window keeps one entry per
+ * (node, packet counter, epoch), collects the copies for the hold time
+ * and then hands the one with the best SNR on, together with the set of
+ * gateways that heard it. Copies arriving after that are late duplicates
+ * and only counted.
+ *
+ * Entries sit in a ring in arrival order with an open-addressing index
+ * beside it, so lookup, insert and expiry are O(1) and memory is fixed:
+ * nothing is allocated per packet, only once per node for its epoch.
+ */
+
+#ifndef DEDUP_WINDOW_H
+#define DEDUP_WINDOW_H
+
+#include <stdint.h>
+#include <string.h>
+#include <unordered_map>
+#include "lora_payload.h"
+#include "packet_queue.h"
+
+using esphome::lora_receiver::RxPacket;
+
+#define DEDUP_MAX_GATEWAYS 32
+
+// Who heard a forwarded packet
+struct Reception {
+  uint32_t gateways = 0;  // Bit per gateway index
+  uint8_t best = 0;       // Gateway of the forwarded copy
+  uint8_t copies = 0;
+};
+
+struct DedupStats {
+  uint64_t unique = 0;
+  uint64_t duplicates = 0;  // Merged while held
+  uint64_t late = 0;        // Arrived after the packet was forwarded
+  uint64_t evicted = 0;     // Forwarded early because the ring was full
+  uint64_t epochs = 0;      // Node reboots seen
+  uint64_t heard[DEDUP_MAX_GATEWAYS] = {};
+  uint64_t best[DEDUP_MAX_GATEWAYS] = {};
+};
+
+// Capacity bounds the packets in flight over the window, power of two.
+// Sink is called as sink(const RxPacket &, const Reception &).
+template <size_t Capacity>
+class DedupWindow {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "DedupWindow capacity must be a power of two");
+
+ public:
+  // holdMs trades latency for diversity: it must cover the spread of
+  // gateway-to-aggregator delays. windowMs catches late copies and is
+  // far below any node's send interval.
+  DedupWindow(uint32_t holdMs, uint32_t windowMs)
+      : holdMs_(holdMs), windowMs_(windowMs > holdMs ? windowMs : holdMs) {
+    for(size_t i = 0; i < INDEX_SIZE; i++) {
+      index_[i] = EMPTY;
+    }
+  }
+
+  // Packets that are not meter readings pass straight through
+  template <class Sink>
+  void add(const RxPacket &packet, uint8_t gateway, uint64_t nowMs, Sink &sink) {
+    if(gateway >= DEDUP_MAX_GATEWAYS) {
+      gateway = DEDUP_MAX_GATEWAYS - 1;
+    }
+    expire(nowMs, sink);
+    stats_.heard[gateway]++;
+    MeterPayloadView view;
+    if(MeterPayloadView::parse(packet.data, packet.length, view) != PAYLOAD_OK) {
+      Reception single;
+      single.gateways = 1u << gateway;
+      single.best = gateway;
+      single.copies = 1;
+      sink(packet, single);
+      return;
+    }
+    uint16_t node = view.nodeId();
+    uint32_t counter = view.packetCounter();
+    NodeEpoch &state = nodeEpoch(node, counter);
+    uint64_t key = makeKey(node, counter, state.epoch);
+
+    size_t slot = find(key);
+    if(slot != EMPTY) {
+      Entry &entry = ring_[slot];
+      entry.reception.gateways |= 1u << gateway;
+      if(entry.reception.copies < 255) {
+        entry.reception.copies++;
+      }
+      if(!isPending(slot)) {
+        stats_.late++;
+        return;
+      }
+      stats_.duplicates++;
+      if(packet.snr > entry.packet.snr) {
+        entry.packet = packet;
+        entry.reception.best = gateway;
+      }
+      return;
+    }
+
+    if(advance(state, counter)) {
+      key = makeKey(node, counter, state.epoch);
+    }
+    if(count_ == Capacity) {
+      stats_.evicted++;
+      popOldest(sink);
+    }
+    stats_.unique++;
+    slot = (head_ + count_) & (Capacity - 1);
+    Entry &entry = ring_[slot];
+    entry.key = key;
+    entry.firstMs = nowMs;
+    entry.packet = packet;
+    entry.reception.gateways = 1u << gateway;
+    entry.reception.best = gateway;
+    entry.reception.copies = 1;
+    count_++;
+    insertIndex(key, slot);
+    flush(nowMs, sink);
+  }
+
+  // Forward packets whose hold time has passed
+  template <class Sink>
+  void flush(uint64_t nowMs, Sink &sink) {
+    while(forwarded_ < count_) {
+      Entry &entry = ring_[(head_ + forwarded_) & (Capacity - 1)];
+      if(nowMs - entry.firstMs < holdMs_) {
+        break;
+      }
+      forward(entry, sink);
+      forwarded_++;
+    }
+  }
+
+  // Forward everything still held, e.g. at the end of input
+  template <class Sink>
+  void drain(Sink &sink) {
+    while(forwarded_ < count_) {
+      forward(ring_[(head_ + forwarded_) & (Capacity - 1)], sink);
+      forwarded_++;
+    }
+  }
+
+  const DedupStats &stats() const { return stats_; }
+  size_t size() const { return count_; }
+  size_t pending() const { return count_ - forwarded_; }
+  uint32_t holdMs() const { return holdMs_; }
+
+ private:
+  static const size_t INDEX_SIZE = Capacity * 2;  // Load factor <= 0.5 keeps probes short
+  static const size_t EMPTY = (size_t)-1;
+  static const uint32_t REORDER = 16;     // Counters this far behind are late copies, not a reboot
+  static const uint32_t MAX_GAP = 1000;   // Same resync rule as SequenceTracker
+
+  struct Entry {
+    uint64_t key;
+    uint64_t firstMs;
+    Reception reception;
+    RxPacket packet;
+  };
+
+  struct NodeEpoch {
+    uint32_t last;
+    uint16_t epoch;
+  };
+
+  NodeEpoch &nodeEpoch(uint16_t node, uint32_t counter) {
+    auto it = epochs_.find(node);
+    if(it == epochs_.end()) {
+      NodeEpoch fresh = {counter, 0};
+      it = epochs_.insert(std::make_pair(node, fresh)).first;
+    }
+    return it->second;
+  }
+
+  // A node that reboots starts its counter again; the epoch keeps its new
+  // packets from matching entries of the previous run still in the window.
+  // Only called for counters not in the window, so a late copy never
+  // looks like a reboot. True when the epoch changed.
+  bool advance(NodeEpoch &state, uint32_t counter) {
+    uint32_t ahead = counter - state.last;
+    if(ahead <= MAX_GAP) {
+      state.last = counter;
+      return false;
+    }
+    if(state.last - counter <= REORDER) {
+      return false;  // Reordered between gateways
+    }
+    state.epoch++;
+    state.last = counter;
+    stats_.epochs++;
+    return true;
+  }
+
+  static uint64_t makeKey(uint16_t node, uint32_t counter, uint16_t epoch) {
+    return ((uint64_t)node << 48) | ((uint64_t)epoch << 32) | counter;
+  }
+
+  static size_t home(uint64_t key) { return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (INDEX_SIZE - 1); }
+
+  bool isPending(size_t slot) const {
+    return ((slot - head_) & (Capacity - 1)) >= forwarded_;
+  }
+
+  size_t find(uint64_t key) const {
+    for(size_t i = home(key);; i = (i + 1) & (INDEX_SIZE - 1)) {
+      if(index_[i] == EMPTY) {
+        return EMPTY;
+      }
+      if(ring_[index_[i]].key == key) {
+        return index_[i];
+      }
+    }
+  }
+
+  void insertIndex(uint64_t key, size_t slot) {
+    size_t i = home(key);
+    while(index_[i] != EMPTY) {
+      i = (i + 1) & (INDEX_SIZE - 1);
+    }
+    index_[i] = slot;
+  }
+
+  // Backward-shift deletion: no tombstones, so probe chains never grow
+  void eraseIndex(uint64_t key) {
+    size_t i = home(key);
+    while(ring_[index_[i]].key != key) {
+      i = (i + 1) & (INDEX_SIZE - 1);
+    }
+    size_t j = i;
+    for(;;) {
+      j = (j + 1) & (INDEX_SIZE - 1);
+      if(index_[j] == EMPTY) {
+        break;
+      }
+      size_t k = home(ring_[index_[j]].key);
+      // Move j back into the hole unless its home lies cyclically in (i, j]
+      bool stays = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+      if(!stays) {
+        index_[i] = index_[j];
+        i = j;
+      }
+    }
+    index_[i] = EMPTY;
+  }
+
+  template <class Sink>
+  void forward(Entry &entry, Sink &sink) {
+    stats_.best[entry.reception.best]++;
+    sink(entry.packet, entry.reception);
+  }
+
+  template <class Sink>
+  void popOldest(Sink &sink) {
+    if(forwarded_ == 0) {
+      forward(ring_[head_], sink);
+    } else {
+      forwarded_--;
+    }
+    eraseIndex(ring_[head_].key);
+    head_ = (head_ + 1) & (Capacity - 1);
+    count_--;
+  }
+
+  template <class Sink>
+  void expire(uint64_t nowMs, Sink &sink) {
+    flush(nowMs, sink);
+    while(count_ > 0 && nowMs - ring_[head_].firstMs >= windowMs_) {
+      popOldest(sink);
+    }
+  }
+
+  uint32_t holdMs_;
+  uint32_t windowMs_;
+  Entry ring_[Capacity];
+  size_t index_[INDEX_SIZE];
+  size_t head_ = 0;
+  size_t count_ = 0;
+  size_t forwarded_ = 0;  // Entries from head_ already handed to the sink
+  std::unordered_map<uint16_t, NodeEpoch> epochs_;
+  DedupStats stats_;
+};
+
+#endif // DEDUP_WINDOW_H
@@ -0,0 +1,150 @@
+/*
+ * Event Loop
+ * Minimal epoll dispatcher for the host gateway: one handler per fd,
+ * timers and signals are timerfd/signalfd on the same loop
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class EventLoop {
+ public:
+  typedef std::function<void(uint32_t events)> Handler;
+
+  EventLoop() : epollFd_(epoll_create1(EPOLL_CLOEXEC)) {}
+  ~EventLoop() {
+    for(auto &entry : owned_) {
+      close(entry);
+    }
+    close(epollFd_);
+  }
+
+  bool add(int fd, uint32_t events, Handler handler) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    if(epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+      perror("epoll_ctl add");
+      return false;
+    }
+    handlers_[fd] = std::make_shared<Handler>(handler);
+    return true;
+  }
+
+  bool modify(int fd, uint32_t events) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    return epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev) == 0;
+  }
+
+  // Safe to call from inside the fd's own handler
+  void remove(int fd) {
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+    handlers_.erase(fd);
+  }
+
+  // Periodic timer; returns the timerfd (owned by the loop) or -1
+  int addTimer(uint32_t intervalMs, std::function<void()> callback) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(fd < 0) {
+      return -1;
+    }
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = intervalMs / 1000;
+    spec.it_interval.tv_nsec = (intervalMs % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+    timerfd_settime(fd, 0, &spec, nullptr);
+    owned_.push_back(fd);
+    add(fd, EPOLLIN, [fd, callback](uint32_t) {
+      uint64_t expirations;
+      if(read(fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+        callback();
+      }
+    });
+    return fd;
+  }
+
+  // Stop the loop cleanly on SIGINT/SIGTERM
+  bool stopOnSignals() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    int fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if(fd < 0) {
+      return false;
+    }
+    owned_.push_back(fd);
+    return add(fd, EPOLLIN, [this](uint32_t) { stop(); });
+  }
+
+  void run() {
+    struct epoll_event events[64];
+    running_ = true;
+    while(running_) {
+      int n = epoll_wait(epollFd_, events, 64, -1);
+      if(n < 0) {
+        if(errno == EINTR) {
+          continue;
+        }
+        perror("epoll_wait");
+        return;
+      }
+      for(int i = 0; i < n && running_; i++) {
+        auto it = handlers_.find(events[i].data.fd);
+        if(it == handlers_.end()) {
+          continue;  // Removed by an earlier handler in this batch
+        }
+        std::shared_ptr<Handler> handler = it->second;
+        (*handler)(events[i].events);
+      }
+    }
+  }
+
+  void stop() { running_ = false; }
+
+  static bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+  }
+
+  static uint64_t monotonicMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+  }
+
+  static uint64_t wallClockMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+  }
+
+ private:
+  int epollFd_;
+  bool running_ = false;
+  std::unordered_map<int, std::shared_ptr<Handler>> handlers_;
+  std::vector<int> owned_;
+};
+
+#endif // EVENT_LOOP_H
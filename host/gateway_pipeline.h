@@ -0,0 +1,300 @@
+/*
+ * Gateway Pipeline
+ * Per-packet work of the host gateway: decode, per-node state and link
+ * statistics, then the MQTT and Volkszähler outputs. Shared by
+ * lora_gatewayd and bench_pipeline, so the benchmark measures the code
+ * that runs in production. MqttT needs publish(topic, payload, length,
+ * retain), VzT needs channel(uuid) and add(channel, timestampMs,
+ * valueMilli). MQTT payloads come from lora_receiver/reading_codec.h, as
+ * on the ESP32 gateway. Behind a DedupWindow the Reception of each packet
+ * adds "via" and "heard_by" to the JSON state; admit() keeps copies whose
+ * tag does not verify out of the window. Meter frames of nodes with a key
+ * (addKey) must be signed, see lora_receiver/node_keys.h. Frames
+ * reach their decoder through the same PayloadRegistry as on the ESP32,
+ * Meshtastic telemetry (src/meshtastic_telemetry.h) once a channel is set,
+ * from the senders added with addMeshtasticNode only.
+ */
+
+#ifndef GATEWAY_PIPELINE_H
+#define GATEWAY_PIPELINE_H
+
+#include <math.h>
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "dedup_window.h"
+#include "event_loop.h"
+#include "link_stats.h"
+#include "node_keys.h"
+#include "lora_payload.h"
+#include "meshtastic_nodes.h"
+#include "meshtastic_telemetry.h"
+#include "packet_queue.h"
+#include "payload_registry.h"
+#include "range_sweep.h"
+#include "reading_codec.h"
+
+using esphome::lora_receiver::LinkStats;
+using esphome::lora_receiver::MeshtasticNodes;
+using esphome::lora_receiver::MeterReading;
+using esphome::lora_receiver::NodeKeys;
+using esphome::lora_receiver::PayloadRegistry;
+using esphome::lora_receiver::ReadingFormat;
+using esphome::lora_receiver::ReadingText;
+using esphome::lora_receiver::RxPacket;
+
+enum VzKind { VZ_POWER, VZ_CONSUMPTION, VZ_GENERATION };
+
+struct VzChannel {
+  VzKind kind;
+  std::string uuid;
+  int index;  // VzT channel
+};
+
+struct NodeState {
+  LinkStats link;
+  uint32_t packets = 0;
+};
+
+struct GatewayStats {
+  uint64_t packets = 0;
+  uint64_t meter = 0;
+  uint64_t sweep = 0;
+  uint64_t decodeErrors = 0;
+  uint64_t authErrors = 0;
+};
+
+#define PIPELINE_MAX_KEYS    256
+#define PIPELINE_MAX_SCHEMAS 8
+
+template <class MqttT, class VzT>
+class GatewayPipeline {
+ public:
+  GatewayPipeline() {
+    payloads_.add(PAYLOAD_SCHEMA_METER, "meter", PAYLOAD_METER_VERSION, PAYLOAD_METER_SIGNED_VERSION,
+                  &GatewayPipeline::decodeMeter);
+    // The host gateway does not follow sweeps
+    payloads_.add_unversioned(SWEEP_FRAME_ANNOUNCE, "sweep_announce", &GatewayPipeline::decodeSweep);
+    payloads_.add_unversioned(SWEEP_FRAME_PROBE, "sweep_probe", &GatewayPipeline::decodeSweep);
+  }
+
+  void setMqtt(MqttT *mqtt, const std::string &prefix, ReadingFormat format = esphome::lora_receiver::READING_JSON) {
+    mqtt_ = mqtt;
+    prefix_ = prefix;
+    format_ = format;
+  }
+  void setVz(VzT *vz) { vz_ = vz; }
+  // After setVz(); false when the output has no channel left
+  bool addVzChannel(uint16_t node, VzChannel channel) {
+    channel.index = vz_->channel(channel.uuid);
+    if(channel.index < 0) {
+      return false;
+    }
+    vzChannels_.insert(std::make_pair(node, channel));
+    return true;
+  }
+  // false when the key table is full
+  bool addKey(uint16_t node, const uint8_t key[AES_KEY_SIZE]) { return keys_.add(node, key); }
+  void setRequireSigned(bool require) { keys_.set_require_signed(require); }
+  // false when it was set before
+  bool setMeshtasticChannel(const char *name, const uint8_t key[AES_KEY_SIZE]) {
+    meshtastic_.set(name, key);
+    return payloads_.add_unversioned(PAYLOAD_SCHEMA_MESHTASTIC, "meshtastic", &GatewayPipeline::decodeMeshtastic);
+  }
+  // Sender num reports as node; false when the table is full or node is taken
+  bool addMeshtasticNode(uint32_t num, uint16_t node) { return meshtasticNodes_.add(num, node); }
+  void setVerbose(bool verbose) { verbose_ = verbose; }
+  // Names by gateway index for Reception, owned by the caller
+  void setGatewayNames(const std::vector<std::string> *names) { gatewayNames_ = names; }
+
+  void process(const RxPacket &packet, const Reception *reception = nullptr) {
+    stats_.packets++;
+    reception_ = reception;
+    PayloadStatus status = payloads_.dispatch(this, packet);
+    if(status == PAYLOAD_OK || payloadAuthError(status)) {
+      return;
+    }
+    stats_.decodeErrors++;
+    if(verbose_) {
+      fprintf(stderr, "dropped %u byte packet, schema 0x%02X: %s\n", packet.length,
+              packet.length > 0 ? packet.data[0] : 0, payloadStatusName(status));
+    }
+  }
+
+  // Before DedupWindow::add: the window keys on the unauthenticated node
+  // and counter and keeps the best SNR, so a forged copy let in would
+  // displace the genuine frame. false for a meter frame that check()
+  // would refuse for its key or tag, counted as an auth error.
+  bool admit(const RxPacket &packet) {
+    MeterPayloadView view;
+    if(packet.length == 0 || packet.data[0] != PAYLOAD_SCHEMA_METER ||
+       MeterPayloadView::parse(packet.data, packet.length, view) != PAYLOAD_OK) {
+      return true;
+    }
+    PayloadStatus status = keys_.verify(packet.data, view);
+    if(status == PAYLOAD_OK) {
+      return true;
+    }
+    stats_.authErrors++;
+    if(verbose_) {
+      fprintf(stderr, "dropped copy of node %04X, counter %u: %s\n", view.nodeId(), (unsigned)view.packetCounter(),
+              payloadStatusName(status));
+    }
+    return false;
+  }
+
+  const GatewayStats &stats() const { return stats_; }
+  size_t nodeCount() const { return nodes_.size(); }
+
+ private:
+  PayloadStatus decodeMeter(const RxPacket &packet) {
+    MeterPayloadView view;
+    PayloadStatus status = MeterPayloadView::parse(packet.data, packet.length, view);
+    if(status != PAYLOAD_OK) {
+      return status;
+    }
+    return acceptMeter(packet.data, view, packet);
+  }
+
+  // As an unsigned meter frame of the node the sender is mapped to, which
+  // keyed nodes and --require-signed refuse
+  PayloadStatus decodeMeshtastic(const RxPacket &packet) {
+    uint16_t node;
+    PayloadStatus status = meshtasticNodes_.lookup(packet.data, packet.length, node);
+    if(status == PAYLOAD_UNKNOWN_NODE) {
+      stats_.authErrors++;
+    }
+    if(status != PAYLOAD_OK) {
+      return status;
+    }
+    MeshtasticReading reading;
+    status = parseMeshtasticTelemetry(packet.data, packet.length, meshtastic_, reading);
+    if(status != PAYLOAD_OK) {
+      return status;
+    }
+    uint8_t frame[PAYLOAD_METER_SIZE];
+    encodeMeterPayload(frame, node, reading.data);
+    MeterPayloadView view;
+    MeterPayloadView::parse(frame, sizeof(frame), view);
+    return acceptMeter(frame, view, packet);
+  }
+
+  // data is the meter frame view was parsed from
+  PayloadStatus acceptMeter(const uint8_t *data, const MeterPayloadView &view, const RxPacket &packet) {
+    PayloadStatus status = keys_.check(data, view);
+    if(status != PAYLOAD_OK) {
+      stats_.authErrors++;
+      if(verbose_) {
+        fprintf(stderr, "dropped frame of node %04X, counter %u: %s\n", view.nodeId(),
+                (unsigned)view.packetCounter(), payloadStatusName(status));
+      }
+      return status;
+    }
+    stats_.meter++;
+
+    NodeState &node = nodes_[view.nodeId()];
+    node.packets++;
+    node.link.update(packet.timestamp_ms, view.packetCounter(), packet.rssi, packet.snr);
+    uint64_t receivedMs = EventLoop::wallClockMs();
+
+    if(mqtt_ != nullptr) {
+      publishState(view, packet, node, receivedMs, reception_);
+    }
+    if(vz_ != nullptr) {
+      pushVz(view, receivedMs);
+    }
+    return PAYLOAD_OK;
+  }
+
+  PayloadStatus decodeSweep(const RxPacket &packet) {
+    if(packet.length != (packet.data[0] == SWEEP_FRAME_ANNOUNCE ? sizeof(SweepAnnounce) : sizeof(SweepProbe))) {
+      return PAYLOAD_BAD_LENGTH;
+    }
+    stats_.sweep++;
+    return PAYLOAD_OK;
+  }
+
+  void publishState(const MeterPayloadView &view, const RxPacket &packet, NodeState &node, uint64_t receivedMs,
+                    const Reception *reception) {
+    char topic[96];
+    snprintf(topic, sizeof(topic), "%s/%04X/state", prefix_.c_str(), view.nodeId());
+    MeterReading reading;
+    reading.node_id = view.nodeId();
+    reading.packet_counter = view.packetCounter();
+    reading.power_mw = view.powerMw();
+    reading.consumption_mwh = view.consumptionMwh();
+    reading.generation_mwh = view.generationMwh();
+    reading.battery_mv = view.batteryMv();
+    reading.rssi = packet.rssi;
+    reading.snr_db10 = (int16_t)lroundf(packet.snr * 10.0f);
+    reading.per_1h_centi = (uint16_t)lroundf(node.link.per_1h(packet.timestamp_ms) * 100.0f);
+    reading.lost = node.link.sequence().lost();
+    reading.timestamp_ms = receivedMs;
+    if(format_ != esphome::lora_receiver::READING_JSON || reception == nullptr || gatewayNames_ == nullptr) {
+      size_t length = esphome::lora_receiver::encode_reading(format_, reading, payload_);
+      mqtt_->publish(topic, payload_, length, true);
+      return;
+    }
+    ReadingText json = {(char *)payload_, 0, sizeof(payload_)};
+    json.len = esphome::lora_receiver::encode_reading_json_fields(reading, json.out, json.size);
+    appendReception(json, *reception);
+    json.print("}");
+    mqtt_->publish(topic, payload_, json.len, true);
+  }
+
+  void appendReception(ReadingText &json, const Reception &reception) {
+    json.print(",\"via\":\"");
+    json.print(gatewayName(reception.best).c_str());
+    json.print("\",\"heard_by\":[");
+    bool first = true;
+    for(uint8_t g = 0; g < DEDUP_MAX_GATEWAYS; g++) {
+      if(reception.gateways & (1u << g)) {
+        json.print(first ? "\"" : ",\"");
+        json.print(gatewayName(g).c_str());
+        json.print("\"");
+        first = false;
+      }
+    }
+    json.print("]");
+  }
+
+  std::string gatewayName(uint8_t gateway) const {
+    return gateway < gatewayNames_->size() ? (*gatewayNames_)[gateway] : std::to_string(gateway);
+  }
+
+  // Volkszähler takes W for power channels and Wh for meter totals;
+  // mW and mWh are exactly the thousandths the output expects
+  void pushVz(const MeterPayloadView &view, uint64_t receivedMs) {
+    auto range = vzChannels_.equal_range(view.nodeId());
+    for(auto it = range.first; it != range.second; ++it) {
+      const VzChannel &channel = it->second;
+      if(channel.kind == VZ_POWER) {
+        vz_->add(channel.index, receivedMs, view.powerMw());
+      } else if(channel.kind == VZ_CONSUMPTION) {
+        vz_->add(channel.index, receivedMs, view.consumptionMwh());
+      } else {
+        vz_->add(channel.index, receivedMs, view.generationMwh());
+      }
+    }
+  }
+
+  MqttT *mqtt_ = nullptr;
+  std::string prefix_;
+  ReadingFormat format_ = esphome::lora_receiver::READING_JSON;
+  uint8_t payload_[1024];  // JSON with the gateway names of a Reception
+  VzT *vz_ = nullptr;
+  std::multimap<uint16_t, VzChannel> vzChannels_;
+  std::unordered_map<uint16_t, NodeState> nodes_;
+  PayloadRegistry<GatewayPipeline, PIPELINE_MAX_SCHEMAS> payloads_;
+  const Reception *reception_ = nullptr;  // Of the packet in process()
+  NodeKeys<PIPELINE_MAX_KEYS> keys_;
+  MeshtasticChannel meshtastic_;
+  MeshtasticNodes<PIPELINE_MAX_KEYS> meshtasticNodes_;
+  GatewayStats stats_;
+  bool verbose_ = false;
+  const std::vector<std::string> *gatewayNames_ = nullptr;
+};
+
+#endif // GATEWAY_PIPELINE_H
@@ -0,0 +1,577 @@
+/*
+ * Linux LoRa Gateway Daemon
+ * Same payload decoder (src/lora_payload.h) and per-node link statistics
+ * (lora_receiver/link_stats.h) as the ESPHome gateway, on an epoll loop.
+ * The per-packet path lives in gateway_pipeline.h for bench_pipeline.
+ *
+ * Radio backends:
+ *   --udp PORT             simulation frames over UDP (see packet_source.h)
+ *   --pipe PATH|-          simulation frames from a FIFO, a file or stdin
+ *   --sx126x /dev/spidevX.Y --irq N --busy N --reset N [--tcxo V]
+ *   --sx127x /dev/spidevX.Y --irq N --reset N
+ * Outputs:
+ *   --mqtt HOST[:PORT]     <prefix>/<node>/state, retained JSON, CBOR or
+ *                          binary (reading_codec.h), QoS 0 or 1
+ *   --vz URL --vz-channel NODE:power|consumption|generation:UUID ...
+ *                          batched per channel, see vz_push.h
+ *   --record FILE          raw frames for bench_pipeline --replay
+ *   --forward HOST:PORT    frames to an aggregating lora_gatewayd
+ * Signed meter frames (src/meter_auth.h):
+ *   --key NODE:HEX ...     per-node AES-128 key, NODE_KEY of the firmware
+ *   --require-signed       refuse unsigned frames of every node
+ * Meshtastic telemetry (src/meshtastic_telemetry.h):
+ *   --meshtastic NAME[:HEX] channel of TRANSPORT_LORA_MESHTASTIC nodes
+ *   --meshtastic-node NUM[:NODE] ...  senders taken as meters, all others dropped
+ * Multi-gateway aggregation (--udp fed by several --forward gateways):
+ *   --dedup HOLD_MS        one copy per packet, best SNR, see dedup_window.h
+ *
+ *   make -C host && host/build/lora_gatewayd --udp 1700 --mqtt localhost
+ *   lora_gatewayd --sx126x /dev/spidev0.0 ... --forward 192.168.1.10:1700
+ *   lora_gatewayd --udp 1700 --dedup 250 --mqtt localhost
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+#include "event_loop.h"
+#include "gateway_pipeline.h"
+#include "mqtt_client.h"
+#include "packet_source.h"
+#include "sx_radio.h"
+#include "vz_push.h"
+
+#define RX_BATCH 64
+#define DEDUP_CAPACITY 4096  // Packets in flight over the dedup window
+
+typedef GatewayPipeline<MqttClient, VzPush> Pipeline;
+typedef DedupWindow<DEDUP_CAPACITY> Dedup;
+
+class Gateway {
+ public:
+  Gateway(EventLoop &loop, PacketSource &source) : loop_(loop), source_(source) {}
+  ~Gateway() {
+    if(resumeFd_ >= 0) {
+      close(resumeFd_);
+    }
+  }
+
+  Pipeline &pipeline() { return pipeline_; }
+  void setMqtt(MqttClient *mqtt, const std::string &prefix, ReadingFormat format) {
+    mqtt_ = mqtt;
+    pipeline_.setMqtt(mqtt, prefix, format);
+  }
+  void setVz(VzPush *vz) {
+    vz_ = vz;
+    pipeline_.setVz(vz);
+  }
+  // Raw simulation frames of everything received, for bench_pipeline --replay
+  void setRecord(FILE *record) { record_ = record; }
+  void setForwarder(FrameForwarder *forwarder) { forwarder_ = forwarder; }
+  void setDedup(uint32_t holdMs, uint32_t windowMs) {
+    dedup_.reset(new Dedup(holdMs, windowMs));
+    pipeline_.setGatewayNames(&gatewayNames_);
+  }
+
+  bool start(uint32_t statsIntervalS) {
+    if(!loop_.add(source_.fd(), EPOLLIN, [this](uint32_t) { drain(); })) {
+      return false;
+    }
+    resumeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(resumeFd_ < 0 || !loop_.add(resumeFd_, EPOLLIN, [this](uint32_t) { resume(); })) {
+      return false;
+    }
+    if(dedup_ && dedup_->holdMs() > 0) {
+      // Held packets go out on time even when no further packet arrives
+      uint32_t tickMs = dedup_->holdMs() / 4 > 10 ? dedup_->holdMs() / 4 : 10;
+      loop_.addTimer(tickMs, [this]() { dedup_->flush(EventLoop::monotonicMs(), sink_); });
+    }
+    if(statsIntervalS > 0) {
+      statsIntervalS_ = statsIntervalS;
+      loop_.addTimer(statsIntervalS * 1000, [this]() { printStats(); });
+    }
+    return true;
+  }
+
+ private:
+  struct PipelineSink {
+    Pipeline &pipeline;
+    void operator()(const RxPacket &packet, const Reception &reception) { pipeline.process(packet, &reception); }
+  };
+
+  // Bounded batches so one busy source cannot starve the outputs' fds.
+  // What is left may sit in the source's buffer with its fd drained, so
+  // resumeFd_ calls drain() again after the other fds had their turn.
+  void drain() {
+    bool more = true;
+    for(int round = 0; round < 16 && more; round++) {
+      size_t n = source_.poll(packets_, RX_BATCH, more);
+      for(size_t i = 0; i < n; i++) {
+        if(record_ != nullptr) {
+          uint8_t frame[SIM_FRAME_MAX_SIZE];
+          fwrite(frame, 1, encodeSimFrame(frame, packets_[i].rssi, packets_[i].snr, packets_[i].data,
+                                          packets_[i].length), record_);
+        }
+        if(forwarder_ != nullptr) {
+          forwarder_->send(packets_[i]);
+        }
+        if(dedup_) {
+          uint8_t gateway = source_.gatewayOf(i);
+          while(gatewayNames_.size() <= gateway) {
+            gatewayNames_.push_back(source_.gatewayName((uint8_t)gatewayNames_.size()));
+          }
+          if(pipeline_.admit(packets_[i])) {
+            dedup_->add(packets_[i], gateway, EventLoop::monotonicMs(), sink_);
+          }
+        } else {
+          pipeline_.process(packets_[i]);
+        }
+      }
+    }
+    if(more) {
+      uint64_t one = 1;
+      if(write(resumeFd_, &one, sizeof(one)) != sizeof(one)) {
+        perror("eventfd");
+      }
+    }
+    if(source_.finished()) {
+      fprintf(stderr, "%s: end of input\n", source_.name().c_str());
+      if(dedup_) {
+        dedup_->drain(sink_);
+      }
+      printStats();
+      loop_.stop();
+    }
+  }
+
+  void resume() {
+    uint64_t count;
+    if(read(resumeFd_, &count, sizeof(count)) == sizeof(count)) {
+      drain();
+    }
+  }
+
+  void printStats() {
+    const GatewayStats &stats = pipeline_.stats();
+    uint64_t delta = stats.packets - lastPackets_;
+    lastPackets_ = stats.packets;
+    fprintf(stderr, "rx %llu (%.0f/s), meter %llu, sweep %llu, decode errors %llu, auth errors %llu, nodes %zu",
+            (unsigned long long)stats.packets, (double)delta / statsIntervalS_, (unsigned long long)stats.meter,
+            (unsigned long long)stats.sweep, (unsigned long long)stats.decodeErrors,
+            (unsigned long long)stats.authErrors, pipeline_.nodeCount());
+    if(mqtt_ != nullptr) {
+      fprintf(stderr, ", mqtt %u sent %u acked %u dropped %zu inflight %zu waiting", mqtt_->published(),
+              mqtt_->acked(), mqtt_->dropped(), mqtt_->inflight(), mqtt_->backlog());
+    }
+    if(vz_ != nullptr) {
+      fprintf(stderr, ", vz %u sent in %u requests, %u failed %u dropped %zu pending", vz_->sent(), vz_->requests(),
+              vz_->failed(), vz_->dropped(), vz_->pending());
+    }
+    if(forwarder_ != nullptr) {
+      fprintf(stderr, ", forwarded %u failed %u", forwarder_->sent(), forwarder_->failed());
+    }
+    if(record_ != nullptr) {
+      fflush(record_);
+    }
+    fprintf(stderr, "\n");
+    if(dedup_) {
+      printDedupStats();
+    }
+  }
+
+  void printDedupStats() {
+    const DedupStats &stats = dedup_->stats();
+    fprintf(stderr, "  dedup %llu unique, %llu merged, %llu late, %llu evicted, %llu reboots, %zu held\n",
+            (unsigned long long)stats.unique, (unsigned long long)stats.duplicates, (unsigned long long)stats.late,
+            (unsigned long long)stats.evicted, (unsigned long long)stats.epochs, dedup_->pending());
+    for(size_t g = 0; g < gatewayNames_.size(); g++) {
+      fprintf(stderr, "  gateway %s: heard %llu, best %llu\n", gatewayNames_[g].c_str(),
+              (unsigned long long)stats.heard[g], (unsigned long long)stats.best[g]);
+    }
+  }
+
+  EventLoop &loop_;
+  PacketSource &source_;
+  int resumeFd_ = -1;
+  Pipeline pipeline_;
+  MqttClient *mqtt_ = nullptr;
+  VzPush *vz_ = nullptr;
+  FILE *record_ = nullptr;
+  FrameForwarder *forwarder_ = nullptr;
+  std::unique_ptr<Dedup> dedup_;
+  std::vector<std::string> gatewayNames_;
+  PipelineSink sink_{pipeline_};
+  uint64_t lastPackets_ = 0;
+  uint32_t statsIntervalS_ = 1;
+  RxPacket packets_[RX_BATCH];
+};
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s (--udp PORT | --pipe PATH | --sx126x SPIDEV | --sx127x SPIDEV) [options]\n"
+          "  --gpiochip PATH      GPIO chip for the radio lines (/dev/gpiochip0)\n"
+          "  --irq N --reset N    DIO1 (SX126x) / DIO0 (SX127x) and reset line offsets\n"
+          "  --busy N             SX126x BUSY line offset\n"
+          "  --tcxo VOLTS         SX126x TCXO supply on DIO3\n"
+          "  --mqtt HOST[:PORT]   publish node state to an MQTT broker\n"
+          "  --mqtt-prefix P      topic prefix (lora_gateway)\n"
+          "  --mqtt-format F      payload: json, cbor or binary (json)\n"
+          "  --mqtt-qos N         0 or 1 (0)\n"
+          "  --mqtt-inflight N    QoS 1 publishes awaiting PUBACK, at most 64 (8)\n"
+          "  --vz URL             Volkszaehler middleware, e.g. http://vz/middleware.php\n"
+          "  --vz-channel NODE:KIND:UUID  KIND is power, consumption or generation\n"
+          "  --vz-batch N         readings per channel and request, at most 32 (30)\n"
+          "  --vz-delay SECONDS   longest a reading waits for its batch (60)\n"
+          "  --record FILE        append every received frame (bench_pipeline --replay)\n"
+          "  --forward HOST:PORT  send every received frame to an aggregating gateway\n"
+          "  --dedup HOLD_MS      merge copies from several gateways, forward the best SNR\n"
+          "  --dedup-window S     how long a packet is remembered for late copies (60)\n"
+          "  --key NODE:HEX       AES-128 key (32 hex digits) of a node, its frames must be signed\n"
+          "  --require-signed     refuse unsigned meter frames of all nodes\n"
+          "  --meshtastic NAME[:HEX]  accept Meshtastic telemetry on this channel, default key\n"
+          "                       without HEX (LongFast: the public channel)\n"
+          "  --meshtastic-node NUM[:NODE]  accept telemetry of Meshtastic node NUM (hex), as\n"
+          "                       node NODE (default NUM, required above FFFF)\n"
+          "  --stats SECONDS      statistics interval, 0 disables (10)\n"
+          "  --verbose            log every dropped packet\n",
+          name);
+}
+
+static bool splitHostPort(const std::string &value, std::string &host, uint16_t &port) {
+  size_t colon = value.rfind(':');
+  host = value.substr(0, colon);
+  if(colon != std::string::npos) {
+    port = (uint16_t)atoi(value.c_str() + colon + 1);
+  }
+  return !host.empty() && port != 0;
+}
+
+static bool parseKey(const std::string &hex, uint8_t key[AES_KEY_SIZE]) {
+  if(hex.size() != 2 * AES_KEY_SIZE) {
+    return false;
+  }
+  for(size_t i = 0; i < AES_KEY_SIZE; i++) {
+    std::string digits = hex.substr(2 * i, 2);
+    char *end;
+    key[i] = (uint8_t)strtoul(digits.c_str(), &end, 16);
+    if(*end != '\0') {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool parseNodeKey(const std::string &value, uint16_t &node, uint8_t key[AES_KEY_SIZE]) {
+  size_t colon = value.find(':');
+  if(colon == std::string::npos) {
+    return false;
+  }
+  node = (uint16_t)strtoul(value.substr(0, colon).c_str(), nullptr, 16);
+  return parseKey(value.substr(colon + 1), key);
+}
+
+// NAME or NAME:HEX, MESHTASTIC_DEFAULT_KEY without a key
+static bool parseMeshtastic(const std::string &value, std::string &name, uint8_t key[AES_KEY_SIZE]) {
+  static const uint8_t defaultKey[AES_KEY_SIZE] = {MESHTASTIC_DEFAULT_KEY};
+  size_t colon = value.find(':');
+  name = value.substr(0, colon);
+  if(name.empty()) {
+    return false;
+  }
+  if(colon == std::string::npos) {
+    memcpy(key, defaultKey, AES_KEY_SIZE);
+    return true;
+  }
+  return parseKey(value.substr(colon + 1), key);
+}
+
+// NUM or NUM:NODE, hex; NUM may carry the app's "!" prefix
+static bool parseMeshtasticNode(const std::string &value, uint32_t &num, uint16_t &node) {
+  size_t colon = value.find(':');
+  std::string digits = value.substr(value[0] == '!' ? 1 : 0, colon - (value[0] == '!' ? 1 : 0));
+  char *end;
+  unsigned long parsed = strtoul(digits.c_str(), &end, 16);
+  if(digits.empty() || *end != '\0' || parsed == 0 || parsed >= MESHTASTIC_BROADCAST) {
+    return false;
+  }
+  num = (uint32_t)parsed;
+  if(colon == std::string::npos) {
+    node = (uint16_t)num;
+    return num <= 0xFFFF;
+  }
+  parsed = strtoul(value.c_str() + colon + 1, &end, 16);
+  node = (uint16_t)parsed;
+  return *end == '\0' && parsed != 0 && parsed <= 0xFFFF;
+}
+
+static bool parseVzChannel(const std::string &value, uint16_t &node, VzChannel &channel) {
+  size_t first = value.find(':');
+  size_t second = value.find(':', first + 1);
+  if(first == std::string::npos || second == std::string::npos) {
+    return false;
+  }
+  node = (uint16_t)strtoul(value.substr(0, first).c_str(), nullptr, 16);
+  std::string kind = value.substr(first + 1, second - first - 1);
+  channel.uuid = value.substr(second + 1);
+  if(kind == "power") {
+    channel.kind = VZ_POWER;
+  } else if(kind == "consumption") {
+    channel.kind = VZ_CONSUMPTION;
+  } else if(kind == "generation") {
+    channel.kind = VZ_GENERATION;
+  } else {
+    return false;
+  }
+  return !channel.uuid.empty();
+}
+
+int main(int argc, char **argv) {
+  enum {
+    OPT_UDP = 256, OPT_PIPE, OPT_SX126X, OPT_SX127X, OPT_GPIOCHIP, OPT_IRQ, OPT_RESET, OPT_BUSY, OPT_TCXO,
+    OPT_MQTT, OPT_MQTT_PREFIX, OPT_MQTT_FORMAT, OPT_MQTT_QOS, OPT_MQTT_INFLIGHT, OPT_VZ, OPT_VZ_CHANNEL, OPT_VZ_BATCH, OPT_VZ_DELAY, OPT_RECORD, OPT_FORWARD, OPT_DEDUP, OPT_DEDUP_WINDOW,
+    OPT_KEY, OPT_REQUIRE_SIGNED, OPT_MESHTASTIC, OPT_MESHTASTIC_NODE, OPT_STATS, OPT_VERBOSE
+  };
+  static const struct option options[] = {
+    {"udp", required_argument, nullptr, OPT_UDP},
+    {"pipe", required_argument, nullptr, OPT_PIPE},
+    {"sx126x", required_argument, nullptr, OPT_SX126X},
+    {"sx127x", required_argument, nullptr, OPT_SX127X},
+    {"gpiochip", required_argument, nullptr, OPT_GPIOCHIP},
+    {"irq", required_argument, nullptr, OPT_IRQ},
+    {"reset", required_argument, nullptr, OPT_RESET},
+    {"busy", required_argument, nullptr, OPT_BUSY},
+    {"tcxo", required_argument, nullptr, OPT_TCXO},
+    {"mqtt", required_argument, nullptr, OPT_MQTT},
+    {"mqtt-prefix", required_argument, nullptr, OPT_MQTT_PREFIX},
+    {"mqtt-format", required_argument, nullptr, OPT_MQTT_FORMAT},
+    {"mqtt-qos", required_argument, nullptr, OPT_MQTT_QOS},
+    {"mqtt-inflight", required_argument, nullptr, OPT_MQTT_INFLIGHT},
+    {"vz", required_argument, nullptr, OPT_VZ},
+    {"vz-channel", required_argument, nullptr, OPT_VZ_CHANNEL},
+    {"vz-batch", required_argument, nullptr, OPT_VZ_BATCH},
+    {"vz-delay", required_argument, nullptr, OPT_VZ_DELAY},
+    {"record", required_argument, nullptr, OPT_RECORD},
+    {"forward", required_argument, nullptr, OPT_FORWARD},
+    {"dedup", required_argument, nullptr, OPT_DEDUP},
+    {"dedup-window", required_argument, nullptr, OPT_DEDUP_WINDOW},
+    {"key", required_argument, nullptr, OPT_KEY},
+    {"require-signed", no_argument, nullptr, OPT_REQUIRE_SIGNED},
+    {"meshtastic", required_argument, nullptr, OPT_MESHTASTIC},
+    {"meshtastic-node", required_argument, nullptr, OPT_MESHTASTIC_NODE},
+    {"stats", required_argument, nullptr, OPT_STATS},
+    {"verbose", no_argument, nullptr, OPT_VERBOSE},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  std::unique_ptr<PacketSource> source;
+  SxRadioConfig radio;
+  int radioType = 0;
+  std::string mqttTarget;
+  std::string mqttPrefix = "lora_gateway";
+  ReadingFormat mqttFormat = esphome::lora_receiver::READING_JSON;
+  int mqttQos = 0;
+  size_t mqttInflight = 8;
+  std::string vzUrl;
+  std::vector<std::pair<uint16_t, VzChannel>> vzChannels;
+  size_t vzBatch = 30;
+  uint32_t vzDelayS = 60;
+  std::string recordPath;
+  std::string forwardTarget;
+  int dedupHoldMs = -1;
+  uint32_t dedupWindowS = 60;
+  std::vector<std::pair<uint16_t, std::vector<uint8_t>>> keys;
+  bool requireSigned = false;
+  std::string meshtasticName;
+  uint8_t meshtasticKey[AES_KEY_SIZE];
+  std::vector<std::pair<uint32_t, uint16_t>> meshtasticNodes;
+  uint32_t statsIntervalS = 10;
+  bool verbose = false;
+
+  int opt;
+  while((opt = getopt_long(argc, argv, "h", options, nullptr)) != -1) {
+    switch(opt) {
+      case OPT_UDP: source.reset(new UdpSource((uint16_t)atoi(optarg))); break;
+      case OPT_PIPE: source.reset(new PipeSource(optarg)); break;
+      case OPT_SX126X: radio.spiPath = optarg; radioType = 1; break;
+      case OPT_SX127X: radio.spiPath = optarg; radioType = 2; break;
+      case OPT_GPIOCHIP: radio.gpioChip = optarg; break;
+      case OPT_IRQ: radio.irqLine = atoi(optarg); break;
+      case OPT_RESET: radio.resetLine = atoi(optarg); break;
+      case OPT_BUSY: radio.busyLine = atoi(optarg); break;
+      case OPT_TCXO: radio.tcxoVoltage = (float)atof(optarg); break;
+      case OPT_MQTT: mqttTarget = optarg; break;
+      case OPT_MQTT_PREFIX: mqttPrefix = optarg; break;
+      case OPT_MQTT_FORMAT:
+        if(!esphome::lora_receiver::parse_reading_format(optarg, mqttFormat)) {
+          fprintf(stderr, "bad --mqtt-format %s\n", optarg);
+          return 2;
+        }
+        break;
+      case OPT_MQTT_QOS: mqttQos = atoi(optarg); break;
+      case OPT_MQTT_INFLIGHT: mqttInflight = (size_t)atoi(optarg); break;
+      case OPT_VZ: vzUrl = optarg; break;
+      case OPT_VZ_CHANNEL: {
+        std::pair<uint16_t, VzChannel> entry;
+        if(!parseVzChannel(optarg, entry.first, entry.second)) {
+          fprintf(stderr, "bad --vz-channel %s\n", optarg);
+          return 2;
+        }
+        vzChannels.push_back(entry);
+        break;
+      }
+      case OPT_VZ_BATCH: vzBatch = (size_t)atoi(optarg); break;
+      case OPT_VZ_DELAY: vzDelayS = (uint32_t)atoi(optarg); break;
+      case OPT_RECORD: recordPath = optarg; break;
+      case OPT_FORWARD: forwardTarget = optarg; break;
+      case OPT_DEDUP: dedupHoldMs = atoi(optarg); break;
+      case OPT_DEDUP_WINDOW: dedupWindowS = (uint32_t)atoi(optarg); break;
+      case OPT_KEY: {
+        std::pair<uint16_t, std::vector<uint8_t>> entry;
+        entry.second.resize(AES_KEY_SIZE);
+        if(!parseNodeKey(optarg, entry.first, entry.second.data())) {
+          fprintf(stderr, "bad --key %s\n", optarg);
+          return 2;
+        }
+        keys.push_back(entry);
+        break;
+      }
+      case OPT_REQUIRE_SIGNED: requireSigned = true; break;
+      case OPT_MESHTASTIC:
+        if(!parseMeshtastic(optarg, meshtasticName, meshtasticKey)) {
+          fprintf(stderr, "bad --meshtastic %s\n", optarg);
+          return 2;
+        }
+        break;
+      case OPT_MESHTASTIC_NODE: {
+        std::pair<uint32_t, uint16_t> entry;
+        if(!parseMeshtasticNode(optarg, entry.first, entry.second)) {
+          fprintf(stderr, "bad --meshtastic-node %s\n", optarg);
+          return 2;
+        }
+        meshtasticNodes.push_back(entry);
+        break;
+      }
+      case OPT_STATS: statsIntervalS = (uint32_t)atoi(optarg); break;
+      case OPT_VERBOSE: verbose = true; break;
+      default: usage(argv[0]); return 2;
+    }
+  }
+
+  if(meshtasticName.empty() != meshtasticNodes.empty()) {
+    fprintf(stderr, "--meshtastic and --meshtastic-node go together\n");
+    return 2;
+  }
+  if(radioType != 0) {
+    if(radio.irqLine < 0 || radio.resetLine < 0 || (radioType == 1 && radio.busyLine < 0)) {
+      fprintf(stderr, "radio needs --irq and --reset%s\n", radioType == 1 ? " and --busy" : "");
+      return 2;
+    }
+    if(radioType == 1) {
+      source.reset(new Sx126xSource(radio));
+    } else {
+      source.reset(new Sx127xSource(radio));
+    }
+  }
+  if(!source) {
+    usage(argv[0]);
+    return 2;
+  }
+  if(!source->open()) {
+    fprintf(stderr, "cannot open %s\n", source->name().c_str());
+    return 1;
+  }
+
+  EventLoop loop;
+  loop.stopOnSignals();
+  Gateway gateway(loop, *source);
+  gateway.pipeline().setVerbose(verbose);
+  gateway.pipeline().setRequireSigned(requireSigned);
+  for(const auto &key : keys) {
+    if(!gateway.pipeline().addKey(key.first, key.second.data())) {
+      fprintf(stderr, "more than %d --key\n", PIPELINE_MAX_KEYS);
+      return 2;
+    }
+  }
+  if(!meshtasticName.empty()) {
+    gateway.pipeline().setMeshtasticChannel(meshtasticName.c_str(), meshtasticKey);
+  }
+  for(const auto &node : meshtasticNodes) {
+    if(!gateway.pipeline().addMeshtasticNode(node.first, node.second)) {
+      fprintf(stderr, "--meshtastic-node %08X: node %04X taken or more than %d senders\n", node.first, node.second,
+              PIPELINE_MAX_KEYS);
+      return 2;
+    }
+  }
+  if(dedupHoldMs >= 0) {
+    gateway.setDedup((uint32_t)dedupHoldMs, dedupWindowS * 1000);
+  }
+
+  FrameForwarder forwarder;
+  if(!forwardTarget.empty()) {
+    std::string host;
+    uint16_t port = 1700;
+    if(!splitHostPort(forwardTarget, host, port) || !forwarder.open(host, port)) {
+      fprintf(stderr, "bad --forward %s (IPv4 address)\n", forwardTarget.c_str());
+      return 2;
+    }
+    gateway.setForwarder(&forwarder);
+  }
+
+  FILE *record = nullptr;
+  if(!recordPath.empty()) {
+    record = fopen(recordPath.c_str(), "ab");
+    if(record == nullptr) {
+      perror(recordPath.c_str());
+      return 1;
+    }
+    gateway.setRecord(record);
+  }
+
+  std::unique_ptr<MqttClient> mqtt;
+  if(!mqttTarget.empty()) {
+    std::string host;
+    uint16_t port = 1883;
+    if(!splitHostPort(mqttTarget, host, port)) {
+      fprintf(stderr, "bad --mqtt %s\n", mqttTarget.c_str());
+      return 2;
+    }
+    mqtt.reset(new MqttClient(loop, host, port, "lora_gatewayd-" + std::to_string(getpid())));
+    mqtt->setQos(mqttQos);
+    mqtt->setInflight(mqttInflight);
+    mqtt->start();
+    gateway.setMqtt(mqtt.get(), mqttPrefix, mqttFormat);
+  }
+
+  std::unique_ptr<VzPush> vz;
+  if(!vzUrl.empty()) {
+    std::string host;
+    std::string path;
+    uint16_t port;
+    if(!VzPush::parseUrl(vzUrl, host, port, path)) {
+      fprintf(stderr, "bad --vz %s (http:// only)\n", vzUrl.c_str());
+      return 2;
+    }
+    vz.reset(new VzPush(loop, host, port, path));
+    vz->setBatching(vzBatch, vzDelayS * 1000);
+    vz->start();
+    gateway.setVz(vz.get());
+    for(size_t i = 0; i < vzChannels.size(); i++) {
+      if(!gateway.pipeline().addVzChannel(vzChannels[i].first, vzChannels[i].second)) {
+        fprintf(stderr, "too many --vz-channel (max %d)\n", VZ_HOST_CHANNELS);
+        return 2;
+      }
+    }
+  }
+
+  if(!gateway.start(statsIntervalS)) {
+    return 1;
+  }
+  fprintf(stderr, "listening on %s\n", source->name().c_str());
+  loop.run();
+  if(record != nullptr) {
+    fclose(record);
+  }
+  return 0;
+}
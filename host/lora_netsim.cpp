@@ -0,0 +1,638 @@
+/*
+ * LoRa Network Simulator
+ * Discrete-event capacity model for one gateway on one channel. Every
+ * virtual node runs the real Firmware core (src/firmware.h) with simulated
+ * meter, transport and deep sleep policies, so send timing and frames are
+ * what a CubeCell produces; time-on-air follows the lora_data.h profile.
+ *
+ * Channel model:
+ *   - log-distance path loss from LORA_TX_POWER, per-node shadowing and
+ *     per-frame fading; frames below the SF demodulation floor are lost
+ *   - one demodulator (SX126x/SX127x gateway): it locks on the first
+ *     frame it can hear; a frame 6 dB stronger steals the lock while the
+ *     locked preamble is still running, otherwise it is lost
+ *   - a locked frame survives overlaps (capture) while it stays 6 dB
+ *     above the summed interference, else both are lost
+ *   - crystal drift per node, so send phases slide against each other
+ *
+ * Sweeps run one simulation per (nodes, SF, interval) point on a pool of
+ * std::thread workers; results do not depend on the thread count.
+ *
+ *   make -C host && host/build/lora_netsim --nodes 100:2000:100 --sf 7,9 --interval 60
+ */
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Arduino.h"
+#include "firmware.h"
+#include "lora_airtime.h"
+#include "lora_payload.h"
+
+#define CAPTURE_THRESHOLD_DB 6.0
+#define NOISE_FIGURE_DB      6.0
+#define CAPTURE_LOCK_SYMBOLS 5     // Preamble symbols needed before the lock holds
+#define SPEED_OF_LIGHT       299792458.0
+
+struct SimConfig {
+  uint32_t nodes = 100;
+  uint8_t spreadingFactor = LORA_SPREADING_FACTOR;
+  uint32_t intervalMs = SEND_INTERVAL;
+  double hours = 6.0;
+  double radiusM = 500.0;          // Nodes spread uniformly over a disc around the gateway
+  double pathLossExponent = 3.0;
+  double shadowingDb = 8.0;        // Per node, fixed
+  double fadingDb = 2.0;           // Per frame
+  double driftPpm = 20.0;          // Crystal tolerance, uniform +/-
+  uint32_t telegramMs = 1000;      // SML push period of the meters
+  uint32_t seed = 1;
+};
+
+struct SimResult {
+  uint64_t sent = 0;
+  uint64_t delivered = 0;
+  uint64_t captured = 0;           // Delivered despite an overlapping frame
+  uint64_t collided = 0;
+  uint64_t weak = 0;               // Below the demodulation floor
+  double airtimeMs = 0;            // Sum of all frames (offered load)
+  double busyMs = 0;               // Union of all frames (channel occupied)
+  double latencyMeanMs = 0;        // Meter reading to end of reception
+  double latencyP99Ms = 0;
+  double gapP99S = 0;              // Time between two readings of a node reaching the gateway
+};
+
+// Push meter: a telegram arrives somewhere within every telegram period
+class SimMeter {
+ public:
+  SimMeter(std::mt19937 &rng, uint32_t telegramMs) : rng_(rng), phase_(0, telegramMs - 1) {}
+
+  void begin() {}
+
+  void requestReading(uint32_t now) {
+    requestedAt_ = now;
+    wait_ = phase_(rng_);
+    pending_ = true;
+  }
+
+  bool poll(uint32_t now) {
+    if(!pending_ || now - requestedAt_ < wait_) {
+      return false;
+    }
+    pending_ = false;
+    readAt_ = now;
+    registers_.power_mw = 250000 + (int64_t)(phase_(rng_) * 100);
+    registers_.consumption_mwh += registers_.power_mw / 60;
+    return true;
+  }
+
+  const MeterRegisters &registers() const { return registers_; }
+
+  // Earliest local time at which poll() can change the firmware's state
+  uint32_t nextEvent() const {
+    return pending_ ? requestedAt_ + std::min(wait_, (uint32_t)METER_READ_TIMEOUT) : requestedAt_ + METER_READ_TIMEOUT;
+  }
+  uint32_t readAt() const { return readAt_; }
+
+ private:
+  std::mt19937 &rng_;
+  std::uniform_int_distribution<uint32_t> phase_;
+  MeterRegisters registers_ = {0, 0, 0};
+  uint32_t requestedAt_ = 0;
+  uint32_t wait_ = 0;
+  uint32_t readAt_ = 0;
+  bool pending_ = false;
+};
+
+// LoRaP2PTransport minus the radio: same encoder, blocks for the airtime
+class SimTransport {
+ public:
+  SimTransport(uint16_t nodeId, uint8_t spreadingFactor) : nodeId_(nodeId), spreadingFactor_(spreadingFactor) {}
+
+  void begin() {}
+  void configure(const NodeConfig &) {}
+
+  bool send(const MeterData &data) {
+    length_ = encodeMeterPayload(frame_, nodeId_, data);
+    airtimeUs_ = loraTimeOnAirUs(spreadingFactor_, LORA_BANDWIDTH, LORA_CODING_RATE, (uint8_t)length_,
+                                 LORA_PREAMBLE_LENGTH);
+    sentAt_ = millis();
+    pending_ = true;
+    delay((airtimeUs_ + 999) / 1000);  // loraSendBlocking waits for TxDone
+    return true;
+  }
+
+  // The simulated gateway never sends downlinks
+  bool exchangeConfig(NodeConfig &) { return false; }
+
+  bool pending() const { return pending_; }
+  void clear() { pending_ = false; }
+  uint32_t sentAt() const { return sentAt_; }
+  uint32_t airtimeUs() const { return airtimeUs_; }
+  const uint8_t *frame() const { return frame_; }
+  size_t length() const { return length_; }
+
+ private:
+  uint16_t nodeId_;
+  uint8_t spreadingFactor_;
+  uint8_t frame_[PAYLOAD_METER_SIZE];
+  size_t length_ = 0;
+  uint32_t airtimeUs_ = 0;
+  uint32_t sentAt_ = 0;
+  bool pending_ = false;
+};
+
+// DeepSleepPolicy with the timer owned by the simulator; the firmware's
+// policy keeps its timer in file statics, one per CubeCell
+class SimDeepSleepPolicy {
+ public:
+  explicit SimDeepSleepPolicy(uint32_t intervalMs) : intervalMs_(intervalMs) {}
+
+  // The interval is a sweep axis, not the build flag default
+  void configure(const NodeConfig &) {}
+  void begin() { wakeAt_ = millis() + intervalMs_; }
+  bool sleeping() const { return lowPower_; }
+  bool sendDue(uint32_t, uint32_t) const { return true; }
+  void cycleDone() { lowPower_ = true; }
+  void idle() {}
+
+  // onDeepSleepTimer(): wake up and re-arm relative to the expiry
+  void fire() {
+    lowPower_ = false;
+    wakeAt_ += intervalMs_;
+  }
+  uint32_t wakeAt() const { return wakeAt_; }
+
+ private:
+  uint32_t intervalMs_;
+  uint32_t wakeAt_ = 0;
+  bool lowPower_ = false;
+};
+
+// Nothing to persist between simulated boots
+class SimConfigStore {
+ public:
+  bool load(NodeConfig &config) {
+    config = nodeConfigDefaults();
+    return false;
+  }
+  void save(const NodeConfig &) {}
+  bool loadCounter(uint32_t &) { return false; }
+  void saveCounter(uint32_t) {}
+};
+
+struct SimFrame {
+  uint32_t node;
+  double startMs;                  // Global time
+  double endMs;
+  double readAtMs;                 // When the reading in the frame was taken
+  double rssi;
+  uint8_t payload[PAYLOAD_METER_SIZE];
+  size_t length;
+};
+
+class SimNode {
+ public:
+  SimNode(uint16_t nodeId, const SimConfig &config, std::mt19937 &rng)
+      : meter_(rng, config.telegramMs),
+        transport_(nodeId, config.spreadingFactor),
+        sleep_(config.intervalMs),
+        firmware_(meter_, transport_, sleep_, store_) {
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::normal_distribution<double> shadowing(0.0, config.shadowingDb);
+    bootMs_ = unit(rng) * config.intervalMs;
+    rate_ = 1.0 + (unit(rng) * 2.0 - 1.0) * config.driftPpm * 1e-6;
+    double distance = std::max(1.0, config.radiusM * sqrt(unit(rng)));
+    double freeSpace1m = 20.0 * log10(4.0 * 3.14159265358979 * LORA_FREQUENCY / SPEED_OF_LIGHT);
+    meanRssi_ = LORA_TX_POWER - freeSpace1m - 10.0 * config.pathLossExponent * log10(distance) - shadowing(rng);
+  }
+
+  // Run the firmware until it hands the next frame to the transport
+  void next(SimFrame &frame) {
+    simClockMs() = (uint32_t)localMs_;
+    if(!started_) {
+      started_ = true;
+      firmware_.setup();
+    }
+    while(true) {
+      firmware_.loop();
+      syncClock();
+      if(transport_.pending()) {
+        break;
+      }
+      // Skip the idle loop passes: nothing changes before the next event
+      uint32_t target = sleep_.sleeping() ? sleep_.wakeAt() : meter_.nextEvent();
+      uint32_t now = simClockMs();
+      advance((int32_t)(target - now) > 0 ? target - now : 1);
+      if(sleep_.sleeping() && (int32_t)(simClockMs() - sleep_.wakeAt()) >= 0) {
+        sleep_.fire();
+      }
+    }
+    transport_.clear();
+    uint32_t sinceSend = simClockMs() - transport_.sentAt();
+    frame.startMs = toGlobal(localMs_ - sinceSend);
+    frame.endMs = frame.startMs + transport_.airtimeUs() / 1000.0;
+    frame.readAtMs = toGlobal(localMs_ - (uint32_t)(simClockMs() - meter_.readAt()));
+    frame.length = transport_.length();
+    memcpy(frame.payload, transport_.frame(), frame.length);
+  }
+
+  double meanRssi() const { return meanRssi_; }
+
+ private:
+  // Fold the 32-bit firmware clock into the 64-bit local time
+  void syncClock() { localMs_ += (uint32_t)(simClockMs() - (uint32_t)localMs_); }
+
+  void advance(uint32_t ms) {
+    simClockMs() += ms;
+    localMs_ += ms;
+  }
+
+  double toGlobal(uint64_t localMs) const { return bootMs_ + localMs / rate_; }
+
+  SimMeter meter_;
+  SimTransport transport_;
+  SimDeepSleepPolicy sleep_;
+  SimConfigStore store_;
+  Firmware<SimMeter, SimTransport, SimDeepSleepPolicy, SimConfigStore> firmware_;
+  uint64_t localMs_ = 0;
+  double bootMs_ = 0;
+  double rate_ = 1.0;
+  double meanRssi_ = 0;
+  bool started_ = false;
+};
+
+// Single demodulator with capture, fed with frames in start order
+class SimGateway {
+ public:
+  SimGateway(const SimConfig &config, uint32_t nodes, SimResult &result)
+      : result_(result), lastDelivery_(nodes, -1.0) {
+    uint32_t symbolUs = loraSymbolTimeUs(config.spreadingFactor, LORA_BANDWIDTH);
+    lockWindowMs_ = (LORA_PREAMBLE_LENGTH - CAPTURE_LOCK_SYMBOLS) * symbolUs / 1000.0;
+    noiseDbm_ = -174.0 + 10.0 * log10((double)loraBandwidthHz(LORA_BANDWIDTH)) + NOISE_FIGURE_DB;
+    snrFloorDb_ = -7.5 - 2.5 * (config.spreadingFactor - 7);
+  }
+
+  void arrive(const SimFrame &frame) {
+    retire(frame.startMs);
+    result_.sent++;
+    result_.airtimeMs += frame.endMs - frame.startMs;
+    if(frame.startMs > busyEnd_) {
+      result_.busyMs += busyEnd_ - busyStart_;
+      busyStart_ = frame.startMs;
+    }
+    busyEnd_ = std::max(busyEnd_, frame.endMs);
+
+    Active active;
+    active.frame = frame;
+    active.powerMw = pow(10.0, frame.rssi / 10.0);
+    for(size_t i = 0; i < active_.size(); i++) {
+      active_[i].interferenceMw += active.powerMw;
+      active.interferenceMw += active_[i].powerMw;
+    }
+
+    if(frame.rssi - noiseDbm_ < snrFloorDb_) {
+      result_.weak++;
+    } else if(locked_ < 0) {
+      active.locked = true;
+    } else {
+      Active &current = active_[locked_];
+      if(frame.rssi >= current.frame.rssi + CAPTURE_THRESHOLD_DB &&
+         frame.startMs <= current.frame.startMs + lockWindowMs_) {
+        current.locked = false;
+        result_.collided++;
+        active.locked = true;
+      } else {
+        result_.collided++;
+      }
+    }
+    active_.push_back(active);
+    locked_ = -1;
+    for(size_t i = 0; i < active_.size(); i++) {
+      if(active_[i].locked) {
+        locked_ = (int)i;
+      }
+    }
+  }
+
+  void finish() {
+    retire(1e300);
+    result_.busyMs += busyEnd_ - busyStart_;
+  }
+
+  std::vector<double> &latencies() { return latencies_; }
+  std::vector<double> &gaps() { return gaps_; }
+
+ private:
+  struct Active {
+    SimFrame frame;
+    double powerMw = 0;
+    double interferenceMw = 0;
+    bool locked = false;
+  };
+
+  void retire(double nowMs) {
+    size_t kept = 0;
+    for(size_t i = 0; i < active_.size(); i++) {
+      if(active_[i].frame.endMs > nowMs) {
+        active_[kept++] = active_[i];
+        continue;
+      }
+      if(active_[i].locked) {
+        demodulated(active_[i]);
+      }
+    }
+    active_.resize(kept);
+    locked_ = -1;
+    for(size_t i = 0; i < active_.size(); i++) {
+      if(active_[i].locked) {
+        locked_ = (int)i;
+      }
+    }
+  }
+
+  void demodulated(const Active &active) {
+    if(active.interferenceMw > 0 &&
+       active.frame.rssi - 10.0 * log10(active.interferenceMw) < CAPTURE_THRESHOLD_DB) {
+      result_.collided++;
+      return;
+    }
+    // What the gateway would decode; the simulator trusts nothing else
+    MeterPayloadView view;
+    if(MeterPayloadView::parse(active.frame.payload, active.frame.length, view) != PAYLOAD_OK) {
+      result_.collided++;
+      return;
+    }
+    result_.delivered++;
+    if(active.interferenceMw > 0) {
+      result_.captured++;
+    }
+    latencies_.push_back(active.frame.endMs - active.frame.readAtMs);
+    double &last = lastDelivery_[active.frame.node];
+    if(last >= 0) {
+      gaps_.push_back((active.frame.endMs - last) / 1000.0);
+    }
+    last = active.frame.endMs;
+  }
+
+  SimResult &result_;
+  std::vector<Active> active_;
+  int locked_ = -1;
+  std::vector<double> lastDelivery_;
+  std::vector<double> latencies_;
+  std::vector<double> gaps_;
+  double lockWindowMs_ = 0;
+  double noiseDbm_ = 0;
+  double snrFloorDb_ = 0;
+  double busyStart_ = 0;
+  double busyEnd_ = 0;
+};
+
+static double percentile(std::vector<double> &values, double p) {
+  if(values.empty()) {
+    return 0;
+  }
+  size_t index = std::min(values.size() - 1, (size_t)(p * values.size()));
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index];
+}
+
+static SimResult simulate(const SimConfig &config) {
+  SimResult result;
+  std::mt19937 rng(config.seed);
+  std::normal_distribution<double> fading(0.0, config.fadingDb);
+  std::vector<std::unique_ptr<SimNode>> nodes;
+  for(uint32_t i = 0; i < config.nodes; i++) {
+    nodes.emplace_back(new SimNode((uint16_t)(i + 1), config, rng));
+  }
+
+  // Next frame of every node, earliest start first
+  typedef std::pair<double, uint32_t> Pending;
+  std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> queue;
+  std::vector<SimFrame> next(config.nodes);
+  for(uint32_t i = 0; i < config.nodes; i++) {
+    nodes[i]->next(next[i]);
+    queue.push(Pending(next[i].startMs, i));
+  }
+
+  SimGateway gateway(config, config.nodes, result);
+  double endMs = config.hours * 3600000.0;
+  while(!queue.empty() && queue.top().first < endMs) {
+    uint32_t i = queue.top().second;
+    queue.pop();
+    SimFrame &frame = next[i];
+    frame.node = i;
+    frame.rssi = nodes[i]->meanRssi() + fading(rng);
+    gateway.arrive(frame);
+    nodes[i]->next(frame);
+    queue.push(Pending(frame.startMs, i));
+  }
+  gateway.finish();
+
+  std::vector<double> &latencies = gateway.latencies();
+  double sum = 0;
+  for(size_t i = 0; i < latencies.size(); i++) {
+    sum += latencies[i];
+  }
+  result.latencyMeanMs = latencies.empty() ? 0 : sum / latencies.size();
+  result.latencyP99Ms = percentile(latencies, 0.99);
+  result.gapP99S = percentile(gateway.gaps(), 0.99);
+  return result;
+}
+
+// "10,20,50" or "100:1000:100" (start:stop:step), or a mix of both
+static bool parseList(const char *text, std::vector<uint32_t> &values) {
+  values.clear();
+  std::string list(text);
+  size_t pos = 0;
+  while(pos <= list.size()) {
+    size_t comma = list.find(',', pos);
+    std::string item = list.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+    unsigned long start = 0;
+    unsigned long stop = 0;
+    unsigned long step = 0;
+    int fields = sscanf(item.c_str(), "%lu:%lu:%lu", &start, &stop, &step);
+    if(fields == 1) {
+      values.push_back((uint32_t)start);
+    } else if(fields == 3 && step > 0 && stop >= start) {
+      for(unsigned long v = start; v <= stop; v += step) {
+        values.push_back((uint32_t)v);
+      }
+    } else {
+      return false;
+    }
+    if(comma == std::string::npos) {
+      break;
+    }
+    pos = comma + 1;
+  }
+  return !values.empty();
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  --nodes LIST         node counts, e.g. 50,100 or 100:2000:100 (default 100)\n"
+          "  --sf LIST            spreading factors (default %d from lora_data.h)\n"
+          "  --interval LIST      send intervals in s (default %d)\n"
+          "  --hours H            simulated time per point (default 6)\n"
+          "  --radius M           nodes within M metres of the gateway (default 500)\n"
+          "  --exponent N         path loss exponent (default 3.0)\n"
+          "  --shadowing DB       per-node shadowing sigma (default 8)\n"
+          "  --drift PPM          crystal tolerance (default 20)\n"
+          "  --target PCT         delivery ratio for the capacity summary (default 90)\n"
+          "  --threads N          worker threads (default: all cores)\n"
+          "  --seed N             random seed (default 1)\n"
+          "  --csv                machine readable output\n",
+          name, LORA_SPREADING_FACTOR, SEND_INTERVAL / 1000);
+}
+
+int main(int argc, char **argv) {
+  static const struct option options[] = {
+    {"nodes", required_argument, nullptr, 'n'},
+    {"sf", required_argument, nullptr, 's'},
+    {"interval", required_argument, nullptr, 'i'},
+    {"hours", required_argument, nullptr, 'H'},
+    {"radius", required_argument, nullptr, 'r'},
+    {"exponent", required_argument, nullptr, 'e'},
+    {"shadowing", required_argument, nullptr, 'S'},
+    {"drift", required_argument, nullptr, 'd'},
+    {"target", required_argument, nullptr, 'T'},
+    {"threads", required_argument, nullptr, 't'},
+    {"seed", required_argument, nullptr, 'x'},
+    {"csv", no_argument, nullptr, 'c'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  SimConfig base;
+  std::vector<uint32_t> nodeCounts(1, base.nodes);
+  std::vector<uint32_t> spreadingFactors(1, base.spreadingFactor);
+  std::vector<uint32_t> intervals(1, base.intervalMs / 1000);
+  double target = 90.0;
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  bool csv = false;
+  bool ok = true;
+
+  int opt;
+  while((opt = getopt_long(argc, argv, "", options, nullptr)) != -1) {
+    switch(opt) {
+      case 'n': ok = ok && parseList(optarg, nodeCounts); break;
+      case 's': ok = ok && parseList(optarg, spreadingFactors); break;
+      case 'i': ok = ok && parseList(optarg, intervals); break;
+      case 'H': base.hours = atof(optarg); break;
+      case 'r': base.radiusM = atof(optarg); break;
+      case 'e': base.pathLossExponent = atof(optarg); break;
+      case 'S': base.shadowingDb = atof(optarg); break;
+      case 'd': base.driftPpm = atof(optarg); break;
+      case 'T': target = atof(optarg); break;
+      case 't': threads = std::max(1, atoi(optarg)); break;
+      case 'x': base.seed = (uint32_t)strtoul(optarg, nullptr, 0); break;
+      case 'c': csv = true; break;
+      default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+    }
+  }
+  for(size_t i = 0; i < spreadingFactors.size(); i++) {
+    ok = ok && spreadingFactors[i] >= 7 && spreadingFactors[i] <= 12;
+  }
+  for(size_t i = 0; i < intervals.size(); i++) {
+    ok = ok && intervals[i] * 1000 > METER_READ_TIMEOUT + 3000;
+  }
+  if(!ok || base.hours <= 0) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  // Largest points first so the pool drains evenly
+  std::vector<SimConfig> points;
+  for(size_t s = 0; s < spreadingFactors.size(); s++) {
+    for(size_t i = 0; i < intervals.size(); i++) {
+      for(size_t n = 0; n < nodeCounts.size(); n++) {
+        SimConfig config = base;
+        config.spreadingFactor = (uint8_t)spreadingFactors[s];
+        config.intervalMs = intervals[i] * 1000;
+        config.nodes = nodeCounts[n];
+        config.seed = base.seed * 1000003u + (uint32_t)points.size();
+        points.push_back(config);
+      }
+    }
+  }
+  std::vector<size_t> order(points.size());
+  for(size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&points](size_t a, size_t b) {
+    return (uint64_t)points[a].nodes * 3600000 / points[a].intervalMs > (uint64_t)points[b].nodes * 3600000 / points[b].intervalMs;
+  });
+
+  std::vector<SimResult> results(points.size());
+  std::atomic<size_t> cursor(0);
+  std::vector<std::thread> workers;
+  for(unsigned t = 0; t < std::min<size_t>(threads, points.size()); t++) {
+    workers.emplace_back([&]() {
+      size_t job;
+      while((job = cursor.fetch_add(1)) < order.size()) {
+        results[order[job]] = simulate(points[order[job]]);
+      }
+    });
+  }
+  for(size_t t = 0; t < workers.size(); t++) {
+    workers[t].join();
+  }
+
+  if(csv) {
+    printf("nodes,sf,interval_s,sent,delivered,captured,collided,weak,delivery_pct,load_pct,busy_pct,latency_ms,latency_p99_ms,gap_p99_s\n");
+  } else {
+    printf("%u sweep points, %.1f h each, %u B frames, %.0f m radius, %u threads\n", (unsigned)points.size(),
+           base.hours, (unsigned)PAYLOAD_METER_SIZE, base.radiusM, (unsigned)workers.size());
+    printf("%6s %3s %6s %9s %8s %8s %8s %7s %7s %9s %9s %8s\n", "nodes", "sf", "int_s", "sent", "deliv%", "coll%",
+           "weak%", "load%", "busy%", "lat_ms", "p99_ms", "gap99_s");
+  }
+  for(size_t i = 0; i < points.size(); i++) {
+    const SimConfig &config = points[i];
+    const SimResult &result = results[i];
+    double sent = std::max<uint64_t>(result.sent, 1);
+    double spanMs = config.hours * 3600000.0;
+    if(csv) {
+      printf("%u,%u,%u,%llu,%llu,%llu,%llu,%llu,%.3f,%.3f,%.3f,%.1f,%.1f,%.1f\n", config.nodes, config.spreadingFactor,
+             config.intervalMs / 1000, (unsigned long long)result.sent, (unsigned long long)result.delivered,
+             (unsigned long long)result.captured, (unsigned long long)result.collided,
+             (unsigned long long)result.weak, 100.0 * result.delivered / sent, 100.0 * result.airtimeMs / spanMs,
+             100.0 * result.busyMs / spanMs, result.latencyMeanMs, result.latencyP99Ms, result.gapP99S);
+    } else {
+      printf("%6u %3u %6u %9llu %8.2f %8.2f %8.2f %7.2f %7.2f %9.1f %9.1f %8.1f\n", config.nodes,
+             config.spreadingFactor, config.intervalMs / 1000, (unsigned long long)result.sent,
+             100.0 * result.delivered / sent, 100.0 * result.collided / sent, 100.0 * result.weak / sent,
+             100.0 * result.airtimeMs / spanMs, 100.0 * result.busyMs / spanMs, result.latencyMeanMs,
+             result.latencyP99Ms, result.gapP99S);
+    }
+  }
+
+  // Capacity: the largest simulated node count that still meets the target
+  if(!csv) {
+    printf("\ncapacity at >= %.1f%% delivery:\n", target);
+    for(size_t s = 0; s < spreadingFactors.size(); s++) {
+      for(size_t i = 0; i < intervals.size(); i++) {
+        uint32_t best = 0;
+        for(size_t p = 0; p < points.size(); p++) {
+          const SimResult &result = results[p];
+          if(points[p].spreadingFactor == spreadingFactors[s] && points[p].intervalMs == intervals[i] * 1000 &&
+             result.sent > 0 && 100.0 * result.delivered / result.sent >= target) {
+            best = std::max(best, points[p].nodes);
+          }
+        }
+        printf("  SF%-2u every %4u s: %s%u nodes\n", spreadingFactors[s], intervals[i], best == 0 ? "< " : "",
+               best == 0 ? *std::min_element(nodeCounts.begin(), nodeCounts.end()) : best);
+      }
+    }
+  }
+  return 0;
+}
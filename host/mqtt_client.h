@@ -0,0 +1,286 @@
+/*
+ * MQTT Publisher
+ * Non-blocking MQTT 3.1.1 client for the host gateway on the event loop:
+ * keepalive pings and reconnect with backoff. Packets are built by
+ * lora_receiver/mqtt_packet.h, shared with the ESP32 sink.
+ * QoS 0 publishes made while disconnected are dropped and counted; the
+ * next reading of a node carries the full state anyway. QoS 1 publishes
+ * go out while fewer than the inflight window await their PUBACK, the
+ * rest wait in a bounded backlog; unacknowledged ones are resent after
+ * a reconnect.
+ */
+
+#ifndef MQTT_CLIENT_H
+#define MQTT_CLIENT_H
+
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <deque>
+#include <string>
+#include "event_loop.h"
+#include "mqtt_packet.h"
+
+using esphome::lora_receiver::MqttInflight;
+using esphome::lora_receiver::MqttPacket;
+
+#define MQTT_HOST_INFLIGHT    64    // Largest --mqtt-inflight
+#define MQTT_HOST_PACKET_SIZE 1024  // Largest QoS 1 publish kept for resend
+#define MQTT_HOST_BACKLOG     10000 // QoS 1 publishes waiting for the window
+
+class MqttClient {
+ public:
+  MqttClient(EventLoop &loop, const std::string &host, uint16_t port, const std::string &clientId)
+      : loop_(loop), host_(host), port_(port), clientId_(clientId) {
+    inflight_.set_window(8);
+  }
+
+  void setQos(uint8_t qos) { qos_ = qos > 0 ? 1 : 0; }
+  void setInflight(size_t window) { inflight_.set_window(window); }
+
+  void start() {
+    connect();
+    loop_.addTimer(1000, [this]() { tick(); });
+  }
+
+  bool connected() const { return state_ == CONNECTED; }
+
+  // False when dropped: QoS 0 offline or over MAX_BACKLOG bytes, QoS 1
+  // with a full backlog (the oldest waiting publish goes)
+  bool publish(const char *topic, const uint8_t *payload, size_t length, bool retain) {
+    if(qos_ == 0) {
+      if(state_ != CONNECTED || out_.size() > MAX_BACKLOG) {
+        dropped_++;
+        return false;
+      }
+      uint8_t packet[MQTT_HOST_PACKET_SIZE];
+      size_t n = esphome::lora_receiver::mqtt_publish(packet, sizeof(packet), topic, payload, length, 0, retain, 0);
+      if(n == 0) {
+        dropped_++;
+        return false;
+      }
+      out_.append((const char *)packet, n);
+      published_++;
+      flush();
+      return true;
+    }
+    bool kept = true;
+    if(backlog_.size() >= MQTT_HOST_BACKLOG) {
+      backlog_.pop_front();
+      dropped_++;
+      kept = false;
+    }
+    backlog_.push_back(Pending{topic, std::string((const char *)payload, length), retain});
+    sendBacklog();
+    return kept;
+  }
+
+  uint32_t published() const { return published_; }
+  uint32_t acked() const { return acked_; }
+  uint32_t dropped() const { return dropped_; }
+  size_t inflight() const { return inflight_.size(); }
+  size_t backlog() const { return backlog_.size(); }
+
+ private:
+  enum State { IDLE, CONNECTING, WAIT_CONNACK, CONNECTED };
+
+  struct Pending {
+    std::string topic;
+    std::string payload;
+    bool retain;
+  };
+
+  static const size_t MAX_BACKLOG = 1 << 20;
+  static const uint16_t KEEPALIVE_S = 30;
+
+  void connect() {
+    struct addrinfo hints;
+    struct addrinfo *result = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(host_.c_str(), std::to_string(port_).c_str(), &hints, &result) != 0 || result == nullptr) {
+      fprintf(stderr, "mqtt: cannot resolve %s\n", host_.c_str());
+      scheduleReconnect();
+      return;
+    }
+    fd_ = socket(result->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    int rc = ::connect(fd_, result->ai_addr, result->ai_addrlen);
+    freeaddrinfo(result);
+    if(rc != 0 && errno != EINPROGRESS) {
+      disconnect();
+      return;
+    }
+    state_ = CONNECTING;
+    loop_.add(fd_, EPOLLIN | EPOLLOUT, [this](uint32_t events) { onEvent(events); });
+  }
+
+  void onEvent(uint32_t events) {
+    if(events & (EPOLLERR | EPOLLHUP)) {
+      disconnect();
+      return;
+    }
+    if(state_ == CONNECTING && (events & EPOLLOUT)) {
+      int error = 0;
+      socklen_t length = sizeof(error);
+      getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &length);
+      if(error != 0) {
+        disconnect();
+        return;
+      }
+      sendConnect();
+    }
+    if(events & EPOLLIN) {
+      receive();
+    }
+    if(fd_ >= 0 && (events & EPOLLOUT)) {
+      flush();
+    }
+  }
+
+  void sendConnect() {
+    state_ = WAIT_CONNACK;
+    uint8_t packet[256];
+    size_t n = esphome::lora_receiver::mqtt_connect(packet, sizeof(packet), clientId_.c_str(), KEEPALIVE_S);
+    out_.append((const char *)packet, n);
+    flush();
+  }
+
+  void receive() {
+    char buffer[512];
+    while(true) {
+      ssize_t n = recv(fd_, buffer, sizeof(buffer), 0);
+      if(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        disconnect();
+        return;
+      }
+      if(n < 0) {
+        break;
+      }
+      in_.append(buffer, n);
+    }
+    MqttPacket packet;
+    int length;
+    while((length = esphome::lora_receiver::mqtt_parse((const uint8_t *)in_.data(), in_.size(), packet)) > 0) {
+      if(packet.type == esphome::lora_receiver::MQTT_CONNACK && state_ == WAIT_CONNACK) {
+        if(packet.body_len < 2 || packet.body[1] != 0) {
+          fprintf(stderr, "mqtt: connection refused (%d)\n", packet.body_len >= 2 ? packet.body[1] : -1);
+          disconnect();
+          return;
+        }
+        onConnected();
+      } else if(inflight_.ack(packet)) {
+        acked_++;
+      }
+      in_.erase(0, length);
+    }
+    if(length < 0) {
+      disconnect();
+      return;
+    }
+    sendBacklog();
+  }
+
+  // Unacknowledged publishes of the last connection go first, in order
+  void onConnected() {
+    state_ = CONNECTED;
+    backoffS_ = 1;
+    fprintf(stderr, "mqtt: connected to %s:%u, %zu to resend\n", host_.c_str(), port_, inflight_.size());
+    inflight_.resend([this](const uint8_t *data, size_t length) { out_.append((const char *)data, length); });
+    flush();
+  }
+
+  void sendBacklog() {
+    if(state_ != CONNECTED) {
+      return;
+    }
+    uint8_t packet[MQTT_HOST_PACKET_SIZE];
+    while(!backlog_.empty() && !inflight_.full()) {
+      const Pending &pending = backlog_.front();
+      uint16_t id = inflight_.next_id();
+      size_t n = esphome::lora_receiver::mqtt_publish(packet, sizeof(packet), pending.topic.c_str(),
+                                                      (const uint8_t *)pending.payload.data(), pending.payload.size(),
+                                                      1, pending.retain, id);
+      backlog_.pop_front();
+      if(n == 0 || !inflight_.add(id, packet, n)) {
+        dropped_++;
+        continue;
+      }
+      out_.append((const char *)packet, n);
+      published_++;
+    }
+    flush();
+  }
+
+  void flush() {
+    while(!out_.empty() && fd_ >= 0 && state_ != CONNECTING) {
+      ssize_t n = send(fd_, out_.data(), out_.size(), MSG_NOSIGNAL);
+      if(n < 0) {
+        if(errno != EAGAIN && errno != EWOULDBLOCK) {
+          disconnect();
+        }
+        break;
+      }
+      out_.erase(0, n);
+      lastSendMs_ = EventLoop::monotonicMs();
+    }
+    if(fd_ >= 0 && state_ != CONNECTING) {
+      loop_.modify(fd_, out_.empty() ? EPOLLIN : EPOLLIN | EPOLLOUT);
+    }
+  }
+
+  void tick() {
+    if(state_ == IDLE && EventLoop::monotonicMs() >= reconnectAtMs_) {
+      connect();
+    } else if(state_ == CONNECTED && EventLoop::monotonicMs() - lastSendMs_ > KEEPALIVE_S * 500u) {
+      uint8_t ping[2];
+      out_.append((const char *)ping, esphome::lora_receiver::mqtt_pingreq(ping));
+      flush();
+    }
+  }
+
+  // The inflight window survives, everything not yet written does not
+  void disconnect() {
+    if(fd_ >= 0) {
+      loop_.remove(fd_);
+      close(fd_);
+      fd_ = -1;
+    }
+    if(state_ != IDLE) {
+      fprintf(stderr, "mqtt: disconnected, retry in %u s\n", backoffS_);
+    }
+    out_.clear();
+    in_.clear();
+    scheduleReconnect();
+  }
+
+  void scheduleReconnect() {
+    state_ = IDLE;
+    reconnectAtMs_ = EventLoop::monotonicMs() + backoffS_ * 1000;
+    if(backoffS_ < 60) {
+      backoffS_ *= 2;
+    }
+  }
+
+  EventLoop &loop_;
+  std::string host_;
+  uint16_t port_;
+  std::string clientId_;
+  uint8_t qos_ = 0;
+  int fd_ = -1;
+  State state_ = IDLE;
+  std::string out_;
+  std::string in_;
+  MqttInflight<MQTT_HOST_INFLIGHT, MQTT_HOST_PACKET_SIZE> inflight_;
+  std::deque<Pending> backlog_;
+  uint64_t lastSendMs_ = 0;
+  uint64_t reconnectAtMs_ = 0;
+  unsigned backoffS_ = 1;
+  uint32_t published_ = 0;
+  uint32_t acked_ = 0;
+  uint32_t dropped_ = 0;
+};
+
+#endif // MQTT_CLIENT_H
@@ -0,0 +1,306 @@
+/*
+ * Packet Sources
+ * Radio backends for the host gateway. Every source exposes a pollable fd
+ * and, when it is readable, drains what is ready without blocking.
+ *
+ * Simulation frames (UDP datagram or pipe record), little endian:
+ *   [0..1]  int16 RSSI in dBm
+ *   [2]     int8 SNR in 0.25 dB steps (SX126x packet status format)
+ *   [3]     payload length
+ *   [4..]   LoRa payload exactly as on air
+ */
+
+#ifndef PACKET_SOURCE_H
+#define PACKET_SOURCE_H
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include "event_loop.h"
+#include "lora_payload.h"
+#include "packet_queue.h"
+
+using esphome::lora_receiver::RxPacket;
+
+#define SIM_FRAME_HEADER_SIZE 4
+#define SIM_FRAME_MAX_SIZE    (SIM_FRAME_HEADER_SIZE + PAYLOAD_MAX_SIZE)
+
+inline size_t encodeSimFrame(uint8_t *out, int16_t rssi, float snr, const uint8_t *payload, uint8_t length) {
+  uint8_t *p = payloadStore<int16_t>(out, rssi);
+  *p++ = (uint8_t)(int8_t)(snr * 4.0f);
+  *p++ = length;
+  memcpy(p, payload, length);
+  return SIM_FRAME_HEADER_SIZE + length;
+}
+
+// Returns the frame size consumed, 0 if more bytes are needed
+inline size_t decodeSimFrame(const uint8_t *data, size_t available, RxPacket &packet) {
+  if(available < SIM_FRAME_HEADER_SIZE || available < SIM_FRAME_HEADER_SIZE + (size_t)data[3]) {
+    return 0;
+  }
+  packet.rssi = payloadLoad<int16_t>(data);
+  packet.snr = (int8_t)data[2] / 4.0f;
+  packet.length = data[3];
+  memcpy(packet.data, data + SIM_FRAME_HEADER_SIZE, packet.length);
+  packet.timestamp_ms = (uint32_t)EventLoop::monotonicMs();
+  return SIM_FRAME_HEADER_SIZE + packet.length;
+}
+
+class PacketSource {
+ public:
+  virtual ~PacketSource() {}
+  virtual bool open() = 0;
+  virtual int fd() const = 0;
+  // Fill up to max packets; more is set while the source may hold more
+  virtual size_t poll(RxPacket *packets, size_t max, bool &more) = 0;
+  virtual bool finished() const { return false; }
+  virtual std::string name() const = 0;
+  // Gateway that received packet i of the last poll, for multi-gateway
+  // sources; a local radio or pipe is a single gateway
+  virtual uint8_t gatewayOf(size_t index) const {
+    (void)index;
+    return 0;
+  }
+  virtual std::string gatewayName(uint8_t gateway) const {
+    (void)gateway;
+    return name();
+  }
+};
+
+// UDP datagrams, one simulation frame each; recvmmsg drains a burst per call.
+// Each sender address is a gateway (lora_gatewayd --forward); the first
+// MAX_GATEWAYS - 1 addresses get their own index, later ones share the last.
+class UdpSource : public PacketSource {
+ public:
+  explicit UdpSource(uint16_t port) : port_(port) {}
+  ~UdpSource() {
+    if(fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  bool open() override {
+    fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd_ < 0) {
+      return false;
+    }
+    int buffer = 4 << 20;  // Ride out scheduling hiccups at high rates
+    setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port_);
+    if(bind(fd_, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+      perror("udp bind");
+      return false;
+    }
+    return true;
+  }
+
+  int fd() const override { return fd_; }
+
+  size_t poll(RxPacket *packets, size_t max, bool &more) override {
+    more = false;
+    if(max > BATCH) {
+      max = BATCH;
+    }
+    struct mmsghdr msgs[BATCH];
+    struct iovec iov[BATCH];
+    struct sockaddr_in senders[BATCH];
+    for(size_t i = 0; i < max; i++) {
+      iov[i].iov_base = buffers_[i];
+      iov[i].iov_len = SIM_FRAME_MAX_SIZE;
+      memset(&msgs[i], 0, sizeof(msgs[i]));
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_name = &senders[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+    }
+    int n = recvmmsg(fd_, msgs, max, MSG_DONTWAIT, nullptr);
+    if(n <= 0) {
+      return 0;
+    }
+    size_t count = 0;
+    for(int i = 0; i < n; i++) {
+      if(decodeSimFrame(buffers_[i], msgs[i].msg_len, packets[count]) == msgs[i].msg_len) {
+        gateways_[count] = senderIndex(senders[i].sin_addr.s_addr);
+        count++;
+      } else {
+        malformed_++;
+      }
+    }
+    more = (size_t)n == max;
+    return count;
+  }
+
+  std::string name() const override { return "udp:" + std::to_string(port_); }
+  uint32_t malformed() const { return malformed_; }
+
+  uint8_t gatewayOf(size_t index) const override { return gateways_[index]; }
+  std::string gatewayName(uint8_t gateway) const override {
+    if(gateway >= senders_.size()) {
+      return name();
+    }
+    char text[INET_ADDRSTRLEN];
+    struct in_addr addr;
+    addr.s_addr = senders_[gateway];
+    inet_ntop(AF_INET, &addr, text, sizeof(text));
+    return gateway == MAX_GATEWAYS - 1 ? std::string(text) + "+" : std::string(text);
+  }
+
+ private:
+  static const size_t BATCH = 64;
+  static const size_t MAX_GATEWAYS = 32;
+
+  uint8_t senderIndex(uint32_t address) {
+    for(size_t i = 0; i < senders_.size(); i++) {
+      if(senders_[i] == address) {
+        return (uint8_t)i;
+      }
+    }
+    if(senders_.size() < MAX_GATEWAYS) {
+      senders_.push_back(address);
+      return (uint8_t)(senders_.size() - 1);
+    }
+    return MAX_GATEWAYS - 1;
+  }
+
+  uint16_t port_;
+  int fd_ = -1;
+  uint32_t malformed_ = 0;
+  uint8_t buffers_[BATCH][SIM_FRAME_MAX_SIZE];
+  uint8_t gateways_[BATCH];
+  std::vector<uint32_t> senders_;  // Network byte order
+};
+
+// Sends every received frame to an aggregating lora_gatewayd (--udp),
+// which deduplicates what several gateways heard. Fire and forget: a
+// full socket buffer drops the frame, the other gateways may have it.
+class FrameForwarder {
+ public:
+  ~FrameForwarder() {
+    if(fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  bool open(const std::string &host, uint16_t port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if(inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+      return false;
+    }
+    fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    return fd_ >= 0 && connect(fd_, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+  }
+
+  void send(const RxPacket &packet) {
+    uint8_t frame[SIM_FRAME_MAX_SIZE];
+    size_t length = encodeSimFrame(frame, packet.rssi, packet.snr, packet.data, packet.length);
+    if(::send(fd_, frame, length, MSG_DONTWAIT) == (ssize_t)length) {
+      sent_++;
+    } else {
+      failed_++;
+    }
+  }
+
+  uint32_t sent() const { return sent_; }
+  uint32_t failed() const { return failed_; }
+
+ private:
+  int fd_ = -1;
+  uint32_t sent_ = 0;
+  uint32_t failed_ = 0;
+};
+
+// Back-to-back simulation frames from stdin ("-"), a named pipe or a
+// file such as a --record capture. A FIFO is opened read/write so the
+// source survives writers coming and going. epoll refuses regular files,
+// which are always readable anyway: an eventfd that stays signalled wakes
+// the loop in their place until the end of the file.
+class PipeSource : public PacketSource {
+ public:
+  explicit PipeSource(const std::string &path) : path_(path) {}
+  ~PipeSource() {
+    if(fd_ > 0) {
+      close(fd_);
+    }
+    if(readyFd_ >= 0) {
+      close(readyFd_);
+    }
+  }
+
+  bool open() override {
+    struct stat st;
+    if(path_ == "-") {
+      fd_ = STDIN_FILENO;
+    } else {
+      bool exists = stat(path_.c_str(), &st) == 0;
+      if(!exists && mkfifo(path_.c_str(), 0660) != 0) {
+        perror("mkfifo");
+        return false;
+      }
+      bool file = exists && S_ISREG(st.st_mode);
+      fd_ = ::open(path_.c_str(), (file ? O_RDONLY : O_RDWR) | O_CLOEXEC);
+    }
+    if(fd_ < 0) {
+      perror(path_.c_str());
+      return false;
+    }
+    if(fstat(fd_, &st) == 0 && S_ISREG(st.st_mode)) {
+      readyFd_ = eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+      return readyFd_ >= 0;
+    }
+    return EventLoop::setNonBlocking(fd_);
+  }
+
+  int fd() const override { return readyFd_ >= 0 ? readyFd_ : fd_; }
+
+  size_t poll(RxPacket *packets, size_t max, bool &more) override {
+    size_t count = 0;
+    while(count < max) {
+      size_t used = decodeSimFrame(buffer_ + start_, end_ - start_, packets[count]);
+      if(used > 0) {
+        start_ += used;
+        count++;
+        continue;
+      }
+      // Compact and refill
+      memmove(buffer_, buffer_ + start_, end_ - start_);
+      end_ -= start_;
+      start_ = 0;
+      ssize_t n = read(fd_, buffer_ + end_, sizeof(buffer_) - end_);
+      if(n == 0) {
+        finished_ = true;
+        break;
+      }
+      if(n < 0) {
+        break;  // EAGAIN: drained
+      }
+      end_ += n;
+    }
+    more = count == max;
+    return count;
+  }
+
+  bool finished() const override { return finished_; }
+  std::string name() const override { return "pipe:" + path_; }
+
+ private:
+  std::string path_;
+  int fd_ = -1;
+  int readyFd_ = -1;  // Stands in for fd_ when that is a regular file
+  bool finished_ = false;
+  uint8_t buffer_[64 * SIM_FRAME_MAX_SIZE];
+  size_t start_ = 0;
+  size_t end_ = 0;
+};
+
+#endif // PACKET_SOURCE_H
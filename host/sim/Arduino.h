@@ -0,0 +1,37 @@
+/*
+ * Arduino Host Shim
+ * Just enough of Arduino.h for firmware.h to run inside lora_netsim.
+ * millis() is the virtual clock of the node currently being stepped,
+ * one per thread so sweep workers do not share time.
+ */
+
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+#include <stdint.h>
+
+#define OUTPUT 1
+#define LOW    0
+#define HIGH   1
+#define RGB    0
+
+inline uint32_t &simClockMs() {
+  static thread_local uint32_t now = 0;
+  return now;
+}
+
+inline uint32_t millis() { return simClockMs(); }
+inline void delay(uint32_t ms) { simClockMs() += ms; }
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline uint16_t getBatteryVoltage() { return 3700; }
+
+struct SimSerial {
+  template <class T> void print(const T &) {}
+  template <class T> void println(const T &) {}
+};
+
+static SimSerial Serial;
+
+#endif // SIM_ARDUINO_H
@@ -0,0 +1,423 @@
+/*
+ * SX126x / SX127x on Linux
+ * spidev for the bus, the GPIO character device for reset, BUSY and the
+ * RX-done interrupt line (DIO1 on SX126x, DIO0 on SX127x). The interrupt
+ * line's event fd goes into the gateway's epoll loop, so no thread polls
+ * the radio. Radio settings come from the shared src/lora_data.h.
+ */
+
+#ifndef SX_RADIO_H
+#define SX_RADIO_H
+
+#include <linux/gpio.h>
+#include <linux/spi/spidev.h>
+#include <sys/ioctl.h>
+#include "lora_airtime.h"
+#include "packet_source.h"
+
+class SpiDev {
+ public:
+  ~SpiDev() {
+    if(fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  bool open(const std::string &path, uint32_t speedHz) {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if(fd_ < 0) {
+      perror(path.c_str());
+      return false;
+    }
+    uint8_t mode = SPI_MODE_0;
+    uint8_t bits = 8;
+    speedHz_ = speedHz;
+    return ioctl(fd_, SPI_IOC_WR_MODE, &mode) == 0 && ioctl(fd_, SPI_IOC_WR_BITS_PER_WORD, &bits) == 0 &&
+           ioctl(fd_, SPI_IOC_WR_MAX_SPEED_HZ, &speedHz_) == 0;
+  }
+
+  // Full duplex, one chip-select assertion; rx may be null
+  bool transfer(const uint8_t *tx, uint8_t *rx, size_t length) {
+    struct spi_ioc_transfer xfer;
+    memset(&xfer, 0, sizeof(xfer));
+    xfer.tx_buf = (uintptr_t)tx;
+    xfer.rx_buf = (uintptr_t)rx;
+    xfer.len = length;
+    xfer.speed_hz = speedHz_;
+    xfer.bits_per_word = 8;
+    return ioctl(fd_, SPI_IOC_MESSAGE(1), &xfer) >= 0;
+  }
+
+ private:
+  int fd_ = -1;
+  uint32_t speedHz_ = 0;
+};
+
+// One requested GPIO line (v1 character device ABI)
+class GpioLine {
+ public:
+  ~GpioLine() {
+    if(fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  bool requestOutput(int chipFd, unsigned line, uint8_t value) {
+    struct gpiohandle_request req;
+    memset(&req, 0, sizeof(req));
+    req.lineoffsets[0] = line;
+    req.lines = 1;
+    req.flags = GPIOHANDLE_REQUEST_OUTPUT;
+    req.default_values[0] = value;
+    strcpy(req.consumer_label, "lora_gatewayd");
+    if(ioctl(chipFd, GPIO_GET_LINEHANDLE_IOCTL, &req) != 0) {
+      return false;
+    }
+    fd_ = req.fd;
+    return true;
+  }
+
+  bool requestInput(int chipFd, unsigned line) {
+    struct gpiohandle_request req;
+    memset(&req, 0, sizeof(req));
+    req.lineoffsets[0] = line;
+    req.lines = 1;
+    req.flags = GPIOHANDLE_REQUEST_INPUT;
+    strcpy(req.consumer_label, "lora_gatewayd");
+    if(ioctl(chipFd, GPIO_GET_LINEHANDLE_IOCTL, &req) != 0) {
+      return false;
+    }
+    fd_ = req.fd;
+    return true;
+  }
+
+  // Input with rising-edge events; fd() becomes readable on each edge
+  bool requestRisingEdge(int chipFd, unsigned line) {
+    struct gpioevent_request req;
+    memset(&req, 0, sizeof(req));
+    req.lineoffset = line;
+    req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    req.eventflags = GPIOEVENT_REQUEST_RISING_EDGE;
+    strcpy(req.consumer_label, "lora_gatewayd");
+    if(ioctl(chipFd, GPIO_GET_LINEEVENT_IOCTL, &req) != 0) {
+      return false;
+    }
+    fd_ = req.fd;
+    return EventLoop::setNonBlocking(fd_);
+  }
+
+  bool get() const {
+    struct gpiohandle_data data;
+    memset(&data, 0, sizeof(data));
+    ioctl(fd_, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data);
+    return data.values[0] != 0;
+  }
+
+  void set(uint8_t value) {
+    struct gpiohandle_data data;
+    memset(&data, 0, sizeof(data));
+    data.values[0] = value;
+    ioctl(fd_, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data);
+  }
+
+  // Discard queued edge events
+  void drainEvents() {
+    struct gpioevent_data event;
+    while(read(fd_, &event, sizeof(event)) == sizeof(event)) {
+    }
+  }
+
+  int fd() const { return fd_; }
+
+ private:
+  int fd_ = -1;
+};
+
+struct SxRadioConfig {
+  std::string spiPath = "/dev/spidev0.0";
+  std::string gpioChip = "/dev/gpiochip0";
+  int irqLine = -1;    // DIO1 (SX126x) or DIO0 (SX127x)
+  int resetLine = -1;
+  int busyLine = -1;   // SX126x only
+  float tcxoVoltage = 0.0f;
+};
+
+// Shared plumbing: GPIO lines, reset pulse, interrupt-driven drain
+class SxRadioSource : public PacketSource {
+ public:
+  explicit SxRadioSource(const SxRadioConfig &config) : config_(config) {}
+
+  bool open() override {
+    int chip = ::open(config_.gpioChip.c_str(), O_RDWR | O_CLOEXEC);
+    if(chip < 0) {
+      perror(config_.gpioChip.c_str());
+      return false;
+    }
+    bool ok = irq_.requestRisingEdge(chip, config_.irqLine) && reset_.requestOutput(chip, config_.resetLine, 1) &&
+              (config_.busyLine < 0 || busy_.requestInput(chip, config_.busyLine));
+    close(chip);
+    if(!ok) {
+      perror("gpio request");
+      return false;
+    }
+    if(!spi_.open(config_.spiPath, 8000000)) {
+      return false;
+    }
+    reset_.set(0);
+    usleep(1000);
+    reset_.set(1);
+    usleep(10000);
+    return init();
+  }
+
+  int fd() const override { return irq_.fd(); }
+
+  // Back-to-back packets keep the line high without a new edge
+  size_t poll(RxPacket *packets, size_t max, bool &more) override {
+    irq_.drainEvents();
+    size_t count = 0;
+    do {
+      if(receive(packets[count])) {
+        count++;
+      }
+    } while(count < max && irq_.get());
+    more = count == max;
+    return count;
+  }
+
+  uint32_t crcErrors() const { return crcErrors_; }
+
+ protected:
+  virtual bool init() = 0;
+  virtual bool receive(RxPacket &packet) = 0;
+
+  SxRadioConfig config_;
+  SpiDev spi_;
+  GpioLine irq_;
+  GpioLine reset_;
+  GpioLine busy_;
+  uint32_t crcErrors_ = 0;
+};
+
+// SX1262/SX1268: same command sequence as the ESPHome lora_receiver component
+class Sx126xSource : public SxRadioSource {
+ public:
+  explicit Sx126xSource(const SxRadioConfig &config) : SxRadioSource(config) {}
+  std::string name() const override { return "sx126x:" + config_.spiPath; }
+
+ protected:
+  void waitBusy() {
+    for(int i = 0; i < 1000 && busy_.get(); i++) {
+      usleep(10);
+    }
+  }
+
+  void command(uint8_t cmd, const uint8_t *data = nullptr, size_t length = 0) {
+    uint8_t tx[16];
+    tx[0] = cmd;
+    if(length > 0) {
+      memcpy(tx + 1, data, length);
+    }
+    waitBusy();
+    spi_.transfer(tx, nullptr, length + 1);
+  }
+
+  // Opcode, one status byte, then data
+  void readCommand(uint8_t cmd, uint8_t *data, size_t length) {
+    uint8_t tx[16] = {cmd};
+    uint8_t rx[16];
+    waitBusy();
+    spi_.transfer(tx, rx, length + 2);
+    memcpy(data, rx + 2, length);
+  }
+
+  void writeRegister(uint16_t address, const uint8_t *data, size_t length) {
+    uint8_t tx[16] = {0x0D, (uint8_t)(address >> 8), (uint8_t)address};
+    memcpy(tx + 3, data, length);
+    waitBusy();
+    spi_.transfer(tx, nullptr, length + 3);
+  }
+
+  bool init() override {
+    const uint8_t standby = 0x00;
+    command(0x80, &standby, 1);
+    uint8_t tx[2] = {0xC0, 0x00};
+    uint8_t rx[2];
+    waitBusy();
+    spi_.transfer(tx, rx, 2);
+    if(((rx[1] >> 4) & 0x07) != 0x02) {
+      fprintf(stderr, "sx126x: unexpected status 0x%02X after standby\n", rx[1]);
+      return false;
+    }
+    if(config_.tcxoVoltage > 0) {
+      static const float TCXO_VOLTAGES[] = {1.6f, 1.7f, 1.8f, 2.2f, 2.4f, 2.7f, 3.0f, 3.3f};
+      uint8_t code = 0;
+      while(code < 7 && TCXO_VOLTAGES[code] + 0.05f < config_.tcxoVoltage) {
+        code++;
+      }
+      const uint8_t tcxo[4] = {code, 0x00, 0x01, 0x40};
+      command(0x97, tcxo, sizeof(tcxo));
+      const uint8_t calibrateAll = 0x7F;
+      command(0x89, &calibrateAll, 1);
+      usleep(5000);
+    }
+    const uint8_t dcdc = 0x01;
+    command(0x96, &dcdc, 1);
+    const uint8_t rfSwitch = 0x01;
+    command(0x9D, &rfSwitch, 1);
+    const uint8_t packetType = 0x01;
+    command(0x8A, &packetType, 1);
+
+    uint8_t image[2] = {0x6B, 0x6F};
+    if(LORA_FREQUENCY > 900000000) {
+      image[0] = 0xE1;
+      image[1] = 0xE9;
+    } else if(LORA_FREQUENCY > 850000000) {
+      image[0] = 0xD7;
+      image[1] = 0xDB;
+    }
+    command(0x98, image, sizeof(image));
+
+    uint32_t frf = (uint32_t)(((uint64_t)LORA_FREQUENCY << 25) / 32000000ULL);
+    const uint8_t freq[4] = {(uint8_t)(frf >> 24), (uint8_t)(frf >> 16), (uint8_t)(frf >> 8), (uint8_t)frf};
+    command(0x86, freq, sizeof(freq));
+    const uint8_t base[2] = {0x00, 0x00};
+    command(0x8F, base, sizeof(base));
+
+    static const uint8_t SX126X_BANDWIDTH[] = {0x04, 0x05, 0x06};
+    const uint8_t modulation[4] = {LORA_SPREADING_FACTOR, SX126X_BANDWIDTH[LORA_BANDWIDTH], LORA_CODING_RATE,
+                                   (uint8_t)(loraSymbolTimeUs(LORA_SPREADING_FACTOR, LORA_BANDWIDTH) > 16000)};
+    command(0x8B, modulation, sizeof(modulation));
+    const uint8_t packet[6] = {(uint8_t)(LORA_PREAMBLE_LENGTH >> 8), (uint8_t)LORA_PREAMBLE_LENGTH, 0x00, 0xFF, 0x01,
+                               0x00};
+    command(0x8C, packet, sizeof(packet));
+
+    const uint8_t sync[2] = {(uint8_t)((LORA_SYNC_WORD & 0xF0) | 0x04), (uint8_t)(((LORA_SYNC_WORD & 0x0F) << 4) | 0x04)};
+    writeRegister(0x0740, sync, sizeof(sync));
+    const uint8_t boostedGain = 0x96;
+    writeRegister(0x08AC, &boostedGain, 1);
+
+    const uint16_t irq = IRQ_RX_DONE | IRQ_HEADER_ERR | IRQ_CRC_ERR;
+    const uint8_t dio[8] = {(uint8_t)(irq >> 8), (uint8_t)irq, (uint8_t)(irq >> 8), (uint8_t)irq, 0, 0, 0, 0};
+    command(0x08, dio, sizeof(dio));
+
+    // Continuous RX
+    const uint8_t clearAll[2] = {0x03, 0xFF};
+    command(0x02, clearAll, sizeof(clearAll));
+    const uint8_t timeout[3] = {0xFF, 0xFF, 0xFF};
+    command(0x82, timeout, sizeof(timeout));
+    return true;
+  }
+
+  bool receive(RxPacket &packet) override {
+    uint8_t status[2];
+    readCommand(0x12, status, sizeof(status));
+    uint16_t irq = ((uint16_t)status[0] << 8) | status[1];
+    command(0x02, status, sizeof(status));
+    if(irq & (IRQ_CRC_ERR | IRQ_HEADER_ERR)) {
+      crcErrors_++;
+      return false;
+    }
+    if(!(irq & IRQ_RX_DONE)) {
+      return false;
+    }
+    uint8_t buffer[2];
+    readCommand(0x13, buffer, sizeof(buffer));
+
+    // ReadBuffer: opcode, offset, NOP, then data
+    uint8_t tx[3 + 255] = {0x1E, buffer[1]};
+    uint8_t rx[3 + 255];
+    waitBusy();
+    spi_.transfer(tx, rx, 3 + buffer[0]);
+    memcpy(packet.data, rx + 3, buffer[0]);
+    packet.length = buffer[0];
+
+    uint8_t packetStatus[3];
+    readCommand(0x14, packetStatus, sizeof(packetStatus));
+    packet.rssi = -(int16_t)packetStatus[0] / 2;
+    packet.snr = (int8_t)packetStatus[1] / 4.0f;
+    packet.timestamp_ms = (uint32_t)EventLoop::monotonicMs();
+    return true;
+  }
+
+  static const uint16_t IRQ_RX_DONE = 0x0002;
+  static const uint16_t IRQ_HEADER_ERR = 0x0020;
+  static const uint16_t IRQ_CRC_ERR = 0x0040;
+};
+
+// SX1276/SX1278: register interface, RxDone mapped to DIO0
+class Sx127xSource : public SxRadioSource {
+ public:
+  explicit Sx127xSource(const SxRadioConfig &config) : SxRadioSource(config) {}
+  std::string name() const override { return "sx127x:" + config_.spiPath; }
+
+ protected:
+  uint8_t readRegister(uint8_t address) {
+    uint8_t tx[2] = {(uint8_t)(address & 0x7F), 0};
+    uint8_t rx[2];
+    spi_.transfer(tx, rx, 2);
+    return rx[1];
+  }
+
+  void writeRegister(uint8_t address, uint8_t value) {
+    uint8_t tx[2] = {(uint8_t)(address | 0x80), value};
+    spi_.transfer(tx, nullptr, 2);
+  }
+
+  bool init() override {
+    uint8_t version = readRegister(0x42);
+    if(version != 0x12) {
+      fprintf(stderr, "sx127x: unexpected version 0x%02X\n", version);
+      return false;
+    }
+    writeRegister(0x01, 0x80);  // Sleep, LoRa mode (only settable in sleep)
+    writeRegister(0x01, 0x81);  // Standby
+    uint64_t frf = ((uint64_t)LORA_FREQUENCY << 19) / 32000000ULL;
+    writeRegister(0x06, (uint8_t)(frf >> 16));
+    writeRegister(0x07, (uint8_t)(frf >> 8));
+    writeRegister(0x08, (uint8_t)frf);
+    writeRegister(0x0F, 0x00);  // RX base address
+    writeRegister(0x0C, 0x23);  // LNA max gain, HF boost
+
+    // Bandwidth codes 125/250/500 kHz = 7/8/9, explicit header, CRC on
+    writeRegister(0x1D, (uint8_t)(((7 + LORA_BANDWIDTH) << 4) | (LORA_CODING_RATE << 1)));
+    writeRegister(0x1E, (uint8_t)((LORA_SPREADING_FACTOR << 4) | 0x04));
+    bool lowDataRate = loraSymbolTimeUs(LORA_SPREADING_FACTOR, LORA_BANDWIDTH) > 16000;
+    writeRegister(0x26, (uint8_t)(0x04 | (lowDataRate ? 0x08 : 0x00)));
+    writeRegister(0x20, (uint8_t)(LORA_PREAMBLE_LENGTH >> 8));
+    writeRegister(0x21, (uint8_t)LORA_PREAMBLE_LENGTH);
+    writeRegister(0x39, LORA_SYNC_WORD);
+    writeRegister(0x40, 0x00);  // DIO0 = RxDone
+    writeRegister(0x12, 0xFF);  // Clear IRQ flags
+    writeRegister(0x01, 0x85);  // RX continuous
+    return true;
+  }
+
+  bool receive(RxPacket &packet) override {
+    uint8_t flags = readRegister(0x12);
+    writeRegister(0x12, flags);
+    if(flags & 0x20) {
+      crcErrors_++;
+      return false;
+    }
+    if(!(flags & 0x40)) {
+      return false;
+    }
+    uint8_t length = readRegister(0x13);
+    writeRegister(0x0D, readRegister(0x10));  // FIFO pointer to the packet start
+
+    uint8_t tx[1 + 255] = {0x00};
+    uint8_t rx[1 + 255];
+    spi_.transfer(tx, rx, 1 + length);
+    memcpy(packet.data, rx + 1, length);
+    packet.length = length;
+
+    // RSSI offset -164 dBm on the low frequency port, -157 dBm above 779 MHz
+    packet.snr = (int8_t)readRegister(0x19) / 4.0f;
+    packet.rssi = (LORA_FREQUENCY > 779000000 ? -157 : -164) + readRegister(0x1A);
+    packet.timestamp_ms = (uint32_t)EventLoop::monotonicMs();
+    return true;
+  }
+};
+
+#endif // SX_RADIO_H
@@ -0,0 +1,251 @@
+/*
+ * Volkszähler Push
+ * Adds readings to Volkszähler middleware channels over HTTP/1.1 in
+ * batches (lora_receiver/vz_batcher.h, shared with the ESP32 gateway):
+ *   POST <path>/data/<uuid>.json   [[ts,value],[ts,value],...]
+ * One keep-alive connection, one request in flight. Failed requests are
+ * retried with exponential backoff; while the middleware is away each
+ * channel keeps its newest VZ_HOST_DEPTH readings.
+ */
+
+#ifndef VZ_PUSH_H
+#define VZ_PUSH_H
+
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <string>
+#include "event_loop.h"
+#include "vz_batcher.h"
+
+using esphome::lora_receiver::RetryBackoff;
+using esphome::lora_receiver::VZ_REQUEST_SIZE;
+using esphome::lora_receiver::VzBatcher;
+
+#define VZ_HOST_CHANNELS 256
+#define VZ_HOST_DEPTH    256
+#define VZ_RESPONSE_TIMEOUT_MS 10000
+
+class VzPush {
+ public:
+  VzPush(EventLoop &loop, const std::string &host, uint16_t port, const std::string &path)
+      : loop_(loop), host_(host), port_(port), path_(path), backoff_(1000, 60000) {}
+
+  // Parse http://host[:port]/path/to/middleware.php
+  static bool parseUrl(const std::string &url, std::string &host, uint16_t &port, std::string &path) {
+    const std::string scheme = "http://";
+    if(url.compare(0, scheme.size(), scheme) != 0) {
+      return false;
+    }
+    size_t hostStart = scheme.size();
+    size_t pathStart = url.find('/', hostStart);
+    std::string hostPort = url.substr(hostStart, pathStart == std::string::npos ? std::string::npos : pathStart - hostStart);
+    path = pathStart == std::string::npos ? "" : url.substr(pathStart);
+    while(!path.empty() && path[path.size() - 1] == '/') {
+      path.erase(path.size() - 1);
+    }
+    size_t colon = hostPort.find(':');
+    host = hostPort.substr(0, colon);
+    port = colon == std::string::npos ? 80 : (uint16_t)atoi(hostPort.c_str() + colon + 1);
+    return !host.empty();
+  }
+
+  // A request goes out once batchSize readings of a channel are queued or
+  // its oldest one waited maxDelayMs
+  void setBatching(size_t batchSize, uint32_t maxDelayMs) { batcher_.set_batching(batchSize, maxDelayMs); }
+
+  void start() {
+    loop_.addTimer(1000, [this]() { tick(); });
+  }
+
+  // Channel index for add(), -1 when VZ_HOST_CHANNELS are in use
+  int channel(const std::string &uuid) { return batcher_.channel(uuid.c_str()); }
+
+  // valueMilli in thousandths of the channel unit, so exact fixed-point
+  // text reaches the middleware
+  void add(int channel, uint64_t timestampMs, int64_t valueMilli) {
+    batcher_.add(channel, timestampMs, valueMilli, (uint32_t)EventLoop::monotonicMs());
+    kick();
+  }
+
+  size_t pending() const { return batcher_.pending(); }
+  uint32_t sent() const { return sent_; }
+  uint32_t requests() const { return requests_; }
+  uint32_t failed() const { return failed_; }
+  uint32_t dropped() const { return batcher_.dropped(); }
+
+ private:
+  enum State { DISCONNECTED, CONNECTING, IDLE_CONNECTED, WAIT_RESPONSE };
+
+  void tick() {
+    if((state_ == CONNECTING || state_ == WAIT_RESPONSE) && EventLoop::monotonicMs() >= deadlineMs_) {
+      fprintf(stderr, "vz: no response from %s\n", host_.c_str());
+      drop();
+      return;
+    }
+    kick();
+  }
+
+  void kick() {
+    if(state_ == IDLE_CONNECTED) {
+      sendNext();
+    } else if(state_ == DISCONNECTED && EventLoop::monotonicMs() >= retryAtMs_ &&
+              batcher_.due((uint32_t)EventLoop::monotonicMs()) >= 0) {
+      connect();
+    }
+  }
+
+  void connect() {
+    struct addrinfo hints;
+    struct addrinfo *result = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(host_.c_str(), std::to_string(port_).c_str(), &hints, &result) != 0 || result == nullptr) {
+      retryLater();
+      return;
+    }
+    fd_ = socket(result->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd_ < 0) {
+      freeaddrinfo(result);
+      retryLater();
+      return;
+    }
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    int rc = ::connect(fd_, result->ai_addr, result->ai_addrlen);
+    freeaddrinfo(result);
+    if(rc != 0 && errno != EINPROGRESS) {
+      close(fd_);
+      fd_ = -1;
+      retryLater();
+      return;
+    }
+    state_ = CONNECTING;
+    deadlineMs_ = EventLoop::monotonicMs() + VZ_RESPONSE_TIMEOUT_MS;
+    loop_.add(fd_, EPOLLIN | EPOLLOUT, [this](uint32_t events) { onEvent(events); });
+  }
+
+  void onEvent(uint32_t events) {
+    if(events & (EPOLLERR | EPOLLHUP)) {
+      drop();
+      return;
+    }
+    if(state_ == CONNECTING && (events & EPOLLOUT)) {
+      state_ = IDLE_CONNECTED;
+      loop_.modify(fd_, EPOLLIN);
+      sendNext();
+    }
+    if(events & EPOLLIN) {
+      receive();
+    }
+  }
+
+  void sendNext() {
+    uint32_t now = (uint32_t)EventLoop::monotonicMs();
+    int channel = batcher_.due(now);
+    if(channel < 0) {
+      return;
+    }
+    char request[VZ_REQUEST_SIZE];
+    size_t length = batcher_.build_request(channel, host_.c_str(), path_.c_str(), request, sizeof(request));
+    // Requests are small; a short write on a fresh socket means trouble
+    if(length == 0 || send(fd_, request, length, MSG_NOSIGNAL) != (ssize_t)length) {
+      batcher_.abort(channel);
+      drop();
+      return;
+    }
+    inFlight_ = channel;
+    state_ = WAIT_RESPONSE;
+    deadlineMs_ = EventLoop::monotonicMs() + VZ_RESPONSE_TIMEOUT_MS;
+    response_.clear();
+    requests_++;
+  }
+
+  void receive() {
+    char buffer[1024];
+    bool closed = false;
+    while(true) {
+      ssize_t n = recv(fd_, buffer, sizeof(buffer), 0);
+      if(n <= 0) {
+        closed = n == 0;
+        break;
+      }
+      response_.append(buffer, n);
+    }
+    // A server that closes after answering still delivered the response
+    int status = state_ == WAIT_RESPONSE ? esphome::lora_receiver::http_response_status(response_.data(),
+                                                                                       response_.size())
+                                         : 0;
+    if(status == 0) {
+      if(closed && state_ == WAIT_RESPONSE) {
+        drop();
+      } else if(closed) {
+        disconnect();  // Idle keep-alive timed out on the server side
+      }
+      return;
+    }
+    if(status >= 500) {
+      // Middleware or database trouble: keep the batch and back off
+      fprintf(stderr, "vz: HTTP %d for %s, retrying\n", status, batcher_.uuid(inFlight_));
+      drop();
+      return;
+    }
+    size_t count = batcher_.commit(inFlight_, (uint32_t)EventLoop::monotonicMs());
+    if(status >= 200 && status < 300) {
+      sent_ += count;
+    } else {
+      // Rejected tuples are not retried: a 4xx will not get better
+      failed_ += count;
+      fprintf(stderr, "vz: HTTP %d for %s, %zu readings dropped\n", status, batcher_.uuid(inFlight_), count);
+    }
+    backoff_.success();
+    if(closed) {
+      disconnect();
+      return;
+    }
+    state_ = IDLE_CONNECTED;
+    sendNext();
+  }
+
+  // Connection lost: the request in flight stays queued and is resent
+  void drop() {
+    if(state_ == WAIT_RESPONSE) {
+      batcher_.abort(inFlight_);
+    }
+    disconnect();
+    retryLater();
+  }
+
+  void disconnect() {
+    if(fd_ >= 0) {
+      loop_.remove(fd_);
+      close(fd_);
+      fd_ = -1;
+    }
+    state_ = DISCONNECTED;
+  }
+
+  void retryLater() {
+    state_ = DISCONNECTED;
+    retryAtMs_ = EventLoop::monotonicMs() + backoff_.failure();
+  }
+
+  EventLoop &loop_;
+  std::string host_;
+  uint16_t port_;
+  std::string path_;
+  int fd_ = -1;
+  State state_ = DISCONNECTED;
+  VzBatcher<VZ_HOST_CHANNELS, VZ_HOST_DEPTH> batcher_;
+  RetryBackoff backoff_;
+  int inFlight_ = -1;
+  std::string response_;
+  uint64_t deadlineMs_ = 0;
+  uint64_t retryAtMs_ = 0;
+  uint32_t sent_ = 0;
+  uint32_t requests_ = 0;
+  uint32_t failed_ = 0;
+};
+
+#endif // VZ_PUSH_H
@@ -0,0 +1,73 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome import pins
+from esphome.components import display, font, i2c, sensor
+from esphome.const import CONF_CONTRAST, CONF_ID, CONF_RESET_PIN
+
+DEPENDENCIES = ["i2c"]
+AUTO_LOAD = ["display"]
+
+gateway_display_ns = cg.esphome_ns.namespace("gateway_display")
+GatewayDisplay = gateway_display_ns.class_(
+    "GatewayDisplay", display.DisplayBuffer, i2c.I2CDevice
+)
+
+CONF_FONT_SMALL = "font_small"
+CONF_FONT_MEDIUM = "font_medium"
+CONF_FONT_LARGE = "font_large"
+CONF_SCREEN_INTERVAL = "screen_interval"
+
+# Same order as the Field enum in gateway_display.h
+FIELDS = [
+    "power",
+    "consumption",
+    "generation",
+    "battery",
+    "rssi",
+    "snr",
+    "packet_counter",
+    "missed_packets",
+]
+
+# No polling by default: the display redraws when a sensor publishes,
+# component.update forces a full redraw
+CONFIG_SCHEMA = (
+    cv.Schema(
+        {
+            cv.GenerateID(): cv.declare_id(GatewayDisplay),
+            cv.Required(CONF_FONT_SMALL): cv.use_id(font.Font),
+            cv.Required(CONF_FONT_MEDIUM): cv.use_id(font.Font),
+            cv.Required(CONF_FONT_LARGE): cv.use_id(font.Font),
+            # Time per screen, 0 keeps the first screen
+            cv.Optional(
+                CONF_SCREEN_INTERVAL, default="10s"
+            ): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_CONTRAST, default=0xCF): cv.int_range(min=0, max=255),
+            cv.Optional(CONF_RESET_PIN): pins.gpio_output_pin_schema,
+            **{cv.Optional(field): cv.use_id(sensor.Sensor) for field in FIELDS},
+        }
+    )
+    .extend(cv.polling_component_schema("never"))
+    .extend(i2c.i2c_device_schema(0x3C))
+)
+
+
+async def to_code(config):
+    var = cg.new_Pvariable(config[CONF_ID])
+    await cg.register_component(var, config)
+    await i2c.register_i2c_device(var, config)
+
+    small = await cg.get_variable(config[CONF_FONT_SMALL])
+    medium = await cg.get_variable(config[CONF_FONT_MEDIUM])
+    large = await cg.get_variable(config[CONF_FONT_LARGE])
+    cg.add(var.set_fonts(small, medium, large))
+    cg.add(var.set_screen_interval(config[CONF_SCREEN_INTERVAL].total_milliseconds))
+    cg.add(var.set_contrast(config[CONF_CONTRAST]))
+    if CONF_RESET_PIN in config:
+        pin = await cg.gpio_pin_expression(config[CONF_RESET_PIN])
+        cg.add(var.set_reset_pin(pin))
+
+    for field, key in enumerate(FIELDS):
+        if key in config:
+            sens = await cg.get_variable(config[key])
+            cg.add(var.set_sensor(field, sens))
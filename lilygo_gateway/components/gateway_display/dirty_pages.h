@@ -0,0 +1,109 @@
+#pragma once
+
+// Dirty tracking for page-organised monochrome panels (SSD1306: 8 pages
+// of 8 rows, one byte per column). Drawing marks the touched column range
+// per page; before sending, the range is narrowed against a shadow copy
+// of what the panel already shows, so a widget redrawn with the same
+// pixels costs no bus traffic at all.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace esphome {
+namespace gateway_display {
+
+// Column range of one page that differs from the panel
+struct PageWindow {
+  uint8_t page;
+  uint8_t first;
+  uint8_t last;
+};
+
+template<size_t Width, size_t Pages> class DirtyPages {
+  static_assert(Width <= 256, "columns are 8 bit");
+
+ public:
+  DirtyPages() { this->clear_marks_(); }
+
+  void mark(size_t page, size_t column) {
+    if (column < this->first_[page])
+      this->first_[page] = column;
+    if (column > this->last_[page] || this->last_[page] == NONE)
+      this->last_[page] = column;
+  }
+
+  void mark_all() {
+    for (size_t page = 0; page < Pages; page++) {
+      this->first_[page] = 0;
+      this->last_[page] = Width - 1;
+    }
+  }
+
+  // Panel content is unknown (power-up, reset): the next pass sends everything
+  void invalidate(const uint8_t *buffer) {
+    for (size_t i = 0; i < Width * Pages; i++)
+      this->shown_[i] = ~buffer[i];
+    this->mark_all();
+  }
+
+  // Next page window to send, narrowed to the bytes that really changed.
+  // Marks that turn out identical to the panel are dropped on the way.
+  bool next(const uint8_t *buffer, PageWindow &window) {
+    for (size_t page = 0; page < Pages; page++) {
+      if (this->last_[page] == NONE)
+        continue;
+      const uint8_t *row = buffer + page * Width;
+      const uint8_t *shown = this->shown_ + page * Width;
+      size_t first = this->first_[page];
+      size_t last = this->last_[page];
+      while (first <= last && row[first] == shown[first])
+        first++;
+      while (last > first && row[last] == shown[last])
+        last--;
+      if (first > last) {
+        this->first_[page] = NONE;
+        this->last_[page] = NONE;
+        continue;
+      }
+      window.page = page;
+      window.first = first;
+      window.last = last;
+      return true;
+    }
+    return false;
+  }
+
+  // The window went out to the panel
+  void sent(const uint8_t *buffer, const PageWindow &window) {
+    size_t offset = window.page * Width;
+    memcpy(this->shown_ + offset + window.first, buffer + offset + window.first, window.last - window.first + 1);
+    this->first_[window.page] = NONE;
+    this->last_[window.page] = NONE;
+  }
+
+  bool pending() const {
+    for (size_t page = 0; page < Pages; page++) {
+      if (this->last_[page] != NONE)
+        return true;
+    }
+    return false;
+  }
+
+ protected:
+  static constexpr uint16_t NONE = 0xFFFF;
+
+  void clear_marks_() {
+    for (size_t page = 0; page < Pages; page++) {
+      this->first_[page] = NONE;
+      this->last_[page] = NONE;
+    }
+  }
+
+  uint8_t shown_[Width * Pages];
+  uint16_t first_[Pages];
+  uint16_t last_[Pages];
+};
+
+}  // namespace gateway_display
+}  // namespace esphome
@@ -0,0 +1,329 @@
+#include "gateway_display.h"
+#include "esphome/core/log.h"
+#include <algorithm>
+#include <cstring>
+
+namespace esphome {
+namespace gateway_display {
+
+static const char *TAG = "gateway_display";
+
+// Bytes per I2C data transfer; the ESP32 Wire buffer holds 128
+static constexpr size_t I2C_CHUNK = 32;
+// Never a real widget text: forces the next set_text_() to draw
+static constexpr char WIDGET_STALE = '\x01';
+
+void GatewayDisplay::setup() {
+  this->init_internal_(DISPLAY_WIDTH * DISPLAY_HEIGHT / 8);
+  if (this->buffer_ == nullptr) {
+    ESP_LOGE(TAG, "Could not allocate the frame buffer");
+    this->mark_failed();
+    return;
+  }
+  if (this->reset_pin_ != nullptr) {
+    this->reset_pin_->setup();
+    this->reset_pin_->digital_write(false);
+    delay(10);
+    this->reset_pin_->digital_write(true);
+    delay(10);
+  }
+  this->init_panel_();
+
+  // Panel RAM is random after power-up: the first passes send every page
+  this->fill(display::COLOR_OFF);
+  this->dirty_.invalidate(this->buffer_);
+  this->screen_time_ = millis();
+  this->full_render_ = true;
+}
+
+void GatewayDisplay::init_panel_() {
+  const uint8_t commands[] = {
+      0xAE,                   // Display off
+      0xD5, 0x80,             // Clock divide ratio / oscillator
+      0xA8, 0x3F,             // Multiplex ratio 64
+      0xD3, 0x00,             // Display offset 0
+      0x40,                   // Start line 0
+      0x8D, 0x14,             // Charge pump on
+      0x20, 0x00,             // Horizontal addressing: windows fill column by column
+      0xA1,                   // Segment remap
+      0xC8,                   // COM scan direction remapped
+      0xDA, 0x12,             // COM pins for 128x64
+      0x81, this->contrast_,  // Contrast
+      0xD9, 0xF1,             // Pre-charge period
+      0xDB, 0x40,             // VCOMH deselect level
+      0xA4,                   // Show RAM content
+      0xA6,                   // Normal (not inverted)
+      0xAF,                   // Display on
+  };
+  this->command_(commands, sizeof(commands));
+}
+
+void GatewayDisplay::command_(const uint8_t *commands, size_t len) {
+  // Control byte 0x00: everything that follows is a command
+  this->write_bytes(0x00, commands, len);
+}
+
+void GatewayDisplay::loop() {
+  uint32_t now = millis();
+  if (this->screen_interval_ > 0 && now - this->screen_time_ >= this->screen_interval_) {
+    this->screen_time_ = now;
+    this->screen_ = (this->screen_ + 1) % SCREEN_COUNT;
+    this->full_render_ = true;
+  }
+
+  bool age_due = this->have_packet_ && now - this->age_time_ >= AGE_REFRESH_MS;
+  if (this->full_render_ || this->changed_ != 0 || age_due)
+    this->render_(this->full_render_);
+
+  this->flush_page_();
+}
+
+// component.update (e.g. a refresh button): redraw everything
+void GatewayDisplay::update() { this->full_render_ = true; }
+
+void GatewayDisplay::dump_config() {
+  ESP_LOGCONFIG(TAG, "Gateway Display (SSD1306 128x64, dirty pages):");
+  ESP_LOGCONFIG(TAG, "  Address: 0x%02X", this->address_);
+  ESP_LOGCONFIG(TAG, "  Screen interval: %u s", (unsigned) (this->screen_interval_ / 1000));
+  ESP_LOGCONFIG(TAG, "  Renders: %u, bytes sent: %u", (unsigned) this->renders_, (unsigned) this->bytes_sent_);
+}
+
+void GatewayDisplay::set_sensor(uint8_t field, sensor::Sensor *sensor) {
+  this->sensors_[field] = sensor;
+  this->values_[field] = NAN;
+  // Only record the value: rendering waits for loop(), so the several
+  // sensors published per packet cost one render
+  sensor->add_on_state_callback([this, field](float state) {
+    this->values_[field] = state;
+    this->changed_ |= 1 << field;
+    if (field == FIELD_POWER || field == FIELD_RSSI || field == FIELD_PACKET_COUNTER) {
+      this->last_packet_time_ = millis();
+      this->have_packet_ = true;
+    }
+  });
+}
+
+void GatewayDisplay::fill(Color color) {
+  memset(this->buffer_, color.is_on() ? 0xFF : 0x00, DISPLAY_WIDTH * DISPLAY_PAGES);
+  this->dirty_.mark_all();
+}
+
+void GatewayDisplay::draw_absolute_pixel_internal(int x, int y, Color color) {
+  if (x < 0 || x >= DISPLAY_WIDTH || y < 0 || y >= DISPLAY_HEIGHT)
+    return;
+  size_t index = x + (y / 8) * DISPLAY_WIDTH;
+  uint8_t bit = 1 << (y & 7);
+  uint8_t before = this->buffer_[index];
+  uint8_t after = color.is_on() ? (before | bit) : (before & ~bit);
+  if (after != before) {
+    this->buffer_[index] = after;
+    this->dirty_.mark(y / 8, x);
+  }
+}
+
+// At most one page window per pass: worst case 128 bytes, ~3 ms at 400 kHz
+void GatewayDisplay::flush_page_() {
+  PageWindow window;
+  if (!this->dirty_.next(this->buffer_, window))
+    return;
+  const uint8_t commands[] = {0x21, window.first, window.last, 0x22, window.page, window.page};
+  this->command_(commands, sizeof(commands));
+  const uint8_t *data = this->buffer_ + window.page * DISPLAY_WIDTH + window.first;
+  size_t len = window.last - window.first + 1;
+  for (size_t i = 0; i < len; i += I2C_CHUNK)
+    this->write_bytes(0x40, data + i, std::min(I2C_CHUNK, len - i));
+  this->dirty_.sent(this->buffer_, window);
+  this->bytes_sent_ += len;
+}
+
+void GatewayDisplay::render_(bool full) {
+  uint16_t changed = this->changed_;
+  if (full) {
+    this->fill(display::COLOR_OFF);
+    for (auto &widget : this->widgets_) {
+      widget.text[0] = WIDGET_STALE;
+      widget.width = 0;
+    }
+    this->signal_bars_ = -1;
+    this->battery_fill_ = -1;
+    changed = (1 << FIELD_COUNT) - 1;
+  }
+
+  switch (this->screen_) {
+    case SCREEN_POWER:
+      if (full)
+        this->draw_header_("SMART METER");
+      this->render_power_(changed);
+      break;
+    case SCREEN_LINK:
+      if (full)
+        this->draw_header_("LINK STATUS");
+      this->render_link_(changed);
+      break;
+    default:
+      if (full)
+        this->draw_header_("TOTALS");
+      this->render_totals_(changed);
+      break;
+  }
+
+  // Widget 0: time since the last packet, top right on every screen
+  char text[24];
+  uint32_t age_s = (millis() - this->last_packet_time_) / 1000;
+  if (!this->have_packet_) {
+    snprintf(text, sizeof(text), "--");
+  } else if (age_s < 100) {
+    snprintf(text, sizeof(text), "%us", (unsigned) age_s);
+  } else if (age_s < 6000) {
+    snprintf(text, sizeof(text), "%um", (unsigned) (age_s / 60));
+  } else {
+    snprintf(text, sizeof(text), "%uh", (unsigned) (age_s / 3600));
+  }
+  this->set_text_(0, DISPLAY_WIDTH - 2, 0, this->font_small_, display::TextAlign::TOP_RIGHT, text);
+  this->age_time_ = millis();
+
+  this->changed_ = 0;
+  this->full_render_ = false;
+  this->renders_++;
+}
+
+void GatewayDisplay::draw_header_(const char *title) {
+  this->print(2, 0, this->font_small_, display::TextAlign::TOP_LEFT, title);
+  this->line(0, 11, DISPLAY_WIDTH - 1, 11);
+}
+
+void GatewayDisplay::render_power_(uint16_t changed) {
+  char text[24];
+  if (changed & (1 << FIELD_POWER)) {
+    float power = this->values_[FIELD_POWER];
+    if (!this->has_value_(FIELD_POWER)) {
+      this->set_text_(1, 64, 13, this->font_small_, display::TextAlign::TOP_CENTER, "");
+      this->set_text_(2, 64, 24, this->font_medium_, display::TextAlign::TOP_CENTER, "No Data");
+    } else {
+      this->set_text_(1, 64, 13, this->font_small_, display::TextAlign::TOP_CENTER,
+                      power < 0 ? "GENERATING" : "CONSUMING");
+      snprintf(text, sizeof(text), power < 0 ? "<%.0fW" : "%.0fW", std::fabs(power));
+      this->set_text_(2, 64, 23, this->font_large_, display::TextAlign::TOP_CENTER, text);
+    }
+  }
+  if (changed == (1 << FIELD_COUNT) - 1)
+    this->line(0, 47, DISPLAY_WIDTH - 1, 47);
+  if ((changed & (1 << FIELD_CONSUMPTION)) && this->has_value_(FIELD_CONSUMPTION)) {
+    snprintf(text, sizeof(text), "In:%.1fkWh", this->values_[FIELD_CONSUMPTION]);
+    this->set_text_(3, 2, 51, this->font_small_, display::TextAlign::TOP_LEFT, text);
+  }
+  if ((changed & (1 << FIELD_GENERATION)) && this->has_value_(FIELD_GENERATION)) {
+    snprintf(text, sizeof(text), "Out:%.1fkWh", this->values_[FIELD_GENERATION]);
+    this->set_text_(4, DISPLAY_WIDTH - 2, 51, this->font_small_, display::TextAlign::TOP_RIGHT, text);
+  }
+}
+
+void GatewayDisplay::render_link_(uint16_t changed) {
+  char text[24];
+  if (changed == (1 << FIELD_COUNT) - 1) {
+    this->print(2, 15, this->font_small_, display::TextAlign::TOP_LEFT, "RSSI:");
+    this->print(2, 29, this->font_small_, display::TextAlign::TOP_LEFT, "SNR:");
+    this->print(2, 42, this->font_small_, display::TextAlign::TOP_LEFT, "Bat:");
+    this->print(2, 53, this->font_small_, display::TextAlign::TOP_LEFT, "Pkts:");
+  }
+
+  if ((changed & (1 << FIELD_RSSI)) && this->has_value_(FIELD_RSSI)) {
+    int rssi = (int) this->values_[FIELD_RSSI];
+    snprintf(text, sizeof(text), "%d dBm", rssi);
+    this->set_text_(1, 36, 13, this->font_medium_, display::TextAlign::TOP_LEFT, text);
+    int8_t bars = rssi > -60 ? 4 : rssi > -70 ? 3 : rssi > -80 ? 2 : rssi > -90 ? 1 : 0;
+    if (bars != this->signal_bars_) {
+      this->signal_bars_ = bars;
+      this->filled_rectangle(110, 14, 15, 11, display::COLOR_OFF);
+      for (int i = 0; i < 4; i++) {
+        int height = 3 + i * 2;
+        if (i < bars) {
+          this->filled_rectangle(110 + i * 4, 24 - height, 3, height);
+        } else {
+          this->rectangle(110 + i * 4, 24 - height, 3, height);
+        }
+      }
+    }
+  }
+
+  if ((changed & (1 << FIELD_SNR)) && this->has_value_(FIELD_SNR)) {
+    snprintf(text, sizeof(text), "%.1f dB", this->values_[FIELD_SNR]);
+    this->set_text_(2, 36, 27, this->font_medium_, display::TextAlign::TOP_LEFT, text);
+  }
+
+  if ((changed & (1 << FIELD_BATTERY)) && this->has_value_(FIELD_BATTERY)) {
+    float voltage = this->values_[FIELD_BATTERY];
+    int percent = (int) ((voltage - 3.0f) / 1.2f * 100);
+    percent = percent > 100 ? 100 : (percent < 0 ? 0 : percent);
+    snprintf(text, sizeof(text), "%.2fV %d%%", voltage, percent);
+    this->set_text_(3, 36, 42, this->font_small_, display::TextAlign::TOP_LEFT, text);
+    int8_t fill = (int8_t) (20 * percent / 100);
+    if (fill != this->battery_fill_) {
+      this->battery_fill_ = fill;
+      this->filled_rectangle(100, 42, 24, 9, display::COLOR_OFF);
+      this->rectangle(100, 42, 22, 9);
+      this->rectangle(122, 44, 2, 5);
+      if (fill > 0)
+        this->filled_rectangle(101, 43, fill, 7);
+    }
+  }
+
+  if ((changed & ((1 << FIELD_PACKET_COUNTER) | (1 << FIELD_MISSED_PACKETS))) &&
+      this->has_value_(FIELD_PACKET_COUNTER)) {
+    if (this->has_value_(FIELD_MISSED_PACKETS)) {
+      snprintf(text, sizeof(text), "%u, %u lost", (unsigned) this->values_[FIELD_PACKET_COUNTER],
+               (unsigned) this->values_[FIELD_MISSED_PACKETS]);
+    } else {
+      snprintf(text, sizeof(text), "%u", (unsigned) this->values_[FIELD_PACKET_COUNTER]);
+    }
+    this->set_text_(4, 36, 53, this->font_small_, display::TextAlign::TOP_LEFT, text);
+  }
+}
+
+void GatewayDisplay::render_totals_(uint16_t changed) {
+  char text[24];
+  if (changed == (1 << FIELD_COUNT) - 1) {
+    this->print(2, 17, this->font_small_, display::TextAlign::TOP_LEFT, "Used");
+    this->print(2, 33, this->font_small_, display::TextAlign::TOP_LEFT, "Solar");
+    this->print(2, 49, this->font_small_, display::TextAlign::TOP_LEFT, "Net");
+  }
+  bool consumption = this->has_value_(FIELD_CONSUMPTION);
+  bool generation = this->has_value_(FIELD_GENERATION);
+  if ((changed & (1 << FIELD_CONSUMPTION)) && consumption) {
+    snprintf(text, sizeof(text), "%.2f kWh", this->values_[FIELD_CONSUMPTION]);
+    this->set_text_(1, DISPLAY_WIDTH - 2, 14, this->font_medium_, display::TextAlign::TOP_RIGHT, text);
+  }
+  if ((changed & (1 << FIELD_GENERATION)) && generation) {
+    snprintf(text, sizeof(text), "%.2f kWh", this->values_[FIELD_GENERATION]);
+    this->set_text_(2, DISPLAY_WIDTH - 2, 30, this->font_medium_, display::TextAlign::TOP_RIGHT, text);
+  }
+  if ((changed & ((1 << FIELD_CONSUMPTION) | (1 << FIELD_GENERATION))) && consumption && generation) {
+    float net = this->values_[FIELD_CONSUMPTION] - this->values_[FIELD_GENERATION];
+    snprintf(text, sizeof(text), "%+.2f kWh", net);
+    this->set_text_(3, DISPLAY_WIDTH - 2, 46, this->font_medium_, display::TextAlign::TOP_RIGHT, text);
+  }
+}
+
+void GatewayDisplay::set_text_(uint8_t widget, int x, int y, font::Font *font, display::TextAlign align,
+                               const char *text) {
+  TextWidget &w = this->widgets_[widget];
+  if (strncmp(w.text, text, sizeof(w.text) - 1) == 0)
+    return;
+  this->clear_widget_(widget);
+  strncpy(w.text, text, sizeof(w.text) - 1);
+  w.text[sizeof(w.text) - 1] = '\0';
+  if (font == nullptr || w.text[0] == '\0')
+    return;
+  this->get_text_bounds(x, y, w.text, font, align, &w.x1, &w.y1, &w.width, &w.height);
+  this->print(x, y, font, display::COLOR_ON, align, w.text);
+}
+
+void GatewayDisplay::clear_widget_(uint8_t widget) {
+  TextWidget &w = this->widgets_[widget];
+  if (w.width > 0)
+    this->filled_rectangle(w.x1, w.y1, w.width, w.height, display::COLOR_OFF);
+  w.width = 0;
+}
+
+}  // namespace gateway_display
+}  // namespace esphome
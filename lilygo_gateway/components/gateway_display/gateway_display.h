@@ -0,0 +1,122 @@
+#pragma once
+
+#include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+#include "esphome/components/display/display_buffer.h"
+#include "esphome/components/font/font.h"
+#include "esphome/components/i2c/i2c.h"
+#include "esphome/components/sensor/sensor.h"
+#include <cmath>
+
+#include "dirty_pages.h"
+
+namespace esphome {
+namespace gateway_display {
+
+static constexpr int DISPLAY_WIDTH = 128;
+static constexpr int DISPLAY_HEIGHT = 64;
+static constexpr size_t DISPLAY_PAGES = DISPLAY_HEIGHT / 8;
+
+// Same order as FIELDS in __init__.py
+enum Field : uint8_t {
+  FIELD_POWER,
+  FIELD_CONSUMPTION,
+  FIELD_GENERATION,
+  FIELD_BATTERY,
+  FIELD_RSSI,
+  FIELD_SNR,
+  FIELD_PACKET_COUNTER,
+  FIELD_MISSED_PACKETS,
+  FIELD_COUNT,
+};
+
+enum Screen : uint8_t {
+  SCREEN_POWER,
+  SCREEN_LINK,
+  SCREEN_TOTALS,
+  SCREEN_COUNT,
+};
+
+// Text drawn at a fixed anchor; keeps what it shows and where, so an
+// unchanged value is neither formatted nor rasterised again
+struct TextWidget {
+  char text[24];
+  int x1, y1, width, height;  // Bounds of the drawn text, cleared before the next draw
+};
+
+// Gateway status on an SSD1306 128x64 over I2C. Sensor updates are
+// coalesced and rendered once per loop(); only widgets whose text
+// changed are redrawn and only changed page column ranges go out on
+// the bus, one page per loop() pass so the main loop never stalls for a
+// whole frame.
+class GatewayDisplay : public display::DisplayBuffer, public i2c::I2CDevice {
+ public:
+  void setup() override;
+  void loop() override;
+  void update() override;
+  void dump_config() override;
+  float get_setup_priority() const override { return setup_priority::PROCESSOR; }
+
+  void set_sensor(uint8_t field, sensor::Sensor *sensor);
+  void set_fonts(font::Font *small, font::Font *medium, font::Font *large) {
+    font_small_ = small;
+    font_medium_ = medium;
+    font_large_ = large;
+  }
+  void set_screen_interval(uint32_t interval_ms) { screen_interval_ = interval_ms; }
+  void set_contrast(uint8_t contrast) { contrast_ = contrast; }
+  void set_reset_pin(GPIOPin *pin) { reset_pin_ = pin; }
+
+  void fill(Color color) override;
+  display::DisplayType get_display_type() override { return display::DisplayType::DISPLAY_TYPE_BINARY; }
+
+ protected:
+  static constexpr uint8_t WIDGET_COUNT = 8;
+  static constexpr uint32_t AGE_REFRESH_MS = 1000;
+
+  int get_width_internal() override { return DISPLAY_WIDTH; }
+  int get_height_internal() override { return DISPLAY_HEIGHT; }
+  void draw_absolute_pixel_internal(int x, int y, Color color) override;
+
+  void init_panel_();
+  void command_(const uint8_t *commands, size_t len);
+  void flush_page_();
+
+  void render_(bool full);
+  void render_power_(uint16_t changed);
+  void render_link_(uint16_t changed);
+  void render_totals_(uint16_t changed);
+  void draw_header_(const char *title);
+  void set_text_(uint8_t widget, int x, int y, font::Font *font, display::TextAlign align, const char *text);
+  void clear_widget_(uint8_t widget);
+  bool has_value_(uint8_t field) const { return sensors_[field] != nullptr && !std::isnan(values_[field]); }
+
+  sensor::Sensor *sensors_[FIELD_COUNT]{};
+  float values_[FIELD_COUNT];
+  uint16_t changed_{0};            // Fields updated since the last render, one bit each
+  uint32_t last_packet_time_{0};
+  bool have_packet_{false};
+
+  font::Font *font_small_{nullptr};
+  font::Font *font_medium_{nullptr};
+  font::Font *font_large_{nullptr};
+  GPIOPin *reset_pin_{nullptr};
+  uint8_t contrast_{0xCF};
+
+  uint8_t screen_{SCREEN_POWER};
+  uint32_t screen_interval_{10000};
+  uint32_t screen_time_{0};
+  bool full_render_{true};
+  uint32_t age_time_{0};
+
+  TextWidget widgets_[WIDGET_COUNT];
+  int8_t signal_bars_{-1};
+  int8_t battery_fill_{-1};
+
+  DirtyPages<DISPLAY_WIDTH, DISPLAY_PAGES> dirty_;
+  uint32_t bytes_sent_{0};
+  uint32_t renders_{0};
+};
+
+}  // namespace gateway_display
+}  // namespace esphome
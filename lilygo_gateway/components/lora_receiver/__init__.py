@@ -1,8 +1,24 @@
+import re
+from pathlib import Path
+
 import esphome.codegen as cg
 import esphome.config_validation as cv
-from esphome.components import sensor
+from esphome.core import CORE
+from esphome.components import sensor, spi, time, web_server_base
 from esphome.const import (
+    CONF_BROKER,
+    CONF_CLIENT_ID,
+    CONF_FREQUENCY,
     CONF_ID,
+    CONF_PASSWORD,
+    CONF_PORT,
+    CONF_QOS,
+    CONF_RETAIN,
+    CONF_TOPIC_PREFIX,
+    CONF_TYPE,
+    CONF_USERNAME,
+    CONF_URL,
+    CONF_TIME_ID,
     DEVICE_CLASS_POWER,
     DEVICE_CLASS_ENERGY,
     DEVICE_CLASS_VOLTAGE,
@@ -13,14 +29,20 @@ from esphome.const import (
     UNIT_VOLT,
     UNIT_DECIBEL_MILLIWATT,
     UNIT_DECIBEL,
+    UNIT_PERCENT,
+    UNIT_SECOND,
+    ENTITY_CATEGORY_DIAGNOSTIC,
 )
 
 DEPENDENCIES = ["spi"]
-AUTO_LOAD = ["sensor"]
+AUTO_LOAD = ["sensor", "web_server_base"]
+
+# Payload, radio and sweep definitions are shared with the CubeCell firmware
+SHARED_SRC_DIR = Path(__file__).resolve().parents[3] / "src"
 
 lora_receiver_ns = cg.esphome_ns.namespace("lora_receiver")
 LoRaReceiverComponent = lora_receiver_ns.class_(
-    "LoRaReceiverComponent", cg.Component
+    "LoRaReceiverComponent", cg.Component, spi.SPIDevice
 )
 
 CONF_POWER = "power"
@@ -31,10 +53,269 @@ CONF_RSSI = "rssi"
 CONF_SNR = "snr"
 CONF_PACKET_COUNTER = "packet_counter"
 CONF_MISSED_PACKETS = "missed_packets"
+CONF_PACKET_ERROR_RATE_1H = "packet_error_rate_1h"
+CONF_PACKET_ERROR_RATE_24H = "packet_error_rate_24h"
+CONF_JITTER = "jitter"
+CONF_CHANNEL_UTILIZATION = "channel_utilization"
+CONF_NOISE_FLOOR = "noise_floor"
+CONF_COLLISION_PROBABILITY = "collision_probability"
 CONF_CS_PIN = "cs_pin"
 CONF_DIO1_PIN = "dio1_pin"
 CONF_RST_PIN = "rst_pin"
 CONF_BUSY_PIN = "busy_pin"
+CONF_TCXO_VOLTAGE = "tcxo_voltage"
+CONF_SWEEP_MAX_PER = "sweep_max_per"
+CONF_WEB_SERVER_BASE_ID = "web_server_base_id"
+CONF_DEADBAND = "deadband"
+CONF_MIN_INTERVAL = "min_interval"
+CONF_FORCE_UPDATE_INTERVAL = "force_update_interval"
+CONF_HISTORY = "history"
+CONF_RAW_SAMPLES = "raw_samples"
+CONF_MINUTE_BUCKETS = "minute_buckets"
+CONF_QUARTER_BUCKETS = "quarter_buckets"
+CONF_OUTBOX_BLOCKS = "outbox_blocks"
+CONF_VOLKSZAEHLER = "volkszaehler"
+CONF_CHANNELS = "channels"
+CONF_UUID = "uuid"
+CONF_NODE = "node"
+CONF_BATCH_SIZE = "batch_size"
+CONF_MAX_DELAY = "max_delay"
+CONF_MQTT = "mqtt"
+CONF_FORMAT = "format"
+CONF_INFLIGHT = "inflight"
+CONF_SCAN_PROFILES = "scan_profiles"
+CONF_SPREADING_FACTOR = "spreading_factor"
+CONF_BANDWIDTH = "bandwidth"
+CONF_DOWNLINK = "downlink"
+CONF_KEY = "key"
+CONF_TX_POWER = "tx_power"
+CONF_NODE_KEYS = "node_keys"
+CONF_REQUIRE_SIGNED = "require_signed"
+CONF_MESHTASTIC = "meshtastic"
+CONF_NODES = "nodes"
+CONF_NUM = "num"
+CONF_CHANNEL = "channel"
+
+# Same order as the PublishChannel enum in lora_receiver.h
+PUBLISH_CHANNELS = [
+    CONF_POWER,
+    CONF_CONSUMPTION,
+    CONF_GENERATION,
+    CONF_BATTERY,
+    CONF_RSSI,
+    CONF_SNR,
+    CONF_PACKET_COUNTER,
+    CONF_MISSED_PACKETS,
+    CONF_PACKET_ERROR_RATE_1H,
+    CONF_PACKET_ERROR_RATE_24H,
+    CONF_JITTER,
+    CONF_CHANNEL_UTILIZATION,
+    CONF_NOISE_FLOOR,
+    CONF_COLLISION_PROBABILITY,
+]
+
+VzField = lora_receiver_ns.enum("VzField")
+VZ_FIELDS = {
+    CONF_POWER: VzField.VZ_FIELD_POWER,
+    CONF_CONSUMPTION: VzField.VZ_FIELD_CONSUMPTION,
+    CONF_GENERATION: VzField.VZ_FIELD_GENERATION,
+}
+VZ_MAX_CHANNELS = 8  # VzClient::MAX_CHANNELS
+MqttSink = lora_receiver_ns.class_("MqttSink")
+ReadingFormat = lora_receiver_ns.enum("ReadingFormat")
+READING_FORMATS = {
+    "json": ReadingFormat.READING_JSON,
+    "cbor": ReadingFormat.READING_CBOR,
+    "binary": ReadingFormat.READING_BINARY,
+}
+MQTT_MAX_INFLIGHT = 8  # MqttSink::MAX_INFLIGHT
+# CubeCell radio API bandwidth codes, as in LoRaProfile
+SCAN_BANDWIDTHS = {"125kHz": 0, "250kHz": 1, "500kHz": 2}
+SCAN_MAX_PROFILES = 8  # MAX_SCAN_PROFILES in lora_receiver.h
+MAX_NODE_KEYS = 8  # LINK_STATS_MAX_NODES in lora_receiver.h
+VZ_URL = re.compile(r"http://([^/:]+)(?::(\d+))?(/.*)?")
+NODE_KEY = re.compile(r"[0-9A-Fa-f]{32}")
+# MESHTASTIC_DEFAULT_CHANNEL / MESHTASTIC_DEFAULT_KEY in meshtastic_telemetry.h
+MESHTASTIC_DEFAULT_CHANNEL = "LongFast"
+MESHTASTIC_DEFAULT_KEY = "d4f1bb3a20290759f0bcffabcf4e6901"
+MESHTASTIC_MAX_CHANNEL = 11  # Meshtastic ChannelSettings.name
+
+
+def publish_options(deadband, min_interval="0s"):
+    """Per-sensor publish filter: skip changes within the deadband and
+    publish at most once per min_interval."""
+    return {
+        cv.Optional(CONF_DEADBAND, default=deadband): cv.positive_float,
+        cv.Optional(
+            CONF_MIN_INTERVAL, default=min_interval
+        ): cv.positive_time_period_milliseconds,
+    }
+
+
+def vz_url(value):
+    """Plain http://host[:port]/path of the middleware, split for the client."""
+    value = cv.string_strict(value)
+    if VZ_URL.fullmatch(value) is None:
+        raise cv.Invalid("Expected http://host[:port]/path/middleware.php")
+    return value
+
+
+def node_key(value):
+    """AES-128 key as 32 hex digits, the bytes of the node's NODE_KEY."""
+    value = cv.string_strict(value).replace(" ", "")
+    if NODE_KEY.fullmatch(value) is None:
+        raise cv.Invalid("Expected 32 hex digits (16 bytes)")
+    return value
+
+
+def meshtastic_num(value):
+    """Meshtastic node number, hex with or without the app's "!" prefix."""
+    if isinstance(value, str) and value.startswith("!"):
+        value = value[1:]
+    return cv.hex_int_range(min=1, max=0xFFFFFFFE)(value)
+
+
+def meshtastic_node_id(config):
+    """Senders above 0xFFFF need an explicit gateway node id."""
+    if CONF_NODE not in config:
+        if config[CONF_NUM] > 0xFFFF:
+            raise cv.Invalid("node numbers above FFFF need node: (the gateway's 16-bit id)")
+        config[CONF_NODE] = config[CONF_NUM]
+    return config
+
+
+def meshtastic_unique_nodes(config):
+    ids = [conf[CONF_NODE] for conf in config[CONF_NODES]]
+    if len(set(ids)) != len(ids):
+        raise cv.Invalid("Each Meshtastic sender needs its own node id")
+    return config
+
+
+def volkszaehler_needs_time(config):
+    if CONF_VOLKSZAEHLER in config and CONF_TIME_ID not in config:
+        raise cv.Invalid("volkszaehler needs time_id: readings are stamped with wall clock time")
+    return config
+
+
+def downlink_needs_keys(config):
+    if CONF_DOWNLINK in config and not config.get(CONF_NODE_KEYS):
+        raise cv.Invalid("downlink needs node_keys: config frames are signed with the node's key")
+    return config
+
+
+VOLKSZAEHLER_SCHEMA = cv.Schema(
+    {
+        cv.Required(CONF_URL): vz_url,
+        cv.Required(CONF_CHANNELS): cv.All(
+            cv.ensure_list(
+                cv.Schema(
+                    {
+                        cv.Required(CONF_UUID): cv.All(
+                            cv.string_strict, cv.Length(min=36, max=36)
+                        ),
+                        cv.Required(CONF_TYPE): cv.one_of(*VZ_FIELDS, lower=True),
+                        # Without a node the channel follows the node the
+                        # sensors show; with several meters give each
+                        # channel its node
+                        cv.Optional(CONF_NODE): cv.hex_int_range(min=1, max=0xFFFF),
+                    }
+                )
+            ),
+            cv.Length(min=1, max=VZ_MAX_CHANNELS),
+        ),
+        # A channel is posted once batch_size readings are queued or its
+        # oldest reading waited max_delay
+        cv.Optional(CONF_BATCH_SIZE, default=30): cv.int_range(min=1, max=32),
+        cv.Optional(
+            CONF_MAX_DELAY, default="60s"
+        ): cv.positive_time_period_milliseconds,
+    }
+)
+
+# One message per reading on <topic_prefix>/<node>/state; payload
+# layouts are described in reading_codec.h
+MQTT_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(MqttSink),
+        cv.Required(CONF_BROKER): cv.string_strict,
+        cv.Optional(CONF_PORT, default=1883): cv.port,
+        cv.Optional(CONF_CLIENT_ID): cv.string_strict,
+        cv.Optional(CONF_USERNAME): cv.string_strict,
+        cv.Optional(CONF_PASSWORD, default=""): cv.string_strict,
+        cv.Optional(CONF_TOPIC_PREFIX, default="lora_gateway"): cv.string_strict,
+        cv.Optional(CONF_FORMAT, default="json"): cv.one_of(
+            *READING_FORMATS, lower=True
+        ),
+        cv.Optional(CONF_QOS, default=0): cv.one_of(0, 1, int=True),
+        # QoS 1 publishes awaiting their PUBACK
+        cv.Optional(CONF_INFLIGHT, default=4): cv.int_range(
+            min=1, max=MQTT_MAX_INFLIGHT
+        ),
+        cv.Optional(CONF_RETAIN, default=True): cv.boolean,
+    }
+)
+
+# Keys of nodes built with -D NODE_KEY: their meter frames must carry a
+# valid tag and a fresh packet counter
+NODE_KEY_SCHEMA = cv.Schema(
+    {
+        cv.Required(CONF_NODE): cv.hex_int_range(min=1, max=0xFFFF),
+        cv.Required(CONF_KEY): node_key,
+    }
+)
+
+# A TRANSPORT_LORA_MESHTASTIC node sends as node number = its node id
+MESHTASTIC_NODE_SCHEMA = cv.All(
+    cv.Schema(
+        {
+            cv.Required(CONF_NUM): meshtastic_num,
+            cv.Optional(CONF_NODE): cv.hex_int_range(min=1, max=0xFFFF),
+        }
+    ),
+    meshtastic_node_id,
+)
+
+# Telemetry of nodes built with TRANSPORT_LORA_MESHTASTIC; the same
+# channel name and key as their MESHTASTIC_CHANNEL and MESHTASTIC_KEY.
+# Only the listed senders count: on a public channel other devices send
+# PowerMetrics too.
+MESHTASTIC_SCHEMA = cv.All(
+    cv.Schema(
+        {
+            cv.Optional(CONF_CHANNEL, default=MESHTASTIC_DEFAULT_CHANNEL): cv.All(
+                cv.string_strict, cv.Length(min=1, max=MESHTASTIC_MAX_CHANNEL)
+            ),
+            cv.Optional(CONF_KEY, default=MESHTASTIC_DEFAULT_KEY): node_key,
+            cv.Required(CONF_NODES): cv.All(
+                cv.ensure_list(MESHTASTIC_NODE_SCHEMA),
+                cv.Length(min=1, max=MAX_NODE_KEYS),
+            ),
+        }
+    ),
+    meshtastic_unique_nodes,
+)
+
+# Config downlinks to nodes in node_keys; changes are queued with
+# POST /lora/config and sent in the node's receive window
+DOWNLINK_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_TX_POWER, default=20): cv.int_range(min=-9, max=22),
+    }
+)
+
+# CAD scan over these profiles instead of continuous RX on the base
+# profile; without a frequency a profile uses LORA_FREQUENCY. All of them
+# must lie in the band the image calibration is done for.
+SCAN_PROFILE_SCHEMA = cv.Schema(
+    {
+        cv.Required(CONF_SPREADING_FACTOR): cv.int_range(min=7, max=12),
+        cv.Optional(CONF_BANDWIDTH, default="125kHz"): cv.enum(SCAN_BANDWIDTHS),
+        cv.Optional(CONF_FREQUENCY): cv.All(
+            cv.frequency, cv.float_range(min=150e6, max=960e6)
+        ),
+    }
+)
+
 
 CONFIG_SCHEMA = cv.Schema(
     {
@@ -42,61 +323,231 @@ CONFIG_SCHEMA = cv.Schema(
         cv.Required(CONF_DIO1_PIN): cv.int_,
         cv.Required(CONF_RST_PIN): cv.int_,
         cv.Required(CONF_BUSY_PIN): cv.int_,
+        cv.Optional(CONF_TCXO_VOLTAGE): cv.float_range(min=1.6, max=3.3),
+        cv.GenerateID(CONF_WEB_SERVER_BASE_ID): cv.use_id(
+            web_server_base.WebServerBase
+        ),
+        # Node the power/energy/link sensors show. Without it they stay on
+        # the first node heard after boot; readings of other nodes go to
+        # MQTT, Volkszaehler channels with their node and /lora/history.
+        cv.Optional(CONF_NODE): cv.hex_int_range(min=1, max=0xFFFF),
+        cv.Optional(CONF_SWEEP_MAX_PER, default=10.0): cv.float_range(
+            min=0.0, max=100.0
+        ),
+        cv.Optional(CONF_SCAN_PROFILES): cv.All(
+            cv.ensure_list(SCAN_PROFILE_SCHEMA),
+            cv.Length(min=2, max=SCAN_MAX_PROFILES),
+        ),
+        cv.Optional(
+            CONF_FORCE_UPDATE_INTERVAL, default="10min"
+        ): cv.positive_time_period_milliseconds,
+        # Without a time source history is stamped with uptime seconds
+        cv.Optional(CONF_TIME_ID): cv.use_id(time.RealTimeClock),
+        cv.Optional(CONF_HISTORY, default={}): cv.Schema(
+            {
+                # 16 bytes per raw sample, 28 per bucket, per node
+                cv.Optional(CONF_RAW_SAMPLES, default=1440): cv.int_range(
+                    min=16, max=65535
+                ),
+                cv.Optional(CONF_MINUTE_BUCKETS, default=720): cv.int_range(
+                    min=1, max=65535
+                ),
+                cv.Optional(CONF_QUARTER_BUCKETS, default=192): cv.int_range(
+                    min=1, max=65535
+                ),
+            }
+        ),
+        # Flash-backed queue for readings while Home Assistant is away,
+        # 8 readings (256 bytes) per block, 0 disables it
+        cv.Optional(CONF_OUTBOX_BLOCKS, default=16): cv.int_range(min=0, max=32),
+        cv.Optional(CONF_VOLKSZAEHLER): VOLKSZAEHLER_SCHEMA,
+        cv.Optional(CONF_MQTT): MQTT_SCHEMA,
+        cv.Optional(CONF_NODE_KEYS): cv.All(
+            cv.ensure_list(NODE_KEY_SCHEMA),
+            cv.Length(max=MAX_NODE_KEYS),
+        ),
+        # Drop unsigned meter frames from every node, not only keyed ones
+        cv.Optional(CONF_REQUIRE_SIGNED, default=False): cv.boolean,
+        cv.Optional(CONF_DOWNLINK): DOWNLINK_SCHEMA,
+        cv.Optional(CONF_MESHTASTIC): MESHTASTIC_SCHEMA,
         cv.Optional(CONF_POWER): sensor.sensor_schema(
             unit_of_measurement=UNIT_WATT,
             device_class=DEVICE_CLASS_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
             accuracy_decimals=1,
-        ),
+        ).extend(publish_options(1.0)),
         cv.Optional(CONF_CONSUMPTION): sensor.sensor_schema(
             unit_of_measurement="kWh",
             device_class=DEVICE_CLASS_ENERGY,
             state_class=STATE_CLASS_TOTAL_INCREASING,
             accuracy_decimals=3,
-        ),
+        ).extend(publish_options(0.001)),
         cv.Optional(CONF_GENERATION): sensor.sensor_schema(
             unit_of_measurement="kWh",
             device_class=DEVICE_CLASS_ENERGY,
             state_class=STATE_CLASS_TOTAL_INCREASING,
             accuracy_decimals=3,
-        ),
+        ).extend(publish_options(0.001)),
         cv.Optional(CONF_BATTERY): sensor.sensor_schema(
             unit_of_measurement=UNIT_VOLT,
             device_class=DEVICE_CLASS_VOLTAGE,
             state_class=STATE_CLASS_MEASUREMENT,
             accuracy_decimals=2,
-        ),
+        ).extend(publish_options(0.02)),
         cv.Optional(CONF_RSSI): sensor.sensor_schema(
             unit_of_measurement=UNIT_DECIBEL_MILLIWATT,
             device_class=DEVICE_CLASS_SIGNAL_STRENGTH,
             state_class=STATE_CLASS_MEASUREMENT,
             accuracy_decimals=0,
-        ),
+        ).extend(publish_options(2.0)),
         cv.Optional(CONF_SNR): sensor.sensor_schema(
             unit_of_measurement=UNIT_DECIBEL,
             state_class=STATE_CLASS_MEASUREMENT,
             accuracy_decimals=1,
-        ),
+        ).extend(publish_options(1.0)),
         cv.Optional(CONF_PACKET_COUNTER): sensor.sensor_schema(
             state_class=STATE_CLASS_MEASUREMENT,
             accuracy_decimals=0,
-        ),
+        ).extend(publish_options(0.0, "60s")),
         cv.Optional(CONF_MISSED_PACKETS): sensor.sensor_schema(
             state_class=STATE_CLASS_MEASUREMENT,
             accuracy_decimals=0,
-        ),
+        ).extend(publish_options(0.0)),
+        cv.Optional(CONF_PACKET_ERROR_RATE_1H): sensor.sensor_schema(
+            unit_of_measurement=UNIT_PERCENT,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+            accuracy_decimals=1,
+        ).extend(publish_options(0.5)),
+        cv.Optional(CONF_PACKET_ERROR_RATE_24H): sensor.sensor_schema(
+            unit_of_measurement=UNIT_PERCENT,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+            accuracy_decimals=1,
+        ).extend(publish_options(0.2)),
+        cv.Optional(CONF_JITTER): sensor.sensor_schema(
+            unit_of_measurement=UNIT_SECOND,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+            accuracy_decimals=2,
+        ).extend(publish_options(0.05)),
+        cv.Optional(CONF_CHANNEL_UTILIZATION): sensor.sensor_schema(
+            unit_of_measurement=UNIT_PERCENT,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+            accuracy_decimals=2,
+        ).extend(publish_options(0.05)),
+        cv.Optional(CONF_NOISE_FLOOR): sensor.sensor_schema(
+            unit_of_measurement=UNIT_DECIBEL_MILLIWATT,
+            device_class=DEVICE_CLASS_SIGNAL_STRENGTH,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+            accuracy_decimals=1,
+        ).extend(publish_options(1.0)),
+        cv.Optional(CONF_COLLISION_PROBABILITY): sensor.sensor_schema(
+            unit_of_measurement=UNIT_PERCENT,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+            accuracy_decimals=1,
+        ).extend(publish_options(0.5)),
     }
-).extend(cv.COMPONENT_SCHEMA)
+).extend(cv.COMPONENT_SCHEMA).extend(spi.spi_device_schema(cs_pin_required=True))
+
+CONFIG_SCHEMA = cv.All(CONFIG_SCHEMA, volkszaehler_needs_time, downlink_needs_keys)
 
 
 async def to_code(config):
+    await cg.get_variable(config[CONF_WEB_SERVER_BASE_ID])
     var = cg.new_Pvariable(config[CONF_ID])
     await cg.register_component(var, config)
+    await spi.register_spi_device(var, config)
+
+    cg.add_build_flag(f"-I{SHARED_SRC_DIR}")
+    cg.add(var.set_sweep_max_per(config[CONF_SWEEP_MAX_PER]))
+    for scan in config.get(CONF_SCAN_PROFILES, []):
+        cg.add(
+            var.add_scan_profile(
+                int(scan.get(CONF_FREQUENCY, 0)),
+                scan[CONF_SPREADING_FACTOR],
+                SCAN_BANDWIDTHS[scan[CONF_BANDWIDTH]],
+            )
+        )
+    cg.add(
+        var.set_force_update_interval(
+            config[CONF_FORCE_UPDATE_INTERVAL].total_milliseconds
+        )
+    )
+    history = config[CONF_HISTORY]
+    cg.add(
+        var.set_history_capacity(
+            history[CONF_RAW_SAMPLES],
+            history[CONF_MINUTE_BUCKETS],
+            history[CONF_QUARTER_BUCKETS],
+        )
+    )
+    cg.add(var.set_outbox_blocks(config[CONF_OUTBOX_BLOCKS]))
+    if CONF_NODE in config:
+        cg.add(var.set_sensor_node(config[CONF_NODE]))
+    if CONF_TIME_ID in config:
+        clock = await cg.get_variable(config[CONF_TIME_ID])
+        cg.add(var.set_time(clock))
+    if CONF_VOLKSZAEHLER in config:
+        vz = config[CONF_VOLKSZAEHLER]
+        match = VZ_URL.fullmatch(vz[CONF_URL])
+        cg.add(
+            var.set_vz_server(
+                match.group(1),
+                int(match.group(2) or 80),
+                (match.group(3) or "").rstrip("/"),
+            )
+        )
+        cg.add(
+            var.set_vz_batching(
+                vz[CONF_BATCH_SIZE], vz[CONF_MAX_DELAY].total_milliseconds
+            )
+        )
+        for channel in vz[CONF_CHANNELS]:
+            cg.add(
+                var.add_vz_channel(
+                    channel[CONF_UUID],
+                    VZ_FIELDS[channel[CONF_TYPE]],
+                    channel.get(CONF_NODE, 0),
+                )
+            )
     
+    if CONF_MQTT in config:
+        conf = config[CONF_MQTT]
+        sink = cg.new_Pvariable(
+            conf[CONF_ID],
+            conf[CONF_BROKER],
+            conf[CONF_PORT],
+            conf.get(CONF_CLIENT_ID, f"{CORE.name}-lora"),
+        )
+        if CONF_USERNAME in conf:
+            cg.add(sink.set_credentials(conf[CONF_USERNAME], conf[CONF_PASSWORD]))
+        cg.add(sink.set_topic_prefix(conf[CONF_TOPIC_PREFIX]))
+        cg.add(sink.set_format(READING_FORMATS[conf[CONF_FORMAT]]))
+        cg.add(sink.set_qos(conf[CONF_QOS]))
+        cg.add(sink.set_inflight(conf[CONF_INFLIGHT]))
+        cg.add(sink.set_retain(conf[CONF_RETAIN]))
+        cg.add(var.set_mqtt_sink(sink))
+    for conf in config.get(CONF_NODE_KEYS, []):
+        cg.add(var.add_node_key(conf[CONF_NODE], list(bytes.fromhex(conf[CONF_KEY]))))
+    cg.add(var.set_require_signed(config[CONF_REQUIRE_SIGNED]))
+    if CONF_DOWNLINK in config:
+        cg.add(var.set_downlink_tx_power(config[CONF_DOWNLINK][CONF_TX_POWER]))
+    if CONF_MESHTASTIC in config:
+        conf = config[CONF_MESHTASTIC]
+        cg.add(var.set_meshtastic_channel(conf[CONF_CHANNEL], list(bytes.fromhex(conf[CONF_KEY]))))
+        for node in conf[CONF_NODES]:
+            cg.add(var.add_meshtastic_node(node[CONF_NUM], node[CONF_NODE]))
+
     # Configure pins
     cg.add(var.set_dio1_pin(config[CONF_DIO1_PIN]))
     cg.add(var.set_rst_pin(config[CONF_RST_PIN]))
     cg.add(var.set_busy_pin(config[CONF_BUSY_PIN]))
+    if CONF_TCXO_VOLTAGE in config:
+        cg.add(var.set_tcxo_voltage(config[CONF_TCXO_VOLTAGE]))
     
     # Register sensors
     if CONF_POWER in config:
@@ -129,4 +580,39 @@ async def to_code(config):
     
     if CONF_MISSED_PACKETS in config:
         sens = await sensor.new_sensor(config[CONF_MISSED_PACKETS])
-        cg.add(var.set_missed_packets_sensor(sens))
\ No newline at end of file
+        cg.add(var.set_missed_packets_sensor(sens))
+
+    if CONF_PACKET_ERROR_RATE_1H in config:
+        sens = await sensor.new_sensor(config[CONF_PACKET_ERROR_RATE_1H])
+        cg.add(var.set_per_1h_sensor(sens))
+
+    if CONF_PACKET_ERROR_RATE_24H in config:
+        sens = await sensor.new_sensor(config[CONF_PACKET_ERROR_RATE_24H])
+        cg.add(var.set_per_24h_sensor(sens))
+
+    if CONF_JITTER in config:
+        sens = await sensor.new_sensor(config[CONF_JITTER])
+        cg.add(var.set_jitter_sensor(sens))
+
+    if CONF_CHANNEL_UTILIZATION in config:
+        sens = await sensor.new_sensor(config[CONF_CHANNEL_UTILIZATION])
+        cg.add(var.set_channel_utilization_sensor(sens))
+
+    if CONF_NOISE_FLOOR in config:
+        sens = await sensor.new_sensor(config[CONF_NOISE_FLOOR])
+        cg.add(var.set_noise_floor_sensor(sens))
+
+    if CONF_COLLISION_PROBABILITY in config:
+        sens = await sensor.new_sensor(config[CONF_COLLISION_PROBABILITY])
+        cg.add(var.set_collision_probability_sensor(sens))
+
+    for channel, key in enumerate(PUBLISH_CHANNELS):
+        if key in config:
+            conf = config[key]
+            cg.add(
+                var.set_publish_policy(
+                    channel,
+                    conf[CONF_DEADBAND],
+                    conf[CONF_MIN_INTERVAL].total_milliseconds,
+                )
+            )
@@ -0,0 +1,112 @@
+#pragma once
+
+// Round-robin Channel Activity Detection over several frequency / SF /
+// bandwidth profiles, so nodes near the gateway can send at SF7 and far
+// ones at SF10 without a second gateway. CAD runs on one profile at a
+// time. When it sees activity, the radio switches straight to RX on that
+// profile (the SX126x CAD_RX exit mode). After the packet, or after the RX
+// timeout, the scan moves on to the next profile.
+// CAD only catches a packet while its preamble is still on air, so a node
+// has to send a preamble that covers a whole scan cycle; see
+// preamble_symbols().
+
+#include <cstddef>
+#include <cstdint>
+
+#include "lora_airtime.h"
+#include "metrics.h"
+
+namespace esphome {
+namespace lora_receiver {
+
+struct ScanProfile {
+  uint32_t frequency_hz;
+  LoRaProfile profile;  // tx_power unused
+};
+
+// Written by the RX task, read by /metrics
+struct ScanStats {
+  MetricCounter cads;
+  MetricCounter detections;
+  MetricCounter packets;
+  MetricCounter timeouts;  // Activity without a header: noise or foreign traffic
+};
+
+// SX126x CAD settings per SF, from Semtech AN1200.48 for 125 kHz
+struct CadSettings {
+  uint8_t symbols;  // 2 or 4
+  uint8_t det_peak;
+  uint8_t det_min;
+};
+
+inline CadSettings cad_settings(uint8_t spreading_factor) {
+  static const uint8_t DET_PEAK[] = {22, 22, 23, 24, 25, 28};  // SF7 .. SF12
+  uint8_t sf = spreading_factor < 7 ? 7 : (spreading_factor > 12 ? 12 : spreading_factor);
+  CadSettings settings;
+  settings.symbols = sf <= 8 ? 2 : 4;
+  settings.det_peak = DET_PEAK[sf - 7];
+  settings.det_min = 10;
+  return settings;
+}
+
+template<size_t MaxProfiles> class CadScanner {
+ public:
+  // SPI commands, standby and PLL lock between two CADs
+  static constexpr uint32_t RETUNE_US = 500;
+  static constexpr uint32_t HEADER_SYMBOLS = 8;
+
+  bool add(const ScanProfile &profile) {
+    if (this->count_ >= MaxProfiles)
+      return false;
+    this->profiles_[this->count_++] = profile;
+    return true;
+  }
+
+  size_t count() const { return this->count_; }
+  size_t index() const { return this->index_; }
+  const ScanProfile &profile(size_t i) const { return this->profiles_[i]; }
+  const ScanProfile &current() const { return this->profiles_[this->index_]; }
+  ScanStats &stats(size_t i) { return this->stats_[i]; }
+  const ScanStats &stats(size_t i) const { return this->stats_[i]; }
+
+  void advance() { this->index_ = (this->index_ + 1) % this->count_; }
+
+  // One CAD takes its symbols plus about one symbol of processing
+  static uint32_t cad_us(const ScanProfile &p) {
+    uint32_t symbol_us = loraSymbolTimeUs(p.profile.spreading_factor, p.profile.bandwidth);
+    return (cad_settings(p.profile.spreading_factor).symbols + 1) * symbol_us + RETUNE_US;
+  }
+
+  uint32_t cycle_us() const {
+    uint32_t total = 0;
+    for (size_t i = 0; i < this->count_; i++)
+      total += cad_us(this->profiles_[i]);
+    return total;
+  }
+
+  // Shortest preamble a node on profile i may send: the scan can just have
+  // left the profile when the preamble starts, so it must outlast a whole
+  // cycle and then the CAD itself
+  uint16_t preamble_symbols(size_t i) const {
+    const ScanProfile &p = this->profiles_[i];
+    uint32_t symbol_us = loraSymbolTimeUs(p.profile.spreading_factor, p.profile.bandwidth);
+    return (this->cycle_us() + symbol_us - 1) / symbol_us + cad_settings(p.profile.spreading_factor).symbols + 1;
+  }
+
+  // RX after a detection ends unless a header arrives within the rest of
+  // the longest preamble plus the header
+  uint32_t rx_timeout_us(size_t i) const {
+    const ScanProfile &p = this->profiles_[i];
+    uint32_t symbol_us = loraSymbolTimeUs(p.profile.spreading_factor, p.profile.bandwidth);
+    return (this->preamble_symbols(i) + HEADER_SYMBOLS) * symbol_us;
+  }
+
+ protected:
+  ScanProfile profiles_[MaxProfiles]{};
+  ScanStats stats_[MaxProfiles];
+  size_t count_{0};
+  size_t index_{0};
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
@@ -0,0 +1,210 @@
+#pragma once
+
+// How busy the channel is, from two sources: the time-on-air of every
+// decoded packet (SF/BW/CR of the active profile and the payload length)
+// and instantaneous RSSI samples taken between packets. Per bucket the
+// 10th RSSI percentile is the noise floor; samples more than
+// CHANNEL_BUSY_MARGIN_DB above it are energy on the channel. Energy not
+// explained by our own packets is foreign traffic. Both loads together
+// give the pure ALOHA collision probability 1 - e^(-2G).
+// Fed by the RX task only; other tasks read the published summaries.
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "link_stats.h"
+
+namespace esphome {
+namespace lora_receiver {
+
+static constexpr float CHANNEL_BUSY_MARGIN_DB = 6.0f;
+
+typedef FixedHistogram<-140, 1, 100> NoiseHistogram;  // -140 .. -40 dBm in 1 dB bins
+
+struct ChannelSummary {
+  float utilization{0.0f};            // % of the window our decoded packets were on air
+  float busy{0.0f};                   // % of RSSI samples above the noise floor
+  float foreign{0.0f};                // % busy beyond our own packets
+  float noise_floor{NAN};             // dBm, NAN before the first full bucket
+  float collision_probability{0.0f};  // % chance a packet overlaps another
+  uint32_t packets{0};
+};
+
+// Summary readable from any task. Fields are stored one by one, so a
+// reader may mix two consecutive summaries; each field is consistent.
+class ChannelSnapshot {
+ public:
+  void store(const ChannelSummary &s) {
+    this->utilization_.store(s.utilization, std::memory_order_relaxed);
+    this->busy_.store(s.busy, std::memory_order_relaxed);
+    this->foreign_.store(s.foreign, std::memory_order_relaxed);
+    this->noise_floor_.store(s.noise_floor, std::memory_order_relaxed);
+    this->collision_probability_.store(s.collision_probability, std::memory_order_relaxed);
+    this->packets_.store(s.packets, std::memory_order_relaxed);
+  }
+  ChannelSummary load() const {
+    ChannelSummary s;
+    s.utilization = this->utilization_.load(std::memory_order_relaxed);
+    s.busy = this->busy_.load(std::memory_order_relaxed);
+    s.foreign = this->foreign_.load(std::memory_order_relaxed);
+    s.noise_floor = this->noise_floor_.load(std::memory_order_relaxed);
+    s.collision_probability = this->collision_probability_.load(std::memory_order_relaxed);
+    s.packets = this->packets_.load(std::memory_order_relaxed);
+    return s;
+  }
+
+ protected:
+  std::atomic<float> utilization_{0.0f};
+  std::atomic<float> busy_{0.0f};
+  std::atomic<float> foreign_{0.0f};
+  std::atomic<float> noise_floor_{NAN};
+  std::atomic<float> collision_probability_{0.0f};
+  std::atomic<uint32_t> packets_{0};
+};
+
+// Sliding window of Buckets completed buckets plus running sums, like
+// WindowCounter. The bucket in progress joins the window when it closes.
+template<size_t Buckets> class ChannelWindow {
+ public:
+  explicit ChannelWindow(uint32_t bucket_ms) : bucket_ms_(bucket_ms) {}
+
+  void add_packet(uint32_t now, uint32_t airtime_us) {
+    this->advance(now);
+    this->current_.airtime_us += airtime_us;
+    this->current_.packets++;
+  }
+
+  void add_rssi(uint32_t now, float rssi_dbm) {
+    this->advance(now);
+    this->noise_.add(rssi_dbm);
+  }
+
+  // Recomputed when a bucket closes; Buckets * bucket_ms once warmed up
+  const ChannelSnapshot &snapshot() const { return this->snapshot_; }
+
+ protected:
+  struct Bucket {
+    uint32_t airtime_us{0};
+    uint32_t packets{0};
+    uint32_t samples{0};
+    uint32_t busy{0};
+    int16_t floor_ddbm{0};  // Tenths of a dBm, valid with samples
+  };
+
+  void advance(uint32_t now) {
+    uint32_t bucket = now / this->bucket_ms_;
+    if (!this->started_) {
+      this->started_ = true;
+      this->bucket_ = bucket;
+      return;
+    }
+    uint32_t steps = bucket - this->bucket_;
+    if (steps == 0)
+      return;
+    this->close();
+    // Idle time adds empty buckets, at most a whole window of them
+    for (uint32_t i = 1; i < steps && i <= Buckets; i++)
+      this->close();
+    this->bucket_ = bucket;
+    this->snapshot_.store(this->summary());
+  }
+
+  // Moves the bucket in progress into the ring, dropping the oldest
+  void close() {
+    Bucket &b = this->current_;
+    b.samples = this->noise_.total();
+    if (b.samples > 0) {
+      float floor = this->noise_.quantile(0.1f) + 0.5f;  // Bin centre
+      b.floor_ddbm = (int16_t) lroundf(floor * 10.0f);
+      for (size_t i = 0; i < NoiseHistogram::bins(); i++) {
+        if (NoiseHistogram::bin_low(i) >= floor + CHANNEL_BUSY_MARGIN_DB)
+          b.busy += this->noise_.count(i);
+      }
+    }
+    this->index_ = (this->index_ + 1) % Buckets;
+    this->remove(this->ring_[this->index_]);
+    this->ring_[this->index_] = b;
+    this->insert(b);
+    if (this->filled_ < Buckets)
+      this->filled_++;
+    this->current_ = Bucket();
+    this->noise_ = NoiseHistogram();
+  }
+
+  void insert(const Bucket &b) {
+    this->airtime_us_ += b.airtime_us;
+    this->packets_ += b.packets;
+    this->samples_ += b.samples;
+    this->busy_ += b.busy;
+    if (b.samples > 0) {
+      this->floor_sum_ += b.floor_ddbm;
+      this->floor_count_++;
+    }
+  }
+
+  void remove(const Bucket &b) {
+    this->airtime_us_ -= b.airtime_us;
+    this->packets_ -= b.packets;
+    this->samples_ -= b.samples;
+    this->busy_ -= b.busy;
+    if (b.samples > 0) {
+      this->floor_sum_ -= b.floor_ddbm;
+      this->floor_count_--;
+    }
+  }
+
+  ChannelSummary summary() const {
+    ChannelSummary s;
+    uint64_t window_us = (uint64_t) this->filled_ * this->bucket_ms_ * 1000;
+    s.utilization = window_us > 0 ? 100.0f * this->airtime_us_ / window_us : 0.0f;
+    if (s.utilization > 100.0f)
+      s.utilization = 100.0f;  // Time-on-air overlaps when packets collide
+    s.busy = this->samples_ > 0 ? 100.0f * this->busy_ / this->samples_ : 0.0f;
+    s.foreign = s.busy > s.utilization ? s.busy - s.utilization : 0.0f;
+    s.noise_floor = this->floor_count_ > 0 ? this->floor_sum_ / (10.0f * this->floor_count_) : NAN;
+    float load = (s.utilization + s.foreign) / 100.0f;
+    s.collision_probability = 100.0f * (1.0f - expf(-2.0f * load));
+    s.packets = this->packets_;
+    return s;
+  }
+
+  uint32_t bucket_ms_;
+  uint32_t bucket_{0};
+  bool started_{false};
+  Bucket current_;
+  NoiseHistogram noise_;
+  Bucket ring_[Buckets];
+  size_t index_{0};
+  size_t filled_{0};
+  uint64_t airtime_us_{0};
+  uint32_t packets_{0};
+  uint32_t samples_{0};
+  uint32_t busy_{0};
+  int32_t floor_sum_{0};
+  uint32_t floor_count_{0};
+  ChannelSnapshot snapshot_;
+};
+
+class ChannelMonitor {
+ public:
+  void add_packet(uint32_t now, uint32_t airtime_us) {
+    this->minute_.add_packet(now, airtime_us);
+    this->hour_.add_packet(now, airtime_us);
+  }
+  void add_rssi(uint32_t now, float rssi_dbm) {
+    this->minute_.add_rssi(now, rssi_dbm);
+    this->hour_.add_rssi(now, rssi_dbm);
+  }
+
+  ChannelSummary minute() const { return this->minute_.snapshot().load(); }
+  ChannelSummary hour() const { return this->hour_.snapshot().load(); }
+
+ protected:
+  ChannelWindow<6> minute_{10000};  // 10 s buckets
+  ChannelWindow<60> hour_{60000};   // 1 min buckets
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
@@ -0,0 +1,143 @@
+#pragma once
+
+// Config changes waiting for their node (src/config_downlink.h), one
+// entry per node. A pending change goes out after every uplink of the
+// node until an ack arrives or MAX_ATTEMPTS uplinks passed. Changes
+// queued in the meantime are merged and get a new sequence, so a node
+// that applied the older one still takes the merged one.
+// Sequences of new entries start at a random seed: after a reboot the
+// gateway must not reuse the sequence of a change the node already has.
+// Owned by the main loop.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "config_downlink.h"
+
+namespace esphome {
+namespace lora_receiver {
+
+enum DownlinkState : uint8_t {
+  DOWNLINK_PENDING,   // Waiting for the next uplink or for the ack
+  DOWNLINK_APPLIED,
+  DOWNLINK_REJECTED,  // Node refused the values
+  DOWNLINK_FAILED,    // No ack after MAX_ATTEMPTS downlinks
+};
+
+inline const char *downlink_state_name(DownlinkState state) {
+  switch (state) {
+    case DOWNLINK_PENDING:
+      return "pending";
+    case DOWNLINK_APPLIED:
+      return "applied";
+    case DOWNLINK_REJECTED:
+      return "rejected";
+    case DOWNLINK_FAILED:
+      return "failed";
+  }
+  return "?";
+}
+
+struct NodeDownlink {
+  ConfigChange change{};  // Still to deliver, or the last one delivered
+  uint16_t sequence{0};
+  uint8_t attempts{0};
+  DownlinkState state{DOWNLINK_APPLIED};
+  uint32_t updated_ms{0};
+};
+
+template<size_t MaxNodes> class DownlinkQueue {
+ public:
+  static constexpr uint8_t MAX_ATTEMPTS = 5;
+
+  void set_seed(uint16_t sequence) { this->seed_ = sequence; }
+
+  // Merges into a change still pending for the node; false when the table is full
+  bool queue(uint16_t node_id, const ConfigChange &change, uint32_t now) {
+    NodeDownlink *entry = this->get(node_id);
+    if (entry == nullptr)
+      return false;
+    if (entry->state != DOWNLINK_PENDING)
+      entry->change = ConfigChange{};
+    mergeConfigChange(entry->change, change);
+    entry->sequence++;
+    entry->attempts = 0;
+    entry->state = DOWNLINK_PENDING;
+    entry->updated_ms = now;
+    return true;
+  }
+
+  // Downlink to answer an uplink of node_id with; counts the attempt
+  bool next(uint16_t node_id, ConfigDownlink &downlink, uint32_t now) {
+    NodeDownlink *entry = this->find(node_id);
+    if (entry == nullptr || entry->state != DOWNLINK_PENDING)
+      return false;
+    if (entry->attempts >= MAX_ATTEMPTS) {
+      entry->state = DOWNLINK_FAILED;
+      entry->updated_ms = now;
+      return false;
+    }
+    entry->attempts++;
+    entry->updated_ms = now;
+    downlink.node_id = node_id;
+    downlink.sequence = entry->sequence;
+    downlink.change = entry->change;
+    return true;
+  }
+
+  void on_ack(const ConfigAck &ack, uint32_t now) {
+    NodeDownlink *entry = this->find(ack.node_id);
+    if (entry == nullptr || entry->state != DOWNLINK_PENDING)
+      return;
+    if (ack.status == CONFIG_ACK_STALE && ack.sequence != entry->sequence) {
+      // Node is ahead, e.g. after a gateway reboot: continue after its
+      // sequence with the next uplink
+      entry->sequence = ack.sequence + 1;
+      return;
+    }
+    if (ack.sequence != entry->sequence)
+      return;  // Late ack of a change merged since
+    // Stale with our own sequence: applied before, the first ack was lost
+    entry->state = ack.status == CONFIG_ACK_REJECTED ? DOWNLINK_REJECTED : DOWNLINK_APPLIED;
+    entry->updated_ms = now;
+  }
+
+  NodeDownlink *find(uint16_t node_id) {
+    for (size_t i = 0; i < this->count_; i++) {
+      if (this->ids_[i] == node_id)
+        return &this->entries_[i];
+    }
+    return nullptr;
+  }
+
+  size_t pending() const {
+    size_t pending = 0;
+    for (size_t i = 0; i < this->count_; i++) {
+      if (this->entries_[i].state == DOWNLINK_PENDING)
+        pending++;
+    }
+    return pending;
+  }
+
+  size_t node_count() const { return this->count_; }
+  uint16_t node_id(size_t index) const { return this->ids_[index]; }
+  const NodeDownlink &node(size_t index) const { return this->entries_[index]; }
+
+ protected:
+  NodeDownlink *get(uint16_t node_id) {
+    NodeDownlink *entry = this->find(node_id);
+    if (entry != nullptr || this->count_ >= MaxNodes)
+      return entry;
+    this->ids_[this->count_] = node_id;
+    this->entries_[this->count_].sequence = this->seed_;
+    return &this->entries_[this->count_++];
+  }
+
+  uint16_t ids_[MaxNodes]{};
+  NodeDownlink entries_[MaxNodes];
+  size_t count_{0};
+  uint16_t seed_{0};
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
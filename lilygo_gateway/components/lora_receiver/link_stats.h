@@ -0,0 +1,239 @@
+#pragma once
+
+// Per-node link quality: packet error rate over sliding 1 h / 24 h windows,
+// RSSI and SNR histograms and inter-arrival jitter. Every update is O(1)
+// and the table is a fixed array, so memory does not grow with traffic
+// or uptime. lora_gatewayd keeps one LinkStats per node as well
+// (host/gateway_pipeline.h).
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace lora_receiver {
+
+// Packet counter bookkeeping that survives wraparound and node reboots.
+// uint32 subtraction handles the wrap; a counter that jumps backwards or
+// far ahead is a reboot (or a different node reusing the id) and restarts
+// the sequence without being counted as loss.
+class SequenceTracker {
+ public:
+  static constexpr uint32_t MAX_GAP = 1000;  // Larger forward jumps resync
+
+  enum Result : uint8_t { SEQ_FIRST, SEQ_NEXT, SEQ_DUPLICATE, SEQ_RESET };
+
+  // lost receives the packets missed since the previous one
+  Result update(uint32_t counter, uint32_t &lost) {
+    lost = 0;
+    if (!this->started_) {
+      this->started_ = true;
+      this->last_ = counter;
+      return SEQ_FIRST;
+    }
+    uint32_t delta = counter - this->last_;
+    if (delta == 0) {
+      this->duplicates_++;
+      return SEQ_DUPLICATE;
+    }
+    this->last_ = counter;
+    if (delta > MAX_GAP) {
+      this->resets_++;
+      return SEQ_RESET;
+    }
+    lost = delta - 1;
+    this->lost_ += lost;
+    return SEQ_NEXT;
+  }
+
+  void clear() { *this = SequenceTracker(); }
+
+  uint32_t last() const { return this->last_; }
+  uint32_t lost() const { return this->lost_; }
+  uint32_t resets() const { return this->resets_; }
+  uint32_t duplicates() const { return this->duplicates_; }
+
+ protected:
+  bool started_{false};
+  uint32_t last_{0};
+  uint32_t lost_{0};
+  uint32_t resets_{0};
+  uint32_t duplicates_{0};
+};
+
+// Received/lost counts over the last Buckets * bucket_ms, kept as a ring of
+// buckets plus running sums. Idle time clears at most Buckets entries.
+template<size_t Buckets> class WindowCounter {
+ public:
+  explicit WindowCounter(uint32_t bucket_ms) : bucket_ms_(bucket_ms) {}
+
+  void add(uint32_t now, uint32_t received, uint32_t lost) {
+    this->advance(now);
+    this->received_[this->index_] += received;
+    this->lost_[this->index_] += lost;
+    this->received_sum_ += received;
+    this->lost_sum_ += lost;
+  }
+
+  // Percent lost in the window, NaN-free: 0 when nothing was expected
+  float per_percent(uint32_t now) {
+    this->advance(now);
+    uint32_t expected = this->received_sum_ + this->lost_sum_;
+    return expected ? 100.0f * this->lost_sum_ / expected : 0.0f;
+  }
+
+  uint32_t received() const { return this->received_sum_; }
+  uint32_t lost() const { return this->lost_sum_; }
+
+ protected:
+  void advance(uint32_t now) {
+    uint32_t bucket = now / this->bucket_ms_;
+    if (!this->started_) {
+      this->started_ = true;
+      this->bucket_ = bucket;
+      return;
+    }
+    uint32_t steps = bucket - this->bucket_;
+    if (steps > Buckets)
+      steps = Buckets;
+    for (uint32_t i = 0; i < steps; i++) {
+      this->index_ = (this->index_ + 1) % Buckets;
+      this->received_sum_ -= this->received_[this->index_];
+      this->lost_sum_ -= this->lost_[this->index_];
+      this->received_[this->index_] = 0;
+      this->lost_[this->index_] = 0;
+    }
+    this->bucket_ = bucket;
+  }
+
+  uint32_t bucket_ms_;
+  uint32_t bucket_{0};
+  size_t index_{0};
+  bool started_{false};
+  uint32_t received_[Buckets]{};
+  uint32_t lost_[Buckets]{};
+  uint32_t received_sum_{0};
+  uint32_t lost_sum_{0};
+};
+
+// Fixed-width buckets from Min to Min + Bins * Width, outliers clamp to the ends
+template<int Min, int Width, size_t Bins> class FixedHistogram {
+ public:
+  void add(float value) {
+    int bin = (int) ((value - Min) / Width);
+    if (bin < 0)
+      bin = 0;
+    if (bin >= (int) Bins)
+      bin = Bins - 1;
+    this->counts_[bin]++;
+    this->total_++;
+  }
+
+  // Lower edge of the bin holding the given quantile (0..1)
+  float quantile(float q) const {
+    if (this->total_ == 0)
+      return 0.0f;
+    uint32_t target = (uint32_t) (q * (this->total_ - 1));
+    uint32_t seen = 0;
+    for (size_t i = 0; i < Bins; i++) {
+      seen += this->counts_[i];
+      if (seen > target)
+        return bin_low(i);
+    }
+    return bin_low(Bins - 1);
+  }
+
+  static float bin_low(size_t bin) { return (float) (Min + (int) bin * Width); }
+  static constexpr size_t bins() { return Bins; }
+  uint32_t count(size_t bin) const { return this->counts_[bin]; }
+  uint32_t total() const { return this->total_; }
+
+ protected:
+  uint32_t counts_[Bins]{};
+  uint32_t total_{0};
+};
+
+// SX126x/SX127x sensitivity ends near -137 dBm, SNR near -20 dB
+typedef FixedHistogram<-140, 5, 24> RssiHistogram;  // -140 .. -20 dBm
+typedef FixedHistogram<-20, 2, 20> SnrHistogram;    // -20 .. +20 dB
+
+class LinkStats {
+ public:
+  void update(uint32_t now, uint32_t counter, int16_t rssi, float snr) {
+    uint32_t lost;
+    SequenceTracker::Result result = this->sequence_.update(counter, lost);
+    if (result == SequenceTracker::SEQ_DUPLICATE)
+      return;
+    this->hour_.add(now, 1, lost);
+    this->day_.add(now, 1, lost);
+    this->rssi_.add(rssi);
+    this->snr_.add(snr);
+
+    // Interval normalised by the counter step so losses do not read as
+    // jitter; RFC 3550 style smoothing with gain 1/16
+    if (result == SequenceTracker::SEQ_NEXT && this->heard_) {
+      float interval = (float) (now - this->last_heard_) / (lost + 1);
+      if (this->interval_ms_ == 0.0f) {
+        this->interval_ms_ = interval;
+      } else {
+        float deviation = interval - this->interval_ms_;
+        this->interval_ms_ += deviation / 16.0f;
+        this->jitter_ms_ += ((deviation < 0 ? -deviation : deviation) - this->jitter_ms_) / 16.0f;
+      }
+    }
+    this->heard_ = true;
+    this->last_heard_ = now;
+  }
+
+  float per_1h(uint32_t now) { return this->hour_.per_percent(now); }
+  float per_24h(uint32_t now) { return this->day_.per_percent(now); }
+  float interval_ms() const { return this->interval_ms_; }
+  float jitter_ms() const { return this->jitter_ms_; }
+  uint32_t last_heard() const { return this->last_heard_; }
+  const SequenceTracker &sequence() const { return this->sequence_; }
+  const RssiHistogram &rssi() const { return this->rssi_; }
+  const SnrHistogram &snr() const { return this->snr_; }
+
+ protected:
+  SequenceTracker sequence_;
+  WindowCounter<60> hour_{60000};     // 1 min buckets
+  WindowCounter<24> day_{3600000};    // 1 h buckets
+  RssiHistogram rssi_;
+  SnrHistogram snr_;
+  float interval_ms_{0.0f};
+  float jitter_ms_{0.0f};
+  uint32_t last_heard_{0};
+  bool heard_{false};
+};
+
+// Fixed table of nodes, statically allocated
+template<size_t MaxNodes> class LinkStatsTable {
+ public:
+  LinkStats *find(uint16_t node_id) {
+    for (size_t i = 0; i < this->count_; i++) {
+      if (this->ids_[i] == node_id)
+        return &this->stats_[i];
+    }
+    return nullptr;
+  }
+
+  // Adds the node on first sight; nullptr when the table is full
+  LinkStats *get(uint16_t node_id) {
+    LinkStats *stats = this->find(node_id);
+    if (stats != nullptr || this->count_ >= MaxNodes)
+      return stats;
+    this->ids_[this->count_] = node_id;
+    return &this->stats_[this->count_++];
+  }
+
+  size_t node_count() const { return this->count_; }
+  uint16_t node_id(size_t index) const { return this->ids_[index]; }
+  LinkStats &node(size_t index) { return this->stats_[index]; }
+
+ protected:
+  uint16_t ids_[MaxNodes]{};
+  LinkStats stats_[MaxNodes];
+  size_t count_{0};
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
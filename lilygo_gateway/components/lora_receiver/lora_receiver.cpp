@@ -1,134 +1,788 @@
 #include "lora_receiver.h"
+#include "lora_web_handler.h"
 #include "esphome/core/log.h"
 #include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#ifdef USE_API
+#include "esphome/components/api/api_server.h"
+#endif
+#include "esphome/components/network/util.h"
+
+#include <algorithm>
+#include <cmath>
 
 namespace esphome {
 namespace lora_receiver {
 
 static const char *TAG = "lora_receiver";
 
-// LoRa configuration - must match CubeCell
-#define LORA_FREQUENCY      433000000  // 433 MHz for international waters
-#define LORA_BANDWIDTH      125.0       // 125 kHz
-#define LORA_SPREADING_FACTOR 7         // SF7
-#define LORA_CODING_RATE    5           // 4/5
-#define LORA_SYNC_WORD      0x12        // Private network
-#define LORA_TX_POWER       14          // 14 dBm
-#define LORA_PREAMBLE_LENGTH 8
+// LoRa configuration comes from the shared src/lora_data.h
+static const LoRaProfile BASE_PROFILE = {LORA_SPREADING_FACTOR, LORA_BANDWIDTH, LORA_CODING_RATE, LORA_TX_POWER};
 
 void LoRaReceiverComponent::setup() {
-  ESP_LOGI(TAG, "Setting up LoRa receiver (simplified)...");
-  ESP_LOGI(TAG, "Component version: 1.0.1 - Debug logging enabled");
-  
-  // Configure pins
+  ESP_LOGCONFIG(TAG, "Setting up SX1262 LoRa receiver...");
+
   pinMode(dio1_pin_, INPUT);
   pinMode(rst_pin_, OUTPUT);
   pinMode(busy_pin_, INPUT);
-  
-  // Note: For now, this is a simplified implementation
-  // In production, you would need to properly initialize the SX1262
-  // using SPI commands or a proper library
-  
-  ESP_LOGW(TAG, "LoRa receiver in test mode - monitoring DIO1 pin for activity");
-  ESP_LOGI(TAG, "  DIO1 Pin: %d", dio1_pin_);
-  ESP_LOGI(TAG, "  RST Pin: %d", rst_pin_);
-  ESP_LOGI(TAG, "  BUSY Pin: %d", busy_pin_);
-  ESP_LOGI(TAG, "  Frequency: %.2f MHz", LORA_FREQUENCY / 1000000.0);
-  
-  // Check initial pin states
-  ESP_LOGI(TAG, "Initial pin states - DIO1: %d, BUSY: %d", 
-           digitalRead(dio1_pin_), digitalRead(busy_pin_));
-  
-  // Reset the module with logging
-  ESP_LOGI(TAG, "Resetting LoRa module...");
-  digitalWrite(rst_pin_, LOW);
-  delay(10);
-  digitalWrite(rst_pin_, HIGH);
-  delay(10);
-  ESP_LOGI(TAG, "Reset complete");
-  
-  // For testing, just publish some dummy data to verify the sensors work
-  if (power_sensor_) power_sensor_->publish_state(0.0);
-  if (consumption_sensor_) consumption_sensor_->publish_state(0.0);
-  if (generation_sensor_) generation_sensor_->publish_state(0.0);
-  if (battery_sensor_) battery_sensor_->publish_state(3.7);
-  if (rssi_sensor_) rssi_sensor_->publish_state(-100);
-  if (snr_sensor_) snr_sensor_->publish_state(0);
-  if (packet_counter_sensor_) packet_counter_sensor_->publish_state(0);
-  if (missed_packets_sensor_) missed_packets_sensor_->publish_state(0);
-}
+  this->spi_setup();
 
-void LoRaReceiverComponent::loop() {
-  static bool last_dio1_state = false;
-  static uint32_t last_activity = 0;
-  static uint32_t loop_counter = 0;
-  static uint32_t last_heartbeat = 0;
-  
-  loop_counter++;
-  
-  // Heartbeat logging every 10 seconds
-  if (millis() - last_heartbeat > 10000) {
-    ESP_LOGI(TAG, "Heartbeat: Loop counter=%lu, uptime=%lu s", 
-             loop_counter, millis() / 1000);
-    last_heartbeat = millis();
-    loop_counter = 0;
+  if (!this->init_lora()) {
+    ESP_LOGE(TAG, "SX1262 not responding, check SPI wiring and BUSY pin");
+    this->mark_failed();
+    return;
   }
-  
-  // Check DIO1 pin for activity (goes high when packet is received)
-  bool dio1_state = digitalRead(dio1_pin_);
-  
-  if (dio1_state != last_dio1_state) {
-    ESP_LOGD(TAG, "DIO1 state changed: %s", dio1_state ? "HIGH" : "LOW");
+
+  this->setup_outbox();
+  this->setup_replay();
+  if (this->vz_client_ != nullptr)
+    this->vz_client_->set_default_node(this->sensor_node_);
+  this->payloads_.add(PAYLOAD_SCHEMA_METER, "meter", PAYLOAD_METER_VERSION, PAYLOAD_METER_SIGNED_VERSION,
+                      &LoRaReceiverComponent::decode_meter);
+  this->payloads_.add(PAYLOAD_SCHEMA_CONFIG_ACK, "config_ack", CONFIG_DOWNLINK_VERSION, CONFIG_DOWNLINK_VERSION,
+                      &LoRaReceiverComponent::decode_config_ack);
+  this->payloads_.add_unversioned(SWEEP_FRAME_ANNOUNCE, "sweep_announce",
+                                  &LoRaReceiverComponent::decode_sweep_announce);
+  this->payloads_.add_unversioned(SWEEP_FRAME_PROBE, "sweep_probe", &LoRaReceiverComponent::decode_sweep_probe);
+  if (this->meshtastic_enabled_)
+    this->payloads_.add_unversioned(PAYLOAD_SCHEMA_MESHTASTIC, "meshtastic",
+                                    &LoRaReceiverComponent::decode_meshtastic);
+  this->downlink_queue_.set_seed((uint16_t) random_uint32());
+  if (this->scanning()) {
+    this->start_cad();
+  } else {
+    this->start_receive();
   }
-  
-  if (dio1_state && !last_dio1_state) {
-    // Rising edge detected - possible packet reception
-    uint32_t now = millis();
-    if (now - last_activity > 100) {  // Debounce
-      ESP_LOGI(TAG, "DIO1 activity detected - possible LoRa packet!");
-      last_activity = now;
-      
-      // For testing, increment packet counter
-      static uint32_t test_counter = 0;
-      test_counter++;
-      
-      if (packet_counter_sensor_) {
-        packet_counter_sensor_->publish_state(test_counter);
+  // Core 0 next to the Wi-Fi stack; ESPHome's loop runs on core 1
+  xTaskCreatePinnedToCore(rx_task, "lora_rx", 4096, this, configMAX_PRIORITIES - 2, &this->rx_task_handle_, 0);
+  attachInterruptArg(digitalPinToInterrupt(dio1_pin_), (void (*)(void *)) dio1_isr, this, RISING);
+  xTaskNotifyGive(this->rx_task_handle_);  // Packet may have landed before the ISR was attached
+
+  this->web_handler_ = new LoRaWebHandler(this);
+  web_server_base::global_web_server_base->add_handler(this->web_handler_);
+
+  ESP_LOGI(TAG, "Listening on %.2f MHz", LORA_FREQUENCY / 1000000.0);
+}
+
+void IRAM_ATTR LoRaReceiverComponent::dio1_isr(LoRaReceiverComponent *arg) {
+  arg->irq_us_.store(micros(), std::memory_order_relaxed);
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(arg->rx_task_handle_, &woken);
+  if (woken)
+    portYIELD_FROM_ISR();
+}
+
+// Drains the radio as soon as DIO1 fires, independent of loop() latency
+void LoRaReceiverComponent::rx_task(void *arg) {
+  auto *self = static_cast<LoRaReceiverComponent *>(arg);
+  uint32_t sampled = millis();
+  while (true) {
+    // Wakes at least every RSSI_SAMPLE_MS so sampling keeps its pace under
+    // traffic, and early enough to start a downlink on time
+    TickType_t wait = pdMS_TO_TICKS(RSSI_SAMPLE_MS);
+    if (self->downlink_requested_.load(std::memory_order_acquire)) {
+      int32_t until_us = (int32_t) (self->downlink_request_.tx_us - micros()) - (int32_t) DOWNLINK_SPIN_US;
+      wait = until_us <= 0 ? 0 : std::min(wait, (TickType_t) pdMS_TO_TICKS(until_us / 1000));
+    }
+    bool notified = ulTaskNotifyTake(pdTRUE, wait) != 0;
+    // On every pass, not only when notified: the TX-done wait of a
+    // downlink takes the notification request_profile() gave
+    if (self->profile_requested_.exchange(false, std::memory_order_acquire)) {
+      const LoRaProfile &profile = self->requested_profile_;
+      self->scan_paused_ = self->scanning() && memcmp(&profile, &BASE_PROFILE, sizeof(profile)) != 0;
+      if (self->scanning() && !self->scan_paused_) {
+        self->start_cad();
+      } else {
+        self->apply_profile(profile);
       }
-      
-      // Simulate receiving data (for testing)
-      if (test_counter % 5 == 0) {  // Every 5th "packet"
-        float test_power = random(-500, 2000) / 10.0;  // -50 to 200 W
-        if (power_sensor_) power_sensor_->publish_state(test_power);
-        
-        ESP_LOGI(TAG, "Test data: Power = %.1f W", test_power);
+    }
+    if (notified) {
+      uint32_t irq_us = self->irq_us_.load(std::memory_order_relaxed);
+      if (self->scanning() && !self->scan_paused_) {
+        self->handle_scan_irq(irq_us);
+      } else {
+        // Back-to-back packets keep DIO1 high without a new edge; their
+        // latency counts from when the previous read finished
+        do {
+          uint16_t irq = self->get_irq_status();
+          self->clear_irq_status(irq);
+          self->receive_packet(irq, irq_us);
+          irq_us = micros();
+        } while (digitalRead(self->dio1_pin_));
       }
     }
+    if (self->downlink_requested_.load(std::memory_order_acquire) &&
+        (int32_t) (self->downlink_request_.tx_us - micros()) <= (int32_t) DOWNLINK_SPIN_US) {
+      self->transmit_downlink();
+      self->downlink_requested_.store(false, std::memory_order_release);
+    }
+    if (self->scanning() && !self->scan_paused_) {
+      // The instantaneous RSSI means nothing between CADs; a scan that
+      // lost its interrupt starts over
+      if (millis() - self->scan_started_ >= SCAN_STALL_MS)
+        self->start_cad();
+    } else if (millis() - sampled >= RSSI_SAMPLE_MS) {
+      sampled = millis();
+      self->sample_rssi();
+    }
   }
-  
-  last_dio1_state = dio1_state;
-  
-  // Check BUSY pin status periodically
-  static uint32_t last_busy_check = 0;
-  if (millis() - last_busy_check > 5000) {
-    bool busy_state = digitalRead(busy_pin_);
-    ESP_LOGD(TAG, "BUSY pin state: %s", busy_state ? "HIGH" : "LOW");
-    last_busy_check = millis();
+}
+
+void LoRaReceiverComponent::loop() {
+  {
+    // Decoding updates the tables the web handler reads; a request waits
+    // for this block, never sees half a row
+    LockGuard lock(this->report_lock_);
+    this->process();
+  }
+  if (vz_client_ != nullptr)
+    vz_client_->loop();
+  if (mqtt_sink_ != nullptr)
+    mqtt_sink_->loop();
+}
+
+void LoRaReceiverComponent::process() {
+  if (this->config_requested_.load(std::memory_order_acquire)) {
+    if (!this->downlink_queue_.queue(this->config_node_, this->config_change_, millis()))
+      ESP_LOGW(TAG, "No room to queue a config change for node %04X", this->config_node_);
+    this->config_requested_.store(false, std::memory_order_release);
+  }
+
+  for (size_t i = 0; i < RX_BATCH; i++) {
+    const RxPacket *packet = this->rx_queue_.peek();
+    if (packet == nullptr)
+      break;
+    this->handle_packet(*packet);
+    this->rx_metrics_.irq_to_publish.observe(micros() - packet->irq_us);
+    this->rx_queue_.release();
+  }
+
+  // PER windows keep sliding while a node is silent
+  if (millis() - link_refresh_time_ >= LINK_REFRESH_MS) {
+    link_refresh_time_ = millis();
+    LinkStats *link = link_stats_.find(sensor_node_);
+    if (link != nullptr)
+      this->update_link_channels(*link);
+    this->update_channel_load();
+  }
+
+  if (publish_filter_.dirty())
+    this->flush_sensors();
+
+  // Live RX first: replay only when the packet queue is idle
+  if (!outbox_.empty() && rx_queue_.size() == 0 && this->upstream_connected())
+    this->replay_outbox();
+  if (outbox_.dirty()) {
+    // Staged in RAM; ESPHome writes them at its flash_write_interval
+    outbox_.persist([this](size_t index, const OutboxBlock &block) { outbox_block_prefs_[index].save(&block); },
+                    [this](const OutboxMeta &meta) { outbox_meta_pref_.save(&meta); });
+  }
+  if (node_keys_.dirty()) {
+    // Same staging as the outbox: one write per node per flash sync
+    node_keys_.persist([this](size_t index, const NodeReplayState &state) { replay_prefs_[index].save(&state); });
+  }
+
+  // Sweep probe window over: back to the base profile
+  if (this->sweep_matrix_.window_expired(millis())) {
+    ESP_LOGD(TAG, "Sweep profile %u done, returning to base profile", this->sweep_matrix_.profile_id());
+    this->request_profile(BASE_PROFILE);
+  }
+  if (this->sweep_matrix_.passes() > this->sweep_reported_passes_ + 1) {
+    this->sweep_reported_passes_ = this->sweep_matrix_.passes() - 1;
+    this->log_sweep_report();
   }
 }
 
 void LoRaReceiverComponent::dump_config() {
-  ESP_LOGCONFIG(TAG, "LoRa Receiver (Test Mode):");
+  ESP_LOGCONFIG(TAG, "LoRa Receiver (SX1262):");
   ESP_LOGCONFIG(TAG, "  Frequency: %.2f MHz", LORA_FREQUENCY / 1000000.0);
-  ESP_LOGCONFIG(TAG, "  Bandwidth: %.1f kHz", LORA_BANDWIDTH);
+  ESP_LOGCONFIG(TAG, "  Bandwidth: %.1f kHz", loraBandwidthHz(LORA_BANDWIDTH) / 1000.0);
   ESP_LOGCONFIG(TAG, "  Spreading Factor: %d", LORA_SPREADING_FACTOR);
-  ESP_LOGCONFIG(TAG, "  Coding Rate: 4/%d", LORA_CODING_RATE);
+  ESP_LOGCONFIG(TAG, "  Coding Rate: 4/%d", LORA_CODING_RATE + 4);
   ESP_LOGCONFIG(TAG, "  DIO1 Pin: %d", dio1_pin_);
   ESP_LOGCONFIG(TAG, "  RST Pin: %d", rst_pin_);
   ESP_LOGCONFIG(TAG, "  BUSY Pin: %d", busy_pin_);
+  if (tcxo_voltage_ > 0)
+    ESP_LOGCONFIG(TAG, "  TCXO: %.1f V on DIO3", tcxo_voltage_);
+  if (this->scanning()) {
+    ESP_LOGCONFIG(TAG, "  CAD scan: %u profiles, %.1f ms per cycle", (unsigned) scanner_.count(),
+                  scanner_.cycle_us() / 1000.0f);
+    for (size_t i = 0; i < scanner_.count(); i++) {
+      const ScanProfile &scan = scanner_.profile(i);
+      const ScanStats &stats = scanner_.stats(i);
+      ESP_LOGCONFIG(TAG, "    %.3f MHz SF%u BW%u: nodes need a %u symbol preamble; %u CADs, %u detected, %u packets",
+                    scan.frequency_hz / 1000000.0, scan.profile.spreading_factor,
+                    (unsigned) (loraBandwidthHz(scan.profile.bandwidth) / 1000), scanner_.preamble_symbols(i),
+                    (unsigned) stats.cads.value(), (unsigned) stats.detections.value(),
+                    (unsigned) stats.packets.value());
+    }
+  }
+  ESP_LOGCONFIG(TAG, "  Packets: %u, CRC errors: %u, decode errors: %u", (unsigned) rx_metrics_.packets.value(),
+                (unsigned) rx_metrics_.crc_errors.value(), (unsigned) rx_metrics_.decode_errors.value());
+  for (size_t i = 0; i < payloads_.count(); i++) {
+    const PayloadSchemaStats &stats = payloads_.stats(i);
+    ESP_LOGCONFIG(TAG, "  Schema 0x%02X %s: %u frames, %u errors", payloads_.schema(i), payloads_.name(i),
+                  (unsigned) stats.frames.value(), (unsigned) stats.errors.value());
+  }
+  if (node_keys_.count() > 0 || node_keys_.require_signed()) {
+    ESP_LOGCONFIG(TAG, "  Signed frames: %u node keys, unsigned frames %s, %u refused", (unsigned) node_keys_.count(),
+                  node_keys_.require_signed() ? "refused" : "accepted from nodes without a key",
+                  (unsigned) rx_metrics_.auth_errors.value());
+  }
+  if (sensor_node_ != 0) {
+    ESP_LOGCONFIG(TAG, "  Sensors show node %04X", sensor_node_);
+  } else {
+    ESP_LOGCONFIG(TAG, "  Sensors show the first node heard");
+  }
+  ESP_LOGCONFIG(TAG, "  Publishes: %u sent, %u suppressed, forced refresh %u s", (unsigned) publish_filter_.published(),
+                (unsigned) publish_filter_.suppressed(), (unsigned) (force_update_interval_ / 1000));
+  for (size_t i = 0; i < history_.node_count(); i++) {
+    ESP_LOGCONFIG(TAG, "  History node %04X: %u samples, %u bytes, %u dropped", history_.node_id(i),
+                  (unsigned) history_.node(i).raw_size(), (unsigned) history_.node(i).bytes(),
+                  (unsigned) history_.node(i).dropped());
+  }
+  if (outbox_.capacity() > 0) {
+    ESP_LOGCONFIG(TAG, "  Outbox: %u/%u readings, %u dropped", (unsigned) outbox_.size(), (unsigned) outbox_.capacity(),
+                  (unsigned) outbox_.dropped());
+  }
+  if (vz_client_ != nullptr)
+    vz_client_->dump_config();
+  if (mqtt_sink_ != nullptr)
+    mqtt_sink_->dump_config();
+  ESP_LOGCONFIG(TAG, "  RX queue: %u slots, %u high water, %u dropped", (unsigned) rx_queue_.capacity(),
+                (unsigned) rx_queue_.high_water(), (unsigned) rx_queue_.dropped());
+  if (downlink_enabled_) {
+    ESP_LOGCONFIG(TAG, "  Config downlink: %d dBm, %u pending, %u sent, %u late, %u acks: /lora/config",
+                  downlink_tx_power_, (unsigned) downlink_queue_.pending(), (unsigned) downlink_metrics_.sent.value(),
+                  (unsigned) downlink_metrics_.late.value(), (unsigned) downlink_metrics_.acks.value());
+  }
+  ESP_LOGCONFIG(TAG, "  Sweep report: /lora/sweep (max PER %.0f%%)", sweep_max_per_);
+  ChannelSummary channel = channel_monitor_.hour();
+  ESP_LOGCONFIG(TAG, "  Channel (1 h): %.2f%% utilization, %.1f%% foreign, noise floor %.1f dBm, collisions %.1f%%",
+                channel.utilization, channel.foreign, channel.noise_floor, channel.collision_probability);
+  ESP_LOGCONFIG(TAG, "  Metrics: /metrics");
+}
+
+// Decoders count and log their auth errors, with what they know of the node
+void LoRaReceiverComponent::handle_packet(const RxPacket &packet) {
+  PayloadStatus status = this->payloads_.dispatch(this, packet);
+  if (status == PAYLOAD_OK || payloadAuthError(status))
+    return;
+  rx_metrics_.decode_errors.inc();
+  ESP_LOGW(TAG, "Dropped %u byte packet, schema 0x%02X: %s", (unsigned) packet.length,
+           packet.length > 0 ? packet.data[0] : 0, payloadStatusName(status));
+}
+
+PayloadStatus LoRaReceiverComponent::decode_meter(const RxPacket &packet) {
+  MeterPayloadView view;
+  PayloadStatus status = MeterPayloadView::parse(packet.data, packet.length, view);
+  if (status != PAYLOAD_OK)
+    return status;
+  status = this->check_meter(packet.data, view);
+  if (status != PAYLOAD_OK)
+    return status;
+  this->publish_meter_data(view, packet.rssi, packet.snr);
+  if (this->downlink_enabled_)
+    this->schedule_downlink(packet, view);
+  return PAYLOAD_OK;
+}
+
+// Re-encoded as an unsigned meter frame of the node id the sender is
+// mapped to, so it takes the same path as a P2P reading. Keyed nodes and
+// require_signed refuse it: the channel key only encrypts. No downlink,
+// the node does not listen.
+PayloadStatus LoRaReceiverComponent::decode_meshtastic(const RxPacket &packet) {
+  uint16_t node_id;
+  PayloadStatus status = this->meshtastic_nodes_.lookup(packet.data, packet.length, node_id);
+  if (status == PAYLOAD_UNKNOWN_NODE) {
+    // Other devices on the mesh, not worth a warning
+    rx_metrics_.auth_errors.inc();
+    ESP_LOGV(TAG, "Dropped Meshtastic frame of !%08x: %s", (unsigned) meshtasticSender(packet.data),
+             payloadStatusName(status));
+  }
+  if (status != PAYLOAD_OK)
+    return status;
+  MeshtasticReading reading;
+  status = parseMeshtasticTelemetry(packet.data, packet.length, this->meshtastic_, reading);
+  if (status != PAYLOAD_OK)
+    return status;
+  uint8_t frame[PAYLOAD_METER_SIZE];
+  encodeMeterPayload(frame, node_id, reading.data);
+  MeterPayloadView view;
+  MeterPayloadView::parse(frame, sizeof(frame), view);
+  status = this->check_meter(frame, view);
+  if (status != PAYLOAD_OK)
+    return status;
+  this->publish_meter_data(view, packet.rssi, packet.snr);
+  return PAYLOAD_OK;
+}
+
+PayloadStatus LoRaReceiverComponent::check_meter(const uint8_t *data, const MeterPayloadView &view) {
+  PayloadStatus status = this->node_keys_.check(data, view);
+  if (status != PAYLOAD_OK) {
+    rx_metrics_.auth_errors.inc();
+    ESP_LOGW(TAG, "Dropped frame of node %04X, counter %u: %s", view.nodeId(), (unsigned) view.packetCounter(),
+             payloadStatusName(status));
+  }
+  return status;
+}
+
+PayloadStatus LoRaReceiverComponent::decode_sweep_announce(const RxPacket &packet) {
+  if (packet.length != sizeof(SweepAnnounce))
+    return PAYLOAD_BAD_LENGTH;
+  SweepAnnounce announce;
+  memcpy(&announce, packet.data, sizeof(announce));
+  if (this->sweep_matrix_.on_announce(announce, millis())) {
+    ESP_LOGD(TAG, "Sweep %u profile %u: SF%u BW%u CR4/%u %d dBm, %u probes", announce.sweep_id, announce.profile_id,
+             announce.profile.spreading_factor, (unsigned) (loraBandwidthHz(announce.profile.bandwidth) / 1000),
+             announce.profile.coding_rate + 4, announce.profile.tx_power, announce.probes);
+    this->request_profile(announce.profile);
+  }
+  return PAYLOAD_OK;
+}
+
+PayloadStatus LoRaReceiverComponent::decode_sweep_probe(const RxPacket &packet) {
+  if (packet.length != sizeof(SweepProbe))
+    return PAYLOAD_BAD_LENGTH;
+  SweepProbe probe;
+  memcpy(&probe, packet.data, sizeof(probe));
+  this->sweep_matrix_.on_probe(probe, packet.rssi, packet.snr);
+  return PAYLOAD_OK;
+}
+
+void LoRaReceiverComponent::publish_meter_data(const MeterPayloadView &view, int16_t rssi, float snr) {
+  uint32_t counter = view.packetCounter();
+  bool shown = this->shows_node(view.nodeId());
+  last_packet_time_ = millis();
+  LinkStats *link = link_stats_.get(view.nodeId());
+  if (link != nullptr) {
+    link->update(last_packet_time_, counter, rssi, snr);
+    if (shown)
+      this->update_link_channels(*link);
+  } else {
+    ESP_LOGW(TAG, "No link stats slot for node %04X", view.nodeId());
+  }
+
+  HistorySample sample;
+  bool timed = this->history_time(sample.time_s);
+  if (timed) {
+    sample.power_mw = view.powerMw();
+    sample.consumption_mwh = view.consumptionMwh();
+    sample.generation_mwh = view.generationMwh();
+    if (!history_.add(view.nodeId(), sample))
+      ESP_LOGW(TAG, "No history slot for node %04X", view.nodeId());
+    // Volkszaehler is independent of Home Assistant, so it bypasses the outbox.
+    // Its config requires a time source, so time_s is epoch seconds.
+    if (vz_client_ != nullptr)
+      vz_client_->on_reading(view.nodeId(), sample.time_s * 1000ULL, view.powerMw(), view.consumptionMwh(),
+                             view.generationMwh());
+  }
+  if (mqtt_sink_ != nullptr)
+    this->publish_mqtt(view, link, rssi, snr);
+  if (!shown)
+    return;
+
+  if (outbox_.capacity() > 0 && (!outbox_.empty() || !this->upstream_connected())) {
+    OutboxRecord record;
+    record.time_s = timed ? sample.time_s : 0;
+    record.node_id = view.nodeId();
+    record.battery_mv = view.batteryMv();
+    record.power_mw = view.powerMw();
+    record.packet_counter = counter;
+    record.consumption_mwh = view.consumptionMwh();
+    record.generation_mwh = view.generationMwh();
+    if (!outbox_.push(record))
+      ESP_LOGW(TAG, "Outbox full, oldest reading dropped");
+  } else {
+    publish_filter_.update(CHANNEL_POWER, meterPowerWatts(view.powerMw()));
+    publish_filter_.update(CHANNEL_CONSUMPTION, meterEnergyKwh(view.consumptionMwh()));
+    publish_filter_.update(CHANNEL_GENERATION, meterEnergyKwh(view.generationMwh()));
+    publish_filter_.update(CHANNEL_BATTERY, meterBatteryVolts(view.batteryMv()));
+  }
+  publish_filter_.update(CHANNEL_RSSI, rssi);
+  publish_filter_.update(CHANNEL_SNR, snr);
+  publish_filter_.update(CHANNEL_PACKET_COUNTER, counter);
+  this->flush_sensors();
+}
+
+bool LoRaReceiverComponent::shows_node(uint16_t node_id) {
+  if (this->sensor_node_ == 0) {
+    this->sensor_node_ = node_id;
+    if (this->vz_client_ != nullptr)
+      this->vz_client_->set_default_node(node_id);
+    ESP_LOGI(TAG, "Sensors show node %04X", node_id);
+  }
+  if (node_id == this->sensor_node_)
+    return true;
+  if (!this->other_node_warned_) {
+    this->other_node_warned_ = true;
+    ESP_LOGW(TAG, "Node %04X heard, sensors stay on node %04X; set node: to choose, MQTT has every node", node_id,
+             this->sensor_node_);
+  }
+  return false;
+}
+
+// One message per reading; like Volkszaehler it does not go through the outbox
+void LoRaReceiverComponent::publish_mqtt(const MeterPayloadView &view, LinkStats *link, int16_t rssi, float snr) {
+  MeterReading reading = {};
+  reading.node_id = view.nodeId();
+  reading.packet_counter = view.packetCounter();
+  reading.power_mw = view.powerMw();
+  reading.consumption_mwh = view.consumptionMwh();
+  reading.generation_mwh = view.generationMwh();
+  reading.battery_mv = view.batteryMv();
+  reading.rssi = rssi;
+  reading.snr_db10 = (int16_t) lroundf(snr * 10.0f);
+  if (link != nullptr) {
+    reading.lost = link->sequence().lost();
+    reading.per_1h_centi = (uint16_t) lroundf(link->per_1h(millis()) * 100.0f);
+  }
+#ifdef USE_TIME
+  if (time_ != nullptr) {
+    ESPTime now = time_->now();
+    if (now.is_valid())
+      reading.timestamp_ms = (uint64_t) now.timestamp * 1000ULL;
+  }
+#endif
+  mqtt_sink_->publish(reading);
+}
+
+void LoRaReceiverComponent::update_link_channels(LinkStats &link) {
+  uint32_t now = millis();
+  publish_filter_.update(CHANNEL_MISSED_PACKETS, link.sequence().lost());
+  publish_filter_.update(CHANNEL_PER_1H, link.per_1h(now));
+  publish_filter_.update(CHANNEL_PER_24H, link.per_24h(now));
+  publish_filter_.update(CHANNEL_JITTER, link.jitter_ms() / 1000.0f);
+}
+
+// Sensors take the 1 h window; /metrics also has the last minute
+void LoRaReceiverComponent::update_channel_load() {
+  ChannelSummary channel = channel_monitor_.hour();
+  publish_filter_.update(CHANNEL_UTILIZATION, channel.utilization);
+  if (!std::isnan(channel.noise_floor))
+    publish_filter_.update(CHANNEL_NOISE_FLOOR, channel.noise_floor);
+  publish_filter_.update(CHANNEL_COLLISION_PROBABILITY, channel.collision_probability);
+}
+
+bool LoRaReceiverComponent::history_time(uint32_t &time_s) {
+#ifdef USE_TIME
+  if (time_ != nullptr) {
+    ESPTime now = time_->now();
+    if (!now.is_valid())
+      return false;  // Not synced yet; mixing clocks would break the time order
+    time_s = (uint32_t) now.timestamp;
+    return true;
+  }
+#endif
+  time_s = millis() / 1000;
+  return true;
+}
+
+bool LoRaReceiverComponent::upstream_connected() {
+#ifdef USE_API
+  bool connected = api::global_api_server != nullptr && api::global_api_server->is_connected();
+#else
+  bool connected = network::is_connected();
+#endif
+  if (connected && !connected_)
+    connected_since_ = millis();
+  connected_ = connected;
+  return connected && millis() - connected_since_ >= OUTBOX_SETTLE_MS;
+}
+
+void LoRaReceiverComponent::setup_outbox() {
+  if (outbox_blocks_ == 0)
+    return;
+  if (!outbox_.allocate(outbox_blocks_)) {
+    ESP_LOGE(TAG, "No memory for a %u block outbox", (unsigned) outbox_blocks_);
+    return;
+  }
+  outbox_block_prefs_ = new ESPPreferenceObject[outbox_.block_count()];
+  uint32_t hash = fnv1_hash("lora_receiver_outbox");
+  for (size_t i = 0; i < outbox_.block_count(); i++) {
+    outbox_block_prefs_[i] = global_preferences->make_preference<OutboxBlock>(hash + 1 + i, true);
+    outbox_block_prefs_[i].load(&outbox_.block(i));
+  }
+  outbox_meta_pref_ = global_preferences->make_preference<OutboxMeta>(hash, true);
+  OutboxMeta meta;
+  if (outbox_meta_pref_.load(&meta) && outbox_.restore(meta) && !outbox_.empty())
+    ESP_LOGI(TAG, "Restored %u unsent readings from flash", (unsigned) outbox_.size());
+}
+
+// Without the saved counters a frame recorded off the air would be taken
+// once more after every reboot
+void LoRaReceiverComponent::setup_replay() {
+  uint32_t hash = fnv1_hash("lora_receiver_replay");
+  size_t restored = 0;
+  for (size_t i = 0; i < node_keys_.count(); i++) {
+    replay_prefs_[i] = global_preferences->make_preference<NodeReplayState>(hash + node_keys_.node_id(i), true);
+    NodeReplayState state;
+    if (replay_prefs_[i].load(&state) && node_keys_.restore(i, state))
+      restored++;
+  }
+  if (restored > 0)
+    ESP_LOGI(TAG, "Restored the replay counters of %u keyed nodes", (unsigned) restored);
+}
+
+// Bounded per call so a long backlog never delays the RX queue
+void LoRaReceiverComponent::replay_outbox() {
+  for (size_t i = 0; i < OUTBOX_REPLAY_BATCH; i++) {
+    const OutboxRecord *record = outbox_.front();
+    if (record == nullptr)
+      break;
+    ESP_LOGD(TAG, "Replaying node %04X #%u from t=%u", record->node_id, (unsigned) record->packet_counter,
+             (unsigned) record->time_s);
+    this->restore_history(*record);
+    // Records of other nodes predate the sensor node filter
+    if (this->shows_node(record->node_id)) {
+      replay_newest_ = *record;
+      replay_pending_ = true;
+    }
+    outbox_.pop();
+  }
+  if (outbox_.empty()) {
+    if (replay_pending_)
+      this->publish_record(replay_newest_);
+    replay_pending_ = false;
+    ESP_LOGI(TAG, "Outbox replay complete");
+  }
+}
+
+// The API has no way to pass a past timestamp, so Home Assistant would
+// stamp every replayed reading with the time it arrives. Only the newest
+// one goes to the sensors; the energy totals still come out right, the
+// outage's consumption just lands in the hour of the reconnect.
+void LoRaReceiverComponent::publish_record(const OutboxRecord &record) {
+  const float values[] = {meterPowerWatts(record.power_mw), meterEnergyKwh(record.consumption_mwh),
+                          meterEnergyKwh(record.generation_mwh), meterBatteryVolts(record.battery_mv)};
+  static_assert(CHANNEL_POWER == 0 && CHANNEL_BATTERY == 3, "meter channels come first");
+  for (size_t channel = CHANNEL_POWER; channel <= CHANNEL_BATTERY; channel++) {
+    if (sensors_[channel] != nullptr)
+      sensors_[channel]->publish_state(values[channel]);
+  }
+}
+
+// After a reboot the history is empty: refill it from flash when the
+// reading carries a wall-clock time and is newer than what is stored
+void LoRaReceiverComponent::restore_history(const OutboxRecord &record) {
+  const NodeHistory *node = history_.find(record.node_id);
+  if (record.time_s >= OUTBOX_EPOCH_MIN && (node == nullptr || record.time_s > node->last_time_s())) {
+    HistorySample sample;
+    sample.time_s = record.time_s;
+    sample.power_mw = record.power_mw;
+    sample.consumption_mwh = record.consumption_mwh;
+    sample.generation_mwh = record.generation_mwh;
+    history_.add(record.node_id, sample);
+  }
+}
+
+// One batch per packet; rate-limited channels are retried from loop()
+void LoRaReceiverComponent::flush_sensors() {
+  publish_filter_.flush(millis(), [this](size_t channel, float value) {
+    if (sensors_[channel] != nullptr)
+      sensors_[channel]->publish_state(value);
+  });
+}
+
+void LoRaReceiverComponent::log_sweep_report() {
+  ESP_LOGI(TAG, "Sweep pass complete, %u profiles:", this->sweep_matrix_.profile_count());
+  for (uint8_t i = 0; i < this->sweep_matrix_.profile_count(); i++) {
+    const SweepCell &c = this->sweep_matrix_.cell(i);
+    if (!c.seen)
+      continue;
+    ESP_LOGI(TAG, "  #%02u SF%-2u BW%-3u CR4/%u %3d dBm  %6.1f ms  PER %5.1f%%  RSSI %6.1f  SNR %5.1f", i,
+             c.profile.spreading_factor, (unsigned) (loraBandwidthHz(c.profile.bandwidth) / 1000),
+             c.profile.coding_rate + 4, c.profile.tx_power, c.airtime_us() / 1000.0f, c.per_percent(), c.rssi_avg(),
+             c.snr_avg());
+  }
+  int best = this->sweep_matrix_.best_profile(this->sweep_max_per_);
+  if (best < 0) {
+    ESP_LOGW(TAG, "No profile reached PER <= %.0f%%", this->sweep_max_per_);
+  } else {
+    ESP_LOGI(TAG, "Lowest airtime profile with PER <= %.0f%%: #%d", this->sweep_max_per_, best);
+  }
+}
+
+// Hand a retune to the RX task, which owns the SPI bus
+void LoRaReceiverComponent::request_profile(const LoRaProfile &profile) {
+  this->requested_profile_ = profile;
+  this->profile_requested_.store(true, std::memory_order_release);
+  xTaskNotifyGive(this->rx_task_handle_);
+}
+
+// Retune for a sweep profile. Leaving RX is also the point where the
+// buffer base is reset, so continuous RX never wraps across a retune.
+void LoRaReceiverComponent::apply_profile(const LoRaProfile &profile) {
+  const uint8_t standby = STANDBY_RC;
+  this->write_command(CMD_SET_STANDBY, &standby, 1);
+  const uint8_t base[2] = {0x00, 0x00};
+  this->write_command(CMD_SET_BUFFER_BASE_ADDRESS, base, sizeof(base));
+  if (this->scanning())
+    this->set_frequency(LORA_FREQUENCY);  // The scan may have left it elsewhere
+  this->set_modulation(profile);
+  this->start_receive();
+}
+
+// CAD on the current scan profile. With the CAD_RX exit mode the radio
+// receives on its own when it detects a preamble, so a detection costs
+// no SPI round trip before the header arrives.
+void LoRaReceiverComponent::start_cad() {
+  const ScanProfile &scan = this->scanner_.current();
+  const uint8_t standby = STANDBY_RC;
+  this->write_command(CMD_SET_STANDBY, &standby, 1);
+  const uint8_t base[2] = {0x00, 0x00};
+  this->write_command(CMD_SET_BUFFER_BASE_ADDRESS, base, sizeof(base));
+  this->set_frequency(scan.frequency_hz);
+  this->set_modulation(scan.profile);
+
+  // cadSymbolNum 0x01: 2 symbols, 0x02: 4; timeout in 15.625 us steps
+  CadSettings settings = cad_settings(scan.profile.spreading_factor);
+  uint32_t timeout = (uint32_t) ((uint64_t) this->scanner_.rx_timeout_us(this->scanner_.index()) * 64 / 1000);
+  const uint8_t cad[7] = {(uint8_t) (settings.symbols == 2 ? 0x01 : 0x02),
+                          settings.det_peak,
+                          settings.det_min,
+                          0x01,  // CAD_RX
+                          (uint8_t) (timeout >> 16),
+                          (uint8_t) (timeout >> 8),
+                          (uint8_t) timeout};
+  this->write_command(CMD_SET_CAD_PARAMS, cad, sizeof(cad));
+  this->clear_irq_status(IRQ_ALL);
+  this->write_command(CMD_SET_CAD);
+  this->scan_started_ = millis();
+}
+
+// One DIO1 edge while scanning: CAD done, or the end of the RX that a
+// detection started. Anything but a detection moves on to the next profile.
+void LoRaReceiverComponent::handle_scan_irq(uint32_t irq_us) {
+  uint16_t irq = this->get_irq_status();
+  this->clear_irq_status(irq);
+  ScanStats &stats = this->scanner_.stats(this->scanner_.index());
+  if (irq & IRQ_CAD_DONE) {
+    stats.cads.inc();
+    if (irq & IRQ_CAD_DETECTED) {
+      stats.detections.inc();
+      return;  // Receiving now
+    }
+  } else if (irq & (IRQ_RX_DONE | IRQ_CRC_ERR | IRQ_HEADER_ERR)) {
+    if (irq & IRQ_RX_DONE)
+      stats.packets.inc();
+    this->receive_packet(irq, irq_us);
+  } else if (irq & IRQ_TIMEOUT) {
+    stats.timeouts.inc();
+  } else {
+    return;  // Woken by a profile request, the CAD is still running
+  }
+  this->scanner_.advance();
+  this->start_cad();
+}
+
+bool LoRaReceiverComponent::listens_on(uint8_t spreading_factor) const {
+  if (!this->scanning())
+    return spreading_factor == LORA_SPREADING_FACTOR;
+  for (size_t i = 0; i < this->scanner_.count(); i++) {
+    const LoRaProfile &profile = this->scanner_.profile(i).profile;
+    if (profile.spreading_factor == spreading_factor && profile.bandwidth == LORA_BANDWIDTH)
+      return true;
+  }
+  return false;
+}
+
+// Called from the web server; loop() owns the downlink queue
+bool LoRaReceiverComponent::request_config(uint16_t node_id, const ConfigChange &change) {
+  if (this->config_requested_.load(std::memory_order_acquire))
+    return false;
+  this->config_node_ = node_id;
+  this->config_change_ = change;
+  this->config_requested_.store(true, std::memory_order_release);
+  return true;
+}
+
+// Answer a meter uplink with the change pending for its node. The RX
+// task sends it into the node's receive window; one frame in flight.
+void LoRaReceiverComponent::schedule_downlink(const RxPacket &packet, const MeterPayloadView &view) {
+  if (!view.isSigned())
+    return;  // Only nodes with a key listen
+  const AesCmac *key = this->node_keys_.find(view.nodeId());
+  if (key == nullptr || this->downlink_requested_.load(std::memory_order_acquire))
+    return;
+  ConfigDownlink downlink;
+  if (!this->downlink_queue_.next(view.nodeId(), downlink, millis()))
+    return;
+  DownlinkRequest &request = this->downlink_request_;
+  request.length = (uint8_t) encodeConfigDownlink(request.data, *key, downlink);
+  request.tx_us = packet.irq_us + DOWNLINK_RX_DELAY_MS * 1000;
+  request.frequency_hz = packet.frequency_hz;
+  request.profile = packet.profile;
+  this->downlink_requested_.store(true, std::memory_order_release);
+  xTaskNotifyGive(this->rx_task_handle_);
+  ESP_LOGD(TAG, "Config #%u for node %04X due in the next receive window", downlink.sequence, downlink.node_id);
+}
+
+PayloadStatus LoRaReceiverComponent::decode_config_ack(const RxPacket &packet) {
+  if (packet.length != CONFIG_ACK_SIZE)
+    return PAYLOAD_BAD_LENGTH;
+  // The node id is only trusted once the node's key verified the tag
+  const AesCmac *key = this->node_keys_.find(payloadLoad<uint16_t>(packet.data + 2));
+  ConfigAck ack;
+  PayloadStatus status = key != nullptr ? parseConfigAck(packet.data, packet.length, *key, ack) : PAYLOAD_UNKNOWN_KEY;
+  if (status != PAYLOAD_OK) {
+    rx_metrics_.auth_errors.inc();
+    ESP_LOGW(TAG, "Dropped config ack: %s", payloadStatusName(status));
+    return status;
+  }
+  this->downlink_metrics_.acks.inc();
+  ESP_LOGI(TAG, "Node %04X config #%u: %s", ack.node_id, ack.sequence, configAckName(ack.status));
+  this->downlink_queue_.on_ack(ack, millis());
+  return PAYLOAD_OK;
+}
+
+// Runs on the RX task at the request's tx_us. The uplink's DIO1 edge is
+// its end on air, the same point the node times its window from.
+void LoRaReceiverComponent::transmit_downlink() {
+  const DownlinkRequest &request = this->downlink_request_;
+  if ((int32_t) (micros() - request.tx_us) > (int32_t) DOWNLINK_LATE_US) {
+    this->downlink_metrics_.late.inc();
+    return;
+  }
+  while ((int32_t) (request.tx_us - micros()) > 0) {
+  }
+
+  LoRaProfile resume = this->rx_profile_;
+  const uint8_t standby = STANDBY_RC;
+  this->write_command(CMD_SET_STANDBY, &standby, 1);
+  const uint8_t base[2] = {0x00, 0x00};
+  this->write_command(CMD_SET_BUFFER_BASE_ADDRESS, base, sizeof(base));
+  this->set_frequency(request.frequency_hz);
+  this->set_modulation(request.profile);
+  this->set_packet_params(request.length);
+  this->write_buffer(0, request.data, request.length);
+  this->clear_irq_status(IRQ_ALL);
+  const uint8_t no_timeout[3] = {0x00, 0x00, 0x00};
+  this->write_command(CMD_SET_TX, no_timeout, sizeof(no_timeout));
+
+  // TX done raises DIO1 like any other IRQ
+  uint32_t airtime_us = loraTimeOnAirUs(request.profile, request.length);
+  uint32_t start = millis();
+  bool done = false;
+  while (!done && millis() - start < airtime_us / 1000 + 100) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+    done = (this->get_irq_status() & IRQ_TX_DONE) != 0;
+  }
+  if (done) {
+    this->downlink_metrics_.sent.inc();
+    this->channel_monitor_.add_packet(millis(), airtime_us);
+  } else {
+    ESP_LOGW(TAG, "Downlink TX did not finish");
+  }
+
+  this->set_packet_params(0xFF);
+  if (this->scanning() && !this->scan_paused_) {
+    this->start_cad();
+  } else {
+    this->apply_profile(resume);
+  }
 }
 
-// Stub implementations for SPI methods (will be implemented properly later)
 void LoRaReceiverComponent::reset_module() {
   digitalWrite(rst_pin_, LOW);
   delay(10);
@@ -140,7 +794,6 @@ void LoRaReceiverComponent::wait_busy() {
   uint32_t start = millis();
   uint32_t timeout = 3000; // 3 second timeout
   
-  ESP_LOGD(TAG, "Waiting for BUSY pin to go LOW...");
   while (digitalRead(busy_pin_)) {
     if (millis() - start > timeout) {
       ESP_LOGE(TAG, "Timeout waiting for BUSY pin! Module may be hung.");
@@ -150,38 +803,230 @@ void LoRaReceiverComponent::wait_busy() {
     }
     delay(1);
   }
-  ESP_LOGD(TAG, "BUSY pin went LOW after %lu ms", millis() - start);
 }
 
 void LoRaReceiverComponent::write_command(uint8_t cmd, const uint8_t *data, size_t len) {
-  // Will be implemented with proper SPI communication
+  this->wait_busy();
+  this->enable();
+  this->write_byte(cmd);
+  if (len > 0)
+    this->write_array(data, len);
+  this->disable();
 }
 
+// The first byte clocked out after the opcode is the chip status
 void LoRaReceiverComponent::read_command(uint8_t cmd, uint8_t *data, size_t len) {
-  // Will be implemented with proper SPI communication
+  this->wait_busy();
+  this->enable();
+  this->write_byte(cmd);
+  this->read_byte();
+  this->read_array(data, len);
+  this->disable();
+}
+
+void LoRaReceiverComponent::write_register(uint16_t address, const uint8_t *data, size_t len) {
+  this->wait_busy();
+  this->enable();
+  this->write_byte(CMD_WRITE_REGISTER);
+  this->write_byte(address >> 8);
+  this->write_byte(address & 0xFF);
+  this->write_array(data, len);
+  this->disable();
+}
+
+void LoRaReceiverComponent::read_buffer(uint8_t offset, uint8_t *data, size_t len) {
+  this->wait_busy();
+  this->enable();
+  this->write_byte(CMD_READ_BUFFER);
+  this->write_byte(offset);
+  this->read_byte();
+  this->read_array(data, len);
+  this->disable();
+}
+
+void LoRaReceiverComponent::write_buffer(uint8_t offset, const uint8_t *data, size_t len) {
+  this->wait_busy();
+  this->enable();
+  this->write_byte(CMD_WRITE_BUFFER);
+  this->write_byte(offset);
+  this->write_array(data, len);
+  this->disable();
 }
 
 bool LoRaReceiverComponent::init_lora() {
-  // Will be implemented with proper initialization sequence
-  return false;
+  this->reset_module();
+
+  const uint8_t standby = STANDBY_RC;
+  this->write_command(CMD_SET_STANDBY, &standby, 1);
+  this->wait_busy();
+  this->enable();
+  this->write_byte(CMD_GET_STATUS);
+  uint8_t status = this->read_byte();
+  this->disable();
+  // Chip mode bits 6:4 must read STBY_RC (0x2)
+  if (((status >> 4) & 0x07) != 0x02) {
+    ESP_LOGE(TAG, "Unexpected status 0x%02X after standby", status);
+    return false;
+  }
+
+  if (tcxo_voltage_ > 0) {
+    // Voltage codes 1.6, 1.7, 1.8, 2.2, 2.4, 2.7, 3.0, 3.3 V; 5 ms startup
+    static const float TCXO_VOLTAGES[] = {1.6f, 1.7f, 1.8f, 2.2f, 2.4f, 2.7f, 3.0f, 3.3f};
+    uint8_t code = 0;
+    while (code < 7 && TCXO_VOLTAGES[code] + 0.05f < tcxo_voltage_)
+      code++;
+    const uint8_t tcxo[4] = {code, 0x00, 0x01, 0x40};  // 320 * 15.625 us
+    this->write_command(CMD_SET_DIO3_AS_TCXO, tcxo, sizeof(tcxo));
+    const uint8_t calibrate_all = 0x7F;
+    this->write_command(CMD_CALIBRATE, &calibrate_all, 1);
+    delay(5);
+  }
+
+  const uint8_t dcdc = 0x01;
+  this->write_command(CMD_SET_REGULATOR_MODE, &dcdc, 1);
+  const uint8_t rf_switch = 0x01;
+  this->write_command(CMD_SET_DIO2_AS_RF_SWITCH, &rf_switch, 1);
+
+  const uint8_t packet_type = PACKET_TYPE_LORA;
+  this->write_command(CMD_SET_PACKET_TYPE, &packet_type, 1);
+
+  // Image calibration for the band in use
+  uint8_t image[2] = {0x6B, 0x6F};  // 430 - 440 MHz
+  if (LORA_FREQUENCY > 900000000) {
+    image[0] = 0xE1;
+    image[1] = 0xE9;
+  } else if (LORA_FREQUENCY > 850000000) {
+    image[0] = 0xD7;
+    image[1] = 0xDB;
+  }
+  this->write_command(CMD_CALIBRATE_IMAGE, image, sizeof(image));
+
+  this->set_frequency(LORA_FREQUENCY);
+
+  const uint8_t base[2] = {0x00, 0x00};  // TX and RX both start at 0
+  this->write_command(CMD_SET_BUFFER_BASE_ADDRESS, base, sizeof(base));
+
+  this->set_modulation(BASE_PROFILE);
+  this->set_packet_params(0xFF);
+
+  if (downlink_enabled_) {
+    // High power PA, up to +22 dBm; 200 us ramp
+    const uint8_t pa[4] = {0x04, 0x07, 0x00, 0x01};
+    this->write_command(CMD_SET_PA_CONFIG, pa, sizeof(pa));
+    const uint8_t tx[2] = {(uint8_t) downlink_tx_power_, 0x04};
+    this->write_command(CMD_SET_TX_PARAMS, tx, sizeof(tx));
+  }
+
+  // One-byte sync word 0xXY is stored as 0xX4 0xY4
+  const uint8_t sync[2] = {(uint8_t) ((LORA_SYNC_WORD & 0xF0) | 0x04), (uint8_t) (((LORA_SYNC_WORD & 0x0F) << 4) | 0x04)};
+  this->write_register(REG_LORA_SYNC_WORD, sync, sizeof(sync));
+
+  const uint8_t boosted_gain = 0x96;
+  this->write_register(REG_RX_GAIN, &boosted_gain, 1);
+
+  uint16_t irq = IRQ_RX_DONE | IRQ_HEADER_ERR | IRQ_CRC_ERR;
+  if (this->scanning())
+    irq |= IRQ_CAD_DONE | IRQ_CAD_DETECTED | IRQ_TIMEOUT;
+  if (downlink_enabled_)
+    irq |= IRQ_TX_DONE;
+  const uint8_t dio[8] = {(uint8_t) (irq >> 8), (uint8_t) irq, (uint8_t) (irq >> 8), (uint8_t) irq, 0, 0, 0, 0};
+  this->write_command(CMD_SET_DIO_IRQ_PARAMS, dio, sizeof(dio));
+  return true;
+}
+
+// Frf = f * 2^25 / 32 MHz
+void LoRaReceiverComponent::set_frequency(uint32_t frequency_hz) {
+  uint32_t frf = (uint32_t) (((uint64_t) frequency_hz << 25) / 32000000ULL);
+  const uint8_t freq[4] = {(uint8_t) (frf >> 24), (uint8_t) (frf >> 16), (uint8_t) (frf >> 8), (uint8_t) frf};
+  this->write_command(CMD_SET_RF_FREQUENCY, freq, sizeof(freq));
+}
+
+// SetModulationParams: SF, BW, CR, low data rate optimization.
+// The CubeCell API bandwidth codes 0/1/2 map to SX126x 0x04/0x05/0x06.
+void LoRaReceiverComponent::set_modulation(const LoRaProfile &profile) {
+  this->rx_profile_ = profile;
+  static const uint8_t SX126X_BANDWIDTH[] = {0x04, 0x05, 0x06};
+  const uint8_t params[4] = {
+      profile.spreading_factor,
+      SX126X_BANDWIDTH[profile.bandwidth > 2 ? 0 : profile.bandwidth],
+      profile.coding_rate,
+      (uint8_t) (loraSymbolTimeUs(profile.spreading_factor, profile.bandwidth) > 16000 ? 1 : 0),
+  };
+  this->write_command(CMD_SET_MODULATION_PARAMS, params, sizeof(params));
+}
+
+// Explicit header, CRC on, standard IQ. The length only matters for TX;
+// RX takes whatever the header says up to it.
+void LoRaReceiverComponent::set_packet_params(uint8_t payload_length) {
+  const uint8_t packet[6] = {(uint8_t) (LORA_PREAMBLE_LENGTH >> 8), (uint8_t) LORA_PREAMBLE_LENGTH, 0x00, payload_length,
+                             0x01, 0x00};
+  this->write_command(CMD_SET_PACKET_PARAMS, packet, sizeof(packet));
+}
+
+// irq as read and cleared by the caller
+void LoRaReceiverComponent::receive_packet(uint16_t irq, uint32_t irq_us) {
+  if (irq & (IRQ_CRC_ERR | IRQ_HEADER_ERR)) {
+    rx_metrics_.crc_errors.inc();
+    return;
+  }
+  if (!(irq & IRQ_RX_DONE))
+    return;
+
+  // In continuous RX every packet starts where the previous one ended;
+  // the buffer status reports length and start offset
+  uint8_t buffer_status[2];
+  this->read_command(CMD_GET_RX_BUFFER_STATUS, buffer_status, sizeof(buffer_status));
+  uint8_t len = buffer_status[0];
+  uint8_t offset = buffer_status[1];
+  // On air even when the queue has no slot for it
+  this->channel_monitor_.add_packet(millis(), loraTimeOnAirUs(this->rx_profile_, len));
+
+  RxPacket *packet = this->rx_queue_.acquire();
+  if (packet == nullptr) {
+    // Queue full: the loop is stalled, the packet is lost but RX continues
+    return;
+  }
+  this->read_buffer(offset, packet->data, len);
+
+  // RssiPkt = -x/2 dBm, SnrPkt = signed x/4 dB
+  uint8_t packet_status[3];
+  this->read_command(CMD_GET_PACKET_STATUS, packet_status, sizeof(packet_status));
+  packet->length = len;
+  packet->rssi = -(int16_t) packet_status[0] / 2;
+  packet->snr = (int8_t) packet_status[1] / 4.0f;
+  packet->timestamp_ms = millis();
+  packet->irq_us = irq_us;
+  packet->frequency_hz = this->scanning() && !this->scan_paused_ ? this->scanner_.current().frequency_hz : LORA_FREQUENCY;
+  packet->profile = this->rx_profile_;
+  this->rx_queue_.commit();
+  this->rx_metrics_.packets.inc();
+  this->rx_metrics_.irq_to_queue.observe(micros() - irq_us);
 }
 
-void LoRaReceiverComponent::receive_packet() {
-  // Will be implemented to read actual packet data
+// Instantaneous RSSI between packets: RssiInst = -x/2 dBm
+void LoRaReceiverComponent::sample_rssi() {
+  uint8_t rssi;
+  this->read_command(CMD_GET_RSSI_INST, &rssi, 1);
+  this->channel_monitor_.add_rssi(millis(), -(float) rssi / 2.0f);
 }
 
+// Continuous receive: timeout 0xFFFFFF keeps the radio in RX after each packet
 void LoRaReceiverComponent::start_receive() {
-  // Will be implemented to start RX mode
+  this->clear_irq_status(IRQ_ALL);
+  const uint8_t timeout[3] = {0xFF, 0xFF, 0xFF};
+  this->write_command(CMD_SET_RX, timeout, sizeof(timeout));
 }
 
 uint16_t LoRaReceiverComponent::get_irq_status() {
-  // Will be implemented to read IRQ status
-  return 0;
+  uint8_t irq[2];
+  this->read_command(CMD_GET_IRQ_STATUS, irq, sizeof(irq));
+  return ((uint16_t) irq[0] << 8) | irq[1];
 }
 
 void LoRaReceiverComponent::clear_irq_status(uint16_t irq) {
-  // Will be implemented to clear IRQ flags
+  const uint8_t data[2] = {(uint8_t) (irq >> 8), (uint8_t) irq};
+  this->write_command(CMD_CLEAR_IRQ_STATUS, data, sizeof(data));
 }
 
 }  // namespace lora_receiver
-}  // namespace esphome
\ No newline at end of file
+}  // namespace esphome
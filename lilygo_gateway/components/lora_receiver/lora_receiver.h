@@ -1,21 +1,68 @@
 #pragma once
 
 #include "esphome/core/component.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/preferences.h"
 #include "esphome/components/sensor/sensor.h"
 #include "esphome/components/spi/spi.h"
+#ifdef USE_TIME
+#include "esphome/components/time/real_time_clock.h"
+#endif
 #include <SPI.h>
+#include <atomic>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "lora_data.h"
+#include "cad_scanner.h"
+#include "channel_monitor.h"
+#include "config_downlink.h"
+#include "downlink_queue.h"
+#include "link_stats.h"
+#include "lora_payload.h"
+#include "meshtastic_nodes.h"
+#include "meshtastic_telemetry.h"
+#include "metrics.h"
+#include "mqtt_sink.h"
+#include "node_keys.h"
+#include "outbox.h"
+#include "packet_queue.h"
+#include "payload_registry.h"
+#include "publish_filter.h"
+#include "sweep_matrix.h"
+#include "timeseries.h"
+#include "vz_client.h"
 
 namespace esphome {
 namespace lora_receiver {
 
-// Must match the struct in CubeCell
-struct MeterData {
-  float power_watts;
-  float total_consumption_kwh;
-  float total_generation_kwh;
-  float battery_voltage;
-  uint32_t packet_counter;
-} __attribute__((packed));
+class LoRaWebHandler;
+
+static constexpr size_t HISTORY_MAX_NODES = 4;
+static constexpr size_t LINK_STATS_MAX_NODES = 8;
+static constexpr size_t RX_QUEUE_SLOTS = 16;
+static constexpr size_t MAX_SCAN_PROFILES = 8;
+static constexpr size_t MAX_PAYLOAD_SCHEMAS = 8;
+
+// Order must match PUBLISH_CHANNELS in __init__.py
+enum PublishChannel : uint8_t {
+  CHANNEL_POWER,
+  CHANNEL_CONSUMPTION,
+  CHANNEL_GENERATION,
+  CHANNEL_BATTERY,
+  CHANNEL_RSSI,
+  CHANNEL_SNR,
+  CHANNEL_PACKET_COUNTER,
+  CHANNEL_MISSED_PACKETS,
+  CHANNEL_PER_1H,
+  CHANNEL_PER_24H,
+  CHANNEL_JITTER,
+  CHANNEL_UTILIZATION,
+  CHANNEL_NOISE_FLOOR,
+  CHANNEL_COLLISION_PROBABILITY,
+  CHANNEL_COUNT,
+};
 
 class LoRaReceiverComponent : public Component, public spi::SPIDevice<spi::BIT_ORDER_MSB_FIRST, spi::CLOCK_POLARITY_LOW, spi::CLOCK_PHASE_LEADING, spi::DATA_RATE_8MHZ> {
  public:
@@ -27,16 +74,112 @@ class LoRaReceiverComponent : public Component, public spi::SPIDevice<spi::BIT_O
   void set_dio1_pin(uint8_t pin) { dio1_pin_ = pin; }
   void set_rst_pin(uint8_t pin) { rst_pin_ = pin; }
   void set_busy_pin(uint8_t pin) { busy_pin_ = pin; }
+  void set_tcxo_voltage(float voltage) { tcxo_voltage_ = voltage; }
   
-  void set_power_sensor(sensor::Sensor *sensor) { power_sensor_ = sensor; }
-  void set_consumption_sensor(sensor::Sensor *sensor) { consumption_sensor_ = sensor; }
-  void set_generation_sensor(sensor::Sensor *sensor) { generation_sensor_ = sensor; }
-  void set_battery_sensor(sensor::Sensor *sensor) { battery_sensor_ = sensor; }
-  void set_rssi_sensor(sensor::Sensor *sensor) { rssi_sensor_ = sensor; }
-  void set_snr_sensor(sensor::Sensor *sensor) { snr_sensor_ = sensor; }
-  void set_packet_counter_sensor(sensor::Sensor *sensor) { packet_counter_sensor_ = sensor; }
-  void set_missed_packets_sensor(sensor::Sensor *sensor) { missed_packets_sensor_ = sensor; }
+  void set_power_sensor(sensor::Sensor *sensor) { sensors_[CHANNEL_POWER] = sensor; }
+  void set_consumption_sensor(sensor::Sensor *sensor) { sensors_[CHANNEL_CONSUMPTION] = sensor; }
+  void set_generation_sensor(sensor::Sensor *sensor) { sensors_[CHANNEL_GENERATION] = sensor; }
+  void set_battery_sensor(sensor::Sensor *sensor) { sensors_[CHANNEL_BATTERY] = sensor; }
+  void set_rssi_sensor(sensor::Sensor *sensor) { sensors_[CHANNEL_RSSI] = sensor; }
+  void set_snr_sensor(sensor::Sensor *sensor) { sensors_[CHANNEL_SNR] = sensor; }
+  void set_packet_counter_sensor(sensor::Sensor *sensor) { sensors_[CHANNEL_PACKET_COUNTER] = sensor; }
+  void set_missed_packets_sensor(sensor::Sensor *sensor) { sensors_[CHANNEL_MISSED_PACKETS] = sensor; }
+  void set_per_1h_sensor(sensor::Sensor *sensor) { sensors_[CHANNEL_PER_1H] = sensor; }
+  void set_per_24h_sensor(sensor::Sensor *sensor) { sensors_[CHANNEL_PER_24H] = sensor; }
+  void set_jitter_sensor(sensor::Sensor *sensor) { sensors_[CHANNEL_JITTER] = sensor; }
+  void set_channel_utilization_sensor(sensor::Sensor *sensor) { sensors_[CHANNEL_UTILIZATION] = sensor; }
+  void set_noise_floor_sensor(sensor::Sensor *sensor) { sensors_[CHANNEL_NOISE_FLOOR] = sensor; }
+  void set_collision_probability_sensor(sensor::Sensor *sensor) { sensors_[CHANNEL_COLLISION_PROBABILITY] = sensor; }
+
+  void set_publish_policy(uint8_t channel, float deadband, uint32_t min_interval_ms) {
+    PublishPolicy policy;
+    policy.deadband = deadband;
+    policy.min_interval_ms = min_interval_ms;
+    policy.max_interval_ms = force_update_interval_;
+    publish_filter_.set_policy(channel, policy);
+  }
+  void set_force_update_interval(uint32_t interval_ms) {
+    force_update_interval_ = interval_ms;
+    publish_filter_.set_max_interval(interval_ms);
+  }
   
+  void set_sweep_max_per(float max_per) { sweep_max_per_ = max_per; }
+  // Two or more profiles switch from continuous RX to CAD scanning;
+  // frequency 0 is LORA_FREQUENCY
+  void add_scan_profile(uint32_t frequency_hz, uint8_t spreading_factor, uint8_t bandwidth) {
+    ScanProfile scan;
+    scan.frequency_hz = frequency_hz != 0 ? frequency_hz : LORA_FREQUENCY;
+    scan.profile = {spreading_factor, bandwidth, LORA_CODING_RATE, LORA_TX_POWER};
+    scanner_.add(scan);
+  }
+  bool scanning() const { return scanner_.count() > 1; }
+  const CadScanner<MAX_SCAN_PROFILES> &scanner() const { return scanner_; }
+  // Whether nodes on this SF (at LORA_BANDWIDTH) are still heard
+  bool listens_on(uint8_t spreading_factor) const;
+
+  // Count and key length checked by the config schema
+  void add_node_key(uint16_t node_id, const std::vector<uint8_t> &key) { node_keys_.add(node_id, key.data()); }
+  void set_require_signed(bool require) { node_keys_.set_require_signed(require); }
+  bool has_node_key(uint16_t node_id) const { return node_keys_.find(node_id) != nullptr; }
+  // Telemetry of TRANSPORT_LORA_MESHTASTIC nodes on this channel, from
+  // the listed senders only; key length, count and unique node ids
+  // checked by the config schema
+  void set_meshtastic_channel(const std::string &name, const std::vector<uint8_t> &key) {
+    meshtastic_.set(name.c_str(), key.data());
+    meshtastic_enabled_ = true;
+  }
+  void add_meshtastic_node(uint32_t num, uint16_t node_id) { meshtastic_nodes_.add(num, node_id); }
+
+  // Config downlinks go to nodes with a key
+  void set_downlink_tx_power(int8_t tx_power) {
+    downlink_tx_power_ = tx_power;
+    downlink_enabled_ = true;
+  }
+  bool downlink_enabled() const { return downlink_enabled_; }
+  // Hands a change to loop(); false while the previous one is not picked up
+  bool request_config(uint16_t node_id, const ConfigChange &change);
+  const DownlinkQueue<LINK_STATS_MAX_NODES> &downlink_queue() const { return downlink_queue_; }
+  const DownlinkMetrics &downlink_metrics() const { return downlink_metrics_; }
+#ifdef USE_TIME
+  void set_time(time::RealTimeClock *time) { time_ = time; }
+#endif
+  void set_history_capacity(size_t raw, size_t minute, size_t quarter) { history_.set_capacity(raw, minute, quarter); }
+  const HistoryStore<HISTORY_MAX_NODES> &history() const { return history_; }
+
+  void set_outbox_blocks(size_t blocks) { outbox_blocks_ = blocks; }
+
+  // Node whose readings the sensors show; 0: the first node heard
+  void set_sensor_node(uint16_t node_id) { sensor_node_ = node_id; }
+  uint16_t sensor_node() const { return sensor_node_; }
+
+  void set_vz_server(const std::string &host, uint16_t port, const std::string &path) {
+    vz_client_ = new VzClient(host, port, path);
+  }
+  void set_vz_batching(size_t batch_size, uint32_t max_delay_ms) { vz_client_->set_batching(batch_size, max_delay_ms); }
+  void set_mqtt_sink(MqttSink *sink) { mqtt_sink_ = sink; }
+
+  // Channel count and UUIDs are checked by the config schema
+  void add_vz_channel(const char *uuid, VzField field, uint16_t node) { vz_client_->add_channel(uuid, field, node); }
+
+  LinkStatsTable<LINK_STATS_MAX_NODES> &link_stats() { return link_stats_; }
+  const RxMetrics &rx_metrics() const { return rx_metrics_; }
+  const PacketQueue<RX_QUEUE_SLOTS> &rx_queue() const { return rx_queue_; }
+  const ChannelMonitor &channel_monitor() const { return channel_monitor_; }
+
+  const SweepMatrix &sweep_matrix() const { return sweep_matrix_; }
+  void clear_sweep_matrix() {
+    LockGuard lock(report_lock_);
+    sweep_matrix_.clear();
+  }
+
+  // Held by loop() while it updates the link stats, history, downlink
+  // queue and sweep matrix, and by the web handler while it reads them
+  Mutex &report_lock() { return report_lock_; }
+
+  // Dispatch one received frame to the decoder of its schema
+  void handle_packet(const RxPacket &packet);
+  const PayloadRegistry<LoRaReceiverComponent, MAX_PAYLOAD_SCHEMAS> &payloads() const { return payloads_; }
+
   uint32_t seconds_since_last_packet() const {
     return (millis() - last_packet_time_) / 1000;
   }
@@ -45,24 +188,135 @@ class LoRaReceiverComponent : public Component, public spi::SPIDevice<spi::BIT_O
   uint8_t dio1_pin_;
   uint8_t rst_pin_;
   uint8_t busy_pin_;
+  float tcxo_voltage_{0.0f};  // 0: crystal, otherwise TCXO supplied from DIO3
+
+  // RX path: DIO1 ISR -> RX task on core 0 -> rx_queue_ -> loop().
+  // The RX task owns the SPI bus after setup(); loop() only requests
+  // retunes through requested_profile_.
+  static constexpr size_t RX_BATCH = 8;  // Packets handled per loop() call
+  PacketQueue<RX_QUEUE_SLOTS> rx_queue_;
+  TaskHandle_t rx_task_handle_{nullptr};
+  LoRaProfile requested_profile_;
+  std::atomic<bool> profile_requested_{false};
+  std::atomic<uint32_t> irq_us_{0};  // micros() of the last DIO1 edge, set by the ISR
+  RxMetrics rx_metrics_;
+
+  // Decoders by schema id (src/lora_payload.h), registered in setup()
+  PayloadStatus decode_meter(const RxPacket &packet);
+  PayloadStatus decode_config_ack(const RxPacket &packet);
+  PayloadStatus decode_sweep_announce(const RxPacket &packet);
+  PayloadStatus decode_sweep_probe(const RxPacket &packet);
+  PayloadStatus decode_meshtastic(const RxPacket &packet);
+  // Key and replay check shared by the meter decoders, counts and logs
+  // what it refuses
+  PayloadStatus check_meter(const uint8_t *data, const MeterPayloadView &view);
+  PayloadRegistry<LoRaReceiverComponent, MAX_PAYLOAD_SCHEMAS> payloads_;
+
+  // Channel load, fed by the RX task: time-on-air of each packet under
+  // the profile it arrived with, and an RSSI sample every RSSI_SAMPLE_MS
+  static constexpr uint32_t RSSI_SAMPLE_MS = 100;
+  void sample_rssi();
+  LoRaProfile rx_profile_{};
+  ChannelMonitor channel_monitor_;
+
+  // CAD scanning, driven by the RX task. A sweep pins its probe profile
+  // and pauses the scan until the base profile is requested again.
+  static constexpr uint32_t SCAN_STALL_MS = 5000;  // Longer than any packet
+  void start_cad();
+  void handle_scan_irq(uint32_t irq_us);
+  CadScanner<MAX_SCAN_PROFILES> scanner_;
+  bool scan_paused_{false};
+  uint32_t scan_started_{0};
+
+  // Config downlinks: loop() answers a meter uplink with the pending
+  // change of its node and hands the frame to the RX task, which sends
+  // it DOWNLINK_RX_DELAY_MS after the uplink ended, on the uplink's
+  // channel and profile, then resumes RX.
+  struct DownlinkRequest {
+    uint8_t data[CONFIG_DOWNLINK_MAX_SIZE];
+    uint8_t length;
+    uint32_t tx_us;
+    uint32_t frequency_hz;
+    LoRaProfile profile;
+  };
+  static constexpr uint32_t DOWNLINK_LATE_US = 5000;  // Well inside the node's window margin
+  static constexpr uint32_t DOWNLINK_SPIN_US = 2000;  // Busy-wait for the exact start
+  void schedule_downlink(const RxPacket &packet, const MeterPayloadView &view);
+  void transmit_downlink();
+  bool downlink_enabled_{false};
+  int8_t downlink_tx_power_{LORA_TX_POWER};
+  DownlinkQueue<LINK_STATS_MAX_NODES> downlink_queue_;
+  DownlinkRequest downlink_request_;
+  std::atomic<bool> downlink_requested_{false};
+  DownlinkMetrics downlink_metrics_;
+  uint16_t config_node_{0};  // Web handler -> loop()
+  ConfigChange config_change_{};
+  std::atomic<bool> config_requested_{false};
+  NodeKeys<LINK_STATS_MAX_NODES> node_keys_;
+  void setup_replay();
+  ESPPreferenceObject replay_prefs_[LINK_STATS_MAX_NODES];
+  MeshtasticChannel meshtastic_;
+  MeshtasticNodes<LINK_STATS_MAX_NODES> meshtastic_nodes_;
+  bool meshtastic_enabled_{false};
   
-  sensor::Sensor *power_sensor_{nullptr};
-  sensor::Sensor *consumption_sensor_{nullptr};
-  sensor::Sensor *generation_sensor_{nullptr};
-  sensor::Sensor *battery_sensor_{nullptr};
-  sensor::Sensor *rssi_sensor_{nullptr};
-  sensor::Sensor *snr_sensor_{nullptr};
-  sensor::Sensor *packet_counter_sensor_{nullptr};
-  sensor::Sensor *missed_packets_sensor_{nullptr};
+  sensor::Sensor *sensors_[CHANNEL_COUNT]{};
+  PublishFilter<CHANNEL_COUNT> publish_filter_;
+  uint32_t force_update_interval_{600000};
   
-  uint32_t last_packet_counter_ = 0;
-  uint32_t missed_packets_ = 0;
   uint32_t last_packet_time_ = 0;
-  bool first_packet_ = true;
+
+  // The sensors show one node, so Home Assistant's energy totals never
+  // jump between meters; /lora/nodes, MQTT and history cover all of them
+  static constexpr uint32_t LINK_REFRESH_MS = 60000;
+  bool shows_node(uint16_t node_id);
+  void update_link_channels(LinkStats &link);
+  void update_channel_load();
+  LinkStatsTable<LINK_STATS_MAX_NODES> link_stats_;
+  uint16_t sensor_node_{0};
+  bool other_node_warned_{false};
+  uint32_t link_refresh_time_{0};
+
+  // Epoch seconds with a time source, uptime seconds otherwise
+  bool history_time(uint32_t &time_s);
+#ifdef USE_TIME
+  time::RealTimeClock *time_{nullptr};
+#endif
+  HistoryStore<HISTORY_MAX_NODES> history_;
+
+  // Readings received while Home Assistant is unreachable, replayed in
+  // order after reconnect: all of them into the history, the newest to
+  // the sensors. Live readings also queue behind a pending replay so Home
+  // Assistant never sees the counters go backwards.
+  static constexpr size_t OUTBOX_REPLAY_BATCH = 2;        // Readings per loop() call
+  static constexpr uint32_t OUTBOX_SETTLE_MS = 5000;      // Let the client subscribe first
+  bool upstream_connected();
+  void setup_outbox();
+  void replay_outbox();
+  void publish_record(const OutboxRecord &record);
+  void restore_history(const OutboxRecord &record);
+  OutboxRecord replay_newest_{};
+  bool replay_pending_{false};
+  size_t outbox_blocks_{16};
+  Outbox outbox_;
+  ESPPreferenceObject outbox_meta_pref_;
+  ESPPreferenceObject *outbox_block_prefs_{nullptr};
+  uint32_t connected_since_{0};
+  bool connected_{false};
+
+  SweepMatrix sweep_matrix_;
+  float sweep_max_per_{10.0f};
+  uint32_t sweep_reported_passes_ = 0;
+  LoRaWebHandler *web_handler_{nullptr};
+  // Everything loop() does but the VZ and MQTT sockets, under report_lock_
+  void process();
+  Mutex report_lock_;
+  VzClient *vz_client_{nullptr};  // Only with a volkszaehler: block
+  MqttSink *mqtt_sink_{nullptr};  // Only with an mqtt: block
   
   // SX1262 registers and commands
   static constexpr uint8_t CMD_SET_STANDBY = 0x80;
   static constexpr uint8_t CMD_SET_RX = 0x82;
+  static constexpr uint8_t CMD_SET_TX = 0x83;
   static constexpr uint8_t CMD_SET_FS = 0x01;
   static constexpr uint8_t CMD_SET_PACKET_TYPE = 0x8A;
   static constexpr uint8_t CMD_SET_RF_FREQUENCY = 0x86;
@@ -73,22 +327,59 @@ class LoRaReceiverComponent : public Component, public spi::SPIDevice<spi::BIT_O
   static constexpr uint8_t CMD_CLEAR_IRQ_STATUS = 0x02;
   static constexpr uint8_t CMD_GET_RX_BUFFER_STATUS = 0x13;
   static constexpr uint8_t CMD_READ_BUFFER = 0x1E;
+  static constexpr uint8_t CMD_WRITE_BUFFER = 0x0E;
   static constexpr uint8_t CMD_GET_PACKET_STATUS = 0x14;
+  static constexpr uint8_t CMD_GET_RSSI_INST = 0x15;
+  static constexpr uint8_t CMD_SET_CAD_PARAMS = 0x88;
+  static constexpr uint8_t CMD_SET_CAD = 0xC5;
   static constexpr uint8_t CMD_SET_REGULATOR_MODE = 0x96;
+  static constexpr uint8_t CMD_SET_PA_CONFIG = 0x95;
+  static constexpr uint8_t CMD_SET_TX_PARAMS = 0x8E;
   static constexpr uint8_t CMD_SET_BUFFER_BASE_ADDRESS = 0x8F;
   static constexpr uint8_t CMD_SET_LORA_SYMB_NUM_TIMEOUT = 0xA0;
-  
+  static constexpr uint8_t CMD_WRITE_REGISTER = 0x0D;
+  static constexpr uint8_t CMD_GET_STATUS = 0xC0;
+  static constexpr uint8_t CMD_CALIBRATE = 0x89;
+  static constexpr uint8_t CMD_CALIBRATE_IMAGE = 0x98;
+  static constexpr uint8_t CMD_SET_DIO2_AS_RF_SWITCH = 0x9D;
+  static constexpr uint8_t CMD_SET_DIO3_AS_TCXO = 0x97;
+
+  static constexpr uint16_t REG_LORA_SYNC_WORD = 0x0740;
+  static constexpr uint16_t REG_RX_GAIN = 0x08AC;
+
+  static constexpr uint8_t STANDBY_RC = 0x00;
   static constexpr uint8_t PACKET_TYPE_LORA = 0x01;
-  static constexpr uint16_t IRQ_RX_DONE = 0x02;
+  static constexpr uint16_t IRQ_TX_DONE = 0x0001;
+  static constexpr uint16_t IRQ_RX_DONE = 0x0002;
+  static constexpr uint16_t IRQ_HEADER_ERR = 0x0020;
+  static constexpr uint16_t IRQ_CRC_ERR = 0x0040;
+  static constexpr uint16_t IRQ_CAD_DONE = 0x0080;
+  static constexpr uint16_t IRQ_CAD_DETECTED = 0x0100;
+  static constexpr uint16_t IRQ_TIMEOUT = 0x0200;
   static constexpr uint16_t IRQ_ALL = 0x3FF;
-  
+
+  static void IRAM_ATTR dio1_isr(LoRaReceiverComponent *arg);
+  static void rx_task(void *arg);
+
   void reset_module();
   void wait_busy();
   void write_command(uint8_t cmd, const uint8_t *data = nullptr, size_t len = 0);
   void read_command(uint8_t cmd, uint8_t *data, size_t len);
+  void write_register(uint16_t address, const uint8_t *data, size_t len);
+  void read_buffer(uint8_t offset, uint8_t *data, size_t len);
+  void write_buffer(uint8_t offset, const uint8_t *data, size_t len);
   bool init_lora();
-  void receive_packet();
+  void set_frequency(uint32_t frequency_hz);
+  void set_modulation(const LoRaProfile &profile);
+  void set_packet_params(uint8_t payload_length);
+  void receive_packet(uint16_t irq, uint32_t irq_us);
   void start_receive();
+  void apply_profile(const LoRaProfile &profile);
+  void request_profile(const LoRaProfile &profile);
+  void publish_meter_data(const MeterPayloadView &view, int16_t rssi, float snr);
+  void publish_mqtt(const MeterPayloadView &view, LinkStats *link, int16_t rssi, float snr);
+  void flush_sensors();
+  void log_sweep_report();
   uint16_t get_irq_status();
   void clear_irq_status(uint16_t irq);
 };
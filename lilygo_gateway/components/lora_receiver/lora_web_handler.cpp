@@ -0,0 +1,496 @@
+#include "lora_web_handler.h"
+#include "lora_receiver.h"
+#include "esphome/core/hal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+namespace esphome {
+namespace lora_receiver {
+
+bool LoRaWebHandler::canHandle(AsyncWebServerRequest *request) {
+  if (request->method() != HTTP_GET && request->method() != HTTP_POST)
+    return false;
+  return request->url() == "/lora/sweep" || request->url() == "/lora/history" || request->url() == "/lora/nodes" ||
+         request->url() == "/lora/config" || request->url() == "/metrics";
+}
+
+static uint32_t arg_u32(AsyncWebServerRequest *request, const char *name, uint32_t fallback) {
+  if (!request->hasParam(name))
+    return fallback;
+  return strtoul(request->arg(name).c_str(), nullptr, 10);
+}
+
+// Comma separated names of flag bits, or "none"; false on an unknown name
+static bool parse_flags(const std::string &list, const char *const names[], const uint8_t bits[], size_t count,
+                        uint8_t &flags) {
+  flags = 0;
+  if (list == "none")
+    return true;
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t end = list.find(',', start);
+    if (end == std::string::npos)
+      end = list.size();
+    std::string name = list.substr(start, end - start);
+    size_t i = 0;
+    while (i < count && name != names[i])
+      i++;
+    if (i == count)
+      return false;
+    flags |= bits[i];
+    start = end + 1;
+  }
+  return true;
+}
+
+static const char *const POLICY_NAMES[] = {"debug", "tx_led", "skip_stale"};
+static const uint8_t POLICY_BITS[] = {CONFIG_POLICY_DEBUG, CONFIG_POLICY_TX_LED, CONFIG_POLICY_SKIP_STALE};
+static const char *const OBIS_NAMES[] = {"16.7.0", "1.8.0", "2.8.0"};
+static const uint8_t OBIS_BITS[] = {CONFIG_OBIS_POWER, CONFIG_OBIS_CONSUMPTION, CONFIG_OBIS_GENERATION};
+
+// GET /lora/nodes             one row per node
+// GET /lora/nodes?node=1A2B   RSSI and SNR histograms of that node
+void LoRaWebHandler::handle_nodes(AsyncWebServerRequest *request) {
+  LockGuard lock(this->parent_->report_lock());
+  LinkStatsTable<LINK_STATS_MAX_NODES> &table = this->parent_->link_stats();
+  uint32_t now = millis();
+  if (!request->hasParam("node")) {
+    AsyncResponseStream *stream = request->beginResponseStream("text/csv");
+    stream->print("node,last_heard_s,last_counter,lost,resets,duplicates,per_1h,per_24h,interval_ms,jitter_ms,"
+                  "rssi_p10,rssi_p50,snr_p10,snr_p50\n");
+    for (size_t i = 0; i < table.node_count(); i++) {
+      LinkStats &link = table.node(i);
+      const SequenceTracker &seq = link.sequence();
+      stream->printf("%04X,%u,%u,%u,%u,%u,%.2f,%.2f,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f\n", table.node_id(i),
+                     (unsigned) ((now - link.last_heard()) / 1000), (unsigned) seq.last(), (unsigned) seq.lost(),
+                     (unsigned) seq.resets(), (unsigned) seq.duplicates(), link.per_1h(now), link.per_24h(now),
+                     link.interval_ms(), link.jitter_ms(), link.rssi().quantile(0.1f), link.rssi().quantile(0.5f),
+                     link.snr().quantile(0.1f), link.snr().quantile(0.5f));
+    }
+    request->send(stream);
+    return;
+  }
+
+  LinkStats *link = table.find(strtoul(request->arg("node").c_str(), nullptr, 16));
+  if (link == nullptr) {
+    request->send(404, "text/plain", "unknown node\n");
+    return;
+  }
+  AsyncResponseStream *stream = request->beginResponseStream("text/csv");
+  stream->print("metric,bin_low,count\n");
+  for (size_t i = 0; i < RssiHistogram::bins(); i++)
+    stream->printf("rssi,%.0f,%u\n", RssiHistogram::bin_low(i), (unsigned) link->rssi().count(i));
+  for (size_t i = 0; i < SnrHistogram::bins(); i++)
+    stream->printf("snr,%.0f,%u\n", SnrHistogram::bin_low(i), (unsigned) link->snr().count(i));
+  request->send(stream);
+}
+
+// Rows per /lora/history request, a day of raw samples at one per minute
+static constexpr size_t HISTORY_QUERY_MAX = 1440;
+// Longest CSV row of either table, newline and terminator included
+static constexpr size_t HISTORY_CSV_ROW_MAX = 80;
+
+// Where a chunked /lora/history response goes on. Samples can share a
+// second, so it counts the rows at from_s that went out already.
+struct HistoryCursor {
+  uint16_t node_id;
+  HistoryResolution resolution;
+  bool binary;
+  uint32_t from_s;
+  uint32_t to_s;
+  size_t sent_at_from;
+  size_t remaining;
+};
+
+// One chunk: as many whole rows as fit into max bytes, queried under the
+// report lock for this chunk only. 0 ends the response.
+static size_t fill_history(LoRaReceiverComponent *parent, HistoryCursor &cursor, uint8_t *buffer, size_t max,
+                           bool first) {
+  bool raw = cursor.resolution == HISTORY_RAW;
+  size_t written = 0;
+  if (first && !cursor.binary) {
+    const char *header = raw ? "time,power_mw,consumption_mwh,generation_mwh\n"
+                             : "start,samples,min_mw,mean_mw,max_mw,consumption_mwh,generation_mwh\n";
+    written = strlen(header);
+    if (written > max)
+      return 0;
+    memcpy(buffer, header, written);
+  }
+  size_t row_size = cursor.binary ? (raw ? sizeof(HistorySample) : sizeof(HistoryRollup)) : HISTORY_CSV_ROW_MAX;
+  size_t rows = std::min((max - written) / row_size, cursor.remaining);
+  if (rows == 0)
+    return written;
+
+  LockGuard lock(parent->report_lock());
+  const NodeHistory *node = parent->history().find(cursor.node_id);
+  size_t skip = cursor.sent_at_from;
+  // false for the rows at from_s an earlier chunk sent
+  auto next = [&cursor, &skip](uint32_t time_s) {
+    if (skip > 0) {
+      skip--;
+      return false;
+    }
+    cursor.sent_at_from = time_s == cursor.from_s ? cursor.sent_at_from + 1 : 1;
+    cursor.from_s = time_s;
+    cursor.remaining--;
+    return true;
+  };
+  // Binary rows are HistorySample (24 B) or HistoryRollup (28 B) as laid out in memory
+  if (raw) {
+    node->query_raw(cursor.from_s, cursor.to_s, rows + skip, [&](const HistorySample &sample) {
+      if (!next(sample.time_s))
+        return;
+      if (cursor.binary) {
+        memcpy(buffer + written, &sample, sizeof(sample));
+        written += sizeof(sample);
+      } else {
+        written += snprintf(reinterpret_cast<char *>(buffer + written), max - written, "%u,%d,%lld,%lld\n",
+                            (unsigned) sample.time_s, (int) sample.power_mw, (long long) sample.consumption_mwh,
+                            (long long) sample.generation_mwh);
+      }
+    });
+  } else {
+    node->query_rollup(cursor.resolution, cursor.from_s, cursor.to_s, rows + skip, [&](const HistoryRollup &rollup) {
+      if (!next(rollup.start_s))
+        return;
+      if (cursor.binary) {
+        memcpy(buffer + written, &rollup, sizeof(rollup));
+        written += sizeof(rollup);
+      } else {
+        written += snprintf(reinterpret_cast<char *>(buffer + written), max - written, "%u,%u,%d,%d,%d,%u,%u\n",
+                            (unsigned) rollup.start_s, (unsigned) rollup.samples, (int) rollup.min_mw,
+                            (int) rollup.mean_mw, (int) rollup.max_mw, (unsigned) rollup.consumption_delta_mwh,
+                            (unsigned) rollup.generation_delta_mwh);
+      }
+    });
+  }
+  return written;
+}
+
+// GET /lora/history                           node list
+// GET /lora/history?node=1A2B&res=15m&from=..&to=..&limit=..&format=csv|bin
+// Rows go out in chunks that each take the report lock while they are
+// read from the ring, so neither the heap nor loop() wait on the client.
+void LoRaWebHandler::handle_history(AsyncWebServerRequest *request) {
+  if (!request->hasParam("node")) {
+    LockGuard lock(this->parent_->report_lock());
+    const HistoryStore<HISTORY_MAX_NODES> &history = this->parent_->history();
+    AsyncResponseStream *stream = request->beginResponseStream("text/csv");
+    stream->print("node,samples,bytes,dropped\n");
+    for (size_t i = 0; i < history.node_count(); i++) {
+      stream->printf("%04X,%u,%u,%u\n", history.node_id(i), (unsigned) history.node(i).raw_size(),
+                     (unsigned) history.node(i).bytes(), (unsigned) history.node(i).dropped());
+    }
+    request->send(stream);
+    return;
+  }
+
+  auto cursor = std::make_shared<HistoryCursor>();
+  cursor->node_id = strtoul(request->arg("node").c_str(), nullptr, 16);
+  {
+    // Nodes keep their history once it exists, so one lookup will do
+    LockGuard lock(this->parent_->report_lock());
+    if (this->parent_->history().find(cursor->node_id) == nullptr) {
+      request->send(404, "text/plain", "unknown node\n");
+      return;
+    }
+  }
+  cursor->resolution = HISTORY_RAW;
+  if (request->hasParam("res")) {
+    std::string res = request->arg("res").c_str();
+    if (res == "1m") {
+      cursor->resolution = HISTORY_1MIN;
+    } else if (res == "15m") {
+      cursor->resolution = HISTORY_15MIN;
+    } else if (res != "raw") {
+      request->send(400, "text/plain", "res must be raw, 1m or 15m\n");
+      return;
+    }
+  }
+  cursor->from_s = arg_u32(request, "from", 0);
+  cursor->to_s = arg_u32(request, "to", UINT32_MAX);
+  cursor->sent_at_from = 0;
+  cursor->remaining = std::min<size_t>(arg_u32(request, "limit", HISTORY_QUERY_MAX), HISTORY_QUERY_MAX);
+  cursor->binary = request->hasParam("format") && request->arg("format") == "bin";
+
+  LoRaReceiverComponent *parent = this->parent_;
+  request->send(request->beginChunkedResponse(
+      cursor->binary ? "application/octet-stream" : "text/csv",
+      [parent, cursor](uint8_t *buffer, size_t max, size_t index) -> size_t {
+        return fill_history(parent, *cursor, buffer, max, index == 0);
+      }));
+}
+
+// GET  /lora/config   queued changes per node; unset fields are empty,
+//                     policy and obis are CONFIG_POLICY_* / CONFIG_OBIS_* bits in hex
+// POST /lora/config?node=1A2B&interval=300&tx_power=14&sf=9&policy=tx_led,skip_stale&obis=1.8.0,2.8.0
+// Fields left out keep their value on the node; policy and obis replace
+// the whole set ("none" clears it). The change goes out after the
+// node's next uplink.
+void LoRaWebHandler::handle_config(AsyncWebServerRequest *request) {
+  if (!this->parent_->downlink_enabled()) {
+    request->send(400, "text/plain", "downlink: is not configured\n");
+    return;
+  }
+  if (request->method() == HTTP_GET) {
+    LockGuard lock(this->parent_->report_lock());
+    const DownlinkQueue<LINK_STATS_MAX_NODES> &queue = this->parent_->downlink_queue();
+    uint32_t now = millis();
+    AsyncResponseStream *stream = request->beginResponseStream("text/csv");
+    stream->print("node,state,sequence,attempts,age_s,interval_s,tx_power,sf,policy,obis\n");
+    for (size_t i = 0; i < queue.node_count(); i++) {
+      const NodeDownlink &node = queue.node(i);
+      const ConfigChange &change = node.change;
+      stream->printf("%04X,%s,%u,%u,%u,", queue.node_id(i), downlink_state_name(node.state), node.sequence,
+                     node.attempts, (unsigned) ((now - node.updated_ms) / 1000));
+      if (change.fields & CONFIG_FIELD_INTERVAL)
+        stream->printf("%u", change.interval_s);
+      stream->print(",");
+      if (change.fields & CONFIG_FIELD_TX_POWER)
+        stream->printf("%d", change.tx_power);
+      stream->print(",");
+      if (change.fields & CONFIG_FIELD_SF)
+        stream->printf("%u", change.spreading_factor);
+      stream->print(",");
+      if (change.fields & CONFIG_FIELD_POLICY)
+        stream->printf("%02X", change.policy);
+      stream->print(",");
+      if (change.fields & CONFIG_FIELD_OBIS)
+        stream->printf("%02X", change.obis);
+      stream->print("\n");
+    }
+    request->send(stream);
+    return;
+  }
+
+  if (!request->hasParam("node")) {
+    request->send(400, "text/plain", "node is required\n");
+    return;
+  }
+  uint16_t node_id = strtoul(request->arg("node").c_str(), nullptr, 16);
+  if (!this->parent_->has_node_key(node_id)) {
+    request->send(404, "text/plain", "no key for that node in node_keys\n");
+    return;
+  }
+  ConfigChange change{};
+  bool valid = true;
+  if (request->hasParam("interval")) {
+    uint32_t interval_s = arg_u32(request, "interval", 0);
+    change.fields |= CONFIG_FIELD_INTERVAL;
+    change.interval_s = interval_s;
+    valid = valid && interval_s <= UINT16_MAX;
+  }
+  if (request->hasParam("tx_power")) {
+    long tx_power = strtol(request->arg("tx_power").c_str(), nullptr, 10);
+    change.fields |= CONFIG_FIELD_TX_POWER;
+    change.tx_power = tx_power;
+    valid = valid && tx_power >= CONFIG_TX_POWER_MIN && tx_power <= CONFIG_TX_POWER_MAX;
+  }
+  if (request->hasParam("sf")) {
+    uint32_t spreading_factor = arg_u32(request, "sf", 0);
+    change.fields |= CONFIG_FIELD_SF;
+    change.spreading_factor = spreading_factor;
+    valid = valid && spreading_factor <= UINT8_MAX;
+  }
+  if (request->hasParam("policy")) {
+    change.fields |= CONFIG_FIELD_POLICY;
+    valid = valid && parse_flags(request->arg("policy").c_str(), POLICY_NAMES, POLICY_BITS, 3, change.policy);
+  }
+  if (request->hasParam("obis")) {
+    change.fields |= CONFIG_FIELD_OBIS;
+    valid = valid && parse_flags(request->arg("obis").c_str(), OBIS_NAMES, OBIS_BITS, 3, change.obis);
+  }
+  if (!valid || !configChangeValid(change)) {
+    request->send(400, "text/plain",
+                  "invalid change: interval >= 10 s, tx_power -9..22, sf 7..12, policy debug,tx_led,skip_stale, "
+                  "obis 16.7.0,1.8.0,2.8.0\n");
+    return;
+  }
+  // A node moved to an SF the gateway does not listen on is lost for good
+  if ((change.fields & CONFIG_FIELD_SF) && !this->parent_->listens_on(change.spreading_factor)) {
+    request->send(400, "text/plain", "gateway does not listen on that SF, add a scan profile first\n");
+    return;
+  }
+  if (!this->parent_->request_config(node_id, change)) {
+    request->send(503, "text/plain", "previous change not picked up yet, retry\n");
+    return;
+  }
+  request->send(202, "text/plain", "queued\n");
+}
+
+// GET /metrics                      Prometheus text format 0.0.4
+// GET /metrics?format=openmetrics   OpenMetrics 1.0
+// Counters only ever grow until reboot; Prometheus handles the reset.
+void LoRaWebHandler::handle_metrics(AsyncWebServerRequest *request) {
+  MetricsFormat format = METRICS_PROMETHEUS;
+  if (request->hasParam("format")) {
+    if (request->arg("format") == "openmetrics") {
+      format = METRICS_OPENMETRICS;
+    } else if (request->arg("format") != "prometheus") {
+      request->send(400, "text/plain", "format must be prometheus or openmetrics\n");
+      return;
+    }
+  }
+  LockGuard lock(this->parent_->report_lock());
+  const RxMetrics &rx = this->parent_->rx_metrics();
+  const PacketQueue<RX_QUEUE_SLOTS> &queue = this->parent_->rx_queue();
+  AsyncResponseStream *stream = request->beginResponseStream(metrics_content_type(format));
+  MetricsWriter<AsyncResponseStream> out(*stream, format);
+
+  out.family("lora_packets_received", "counter", "Frames read from the radio and queued for decoding");
+  out.counter("lora_packets_received", rx.packets.value());
+  out.family("lora_crc_errors", "counter", "Frames dropped by the radio with a CRC or header error");
+  out.counter("lora_crc_errors", rx.crc_errors.value());
+  out.family("lora_decode_errors", "counter", "Frames of an unknown schema or version, or malformed");
+  out.counter("lora_decode_errors", rx.decode_errors.value());
+  const auto &payloads = this->parent_->payloads();
+  char schema_labels[32];
+  out.family("lora_frames", "counter", "Frames handed to the decoder of their schema");
+  for (size_t i = 0; i < payloads.count(); i++) {
+    snprintf(schema_labels, sizeof(schema_labels), "schema=\"%s\"", payloads.name(i));
+    out.counter("lora_frames", payloads.stats(i).frames.value(), schema_labels);
+  }
+  out.family("lora_frame_errors", "counter", "Frames their decoder refused, including auth errors");
+  for (size_t i = 0; i < payloads.count(); i++) {
+    snprintf(schema_labels, sizeof(schema_labels), "schema=\"%s\"", payloads.name(i));
+    out.counter("lora_frame_errors", payloads.stats(i).errors.value(), schema_labels);
+  }
+  out.family("lora_frames_rejected", "counter", "Frames of a schema or version this gateway has no decoder for");
+  out.counter("lora_frames_rejected", payloads.rejected());
+  out.family("lora_auth_errors", "counter", "Frames refused: bad tag, replayed counter, unknown key or unsigned");
+  out.counter("lora_auth_errors", rx.auth_errors.value());
+  out.family("lora_rx_queue_dropped", "counter", "Frames lost because the RX queue was full");
+  out.counter("lora_rx_queue_dropped", queue.dropped());
+  out.family("lora_rx_queue_depth", "gauge", "Frames waiting for the main loop");
+  out.gauge("lora_rx_queue_depth", queue.size());
+  out.family("lora_rx_queue_high_water", "gauge", "Deepest the RX queue has been since boot");
+  out.gauge("lora_rx_queue_high_water", queue.high_water());
+  out.family("lora_rx_queue_capacity", "gauge", "Slots of the RX queue");
+  out.gauge("lora_rx_queue_capacity", queue.capacity());
+
+  LinkStatsTable<LINK_STATS_MAX_NODES> &table = this->parent_->link_stats();
+  char labels[16];
+  out.family("lora_node_lost", "counter", "Packets missing from the counter sequence of a node");
+  for (size_t i = 0; i < table.node_count(); i++) {
+    snprintf(labels, sizeof(labels), "node=\"%04X\"", table.node_id(i));
+    out.counter("lora_node_lost", table.node(i).sequence().lost(), labels);
+  }
+  out.family("lora_node_duplicates", "counter", "Packets of a node received twice");
+  for (size_t i = 0; i < table.node_count(); i++) {
+    snprintf(labels, sizeof(labels), "node=\"%04X\"", table.node_id(i));
+    out.counter("lora_node_duplicates", table.node(i).sequence().duplicates(), labels);
+  }
+  out.family("lora_node_resets", "counter", "Counter restarts of a node, usually a reboot");
+  for (size_t i = 0; i < table.node_count(); i++) {
+    snprintf(labels, sizeof(labels), "node=\"%04X\"", table.node_id(i));
+    out.counter("lora_node_resets", table.node(i).sequence().resets(), labels);
+  }
+  uint32_t now = millis();
+  out.family("lora_node_last_heard_seconds", "gauge", "Seconds since the last packet of a node");
+  for (size_t i = 0; i < table.node_count(); i++) {
+    snprintf(labels, sizeof(labels), "node=\"%04X\"", table.node_id(i));
+    out.gauge("lora_node_last_heard_seconds", (now - table.node(i).last_heard()) / 1000.0f, labels);
+  }
+
+  const ChannelMonitor &channel = this->parent_->channel_monitor();
+  const ChannelSummary windows[2] = {channel.minute(), channel.hour()};
+  const char *window_labels[2] = {"window=\"1m\"", "window=\"1h\""};
+  out.family("lora_channel_utilization_ratio", "gauge", "Share of time decoded packets were on air");
+  for (size_t w = 0; w < 2; w++)
+    out.gauge("lora_channel_utilization_ratio", windows[w].utilization / 100.0f, window_labels[w]);
+  out.family("lora_channel_foreign_ratio", "gauge", "Share of RSSI samples busy beyond the decoded packets");
+  for (size_t w = 0; w < 2; w++)
+    out.gauge("lora_channel_foreign_ratio", windows[w].foreign / 100.0f, window_labels[w]);
+  out.family("lora_channel_noise_floor_dbm", "gauge", "10th percentile of the instantaneous RSSI");
+  for (size_t w = 0; w < 2; w++) {
+    if (!std::isnan(windows[w].noise_floor))
+      out.gauge("lora_channel_noise_floor_dbm", windows[w].noise_floor, window_labels[w]);
+  }
+  out.family("lora_channel_collision_probability", "gauge", "Pure ALOHA chance that a packet overlaps another");
+  for (size_t w = 0; w < 2; w++)
+    out.gauge("lora_channel_collision_probability", windows[w].collision_probability / 100.0f, window_labels[w]);
+
+  const CadScanner<MAX_SCAN_PROFILES> &scanner = this->parent_->scanner();
+  if (this->parent_->scanning()) {
+    static const char *const SCAN_FAMILIES[4][2] = {
+        {"lora_scan_cads", "Channel activity detections run on a scan profile"},
+        {"lora_scan_detections", "CADs that found a preamble"},
+        {"lora_scan_packets", "Packets received after a detection"},
+        {"lora_scan_timeouts", "Detections without a packet header"},
+    };
+    char scan_labels[48];
+    for (size_t f = 0; f < 4; f++) {
+      out.family(SCAN_FAMILIES[f][0], "counter", SCAN_FAMILIES[f][1]);
+      for (size_t i = 0; i < scanner.count(); i++) {
+        const ScanProfile &scan = scanner.profile(i);
+        const ScanStats &stats = scanner.stats(i);
+        const MetricCounter *counters[4] = {&stats.cads, &stats.detections, &stats.packets, &stats.timeouts};
+        snprintf(scan_labels, sizeof(scan_labels), "frequency=\"%u\",sf=\"%u\",bw=\"%u\"",
+                 (unsigned) scan.frequency_hz, scan.profile.spreading_factor,
+                 (unsigned) loraBandwidthHz(scan.profile.bandwidth));
+        out.counter(SCAN_FAMILIES[f][0], counters[f]->value(), scan_labels);
+      }
+    }
+  }
+
+  if (this->parent_->downlink_enabled()) {
+    const DownlinkMetrics &downlink = this->parent_->downlink_metrics();
+    out.family("lora_downlinks_sent", "counter", "Config downlinks sent into a node's receive window");
+    out.counter("lora_downlinks_sent", downlink.sent.value());
+    out.family("lora_downlinks_late", "counter", "Config downlinks dropped because the receive window had passed");
+    out.counter("lora_downlinks_late", downlink.late.value());
+    out.family("lora_config_acks", "counter", "Authenticated config acks received from nodes");
+    out.counter("lora_config_acks", downlink.acks.value());
+    out.family("lora_config_pending", "gauge", "Nodes with a config change not yet acknowledged");
+    out.gauge("lora_config_pending", this->parent_->downlink_queue().pending());
+  }
+
+  out.histogram("lora_irq_to_queue_seconds", "DIO1 interrupt to the frame queued by the RX task", rx.irq_to_queue);
+  out.histogram("lora_irq_to_publish_seconds", "DIO1 interrupt to the frame decoded and published by the main loop",
+                rx.irq_to_publish);
+  out.finish();
+  request->send(stream);
+}
+
+void LoRaWebHandler::handleRequest(AsyncWebServerRequest *request) {
+  if (request->url() == "/lora/sweep") {
+    // POST clears the matrix before a new measurement at another site
+    if (request->method() == HTTP_POST) {
+      this->parent_->clear_sweep_matrix();
+      request->send(200, "text/plain", "cleared\n");
+      return;
+    }
+    std::string csv;
+    {
+      LockGuard lock(this->parent_->report_lock());
+      csv = this->parent_->sweep_matrix().to_csv();
+    }
+    request->send(200, "text/csv", csv.c_str());
+    return;
+  }
+  if (request->url() == "/lora/nodes" && request->method() == HTTP_GET) {
+    this->handle_nodes(request);
+    return;
+  }
+  if (request->url() == "/lora/history" && request->method() == HTTP_GET) {
+    this->handle_history(request);
+    return;
+  }
+  if (request->url() == "/lora/config") {
+    this->handle_config(request);
+    return;
+  }
+  if (request->url() == "/metrics" && request->method() == HTTP_GET) {
+    this->handle_metrics(request);
+    return;
+  }
+  request->send(404);
+}
+
+}  // namespace lora_receiver
+}  // namespace esphome
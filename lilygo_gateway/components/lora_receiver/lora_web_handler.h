@@ -0,0 +1,31 @@
+#pragma once
+
+#include "esphome/components/web_server_base/web_server_base.h"
+
+namespace esphome {
+namespace lora_receiver {
+
+class LoRaReceiverComponent;
+
+// Gateway reports and node config under /lora/ and Prometheus metrics on
+// /metrics, on the ESPHome web server port. Requests run on the AsyncTCP
+// task and read the component's tables under its report_lock().
+class LoRaWebHandler : public AsyncWebHandler {
+ public:
+  explicit LoRaWebHandler(LoRaReceiverComponent *parent) : parent_(parent) {}
+
+  bool canHandle(AsyncWebServerRequest *request) override;
+  void handleRequest(AsyncWebServerRequest *request) override;
+  bool isRequestHandlerTrivial() override { return true; }
+
+ protected:
+  void handle_nodes(AsyncWebServerRequest *request);
+  void handle_history(AsyncWebServerRequest *request);
+  void handle_config(AsyncWebServerRequest *request);
+  void handle_metrics(AsyncWebServerRequest *request);
+
+  LoRaReceiverComponent *parent_;
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
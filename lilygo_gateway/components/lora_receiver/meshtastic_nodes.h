@@ -0,0 +1,64 @@
+#pragma once
+
+// Meshtastic senders whose telemetry is taken as meter readings. On a
+// public channel every INA219/INA260 node sends PowerMetrics too, so
+// only listed 32-bit node numbers get through, each mapped to the 16-bit
+// node id that link stats, history and node_keys know it by. The sender
+// is in the clear header, so foreign traffic is dropped before it is
+// decrypted.
+// Filled from the config before setup(), read by the main loop.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "meshtastic_telemetry.h"
+
+namespace esphome {
+namespace lora_receiver {
+
+template<size_t MaxNodes> class MeshtasticNodes {
+ public:
+  // false when the table is full or node_id belongs to another sender
+  bool add(uint32_t num, uint16_t node_id) {
+    for (size_t i = 0; i < this->count_; i++) {
+      if (this->entries_[i].node_id == node_id && this->entries_[i].num != num)
+        return false;
+      if (this->entries_[i].num == num) {
+        this->entries_[i].node_id = node_id;
+        return true;
+      }
+    }
+    if (this->count_ >= MaxNodes)
+      return false;
+    this->entries_[this->count_++] = {num, node_id};
+    return true;
+  }
+
+  // Node id of the sender of frame; PAYLOAD_UNKNOWN_NODE when unlisted
+  PayloadStatus lookup(const uint8_t *frame, size_t length, uint16_t &node_id) const {
+    if (length <= MESHTASTIC_HEADER_SIZE)
+      return PAYLOAD_TOO_SHORT;
+    uint32_t num = meshtasticSender(frame);
+    for (size_t i = 0; i < this->count_; i++) {
+      if (this->entries_[i].num == num) {
+        node_id = this->entries_[i].node_id;
+        return PAYLOAD_OK;
+      }
+    }
+    return PAYLOAD_UNKNOWN_NODE;
+  }
+
+  size_t count() const { return this->count_; }
+
+ protected:
+  struct Entry {
+    uint32_t num;
+    uint16_t node_id;
+  };
+
+  Entry entries_[MaxNodes];
+  size_t count_{0};
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
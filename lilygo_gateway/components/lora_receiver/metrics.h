@@ -0,0 +1,150 @@
+#pragma once
+
+// Gateway counters and hot-path latency histograms, exposed as Prometheus
+// text (version 0.0.4) or OpenMetrics 1.0 on GET /metrics.
+// Every counter and histogram has exactly one writer (RX task or loop()),
+// so updates are a relaxed load and store, no locks and no
+// read-modify-write; a scrape from the web server task only reads.
+// MetricCounter also counts frames per schema in payload_registry.h, so
+// the host gateway builds this file too.
+
+#include <atomic>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace esphome {
+namespace lora_receiver {
+
+// Upper bucket bounds in µs; a last +Inf bucket catches the rest
+static constexpr uint32_t LATENCY_BOUNDS_US[] = {100,   250,   500,    1000,   2500,   5000,   10000,
+                                                 25000, 50000, 100000, 250000, 500000, 1000000};
+static constexpr size_t LATENCY_BUCKETS = sizeof(LATENCY_BOUNDS_US) / sizeof(LATENCY_BOUNDS_US[0]) + 1;
+
+// Single-writer counter, safe to read from any task
+class MetricCounter {
+ public:
+  void inc() { this->value_.store(this->value_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+  uint32_t value() const { return this->value_.load(std::memory_order_relaxed); }
+
+ protected:
+  std::atomic<uint32_t> value_{0};
+};
+
+// Fixed buckets, single writer. The count is the sum of the buckets, so a
+// scrape between two stores never shows a +Inf bucket above the count.
+// The µs sum wraps after 71 minutes of accumulated latency, which
+// Prometheus reads as a counter reset.
+class LatencyHistogram {
+ public:
+  void observe(uint32_t us) {
+    size_t i = 0;
+    while (i < LATENCY_BUCKETS - 1 && us > LATENCY_BOUNDS_US[i])
+      i++;
+    this->buckets_[i].inc();
+    this->sum_us_.store(this->sum_us_.load(std::memory_order_relaxed) + us, std::memory_order_relaxed);
+  }
+
+  // Not cumulative
+  uint32_t bucket(size_t i) const { return this->buckets_[i].value(); }
+  uint32_t sum_us() const { return this->sum_us_.load(std::memory_order_relaxed); }
+
+ protected:
+  MetricCounter buckets_[LATENCY_BUCKETS];
+  std::atomic<uint32_t> sum_us_{0};
+};
+
+// RX path counters of the gateway, writer of each in brackets
+struct RxMetrics {
+  MetricCounter packets;        // Frames queued for loop() [RX task]
+  MetricCounter crc_errors;     // CRC or header errors [RX task]
+  MetricCounter decode_errors;  // Unknown schema or version, malformed frame [loop()]
+  MetricCounter auth_errors;    // Bad tag, unknown key, ..., unlisted Meshtastic sender [loop()]
+  LatencyHistogram irq_to_queue;    // DIO1 edge to the slot committed [RX task]
+  LatencyHistogram irq_to_publish;  // DIO1 edge to handle_packet() done [loop()]
+};
+
+// Config downlink counters, writer of each in brackets
+struct DownlinkMetrics {
+  MetricCounter sent;  // Frames on air in a node's receive window [RX task]
+  MetricCounter late;  // Window already closed when the RX task got the frame [RX task]
+  MetricCounter acks;  // Verified acks from nodes [loop()]
+};
+
+enum MetricsFormat : uint8_t {
+  METRICS_PROMETHEUS,
+  METRICS_OPENMETRICS,
+};
+
+inline const char *metrics_content_type(MetricsFormat format) {
+  return format == METRICS_OPENMETRICS ? "application/openmetrics-text; version=1.0.0; charset=utf-8"
+                                       : "text/plain; version=0.0.4; charset=utf-8";
+}
+
+// Writes families to anything with print(const char *). Counter names are
+// given without _total: OpenMetrics adds it to the samples only, the
+// Prometheus format to the family as well.
+template<typename Out> class MetricsWriter {
+ public:
+  MetricsWriter(Out &out, MetricsFormat format) : out_(out), format_(format) {}
+
+  void family(const char *name, const char *type, const char *help) {
+    const char *suffix = this->format_ == METRICS_PROMETHEUS && type[0] == 'c' ? "_total" : "";
+    this->printf("# HELP %s%s %s\n# TYPE %s%s %s\n", name, suffix, help, name, suffix, type);
+  }
+
+  // labels like node="1A2B", or nullptr
+  void counter(const char *name, uint32_t value, const char *labels = nullptr) {
+    this->sample(name, "_total", labels);
+    this->printf(" %u\n", (unsigned) value);
+  }
+  void gauge(const char *name, float value, const char *labels = nullptr) {
+    this->sample(name, "", labels);
+    this->printf(" %g\n", value);
+  }
+
+  // Whole family; buckets in seconds as Prometheus expects
+  void histogram(const char *name, const char *help, const LatencyHistogram &histogram) {
+    this->family(name, "histogram", help);
+    uint32_t cumulative = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+      cumulative += histogram.bucket(i);
+      if (i < LATENCY_BUCKETS - 1) {
+        this->printf("%s_bucket{le=\"%g\"} %u\n", name, LATENCY_BOUNDS_US[i] / 1e6, (unsigned) cumulative);
+      } else {
+        this->printf("%s_bucket{le=\"+Inf\"} %u\n", name, (unsigned) cumulative);
+      }
+    }
+    this->printf("%s_sum %.6f\n%s_count %u\n", name, histogram.sum_us() / 1e6, name, (unsigned) cumulative);
+  }
+
+  void finish() {
+    if (this->format_ == METRICS_OPENMETRICS)
+      this->out_.print("# EOF\n");
+  }
+
+ protected:
+  void sample(const char *name, const char *suffix, const char *labels) {
+    if (labels != nullptr) {
+      this->printf("%s%s{%s}", name, suffix, labels);
+    } else {
+      this->printf("%s%s", name, suffix);
+    }
+  }
+
+  void printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+    char line[160];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    this->out_.print(line);
+  }
+
+  Out &out_;
+  MetricsFormat format_;
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
@@ -0,0 +1,230 @@
+#pragma once
+
+// MQTT 3.1.1 packets for the gateway outputs: CONNECT, PUBLISH with QoS
+// 0 or 1, PINGREQ, and an inflight window for QoS 1 publishes awaiting
+// their PUBACK. Only what a publisher needs; the caller owns the socket.
+// Shared by the ESP32 sink (mqtt_sink.h) and the host gateway
+// (host/mqtt_client.h).
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace esphome {
+namespace lora_receiver {
+
+enum MqttPacketType : uint8_t {
+  MQTT_CONNECT = 1,
+  MQTT_CONNACK = 2,
+  MQTT_PUBLISH = 3,
+  MQTT_PUBACK = 4,
+  MQTT_PINGREQ = 12,
+  MQTT_PINGRESP = 13,
+};
+
+static constexpr uint8_t MQTT_DUP = 0x08;  // Set in byte 0 of a resent PUBLISH
+
+// Fixed header with the remaining length; returns its size
+inline size_t mqtt_fixed_header(uint8_t *out, uint8_t header, size_t remaining) {
+  size_t n = 0;
+  out[n++] = header;
+  do {
+    uint8_t byte = remaining & 0x7F;
+    remaining >>= 7;
+    out[n++] = remaining ? byte | 0x80 : byte;
+  } while (remaining);
+  return n;
+}
+
+inline size_t mqtt_string(uint8_t *out, const char *value, size_t len) {
+  out[0] = len >> 8;
+  out[1] = len & 0xFF;
+  memcpy(out + 2, value, len);
+  return 2 + len;
+}
+
+// Clean session; user and password may be null. Returns the packet
+// length, 0 when out_size is too small.
+inline size_t mqtt_connect(uint8_t *out, size_t out_size, const char *client_id, uint16_t keepalive_s,
+                           const char *user = nullptr, const char *password = nullptr) {
+  size_t id_len = strlen(client_id);
+  size_t user_len = user != nullptr ? strlen(user) : 0;
+  size_t password_len = password != nullptr ? strlen(password) : 0;
+  size_t remaining = 10 + 2 + id_len + (user != nullptr ? 2 + user_len : 0) + (password != nullptr ? 2 + password_len : 0);
+  if (remaining + 5 > out_size)
+    return 0;
+  uint8_t flags = 0x02;
+  if (user != nullptr)
+    flags |= 0x80;
+  if (password != nullptr)
+    flags |= 0x40;
+  size_t n = mqtt_fixed_header(out, MQTT_CONNECT << 4, remaining);
+  n += mqtt_string(out + n, "MQTT", 4);
+  out[n++] = 4;  // Protocol level 3.1.1
+  out[n++] = flags;
+  out[n++] = keepalive_s >> 8;
+  out[n++] = keepalive_s & 0xFF;
+  n += mqtt_string(out + n, client_id, id_len);
+  if (user != nullptr)
+    n += mqtt_string(out + n, user, user_len);
+  if (password != nullptr)
+    n += mqtt_string(out + n, password, password_len);
+  return n;
+}
+
+// packet_id only goes out with qos 1. Returns the packet length, 0 when
+// out_size is too small.
+inline size_t mqtt_publish(uint8_t *out, size_t out_size, const char *topic, const uint8_t *payload, size_t len,
+                           uint8_t qos, bool retain, uint16_t packet_id) {
+  size_t topic_len = strlen(topic);
+  size_t remaining = 2 + topic_len + (qos > 0 ? 2 : 0) + len;
+  if (remaining + 5 > out_size)
+    return 0;
+  uint8_t header = (MQTT_PUBLISH << 4) | (qos > 0 ? 0x02 : 0x00) | (retain ? 0x01 : 0x00);
+  size_t n = mqtt_fixed_header(out, header, remaining);
+  n += mqtt_string(out + n, topic, topic_len);
+  if (qos > 0) {
+    out[n++] = packet_id >> 8;
+    out[n++] = packet_id & 0xFF;
+  }
+  memcpy(out + n, payload, len);
+  return n + len;
+}
+
+inline size_t mqtt_pingreq(uint8_t *out) {
+  out[0] = MQTT_PINGREQ << 4;
+  out[1] = 0;
+  return 2;
+}
+
+struct MqttPacket {
+  uint8_t type;
+  uint8_t flags;
+  const uint8_t *body;
+  size_t body_len;
+};
+
+// First packet in data. Returns its total length, 0 while incomplete,
+// -1 when the remaining length is malformed.
+inline int mqtt_parse(const uint8_t *data, size_t len, MqttPacket &packet) {
+  size_t remaining = 0;
+  size_t pos = 1;
+  for (uint8_t shift = 0;; shift += 7) {
+    if (pos >= len)
+      return 0;
+    if (shift > 21)
+      return -1;
+    uint8_t byte = data[pos++];
+    remaining |= (size_t) (byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      break;
+  }
+  if (len < pos + remaining)
+    return 0;
+  packet.type = data[0] >> 4;
+  packet.flags = data[0] & 0x0F;
+  packet.body = data + pos;
+  packet.body_len = remaining;
+  return pos + remaining;
+}
+
+// QoS 1 publishes sent but not acknowledged, as encoded packets so they
+// can be resent unchanged (with DUP) after a reconnect
+template<size_t Slots, size_t SlotSize> class MqttInflight {
+ public:
+  // Packet id for the next publish; never 0 and never one still in flight
+  uint16_t next_id() {
+    do {
+      this->last_id_++;
+    } while (this->last_id_ == 0 || this->find(this->last_id_) >= 0);
+    return this->last_id_;
+  }
+
+  // Limit below Slots, e.g. from the config; at least one
+  void set_window(size_t window) { this->window_ = window < 1 ? 1 : (window > Slots ? Slots : window); }
+  bool full() const { return this->count_ >= this->window_; }
+  size_t size() const { return this->count_; }
+  size_t window() const { return this->window_; }
+
+  // False when the window is full or the packet does not fit a slot
+  bool add(uint16_t packet_id, const uint8_t *packet, size_t len) {
+    if (this->full() || len > SlotSize)
+      return false;
+    for (size_t i = 0; i < Slots; i++) {
+      Slot &slot = this->slots_[i];
+      if (slot.packet_id != 0)
+        continue;
+      slot.packet_id = packet_id;
+      slot.len = len;
+      slot.sequence = this->sequence_++;
+      memcpy(slot.data, packet, len);
+      this->count_++;
+      return true;
+    }
+    return false;
+  }
+
+  // PUBACK body; false for an id not in flight
+  bool ack(const MqttPacket &puback) {
+    if (puback.type != MQTT_PUBACK || puback.body_len < 2)
+      return false;
+    int index = this->find((puback.body[0] << 8) | puback.body[1]);
+    if (index < 0)
+      return false;
+    this->slots_[index].packet_id = 0;
+    this->count_--;
+    return true;
+  }
+
+  // Resend everything in send order after a reconnect, marked as DUP
+  template<typename Send> void resend(Send send) {
+    size_t order[Slots];
+    size_t n = 0;
+    for (size_t i = 0; i < Slots; i++) {
+      if (this->slots_[i].packet_id == 0)
+        continue;
+      size_t j = n++;
+      while (j > 0 && (int32_t) (this->slots_[order[j - 1]].sequence - this->slots_[i].sequence) > 0) {
+        order[j] = order[j - 1];
+        j--;
+      }
+      order[j] = i;
+    }
+    for (size_t k = 0; k < n; k++) {
+      Slot &slot = this->slots_[order[k]];
+      slot.data[0] |= MQTT_DUP;
+      send(slot.data, slot.len);
+    }
+  }
+
+  void clear() {
+    for (size_t i = 0; i < Slots; i++)
+      this->slots_[i].packet_id = 0;
+    this->count_ = 0;
+  }
+
+ protected:
+  struct Slot {
+    uint16_t packet_id{0};  // 0: free
+    uint16_t len{0};
+    uint32_t sequence{0};
+    uint8_t data[SlotSize];
+  };
+
+  int find(uint16_t packet_id) const {
+    for (size_t i = 0; i < Slots; i++) {
+      if (this->slots_[i].packet_id == packet_id)
+        return i;
+    }
+    return -1;
+  }
+
+  Slot slots_[Slots];
+  size_t count_{0};
+  size_t window_{Slots};
+  uint16_t last_id_{0};
+  uint32_t sequence_{0};
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
@@ -0,0 +1,261 @@
+#include "mqtt_sink.h"
+#include "esphome/core/log.h"
+#include "esphome/core/hal.h"
+#include "esphome/components/network/util.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <lwip/netdb.h>
+#include <lwip/sockets.h>
+#include <unistd.h>
+
+namespace esphome {
+namespace lora_receiver {
+
+static const char *TAG = "lora_receiver.mqtt";
+
+void MqttSink::publish(const MeterReading &reading) {
+  if (this->queue_count_ == QUEUE_SIZE) {
+    this->queue_head_ = (this->queue_head_ + 1) % QUEUE_SIZE;
+    this->queue_count_--;
+    this->dropped_++;
+  }
+  this->queue_[(this->queue_head_ + this->queue_count_) % QUEUE_SIZE] = reading;
+  this->queue_count_++;
+  if (this->state_ == CONNECTED)
+    this->send_queued();
+}
+
+void MqttSink::loop() {
+  uint32_t now = millis();
+  switch (this->state_) {
+    case DISCONNECTED:
+      if ((int32_t) (now - this->retry_at_) >= 0 && network::is_connected())
+        this->connect();
+      return;
+    case CONNECTING: {
+      fd_set writable;
+      FD_ZERO(&writable);
+      FD_SET(this->fd_, &writable);
+      struct timeval poll = {0, 0};
+      if (select(this->fd_ + 1, nullptr, &writable, nullptr, &poll) > 0) {
+        int error = 0;
+        socklen_t len = sizeof(error);
+        getsockopt(this->fd_, SOL_SOCKET, SO_ERROR, &error, &len);
+        if (error != 0) {
+          ESP_LOGW(TAG, "Connecting to %s:%u failed: %d", this->host_.c_str(), this->port_, error);
+          this->address_ = 0;
+          this->drop();
+          return;
+        }
+        uint8_t packet[256];
+        size_t connect_len =
+            mqtt_connect(packet, sizeof(packet), this->client_id_.c_str(), KEEPALIVE_S,
+                         this->username_.empty() ? nullptr : this->username_.c_str(),
+                         this->username_.empty() ? nullptr : this->password_.c_str());
+        if (connect_len == 0 || !this->append(packet, connect_len)) {
+          this->drop();
+          return;
+        }
+        this->state_ = WAIT_CONNACK;
+      }
+      break;
+    }
+    case WAIT_CONNACK:
+    case CONNECTED:
+      this->receive();
+      break;
+  }
+  if (this->state_ == DISCONNECTED)
+    return;
+  this->flush();
+  // A QoS 0 stream gets no answers, so the ping also proves the broker is alive
+  if (this->state_ == CONNECTED && !this->ping_pending_ &&
+      (now - this->last_send_ >= KEEPALIVE_S * 500u || now - this->last_receive_ >= KEEPALIVE_S * 500u)) {
+    uint8_t ping[2];
+    if (this->append(ping, mqtt_pingreq(ping))) {
+      this->ping_pending_ = true;
+      this->flush();
+    }
+  }
+  if (this->state_ != DISCONNECTED && (int32_t) (millis() - this->deadline_) >= 0) {
+    ESP_LOGW(TAG, "No answer from %s", this->host_.c_str());
+    this->drop();
+  }
+}
+
+// getaddrinfo blocks, so the address is only looked up again after a
+// connect failed, not for every connection
+bool MqttSink::resolve() {
+  if (this->address_ != 0)
+    return true;
+  struct addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *result = nullptr;
+  if (getaddrinfo(this->host_.c_str(), nullptr, &hints, &result) != 0 || result == nullptr) {
+    ESP_LOGW(TAG, "Cannot resolve %s", this->host_.c_str());
+    return false;
+  }
+  this->address_ = ((struct sockaddr_in *) result->ai_addr)->sin_addr.s_addr;
+  freeaddrinfo(result);
+  return true;
+}
+
+void MqttSink::connect() {
+  if (!this->resolve()) {
+    this->drop();
+    return;
+  }
+  this->fd_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (this->fd_ < 0) {
+    this->drop();
+    return;
+  }
+  fcntl(this->fd_, F_SETFL, fcntl(this->fd_, F_GETFL, 0) | O_NONBLOCK);
+  int one = 1;
+  setsockopt(this->fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(this->port_);
+  addr.sin_addr.s_addr = this->address_;
+  if (::connect(this->fd_, (struct sockaddr *) &addr, sizeof(addr)) != 0 && errno != EINPROGRESS) {
+    this->address_ = 0;
+    this->drop();
+    return;
+  }
+  this->state_ = CONNECTING;
+  this->ping_pending_ = false;
+  this->out_len_ = 0;
+  this->out_sent_ = 0;
+  this->in_len_ = 0;
+  this->deadline_ = millis() + CONNECT_TIMEOUT_MS;
+}
+
+// Unacknowledged publishes of the last connection go first, in order
+void MqttSink::on_connected() {
+  this->state_ = CONNECTED;
+  this->connects_++;
+  this->backoff_.success();
+  ESP_LOGD(TAG, "Connected to %s:%u, %u publishes to resend", this->host_.c_str(), this->port_,
+           (unsigned) this->inflight_.size());
+  this->inflight_.resend([this](const uint8_t *data, size_t len) { this->append(data, len); });
+  this->send_queued();
+}
+
+void MqttSink::send_queued() {
+  char topic[64];
+  uint8_t payload[READING_MAX_SIZE];
+  uint8_t packet[PACKET_SIZE];
+  while (this->queue_count_ > 0 && this->out_len_ + PACKET_SIZE <= OUT_SIZE) {
+    if (this->qos_ > 0 && this->inflight_.full())
+      break;
+    const MeterReading &reading = this->queue_[this->queue_head_];
+    snprintf(topic, sizeof(topic), "%s/%04X/state", this->topic_prefix_.c_str(), reading.node_id);
+    size_t payload_len = encode_reading(this->format_, reading, payload);
+    uint16_t packet_id = this->qos_ > 0 ? this->inflight_.next_id() : 0;
+    size_t len = mqtt_publish(packet, sizeof(packet), topic, payload, payload_len, this->qos_, this->retain_, packet_id);
+    this->queue_head_ = (this->queue_head_ + 1) % QUEUE_SIZE;
+    this->queue_count_--;
+    if (len == 0) {
+      this->dropped_++;
+      continue;
+    }
+    if (this->qos_ > 0)
+      this->inflight_.add(packet_id, packet, len);
+    this->append(packet, len);
+    this->published_++;
+  }
+  this->flush();
+}
+
+bool MqttSink::append(const uint8_t *data, size_t len) {
+  if (this->out_len_ + len > OUT_SIZE)
+    return false;
+  memcpy(this->out_ + this->out_len_, data, len);
+  this->out_len_ += len;
+  return true;
+}
+
+// The lwIP send buffer may take the output in several pieces
+void MqttSink::flush() {
+  if (this->state_ == CONNECTING || this->state_ == DISCONNECTED)
+    return;
+  while (this->out_sent_ < this->out_len_) {
+    ssize_t n = send(this->fd_, this->out_ + this->out_sent_, this->out_len_ - this->out_sent_, MSG_DONTWAIT);
+    if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        this->drop();
+      return;
+    }
+    this->out_sent_ += n;
+    this->last_send_ = millis();
+  }
+  this->out_len_ = 0;
+  this->out_sent_ = 0;
+}
+
+void MqttSink::receive() {
+  while (true) {
+    ssize_t n = recv(this->fd_, this->in_ + this->in_len_, sizeof(this->in_) - this->in_len_, MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+      this->drop();
+      return;
+    }
+    if (n < 0)
+      break;
+    this->in_len_ += n;
+    MqttPacket packet;
+    int len;
+    while ((len = mqtt_parse(this->in_, this->in_len_, packet)) > 0) {
+      this->last_receive_ = millis();
+      this->deadline_ = this->last_receive_ + KEEPALIVE_S * 1500u;
+      if (packet.type == MQTT_CONNACK && this->state_ == WAIT_CONNACK) {
+        if (packet.body_len < 2 || packet.body[1] != 0) {
+          ESP_LOGW(TAG, "Broker refused the connection (%d)", packet.body_len >= 2 ? packet.body[1] : -1);
+          this->drop();
+          return;
+        }
+        this->on_connected();
+      } else if (packet.type == MQTT_PINGRESP) {
+        this->ping_pending_ = false;
+      } else if (packet.type == MQTT_PUBACK && this->inflight_.ack(packet)) {
+        this->acked_++;
+      }
+      if (this->state_ == DISCONNECTED)
+        return;
+      this->in_len_ -= len;
+      memmove(this->in_, this->in_ + len, this->in_len_);
+    }
+    if (len < 0 || this->in_len_ == sizeof(this->in_)) {
+      this->drop();  // Nothing the broker sends a publisher is this long
+      return;
+    }
+  }
+  if (this->state_ == CONNECTED && this->queue_count_ > 0)
+    this->send_queued();
+}
+
+// Publishes in flight stay in the window and are resent after reconnect
+void MqttSink::drop() {
+  if (this->fd_ >= 0) {
+    close(this->fd_);
+    this->fd_ = -1;
+  }
+  this->state_ = DISCONNECTED;
+  this->out_len_ = 0;
+  this->out_sent_ = 0;
+  this->retry_at_ = millis() + this->backoff_.failure();
+}
+
+void MqttSink::dump_config() {
+  ESP_LOGCONFIG(TAG, "  MQTT: %s:%u as %s, %s/<node>/state", this->host_.c_str(), this->port_,
+                this->client_id_.c_str(), this->topic_prefix_.c_str());
+  ESP_LOGCONFIG(TAG, "    Format: %s, QoS %u, inflight %u, retain %s", reading_format_name(this->format_), this->qos_,
+                (unsigned) this->inflight_.window(), this->retain_ ? "yes" : "no");
+  ESP_LOGCONFIG(TAG, "    %u published, %u acknowledged, %u dropped, %u connects", (unsigned) this->published_,
+                (unsigned) this->acked_, (unsigned) this->dropped_, (unsigned) this->connects_);
+}
+
+}  // namespace lora_receiver
+}  // namespace esphome
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "mqtt_packet.h"
+#include "reading_codec.h"
+#include "retry_backoff.h"
+
+namespace esphome {
+namespace lora_receiver {
+
+// MQTT output of the gateway: one message per reading on
+// <prefix>/<node>/state instead of one topic per sensor. Own connection
+// to the broker, polled from loop() with non-blocking lwIP sockets like
+// VzClient. With QoS 1 at most `inflight` publishes wait for their PUBACK;
+// readings beyond that, or while the broker is away, wait in a short queue.
+class MqttSink {
+ public:
+  static constexpr size_t MAX_INFLIGHT = 8;
+  static constexpr size_t QUEUE_SIZE = 16;  // Oldest reading goes when full
+  static constexpr size_t PACKET_SIZE = READING_MAX_SIZE + 64;
+
+  MqttSink(const std::string &host, uint16_t port, const std::string &client_id)
+      : host_(host), port_(port), client_id_(client_id), backoff_(1000, 60000) {}
+
+  void set_credentials(const std::string &username, const std::string &password) {
+    this->username_ = username;
+    this->password_ = password;
+  }
+  void set_topic_prefix(const std::string &prefix) { this->topic_prefix_ = prefix; }
+  void set_format(ReadingFormat format) { this->format_ = format; }
+  void set_qos(uint8_t qos) { this->qos_ = qos > 0 ? 1 : 0; }
+  void set_inflight(size_t inflight) { this->inflight_.set_window(inflight); }
+  void set_retain(bool retain) { this->retain_ = retain; }
+
+  void publish(const MeterReading &reading);
+  void loop();
+  void dump_config();
+
+ protected:
+  enum State : uint8_t { DISCONNECTED, CONNECTING, WAIT_CONNACK, CONNECTED };
+
+  static constexpr uint16_t KEEPALIVE_S = 30;
+  static constexpr uint32_t CONNECT_TIMEOUT_MS = 10000;
+  // Room for a resend of the whole window plus one new publish
+  static constexpr size_t OUT_SIZE = (MAX_INFLIGHT + 1) * PACKET_SIZE;
+
+  bool resolve();
+  void connect();
+  void on_connected();
+  void send_queued();
+  bool append(const uint8_t *data, size_t len);
+  void flush();
+  void receive();
+  void drop();
+
+  std::string host_;
+  uint16_t port_;
+  std::string client_id_;
+  std::string username_;
+  std::string password_;
+  std::string topic_prefix_{"lora_gateway"};
+  ReadingFormat format_{READING_JSON};
+  uint8_t qos_{0};
+  bool retain_{true};
+
+  uint32_t address_{0};  // Resolved once; again after a failed connect
+  int fd_{-1};
+  State state_{DISCONNECTED};
+  RetryBackoff backoff_;
+  uint32_t retry_at_{0};
+  uint32_t deadline_{0};    // CONNACK, or any packet from the broker within 1.5 keepalives
+  uint32_t last_send_{0};
+  uint32_t last_receive_{0};
+  bool ping_pending_{false};
+
+  MqttInflight<MAX_INFLIGHT, PACKET_SIZE> inflight_;
+  MeterReading queue_[QUEUE_SIZE];
+  size_t queue_head_{0};
+  size_t queue_count_{0};
+  uint8_t out_[OUT_SIZE];
+  size_t out_len_{0};
+  size_t out_sent_{0};
+  uint8_t in_[64];
+  size_t in_len_{0};
+
+  uint32_t published_{0};
+  uint32_t acked_{0};
+  uint32_t dropped_{0};
+  uint32_t connects_{0};
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
@@ -0,0 +1,147 @@
+#pragma once
+
+// Per-node AES keys (NODE_KEY on the node) and what the gateway accepts
+// from each node. Signed meter frames (src/meter_auth.h) need the node's
+// key, a valid tag and a packet counter above the last accepted one.
+// Unsigned frames are refused from nodes that have a key, so stripping
+// the tag does not get a forged reading in, and from every node once
+// require_signed is set. The owner saves the last accepted counter of
+// each node (persist) and hands it back after a restart (restore), so an
+// old frame recorded off the air is not taken again after a reboot. The
+// saved state carries a check value of the key: a node given a new key
+// starts from a fresh baseline.
+// Owned by the main loop. Also built into the host gateway (host/).
+
+#include <cstddef>
+#include <cstdint>
+
+#include "aes_cmac.h"
+#include "lora_payload.h"
+#include "meter_auth.h"
+
+namespace esphome {
+namespace lora_receiver {
+
+// What persist() saves per node
+struct NodeReplayState {
+  uint32_t last;       // Last accepted packet counter
+  uint32_t key_check;  // First 4 bytes of the CMAC of a zero block
+};
+
+template<size_t MaxNodes> class NodeKeys {
+ public:
+  // The key schedule is expanded here, once; false when the table is full
+  bool add(uint16_t node_id, const uint8_t key[AES_KEY_SIZE]) {
+    int index = this->index(node_id);
+    if (index < 0) {
+      if (this->count_ >= MaxNodes)
+        return false;
+      index = this->count_++;
+      this->entries_[index].node_id = node_id;
+    }
+    Entry *entry = &this->entries_[index];
+    entry->cmac.setKey(key);
+    entry->guard = MeterReplayGuard();
+    entry->dirty = false;
+    return true;
+  }
+
+  // Adopt the state an earlier boot saved for the index-th node; false
+  // when it was saved under another key
+  bool restore(size_t index, const NodeReplayState &state) {
+    Entry &entry = this->entries_[index];
+    if (state.key_check != key_check(entry.cmac))
+      return false;
+    entry.guard.restore(state.last);
+    return true;
+  }
+
+  bool dirty() const {
+    for (size_t i = 0; i < this->count_; i++) {
+      if (this->entries_[i].dirty)
+        return true;
+    }
+    return false;
+  }
+
+  // Calls save(index, const NodeReplayState &) for each node whose
+  // counter moved since the last call
+  template<typename Save> void persist(Save save) {
+    for (size_t i = 0; i < this->count_; i++) {
+      Entry &entry = this->entries_[i];
+      if (!entry.dirty)
+        continue;
+      save(i, NodeReplayState{entry.guard.last(), key_check(entry.cmac)});
+      entry.dirty = false;
+    }
+  }
+
+  void set_require_signed(bool require) { this->require_signed_ = require; }
+  bool require_signed() const { return this->require_signed_; }
+
+  const AesCmac *find(uint16_t node_id) const {
+    int index = this->index(node_id);
+    return index >= 0 ? &this->entries_[index].cmac : nullptr;
+  }
+
+  // Key and tag only, the replay guard is left alone: for copies that
+  // are held before check() sees one of them. data is the frame view was
+  // parsed from.
+  PayloadStatus verify(const uint8_t *data, const MeterPayloadView &view) const {
+    int index = this->index(view.nodeId());
+    const Entry *entry = index >= 0 ? &this->entries_[index] : nullptr;
+    if (!view.isSigned()) {
+      return entry != nullptr || this->require_signed_ ? PAYLOAD_UNSIGNED : PAYLOAD_OK;
+    }
+    if (entry == nullptr)
+      return PAYLOAD_UNKNOWN_KEY;
+    if (!meterTagValid(data, entry->cmac))
+      return PAYLOAD_BAD_TAG;
+    return PAYLOAD_OK;
+  }
+
+  // data is the frame view was parsed from
+  PayloadStatus check(const uint8_t *data, const MeterPayloadView &view) {
+    PayloadStatus status = this->verify(data, view);
+    if (status != PAYLOAD_OK || !view.isSigned())
+      return status;
+    Entry *entry = &this->entries_[this->index(view.nodeId())];
+    if (!entry->guard.accept(view.packetCounter()))
+      return PAYLOAD_REPLAYED;
+    entry->dirty = true;
+    return PAYLOAD_OK;
+  }
+
+  size_t count() const { return this->count_; }
+  uint16_t node_id(size_t index) const { return this->entries_[index].node_id; }
+
+ protected:
+  struct Entry {
+    uint16_t node_id;
+    AesCmac cmac;
+    MeterReplayGuard guard;
+    bool dirty;  // Counter not yet handed to persist()
+  };
+
+  static uint32_t key_check(const AesCmac &cmac) {
+    const uint8_t zero[AES_BLOCK_SIZE] = {0};
+    uint8_t tag[4];
+    cmac.tag(zero, sizeof(zero), tag, sizeof(tag));
+    return payloadLoad<uint32_t>(tag);
+  }
+
+  int index(uint16_t node_id) const {
+    for (size_t i = 0; i < this->count_; i++) {
+      if (this->entries_[i].node_id == node_id)
+        return i;
+    }
+    return -1;
+  }
+
+  Entry entries_[MaxNodes];
+  size_t count_{0};
+  bool require_signed_{false};
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
@@ -0,0 +1,143 @@
+#pragma once
+
+// Bounded store-and-forward queue for meter readings received while Home
+// Assistant is unreachable. Records are kept in RAM in fixed-size blocks;
+// the owner mirrors dirty blocks and the head/count meta to flash, so a
+// burst of readings costs one write per touched block per flash sync
+// instead of one write per packet. When full, the oldest reading is
+// overwritten: the energy counters are totals, so losing an intermediate
+// reading only costs resolution, not energy.
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace esphome {
+namespace lora_receiver {
+
+static constexpr size_t OUTBOX_BLOCK_RECORDS = 8;
+static constexpr size_t OUTBOX_MAX_BLOCKS = 32;
+// Timestamps below this are uptime seconds (no time source configured)
+static constexpr uint32_t OUTBOX_EPOCH_MIN = 1600000000;
+
+struct OutboxRecord {
+  uint32_t time_s;
+  uint16_t node_id;
+  uint16_t battery_mv;
+  int32_t power_mw;
+  uint32_t packet_counter;
+  int64_t consumption_mwh;
+  int64_t generation_mwh;
+};
+
+struct OutboxBlock {
+  OutboxRecord records[OUTBOX_BLOCK_RECORDS];
+};
+
+struct OutboxMeta {
+  uint32_t magic;  // Layout tag and capacity; anything else is discarded on boot
+  uint16_t head;
+  uint16_t count;
+};
+
+class Outbox {
+ public:
+  ~Outbox() { delete[] this->blocks_; }
+
+  bool allocate(size_t blocks) {
+    if (blocks > OUTBOX_MAX_BLOCKS)
+      blocks = OUTBOX_MAX_BLOCKS;
+    this->blocks_ = new (std::nothrow) OutboxBlock[blocks];
+    this->block_count_ = this->blocks_ != nullptr ? blocks : 0;
+    return this->blocks_ != nullptr;
+  }
+
+  size_t block_count() const { return this->block_count_; }
+  OutboxBlock &block(size_t index) { return this->blocks_[index]; }
+
+  // Adopt head/count persisted by an earlier boot; the blocks must already be loaded
+  bool restore(const OutboxMeta &meta) {
+    if (meta.magic != this->magic() || meta.head >= this->capacity() || meta.count > this->capacity())
+      return false;
+    this->head_ = meta.head;
+    this->count_ = meta.count;
+    return true;
+  }
+
+  OutboxMeta meta() const {
+    OutboxMeta meta;
+    meta.magic = this->magic();
+    meta.head = (uint16_t) this->head_;
+    meta.count = (uint16_t) this->count_;
+    return meta;
+  }
+
+  // Returns false when the oldest reading had to be overwritten
+  bool push(const OutboxRecord &record) {
+    if (this->capacity() == 0)
+      return false;
+    bool kept_all = this->count_ < this->capacity();
+    this->slot(this->head_) = record;
+    this->dirty_blocks_ |= 1UL << (this->head_ / OUTBOX_BLOCK_RECORDS);
+    this->head_ = (this->head_ + 1) % this->capacity();
+    if (kept_all) {
+      this->count_++;
+    } else {
+      this->dropped_++;
+    }
+    this->meta_dirty_ = true;
+    return kept_all;
+  }
+
+  const OutboxRecord *front() const {
+    if (this->count_ == 0)
+      return nullptr;
+    return &this->slot((this->head_ + this->capacity() - this->count_) % this->capacity());
+  }
+
+  // Popping only moves the tail, so only the meta needs rewriting
+  void pop() {
+    if (this->count_ == 0)
+      return;
+    this->count_--;
+    this->meta_dirty_ = true;
+  }
+
+  size_t size() const { return this->count_; }
+  size_t capacity() const { return this->block_count_ * OUTBOX_BLOCK_RECORDS; }
+  bool empty() const { return this->count_ == 0; }
+  uint32_t dropped() const { return this->dropped_; }
+  bool dirty() const { return this->meta_dirty_ || this->dirty_blocks_ != 0; }
+
+  // Calls save_block(index, const OutboxBlock &) for each changed block,
+  // then save_meta(const OutboxMeta &) if anything changed
+  template<typename B, typename M> void persist(B save_block, M save_meta) {
+    for (size_t i = 0; this->dirty_blocks_ != 0; i++) {
+      if (this->dirty_blocks_ & (1UL << i)) {
+        save_block(i, this->blocks_[i]);
+        this->dirty_blocks_ &= ~(1UL << i);
+      }
+    }
+    if (this->meta_dirty_) {
+      save_meta(this->meta());
+      this->meta_dirty_ = false;
+    }
+  }
+
+ protected:
+  uint32_t magic() const { return 0x4F420000UL | (uint32_t) this->capacity(); }
+  OutboxRecord &slot(size_t index) const {
+    return this->blocks_[index / OUTBOX_BLOCK_RECORDS].records[index % OUTBOX_BLOCK_RECORDS];
+  }
+
+  OutboxBlock *blocks_{nullptr};
+  size_t block_count_{0};
+  size_t head_{0};
+  size_t count_{0};
+  uint32_t dirty_blocks_{0};
+  bool meta_dirty_{false};
+  uint32_t dropped_{0};
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
@@ -0,0 +1,84 @@
+#pragma once
+
+// Single-producer / single-consumer ring of preallocated packet slots.
+// The radio side (ISR-woken RX task) fills slots, the ESPHome loop drains
+// them. No locks and no allocation after construction, so a busy loop
+// (Wi-Fi, API, slow publishes) only ever costs slots, never radio time.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "lora_airtime.h"
+
+namespace esphome {
+namespace lora_receiver {
+
+struct RxPacket {
+  uint32_t timestamp_ms;
+  uint32_t irq_us;        // micros() of the DIO1 edge, for the latency histograms
+  uint32_t frequency_hz;  // Channel and profile it arrived on,
+  LoRaProfile profile;    // where a downlink answers it
+  int16_t rssi;           // dBm
+  float snr;              // dB
+  uint8_t length;
+  uint8_t data[255];      // Maximum LoRa payload
+};
+
+// Size must be a power of two; one slot stays empty to tell full from empty
+template<size_t Size> class PacketQueue {
+  static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "PacketQueue size must be a power of two");
+
+ public:
+  // Producer: slot to fill, or nullptr when the consumer is too far behind
+  RxPacket *acquire() {
+    size_t head = this->head_.load(std::memory_order_relaxed);
+    size_t next = (head + 1) & (Size - 1);
+    if (next == this->tail_.load(std::memory_order_acquire)) {
+      this->dropped_.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    return &this->slots_[head];
+  }
+
+  // Producer: publish the slot returned by acquire()
+  void commit() {
+    size_t head = (this->head_.load(std::memory_order_relaxed) + 1) & (Size - 1);
+    this->head_.store(head, std::memory_order_release);
+    size_t depth = (head - this->tail_.load(std::memory_order_relaxed)) & (Size - 1);
+    if (depth > this->high_water_.load(std::memory_order_relaxed))
+      this->high_water_.store(depth, std::memory_order_relaxed);
+  }
+
+  // Consumer: oldest packet, or nullptr when empty
+  const RxPacket *peek() const {
+    size_t tail = this->tail_.load(std::memory_order_relaxed);
+    if (tail == this->head_.load(std::memory_order_acquire))
+      return nullptr;
+    return &this->slots_[tail];
+  }
+
+  // Consumer: hand the slot from peek() back to the producer
+  void release() {
+    size_t tail = this->tail_.load(std::memory_order_relaxed);
+    this->tail_.store((tail + 1) & (Size - 1), std::memory_order_release);
+  }
+
+  size_t size() const {
+    return (this->head_.load(std::memory_order_acquire) - this->tail_.load(std::memory_order_acquire)) & (Size - 1);
+  }
+  static constexpr size_t capacity() { return Size - 1; }
+  uint32_t dropped() const { return this->dropped_.load(std::memory_order_relaxed); }
+  // Deepest the queue has been since boot; written by the producer only
+  size_t high_water() const { return this->high_water_.load(std::memory_order_relaxed); }
+
+ protected:
+  RxPacket slots_[Size];
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+  std::atomic<uint32_t> dropped_{0};
+  std::atomic<size_t> high_water_{0};
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
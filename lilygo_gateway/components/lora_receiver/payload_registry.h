@@ -0,0 +1,107 @@
+#pragma once
+
+// Decoders by schema id (src/lora_payload.h). The first byte of a frame
+// indexes a 256-entry table, so dispatch costs the same however many
+// schemas are registered, and a frame of a schema this gateway does not
+// know is counted and dropped without reaching any decoder. Versioned
+// schemas check byte 1 against the versions the decoder takes; the
+// range-test frames (src/range_sweep.h) carry no version byte.
+// Owned by the main loop; the counters may be read from any task.
+// lora_gatewayd and bench_payload dispatch through the same table.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "lora_payload.h"
+#include "metrics.h"
+#include "packet_queue.h"
+
+namespace esphome {
+namespace lora_receiver {
+
+struct PayloadSchemaStats {
+  MetricCounter frames;  // Handed to the decoder
+  MetricCounter errors;  // Decoder returned an error
+};
+
+template<class Owner, size_t MaxSchemas> class PayloadRegistry {
+  static_assert(MaxSchemas < 255, "PayloadRegistry slot 0 means unregistered");
+
+ public:
+  typedef PayloadStatus (Owner::*Decoder)(const RxPacket &packet);
+
+  // Versions min_version..max_version of schema; false when the table is
+  // full or the schema is taken
+  bool add(uint8_t schema, const char *name, uint8_t min_version, uint8_t max_version, Decoder decoder) {
+    if (this->slots_[schema] != 0 || this->count_ >= MaxSchemas)
+      return false;
+    Entry &entry = this->entries_[this->count_++];
+    entry.schema = schema;
+    entry.name = name;
+    entry.versioned = true;
+    entry.min_version = min_version;
+    entry.max_version = max_version;
+    entry.decoder = decoder;
+    this->slots_[schema] = this->count_;
+    return true;
+  }
+
+  // Frames whose first byte is the type and nothing more
+  bool add_unversioned(uint8_t schema, const char *name, Decoder decoder) {
+    if (!this->add(schema, name, 0, 0, decoder))
+      return false;
+    this->entries_[this->count_ - 1].versioned = false;
+    return true;
+  }
+
+  PayloadStatus dispatch(Owner *owner, const RxPacket &packet) {
+    if (packet.length == 0)
+      return this->reject(PAYLOAD_TOO_SHORT);
+    uint8_t slot = this->slots_[packet.data[0]];
+    if (slot == 0)
+      return this->reject(PAYLOAD_UNKNOWN_SCHEMA);
+    Entry &entry = this->entries_[slot - 1];
+    if (entry.versioned) {
+      if (packet.length < 2)
+        return this->reject(PAYLOAD_TOO_SHORT);
+      if (packet.data[1] < entry.min_version || packet.data[1] > entry.max_version)
+        return this->reject(PAYLOAD_UNSUPPORTED_VERSION);
+    }
+    entry.stats.frames.inc();
+    PayloadStatus status = (owner->*entry.decoder)(packet);
+    if (status != PAYLOAD_OK)
+      entry.stats.errors.inc();
+    return status;
+  }
+
+  size_t count() const { return this->count_; }
+  uint8_t schema(size_t index) const { return this->entries_[index].schema; }
+  const char *name(size_t index) const { return this->entries_[index].name; }
+  const PayloadSchemaStats &stats(size_t index) const { return this->entries_[index].stats; }
+  // Frames no decoder saw: unknown schema, unsupported version, too short
+  uint32_t rejected() const { return this->rejected_.value(); }
+
+ protected:
+  struct Entry {
+    uint8_t schema;
+    bool versioned;
+    uint8_t min_version;
+    uint8_t max_version;
+    const char *name;
+    Decoder decoder;
+    PayloadSchemaStats stats;
+  };
+
+  PayloadStatus reject(PayloadStatus status) {
+    this->rejected_.inc();
+    return status;
+  }
+
+  uint8_t slots_[256]{};  // Entry index + 1 by schema id, 0: none
+  Entry entries_[MaxSchemas];
+  size_t count_{0};
+  MetricCounter rejected_;
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
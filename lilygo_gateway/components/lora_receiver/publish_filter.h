@@ -0,0 +1,90 @@
+#pragma once
+
+// Change-filtered, coalesced sensor publishing. Every packet updates all
+// channels, then one flush() publishes only what changed by more than the
+// channel's deadband. Rate-limited channels stay dirty and go out with a
+// later flush carrying the newest value; a forced refresh republishes
+// unchanged values after max_interval_ms so Home Assistant never goes stale.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace lora_receiver {
+
+struct PublishPolicy {
+  float deadband{0.0f};           // Minimum change to publish
+  uint32_t min_interval_ms{0};    // Rate limit between publishes
+  uint32_t max_interval_ms{600000};  // Forced refresh of unchanged values
+};
+
+template<size_t Channels> class PublishFilter {
+  static_assert(Channels <= 32, "dirty mask is 32 bits");
+
+ public:
+  void set_policy(size_t channel, const PublishPolicy &policy) { this->policy_[channel] = policy; }
+  void set_max_interval(uint32_t max_interval_ms) {
+    for (size_t i = 0; i < Channels; i++)
+      this->policy_[i].max_interval_ms = max_interval_ms;
+  }
+
+  void update(size_t channel, float value) {
+    this->pending_[channel] = value;
+    this->dirty_ |= 1UL << channel;
+  }
+
+  bool dirty() const { return this->dirty_ != 0; }
+
+  // Publish every dirty channel that passes its policy; returns the
+  // number of publishes. publish(channel, value) is called in channel order.
+  template<typename F> size_t flush(uint32_t now, F publish) {
+    size_t published = 0;
+    uint32_t mask = this->dirty_;
+    for (size_t i = 0; mask != 0; i++, mask >>= 1) {
+      if (!(mask & 1))
+        continue;
+      const PublishPolicy &policy = this->policy_[i];
+      float value = this->pending_[i];
+      uint32_t elapsed = now - this->last_time_[i];
+
+      if (this->published_once_ & (1UL << i)) {
+        bool forced = elapsed >= policy.max_interval_ms;
+        if (!forced && elapsed < policy.min_interval_ms)
+          continue;  // Stay dirty, newest value goes out later
+        bool changed = std::isnan(value) != std::isnan(this->last_value_[i]) ||
+                       std::fabs(value - this->last_value_[i]) > policy.deadband;
+        if (!forced && !changed) {
+          this->dirty_ &= ~(1UL << i);
+          this->suppressed_++;
+          continue;
+        }
+      }
+
+      publish(i, value);
+      this->last_value_[i] = value;
+      this->last_time_[i] = now;
+      this->published_once_ |= 1UL << i;
+      this->dirty_ &= ~(1UL << i);
+      published++;
+    }
+    this->published_ += published;
+    return published;
+  }
+
+  uint32_t published() const { return this->published_; }
+  uint32_t suppressed() const { return this->suppressed_; }
+
+ protected:
+  PublishPolicy policy_[Channels];
+  float pending_[Channels]{};
+  float last_value_[Channels]{};
+  uint32_t last_time_[Channels]{};
+  uint32_t dirty_{0};
+  uint32_t published_once_{0};
+  uint32_t published_{0};
+  uint32_t suppressed_{0};
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
@@ -0,0 +1,226 @@
+#pragma once
+
+// One MQTT message per meter reading instead of one topic per sensor, in
+// three encodings:
+//   json    {"node":"1A2B","power_w":123.456,...}   readable, ~190 bytes
+//   cbor    map with the same keys, integer milli-units, ~140 bytes
+//   binary  fixed 48-byte little-endian record (READING_BINARY_SIZE)
+// Binary layout, version 1:
+//   0 version  1 reserved  2 node u16  4 counter u32  8 power_mw i32
+//   12 consumption_mwh i64  20 generation_mwh i64  28 battery_mv u16
+//   30 rssi i16  32 snr_db10 i16  34 per_1h_centi u16  36 lost u32
+//   40 timestamp_ms u64
+// lora_gatewayd publishes the same encodings (host/gateway_pipeline.h).
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "fixed_point.h"
+
+namespace esphome {
+namespace lora_receiver {
+
+enum ReadingFormat : uint8_t {
+  READING_JSON,
+  READING_CBOR,
+  READING_BINARY,
+};
+
+static constexpr uint8_t READING_BINARY_VERSION = 1;
+static constexpr size_t READING_BINARY_SIZE = 48;
+static constexpr size_t READING_MAX_SIZE = 320;  // Largest encoding, with room to spare
+
+struct MeterReading {
+  uint16_t node_id;
+  uint32_t packet_counter;
+  int32_t power_mw;
+  int64_t consumption_mwh;
+  int64_t generation_mwh;
+  uint16_t battery_mv;
+  int16_t rssi;
+  int16_t snr_db10;       // Tenths of a dB
+  uint16_t per_1h_centi;  // Hundredths of a percent
+  uint32_t lost;
+  uint64_t timestamp_ms;  // Epoch ms, 0 without a time source
+};
+
+inline const char *reading_format_name(ReadingFormat format) {
+  switch (format) {
+    case READING_CBOR:
+      return "cbor";
+    case READING_BINARY:
+      return "binary";
+    default:
+      return "json";
+  }
+}
+
+inline bool parse_reading_format(const char *name, ReadingFormat &format) {
+  for (uint8_t f = READING_JSON; f <= READING_BINARY; f++) {
+    if (strcmp(name, reading_format_name((ReadingFormat) f)) == 0) {
+      format = (ReadingFormat) f;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Little-endian stores for the binary record
+inline uint8_t *reading_store(uint8_t *out, uint64_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; i++)
+    out[i] = value >> (8 * i);
+  return out + bytes;
+}
+
+inline size_t encode_reading_binary(const MeterReading &r, uint8_t *out) {
+  uint8_t *p = out;
+  *p++ = READING_BINARY_VERSION;
+  *p++ = 0;
+  p = reading_store(p, r.node_id, 2);
+  p = reading_store(p, r.packet_counter, 4);
+  p = reading_store(p, (uint32_t) r.power_mw, 4);
+  p = reading_store(p, (uint64_t) r.consumption_mwh, 8);
+  p = reading_store(p, (uint64_t) r.generation_mwh, 8);
+  p = reading_store(p, r.battery_mv, 2);
+  p = reading_store(p, (uint16_t) r.rssi, 2);
+  p = reading_store(p, (uint16_t) r.snr_db10, 2);
+  p = reading_store(p, r.per_1h_centi, 2);
+  p = reading_store(p, r.lost, 4);
+  p = reading_store(p, r.timestamp_ms, 8);
+  return p - out;
+}
+
+// CBOR (RFC 8949) head: major type and argument in the shortest form
+inline uint8_t *cbor_head(uint8_t *out, uint8_t major, uint64_t value) {
+  major <<= 5;
+  if (value < 24) {
+    *out++ = major | value;
+  } else if (value <= 0xFF) {
+    *out++ = major | 24;
+    *out++ = value;
+  } else if (value <= 0xFFFF) {
+    *out++ = major | 25;
+    *out++ = value >> 8;
+    *out++ = value;
+  } else if (value <= 0xFFFFFFFF) {
+    *out++ = major | 26;
+    for (int shift = 24; shift >= 0; shift -= 8)
+      *out++ = value >> shift;
+  } else {
+    *out++ = major | 27;
+    for (int shift = 56; shift >= 0; shift -= 8)
+      *out++ = value >> shift;
+  }
+  return out;
+}
+
+inline uint8_t *cbor_int(uint8_t *out, int64_t value) {
+  return value < 0 ? cbor_head(out, 1, (uint64_t) (-(value + 1))) : cbor_head(out, 0, value);
+}
+
+inline uint8_t *cbor_key(uint8_t *out, const char *key) {
+  size_t len = strlen(key);
+  out = cbor_head(out, 3, len);
+  memcpy(out, key, len);
+  return out + len;
+}
+
+// Integer fields only, in the units of MeterReading
+inline size_t encode_reading_cbor(const MeterReading &r, uint8_t *out) {
+  uint8_t *p = cbor_head(out, 5, 11);
+  p = cbor_key(p, "node");
+  p = cbor_int(p, r.node_id);
+  p = cbor_key(p, "counter");
+  p = cbor_int(p, r.packet_counter);
+  p = cbor_key(p, "power_mw");
+  p = cbor_int(p, r.power_mw);
+  p = cbor_key(p, "consumption_mwh");
+  p = cbor_int(p, r.consumption_mwh);
+  p = cbor_key(p, "generation_mwh");
+  p = cbor_int(p, r.generation_mwh);
+  p = cbor_key(p, "battery_mv");
+  p = cbor_int(p, r.battery_mv);
+  p = cbor_key(p, "rssi");
+  p = cbor_int(p, r.rssi);
+  p = cbor_key(p, "snr_db10");
+  p = cbor_int(p, r.snr_db10);
+  p = cbor_key(p, "per_1h_centi");
+  p = cbor_int(p, r.per_1h_centi);
+  p = cbor_key(p, "lost");
+  p = cbor_int(p, r.lost);
+  p = cbor_key(p, "ts");
+  p = cbor_int(p, r.timestamp_ms);
+  return p - out;
+}
+
+// printFixed() target writing into a buffer
+struct ReadingText {
+  char *out;
+  size_t len;
+  size_t size;
+  void print(const char *s) {
+    while (*s != '\0' && this->len + 1 < this->size)
+      this->out[this->len++] = *s++;
+    this->out[this->len] = '\0';
+  }
+  // printFixed() sends the fraction digit by digit, so no snprintf here
+  void print(unsigned long value) {
+    char digits[24];
+    char *p = digits + sizeof(digits);
+    *--p = '\0';
+    do {
+      *--p = '0' + value % 10;
+      value /= 10;
+    } while (value != 0);
+    this->print(p);
+  }
+};
+
+// Without the closing brace, so callers can append fields
+inline size_t encode_reading_json_fields(const MeterReading &r, char *out, size_t out_size) {
+  ReadingText text = {out, 0, out_size};
+  char field[48];
+  snprintf(field, sizeof(field), "{\"node\":\"%04X\",\"power_w\":", r.node_id);
+  text.print(field);
+  printFixed(text, r.power_mw, 1000, 3);
+  text.print(",\"consumption_kwh\":");
+  printFixed(text, r.consumption_mwh, 1000000, 6);
+  text.print(",\"generation_kwh\":");
+  printFixed(text, r.generation_mwh, 1000000, 6);
+  text.print(",\"battery_v\":");
+  printFixed(text, r.battery_mv, 1000, 3);
+  snprintf(field, sizeof(field), ",\"rssi\":%d,\"snr\":", r.rssi);
+  text.print(field);
+  printFixed(text, r.snr_db10, 10, 1);
+  snprintf(field, sizeof(field), ",\"counter\":%u,\"lost\":%u,\"per_1h\":", (unsigned) r.packet_counter,
+           (unsigned) r.lost);
+  text.print(field);
+  printFixed(text, r.per_1h_centi, 100, 2);
+  snprintf(field, sizeof(field), ",\"ts\":%llu", (unsigned long long) r.timestamp_ms);
+  text.print(field);
+  return text.len;
+}
+
+inline size_t encode_reading_json(const MeterReading &r, char *out, size_t out_size) {
+  size_t len = encode_reading_json_fields(r, out, out_size);
+  ReadingText text = {out, len, out_size};
+  text.print("}");
+  return text.len;
+}
+
+// out holds READING_MAX_SIZE bytes
+inline size_t encode_reading(ReadingFormat format, const MeterReading &r, uint8_t *out) {
+  switch (format) {
+    case READING_CBOR:
+      return encode_reading_cbor(r, out);
+    case READING_BINARY:
+      return encode_reading_binary(r, out);
+    default:
+      return encode_reading_json(r, (char *) out, READING_MAX_SIZE);
+  }
+}
+
+}  // namespace lora_receiver
+}  // namespace esphome
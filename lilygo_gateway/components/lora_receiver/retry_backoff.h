@@ -0,0 +1,35 @@
+#pragma once
+
+// Reconnect and retry pacing of the gateway's network outputs.
+// The host gateway paces its Volkszaehler reconnects with it too
+// (host/vz_push.h).
+
+#include <cstdint>
+
+namespace esphome {
+namespace lora_receiver {
+
+// Retry delay after failed requests: doubles from base_ms up to max_ms,
+// back to base_ms after a success
+class RetryBackoff {
+ public:
+  RetryBackoff(uint32_t base_ms, uint32_t max_ms) : base_ms_(base_ms), max_ms_(max_ms) {}
+
+  void success() { this->failures_ = 0; }
+  uint32_t failure() {
+    uint32_t delay = this->base_ms_;
+    for (uint32_t i = 0; i < this->failures_ && delay < this->max_ms_; i++)
+      delay *= 2;
+    this->failures_++;
+    return delay < this->max_ms_ ? delay : this->max_ms_;
+  }
+  uint32_t failures() const { return this->failures_; }
+
+ protected:
+  uint32_t base_ms_;
+  uint32_t max_ms_;
+  uint32_t failures_{0};
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
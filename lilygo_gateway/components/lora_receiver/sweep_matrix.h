@@ -0,0 +1,166 @@
+#pragma once
+
+// Packet error rate / RSSI / SNR per link profile, filled from the
+// CubeCell sweep mode (src/range_sweep.h).
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "lora_data.h"
+#include "lora_payload.h"
+#include "lora_airtime.h"
+#include "range_sweep.h"
+
+namespace esphome {
+namespace lora_receiver {
+
+// Profile ids beyond this are ignored; the default grid has 36 profiles
+static constexpr uint8_t SWEEP_MAX_PROFILES = 64;
+
+struct SweepCell {
+  LoRaProfile profile;
+  bool seen{false};
+  uint32_t expected{0};
+  uint32_t received{0};
+  int32_t rssi_sum{0};      // dBm
+  int32_t snr_sum_x10{0};   // 0.1 dB
+  int16_t rssi_min{0};
+  int16_t rssi_max{0};
+
+  // Packet error rate in percent, 100 if nothing was expected yet
+  float per_percent() const {
+    if (expected == 0)
+      return 100.0f;
+    uint32_t lost = received >= expected ? 0 : expected - received;
+    return 100.0f * lost / expected;
+  }
+  float rssi_avg() const { return received ? (float) rssi_sum / received : 0.0f; }
+  float snr_avg() const { return received ? snr_sum_x10 / (10.0f * received) : 0.0f; }
+  uint32_t airtime_us() const { return loraTimeOnAirUs(profile, PAYLOAD_METER_SIZE); }
+};
+
+class SweepMatrix {
+ public:
+  // Returns true when the receiver should retune to announce.profile.
+  // Repeated announces for the window already being followed are ignored.
+  bool on_announce(const SweepAnnounce &announce, uint32_t now) {
+    if (announce.profile_id >= SWEEP_MAX_PROFILES)
+      return false;
+    if (this->following_ && announce.sweep_id == this->sweep_id_ && announce.profile_id == this->profile_id_)
+      return false;
+
+    SweepCell &cell = this->cells_[announce.profile_id];
+    cell.profile = announce.profile;
+    cell.seen = true;
+    cell.expected += announce.probes;
+    if (announce.profile_id >= this->profile_count_)
+      this->profile_count_ = announce.profile_id + 1;
+
+    // Remaining announces and settle time, then the probe window plus guard
+    uint8_t remaining = announce.repeat + 1 < SWEEP_ANNOUNCE_REPEATS ? SWEEP_ANNOUNCE_REPEATS - 1 - announce.repeat : 0;
+    uint32_t announce_ms = loraTimeOnAirUs(LORA_SPREADING_FACTOR, LORA_BANDWIDTH, LORA_CODING_RATE,
+                                           sizeof(SweepAnnounce)) / 1000;
+    uint32_t window = remaining * (announce_ms + SWEEP_ANNOUNCE_GAP_MS) + SWEEP_SETTLE_MS +
+                      (uint32_t) announce.probes * announce.interval_ms + SWEEP_GUARD_MS;
+
+    if (announce.sweep_id != this->sweep_id_ || !this->any_window_)
+      this->passes_++;
+    this->any_window_ = true;
+    this->sweep_id_ = announce.sweep_id;
+    this->profile_id_ = announce.profile_id;
+    this->window_end_ = now + window;
+    this->seen_mask_ = 0;
+    this->following_ = true;
+    return true;
+  }
+
+  void on_probe(const SweepProbe &probe, int16_t rssi, float snr) {
+    if (!this->following_ || probe.sweep_id != this->sweep_id_ || probe.profile_id != this->profile_id_)
+      return;
+    // Drop duplicates within the window (sequence numbers below 64)
+    if (probe.sequence < 64) {
+      uint64_t bit = 1ULL << probe.sequence;
+      if (this->seen_mask_ & bit)
+        return;
+      this->seen_mask_ |= bit;
+    }
+
+    SweepCell &cell = this->cells_[probe.profile_id];
+    if (cell.received == 0 || rssi < cell.rssi_min)
+      cell.rssi_min = rssi;
+    if (cell.received == 0 || rssi > cell.rssi_max)
+      cell.rssi_max = rssi;
+    cell.received++;
+    cell.rssi_sum += rssi;
+    cell.snr_sum_x10 += (int32_t) (snr * 10.0f);
+  }
+
+  // True once when the probe window has passed; the receiver should then
+  // return to the base profile
+  bool window_expired(uint32_t now) {
+    if (!this->following_ || (int32_t) (now - this->window_end_) < 0)
+      return false;
+    this->following_ = false;
+    return true;
+  }
+
+  bool following() const { return this->following_; }
+  uint8_t profile_id() const { return this->profile_id_; }
+  uint32_t passes() const { return this->passes_; }
+  uint8_t profile_count() const { return this->profile_count_; }
+  const SweepCell &cell(uint8_t profile_id) const { return this->cells_[profile_id]; }
+
+  // Lowest airtime profile with at most max_per_percent loss; ties go to
+  // the lower TX power. Returns -1 if no profile qualifies.
+  int best_profile(float max_per_percent) const {
+    int best = -1;
+    for (uint8_t i = 0; i < this->profile_count_; i++) {
+      const SweepCell &c = this->cells_[i];
+      if (!c.seen || c.expected == 0 || c.per_percent() > max_per_percent)
+        continue;
+      if (best < 0) {
+        best = i;
+        continue;
+      }
+      const SweepCell &b = this->cells_[best];
+      uint32_t c_air = c.airtime_us(), b_air = b.airtime_us();
+      if (c_air < b_air || (c_air == b_air && c.profile.tx_power < b.profile.tx_power))
+        best = i;
+    }
+    return best;
+  }
+
+  void clear() { *this = SweepMatrix(); }
+
+  // One CSV row per profile seen so far
+  std::string to_csv() const {
+    std::string out = "profile,sf,bw_khz,cr,tx_dbm,airtime_ms,expected,received,per_pct,rssi_avg,rssi_min,rssi_max,snr_avg\n";
+    char line[128];
+    for (uint8_t i = 0; i < this->profile_count_; i++) {
+      const SweepCell &c = this->cells_[i];
+      if (!c.seen)
+        continue;
+      snprintf(line, sizeof(line), "%u,%u,%u,4/%u,%d,%.1f,%u,%u,%.1f,%.1f,%d,%d,%.1f\n", i,
+               c.profile.spreading_factor, (unsigned) (loraBandwidthHz(c.profile.bandwidth) / 1000),
+               c.profile.coding_rate + 4, c.profile.tx_power, c.airtime_us() / 1000.0f, (unsigned) c.expected,
+               (unsigned) c.received, c.per_percent(), c.rssi_avg(), c.rssi_min, c.rssi_max, c.snr_avg());
+      out += line;
+    }
+    return out;
+  }
+
+ protected:
+  SweepCell cells_[SWEEP_MAX_PROFILES];
+  uint8_t profile_count_{0};
+  uint8_t sweep_id_{0};
+  uint8_t profile_id_{0};
+  bool following_{false};
+  bool any_window_{false};
+  uint32_t window_end_{0};
+  uint32_t passes_{0};
+  uint64_t seen_mask_{0};
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
@@ -0,0 +1,400 @@
+#pragma once
+
+// Per-node time-series history on the gateway: 16-byte raw rows in a ring
+// plus 1-minute and 15-minute rollups that are built incrementally on
+// insert. Memory is allocated once per node (large blocks land in PSRAM
+// when the board has it) and never per sample. Queries binary-search the
+// row times, so a range lookup costs O(log n) plus the rows returned.
+// Samples older than the newest one, e.g. after an SNTP step, are
+// dropped and counted; the stored day is never thrown away for one bad
+// sample. Filled by the main loop.
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace esphome {
+namespace lora_receiver {
+
+enum HistoryResolution : uint8_t {
+  HISTORY_RAW,
+  HISTORY_1MIN,
+  HISTORY_15MIN,
+};
+
+struct HistorySample {
+  uint32_t time_s;
+  int32_t power_mw;
+  int64_t consumption_mwh;
+  int64_t generation_mwh;
+};
+
+struct HistoryRollup {
+  uint32_t start_s;
+  int32_t min_mw;
+  int32_t max_mw;
+  int32_t mean_mw;
+  uint32_t consumption_delta_mwh;  // Energy used within the bucket
+  uint32_t generation_delta_mwh;
+  uint16_t samples;
+};
+
+// Fixed-capacity ring with logical index 0 = oldest
+template<typename T> class HistoryRing {
+ public:
+  ~HistoryRing() { delete[] this->items_; }
+
+  bool allocate(size_t capacity) {
+    this->items_ = new (std::nothrow) T[capacity];
+    this->capacity_ = this->items_ != nullptr ? capacity : 0;
+    return this->items_ != nullptr;
+  }
+  void push(const T &item) {
+    if (this->capacity_ == 0)
+      return;
+    this->items_[this->head_] = item;
+    this->head_ = (this->head_ + 1) % this->capacity_;
+    if (this->count_ < this->capacity_)
+      this->count_++;
+  }
+  const T &at(size_t index) const {
+    return this->items_[(this->head_ + this->capacity_ - this->count_ + index) % this->capacity_];
+  }
+  T &at(size_t index) { return this->items_[(this->head_ + this->capacity_ - this->count_ + index) % this->capacity_]; }
+  size_t size() const { return this->count_; }
+  size_t capacity() const { return this->capacity_; }
+  void clear() { this->head_ = this->count_ = 0; }
+  void drop_oldest(size_t count) { this->count_ -= count < this->count_ ? count : this->count_; }
+
+ protected:
+  T *items_{nullptr};
+  size_t capacity_{0};
+  size_t head_{0};
+  size_t count_{0};
+};
+
+// Running min/max/mean/energy for the open bucket
+class RollupBuilder {
+ public:
+  explicit RollupBuilder(uint32_t period_s) : period_s_(period_s) {}
+
+  // Returns true and fills closed when the sample starts a new bucket
+  bool add(const HistorySample &sample, HistoryRollup &closed) {
+    uint32_t start = sample.time_s - sample.time_s % this->period_s_;
+    bool did_close = false;
+    if (this->samples_ > 0 && start != this->start_s_) {
+      closed = this->current();
+      did_close = true;
+      this->samples_ = 0;
+    }
+    if (this->samples_ == 0) {
+      this->start_s_ = start;
+      this->min_mw_ = this->max_mw_ = sample.power_mw;
+      this->sum_mw_ = 0;
+      // Energy delta counts from the last reading before this bucket
+      if (!this->has_previous_) {
+        this->base_consumption_ = sample.consumption_mwh;
+        this->base_generation_ = sample.generation_mwh;
+      } else {
+        this->base_consumption_ = this->last_consumption_;
+        this->base_generation_ = this->last_generation_;
+      }
+    }
+    if (sample.power_mw < this->min_mw_)
+      this->min_mw_ = sample.power_mw;
+    if (sample.power_mw > this->max_mw_)
+      this->max_mw_ = sample.power_mw;
+    this->sum_mw_ += sample.power_mw;
+    this->samples_++;
+    this->last_consumption_ = sample.consumption_mwh;
+    this->last_generation_ = sample.generation_mwh;
+    this->has_previous_ = true;
+    return did_close;
+  }
+
+  bool open() const { return this->samples_ > 0; }
+
+  HistoryRollup current() const {
+    HistoryRollup rollup;
+    rollup.start_s = this->start_s_;
+    rollup.min_mw = this->min_mw_;
+    rollup.max_mw = this->max_mw_;
+    rollup.mean_mw = this->samples_ ? (int32_t) (this->sum_mw_ / this->samples_) : 0;
+    rollup.consumption_delta_mwh = delta(this->last_consumption_, this->base_consumption_);
+    rollup.generation_delta_mwh = delta(this->last_generation_, this->base_generation_);
+    rollup.samples = this->samples_;
+    return rollup;
+  }
+
+  void reset() {
+    this->samples_ = 0;
+    this->has_previous_ = false;
+  }
+
+ protected:
+  // Counters only grow; a meter swap shows up as 0 instead of wrapping
+  static uint32_t delta(int64_t last, int64_t base) {
+    if (last <= base)
+      return 0;
+    int64_t d = last - base;
+    return d > UINT32_MAX ? UINT32_MAX : (uint32_t) d;
+  }
+
+  uint32_t period_s_;
+  uint32_t start_s_{0};
+  int32_t min_mw_{0};
+  int32_t max_mw_{0};
+  int64_t sum_mw_{0};
+  uint16_t samples_{0};
+  bool has_previous_{false};
+  int64_t base_consumption_{0};
+  int64_t base_generation_{0};
+  int64_t last_consumption_{0};
+  int64_t last_generation_{0};
+};
+
+class NodeHistory {
+ public:
+  // Consecutive samples with falling energy counters that mean the meter
+  // was swapped rather than a stale frame slipping in
+  static constexpr uint8_t METER_SWAP_SAMPLES = 8;
+
+  // Energy counters are stored as 32-bit offsets from a base, 4294 kWh
+  // across the rows held; the base moves up to the oldest row when a new
+  // sample would overflow
+  struct RawRow {
+    uint32_t time_s;
+    int32_t power_mw;
+    uint32_t consumption_offset;
+    uint32_t generation_offset;
+  };
+
+  bool allocate(size_t raw, size_t minute, size_t quarter) {
+    return this->raw_.allocate(raw) && this->minute_.allocate(minute) && this->quarter_.allocate(quarter);
+  }
+
+  // false when the sample was dropped
+  bool add(const HistorySample &sample) {
+    if (this->raw_.size() > 0) {
+      if (sample.time_s < this->last_time_s_) {
+        this->dropped_++;
+        return false;
+      }
+      if (sample.consumption_mwh < this->last_consumption_ || sample.generation_mwh < this->last_generation_) {
+        if (++this->falling_ < METER_SWAP_SAMPLES) {
+          this->dropped_++;
+          return false;
+        }
+        this->clear();
+      }
+    }
+    this->falling_ = 0;
+    if (this->raw_.size() == 0) {
+      this->base_consumption_ = sample.consumption_mwh;
+      this->base_generation_ = sample.generation_mwh;
+    } else if (!this->fits(sample)) {
+      this->rebase(sample);
+    }
+    this->last_time_s_ = sample.time_s;
+    this->last_consumption_ = sample.consumption_mwh;
+    this->last_generation_ = sample.generation_mwh;
+
+    RawRow row;
+    row.time_s = sample.time_s;
+    row.power_mw = sample.power_mw;
+    row.consumption_offset = (uint32_t) (sample.consumption_mwh - this->base_consumption_);
+    row.generation_offset = (uint32_t) (sample.generation_mwh - this->base_generation_);
+    this->raw_.push(row);
+
+    HistoryRollup closed;
+    if (this->minute_builder_.add(sample, closed))
+      this->minute_.push(closed);
+    if (this->quarter_builder_.add(sample, closed))
+      this->quarter_.push(closed);
+    return true;
+  }
+
+  void clear() {
+    this->raw_.clear();
+    this->minute_.clear();
+    this->quarter_.clear();
+    this->minute_builder_.reset();
+    this->quarter_builder_.reset();
+  }
+
+  // Calls emit(const HistorySample &) for raw samples in [from_s, to_s]
+  template<typename F> size_t query_raw(uint32_t from_s, uint32_t to_s, size_t limit, F emit) const {
+    size_t emitted = 0;
+    for (size_t i = lower_bound(this->raw_, from_s); i < this->raw_.size() && emitted < limit; i++) {
+      const RawRow &row = this->raw_.at(i);
+      if (row.time_s > to_s)
+        break;
+      HistorySample sample;
+      sample.time_s = row.time_s;
+      sample.power_mw = row.power_mw;
+      sample.consumption_mwh = this->base_consumption_ + row.consumption_offset;
+      sample.generation_mwh = this->base_generation_ + row.generation_offset;
+      emit(sample);
+      emitted++;
+    }
+    return emitted;
+  }
+
+  // Calls emit(const HistoryRollup &) for buckets starting in [from_s, to_s],
+  // including the bucket that is still open
+  template<typename F>
+  size_t query_rollup(HistoryResolution resolution, uint32_t from_s, uint32_t to_s, size_t limit, F emit) const {
+    const HistoryRing<HistoryRollup> &ring = resolution == HISTORY_15MIN ? this->quarter_ : this->minute_;
+    const RollupBuilder &builder = resolution == HISTORY_15MIN ? this->quarter_builder_ : this->minute_builder_;
+    size_t emitted = 0;
+    for (size_t i = lower_bound(ring, from_s); i < ring.size() && emitted < limit; i++) {
+      if (ring.at(i).start_s > to_s)
+        return emitted;
+      emit(ring.at(i));
+      emitted++;
+    }
+    if (builder.open() && emitted < limit) {
+      HistoryRollup open = builder.current();
+      if (open.start_s >= from_s && open.start_s <= to_s) {
+        emit(open);
+        emitted++;
+      }
+    }
+    return emitted;
+  }
+
+  size_t raw_size() const { return this->raw_.size(); }
+  // Out of order or stale samples, see add()
+  uint32_t dropped() const { return this->dropped_; }
+  uint32_t last_time_s() const { return this->raw_.size() > 0 ? this->last_time_s_ : 0; }
+  size_t bytes() const {
+    return this->raw_.capacity() * sizeof(RawRow) +
+           (this->minute_.capacity() + this->quarter_.capacity()) * sizeof(HistoryRollup);
+  }
+
+ protected:
+  static uint32_t time_of(const RawRow &row) { return row.time_s; }
+  static uint32_t time_of(const HistoryRollup &rollup) { return rollup.start_s; }
+
+  template<typename T> static size_t lower_bound(const HistoryRing<T> &ring, uint32_t time_s) {
+    size_t lo = 0, hi = ring.size();
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (time_of(ring.at(mid)) < time_s) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+  bool fits(const HistorySample &sample) const {
+    return sample.consumption_mwh - this->base_consumption_ <= UINT32_MAX &&
+           sample.generation_mwh - this->base_generation_ <= UINT32_MAX;
+  }
+
+  // Counters only grow between add() calls, so the oldest row holds the
+  // smallest offsets. Rows more than 4294 kWh behind sample are dropped
+  // first; the rollups keep them. O(rows), once per 4294 kWh at most.
+  void rebase(const HistorySample &sample) {
+    size_t stale = 0;
+    while (stale < this->raw_.size()) {
+      const RawRow &row = this->raw_.at(stale);
+      if (sample.consumption_mwh - (this->base_consumption_ + row.consumption_offset) <= UINT32_MAX &&
+          sample.generation_mwh - (this->base_generation_ + row.generation_offset) <= UINT32_MAX)
+        break;
+      stale++;
+    }
+    this->raw_.drop_oldest(stale);
+    if (this->raw_.size() == 0) {
+      this->base_consumption_ = sample.consumption_mwh;
+      this->base_generation_ = sample.generation_mwh;
+      return;
+    }
+    RawRow &oldest = this->raw_.at(0);
+    uint32_t consumption = oldest.consumption_offset;
+    uint32_t generation = oldest.generation_offset;
+    for (size_t i = 0; i < this->raw_.size(); i++) {
+      RawRow &row = this->raw_.at(i);
+      row.consumption_offset -= consumption;
+      row.generation_offset -= generation;
+    }
+    this->base_consumption_ += consumption;
+    this->base_generation_ += generation;
+  }
+
+  HistoryRing<RawRow> raw_;
+  HistoryRing<HistoryRollup> minute_;
+  HistoryRing<HistoryRollup> quarter_;
+  RollupBuilder minute_builder_{60};
+  RollupBuilder quarter_builder_{900};
+  int64_t base_consumption_{0};
+  int64_t base_generation_{0};
+  uint32_t last_time_s_{0};
+  int64_t last_consumption_{0};
+  int64_t last_generation_{0};
+  uint32_t dropped_{0};
+  uint8_t falling_{0};
+};
+
+// Fixed table of nodes; a node's history is allocated on its first sample
+template<size_t MaxNodes> class HistoryStore {
+ public:
+  ~HistoryStore() {
+    for (size_t i = 0; i < this->count_; i++)
+      delete this->nodes_[i];
+  }
+
+  void set_capacity(size_t raw, size_t minute, size_t quarter) {
+    this->raw_ = raw;
+    this->minute_ = minute;
+    this->quarter_ = quarter;
+  }
+
+  // False when the node table is full or the allocation failed; dropped
+  // samples count in NodeHistory::dropped()
+  bool add(uint16_t node_id, const HistorySample &sample) {
+    NodeHistory *history = this->find(node_id);
+    if (history == nullptr) {
+      if (this->count_ >= MaxNodes)
+        return false;
+      history = new (std::nothrow) NodeHistory();
+      if (history == nullptr || !history->allocate(this->raw_, this->minute_, this->quarter_)) {
+        delete history;
+        return false;
+      }
+      this->ids_[this->count_] = node_id;
+      this->nodes_[this->count_] = history;
+      this->count_++;
+    }
+    history->add(sample);
+    return true;
+  }
+
+  const NodeHistory *find(uint16_t node_id) const {
+    for (size_t i = 0; i < this->count_; i++) {
+      if (this->ids_[i] == node_id)
+        return this->nodes_[i];
+    }
+    return nullptr;
+  }
+  NodeHistory *find(uint16_t node_id) {
+    return const_cast<NodeHistory *>(static_cast<const HistoryStore *>(this)->find(node_id));
+  }
+
+  size_t node_count() const { return this->count_; }
+  uint16_t node_id(size_t index) const { return this->ids_[index]; }
+  const NodeHistory &node(size_t index) const { return *this->nodes_[index]; }
+
+ protected:
+  uint16_t ids_[MaxNodes]{};
+  NodeHistory *nodes_[MaxNodes]{};
+  size_t count_{0};
+  size_t raw_{1440};
+  size_t minute_{720};
+  size_t quarter_{192};
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
@@ -0,0 +1,207 @@
+#pragma once
+
+// Volkszähler middleware output, transport independent. Readings queue
+// per channel and go out as one POST <path>/data/<uuid>.json whose body
+// is a JSON array of [timestamp_ms, value] tuples, so a channel costs one
+// request per batch instead of one per reading. Also holds the parts of
+// the HTTP/1.1 keep-alive exchange shared by the ESP32 client
+// (vz_client.h) and the host gateway (host/vz_push.h).
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+#include "retry_backoff.h"
+
+namespace esphome {
+namespace lora_receiver {
+
+static constexpr size_t VZ_UUID_SIZE = 37;  // 36 characters and the terminator
+static constexpr size_t VZ_MAX_BATCH = 32;  // Tuples per request
+// Worst case request: headers plus VZ_MAX_BATCH tuples of ~45 characters
+static constexpr size_t VZ_REQUEST_SIZE = 512 + VZ_MAX_BATCH * 48;
+
+struct VzTuple {
+  uint64_t timestamp_ms;
+  int64_t value_milli;  // Thousandths of the channel unit (W for power, Wh for meters)
+};
+
+template<size_t Channels, size_t Depth> class VzBatcher {
+  static_assert(Depth >= VZ_MAX_BATCH, "a channel must hold at least one full batch");
+
+ public:
+  // Index of the channel for uuid, added on first use; -1 when all are taken
+  int channel(const char *uuid) {
+    for (size_t i = 0; i < this->channel_count_; i++) {
+      if (strcmp(this->channels_[i].uuid, uuid) == 0)
+        return i;
+    }
+    if (this->channel_count_ == Channels || strlen(uuid) >= VZ_UUID_SIZE)
+      return -1;
+    Channel &channel = this->channels_[this->channel_count_];
+    strcpy(channel.uuid, uuid);
+    channel.head = 0;
+    channel.count = 0;
+    channel.sending = 0;
+    return this->channel_count_++;
+  }
+
+  // A channel is sent once it holds batch_size tuples or its oldest one
+  // has waited max_delay_ms, whichever comes first
+  void set_batching(size_t batch_size, uint32_t max_delay_ms) {
+    this->batch_size_ = batch_size < 1 ? 1 : (batch_size > VZ_MAX_BATCH ? VZ_MAX_BATCH : batch_size);
+    this->max_delay_ms_ = max_delay_ms;
+  }
+
+  // When a channel is full its oldest tuple goes: the meter channels are
+  // totals, so that only costs resolution
+  void add(size_t index, uint64_t timestamp_ms, int64_t value_milli, uint32_t now_ms) {
+    Channel &channel = this->channels_[index];
+    if (channel.count == Depth) {
+      channel.head = (channel.head + 1) % Depth;
+      channel.count--;
+      if (channel.sending > 0)
+        channel.sending--;  // Its request still goes out, the answer must not pop a newer tuple
+      this->dropped_++;
+    }
+    if (channel.count == 0)
+      channel.since_ms = now_ms;
+    VzTuple &tuple = channel.tuples[(channel.head + channel.count) % Depth];
+    tuple.timestamp_ms = timestamp_ms;
+    tuple.value_milli = value_milli;
+    channel.count++;
+  }
+
+  // Next channel with a batch ready, round-robin so a busy channel cannot
+  // starve the others; -1 if none. all also sends partial batches.
+  int due(uint32_t now_ms, bool all = false) {
+    for (size_t n = 0; n < this->channel_count_; n++) {
+      size_t index = (this->next_ + n) % this->channel_count_;
+      const Channel &channel = this->channels_[index];
+      if (channel.count == 0)
+        continue;
+      if (all || channel.count >= this->batch_size_ || now_ms - channel.since_ms >= this->max_delay_ms_) {
+        this->next_ = (index + 1) % this->channel_count_;
+        return index;
+      }
+    }
+    return -1;
+  }
+
+  // HTTP request for the oldest tuples of a channel, which stay queued
+  // until commit() or abort(). Returns its length, 0 when out_size is too small.
+  size_t build_request(size_t index, const char *host, const char *path, char *out, size_t out_size) {
+    Channel &channel = this->channels_[index];
+    size_t count = channel.count < VZ_MAX_BATCH ? channel.count : VZ_MAX_BATCH;
+    char body[VZ_MAX_BATCH * 48];
+    size_t body_len = 0;
+    body[body_len++] = '[';
+    for (size_t i = 0; i < count; i++) {
+      const VzTuple &tuple = channel.tuples[(channel.head + i) % Depth];
+      int64_t value = tuple.value_milli;
+      uint64_t magnitude = value < 0 ? (uint64_t) (-(value + 1)) + 1 : (uint64_t) value;
+      body_len += snprintf(body + body_len, sizeof(body) - body_len, "%s[%llu,%s%llu.%03u]", i == 0 ? "" : ",",
+                           (unsigned long long) tuple.timestamp_ms, value < 0 ? "-" : "",
+                           (unsigned long long) (magnitude / 1000), (unsigned) (magnitude % 1000));
+    }
+    body[body_len++] = ']';
+    int len = snprintf(out, out_size,
+                       "POST %s/data/%s.json HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\n"
+                       "Content-Length: %u\r\nConnection: keep-alive\r\n\r\n",
+                       path, channel.uuid, host, (unsigned) body_len);
+    if (len < 0 || (size_t) len + body_len >= out_size)
+      return 0;
+    memcpy(out + len, body, body_len);
+    out[len + body_len] = '\0';
+    channel.sending = count;
+    return len + body_len;
+  }
+
+  // The middleware answered the last request of the channel: accepted, or
+  // rejected for good (4xx, which will not get better). Returns the
+  // number of tuples it carried.
+  size_t commit(size_t index, uint32_t now_ms) {
+    Channel &channel = this->channels_[index];
+    size_t count = channel.sending;
+    channel.head = (channel.head + count) % Depth;
+    channel.count -= count;
+    channel.sending = 0;
+    channel.since_ms = now_ms;
+    return count;
+  }
+
+  // No answer: the tuples go out again with the next request
+  void abort(size_t index) { this->channels_[index].sending = 0; }
+
+  size_t channel_count() const { return this->channel_count_; }
+  const char *uuid(size_t index) const { return this->channels_[index].uuid; }
+  size_t pending() const {
+    size_t total = 0;
+    for (size_t i = 0; i < this->channel_count_; i++)
+      total += this->channels_[i].count;
+    return total;
+  }
+  uint32_t dropped() const { return this->dropped_; }
+
+ protected:
+  struct Channel {
+    char uuid[VZ_UUID_SIZE];
+    VzTuple tuples[Depth];
+    size_t head;
+    size_t count;
+    size_t sending;     // Oldest tuples carried by the request in flight
+    uint32_t since_ms;  // Oldest unsent tuple queued (or last batch sent)
+  };
+
+  Channel channels_[Channels];
+  size_t channel_count_{0};
+  size_t next_{0};
+  size_t batch_size_{VZ_MAX_BATCH};
+  uint32_t max_delay_ms_{60000};
+  uint32_t dropped_{0};
+};
+
+// Status of a complete HTTP/1.1 response in data, 0 while incomplete.
+// Content-Length or chunked; the middleware answers with small JSON bodies.
+inline int http_response_status(const char *data, size_t len) {
+  const char *end = nullptr;
+  for (size_t i = 0; i + 3 < len; i++) {
+    if (memcmp(data + i, "\r\n\r\n", 4) == 0) {
+      end = data + i;
+      break;
+    }
+  }
+  if (end == nullptr || len < 12 || memcmp(data, "HTTP/1.", 7) != 0)
+    return 0;
+  size_t body = end - data + 4;
+  bool chunked = false;
+  long content_length = -1;
+  for (const char *line = data; line < end;) {
+    const char *next = line;
+    while (next < end && *next != '\r')
+      next++;
+    if (next - line > 15 && strncasecmp(line, "content-length:", 15) == 0)
+      content_length = atol(line + 15);
+    if (next - line > 18 && strncasecmp(line, "transfer-encoding:", 18) == 0) {
+      for (const char *p = line + 18; p + 7 <= next; p++)
+        chunked |= strncasecmp(p, "chunked", 7) == 0;
+    }
+    line = next + 2;
+  }
+  if (content_length >= 0 && len < body + (size_t) content_length)
+    return 0;
+  if (chunked) {
+    bool last_chunk = false;
+    for (size_t i = body; i + 5 <= len && !last_chunk; i++)
+      last_chunk = memcmp(data + i, "0\r\n\r\n", 5) == 0 && (i == body || data[i - 1] == '\n');
+    if (!last_chunk)
+      return 0;
+  }
+  return atoi(data + 9);
+}
+
+}  // namespace lora_receiver
+}  // namespace esphome
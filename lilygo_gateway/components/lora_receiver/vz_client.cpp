@@ -0,0 +1,249 @@
+#include "vz_client.h"
+#include "esphome/core/log.h"
+#include "esphome/core/hal.h"
+#include "esphome/components/network/util.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <lwip/netdb.h>
+#include <lwip/sockets.h>
+#include <unistd.h>
+
+namespace esphome {
+namespace lora_receiver {
+
+static const char *TAG = "lora_receiver.vz";
+
+static const char *const FIELD_NAMES[] = {"power", "consumption", "generation"};
+
+bool VzClient::add_channel(const char *uuid, VzField field, uint16_t node) {
+  int channel = this->batcher_.channel(uuid);
+  if (channel < 0 || this->route_count_ == MAX_CHANNELS)
+    return false;
+  Route &route = this->routes_[this->route_count_++];
+  route.channel = channel;
+  route.field = field;
+  route.node = node;
+  return true;
+}
+
+// Values go out in thousandths of W / Wh, i.e. the mW / mWh the node sends
+void VzClient::on_reading(uint16_t node, uint64_t timestamp_ms, int32_t power_mw, int64_t consumption_mwh,
+                          int64_t generation_mwh) {
+  uint32_t now = millis();
+  for (size_t i = 0; i < this->route_count_; i++) {
+    const Route &route = this->routes_[i];
+    if ((route.node != 0 ? route.node : this->default_node_) != node)
+      continue;
+    int64_t value = route.field == VZ_FIELD_POWER         ? power_mw
+                    : route.field == VZ_FIELD_CONSUMPTION ? consumption_mwh
+                                                          : generation_mwh;
+    this->batcher_.add(route.channel, timestamp_ms, value, now);
+  }
+}
+
+void VzClient::loop() {
+  uint32_t now = millis();
+  switch (this->state_) {
+    case DISCONNECTED:
+      if ((int32_t) (now - this->retry_at_) >= 0 && network::is_connected() && this->batcher_.due(now) >= 0)
+        this->connect();
+      break;
+    case CONNECTING: {
+      fd_set writable;
+      FD_ZERO(&writable);
+      FD_SET(this->fd_, &writable);
+      struct timeval poll = {0, 0};
+      if (select(this->fd_ + 1, nullptr, &writable, nullptr, &poll) > 0) {
+        int error = 0;
+        socklen_t len = sizeof(error);
+        getsockopt(this->fd_, SOL_SOCKET, SO_ERROR, &error, &len);
+        if (error != 0) {
+          ESP_LOGW(TAG, "Connecting to %s:%u failed: %d", this->host_.c_str(), this->port_, error);
+          this->address_ = 0;
+          this->drop();
+          break;
+        }
+        this->state_ = IDLE_CONNECTED;
+        this->start_request();
+      }
+      break;
+    }
+    case SENDING:
+      this->send_pending();
+      break;
+    case WAIT_RESPONSE:
+      this->receive();
+      break;
+    case IDLE_CONNECTED:
+      this->receive();  // Notices the server closing an idle connection
+      if (this->state_ == IDLE_CONNECTED)
+        this->start_request();
+      break;
+  }
+  if ((this->state_ == CONNECTING || this->state_ == SENDING || this->state_ == WAIT_RESPONSE) &&
+      (int32_t) (millis() - this->deadline_) >= 0) {
+    ESP_LOGW(TAG, "No response from %s", this->host_.c_str());
+    this->drop();
+  }
+}
+
+// getaddrinfo blocks, so the address is only looked up again after a
+// connect failed, not for every connection
+bool VzClient::resolve() {
+  if (this->address_ != 0)
+    return true;
+  struct addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *result = nullptr;
+  if (getaddrinfo(this->host_.c_str(), nullptr, &hints, &result) != 0 || result == nullptr) {
+    ESP_LOGW(TAG, "Cannot resolve %s", this->host_.c_str());
+    return false;
+  }
+  this->address_ = ((struct sockaddr_in *) result->ai_addr)->sin_addr.s_addr;
+  freeaddrinfo(result);
+  return true;
+}
+
+void VzClient::connect() {
+  if (!this->resolve()) {
+    this->drop();
+    return;
+  }
+  this->fd_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (this->fd_ < 0) {
+    this->drop();
+    return;
+  }
+  fcntl(this->fd_, F_SETFL, fcntl(this->fd_, F_GETFL, 0) | O_NONBLOCK);
+  int one = 1;
+  setsockopt(this->fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(this->port_);
+  addr.sin_addr.s_addr = this->address_;
+  if (::connect(this->fd_, (struct sockaddr *) &addr, sizeof(addr)) != 0 && errno != EINPROGRESS) {
+    this->address_ = 0;
+    this->drop();
+    return;
+  }
+  this->state_ = CONNECTING;
+  this->deadline_ = millis() + RESPONSE_TIMEOUT_MS;
+}
+
+void VzClient::start_request() {
+  int channel = this->batcher_.due(millis());
+  if (channel < 0)
+    return;
+  this->request_len_ =
+      this->batcher_.build_request(channel, this->host_.c_str(), this->path_.c_str(), this->request_, sizeof(this->request_));
+  if (this->request_len_ == 0) {
+    this->batcher_.abort(channel);
+    return;
+  }
+  this->in_flight_ = channel;
+  this->request_sent_ = 0;
+  this->response_len_ = 0;
+  this->requests_++;
+  this->state_ = SENDING;
+  this->deadline_ = millis() + RESPONSE_TIMEOUT_MS;
+  this->send_pending();
+}
+
+// The lwIP send buffer may take the request in several pieces
+void VzClient::send_pending() {
+  ssize_t n = send(this->fd_, this->request_ + this->request_sent_, this->request_len_ - this->request_sent_,
+                   MSG_DONTWAIT);
+  if (n < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK)
+      this->drop();
+    return;
+  }
+  this->request_sent_ += n;
+  if (this->request_sent_ == this->request_len_)
+    this->state_ = WAIT_RESPONSE;
+}
+
+void VzClient::receive() {
+  bool closed = false;
+  while (this->response_len_ < sizeof(this->response_)) {
+    ssize_t n = recv(this->fd_, this->response_ + this->response_len_, sizeof(this->response_) - this->response_len_,
+                     MSG_DONTWAIT);
+    if (n <= 0) {
+      closed = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+      break;
+    }
+    this->response_len_ += n;
+  }
+  if (this->state_ == IDLE_CONNECTED) {
+    this->response_len_ = 0;
+    if (closed)
+      this->disconnect();  // Idle keep-alive timed out on the server side
+    return;
+  }
+  int status = http_response_status(this->response_, this->response_len_);
+  if (status == 0) {
+    if (closed || this->response_len_ == sizeof(this->response_))
+      this->drop();
+    return;
+  }
+  if (status >= 500) {
+    // Middleware or database trouble: keep the batch and back off
+    ESP_LOGW(TAG, "HTTP %d for %s, retrying", status, this->batcher_.uuid(this->in_flight_));
+    this->drop();
+    return;
+  }
+  size_t count = this->batcher_.commit(this->in_flight_, millis());
+  if (status >= 200 && status < 300) {
+    this->sent_ += count;
+  } else {
+    // Rejected tuples are not retried: a 4xx will not get better
+    this->failed_ += count;
+    ESP_LOGW(TAG, "HTTP %d for %s, %u readings dropped", status, this->batcher_.uuid(this->in_flight_),
+             (unsigned) count);
+  }
+  this->backoff_.success();
+  if (closed) {
+    this->disconnect();
+    return;
+  }
+  this->state_ = IDLE_CONNECTED;
+  this->start_request();
+}
+
+// Connection lost: the request in flight stays queued and is resent
+void VzClient::drop() {
+  if (this->state_ == SENDING || this->state_ == WAIT_RESPONSE)
+    this->batcher_.abort(this->in_flight_);
+  this->disconnect();
+  this->retry_at_ = millis() + this->backoff_.failure();
+}
+
+void VzClient::disconnect() {
+  if (this->fd_ >= 0) {
+    close(this->fd_);
+    this->fd_ = -1;
+  }
+  this->state_ = DISCONNECTED;
+}
+
+void VzClient::dump_config() {
+  ESP_LOGCONFIG(TAG, "  Volkszaehler: http://%s:%u%s", this->host_.c_str(), this->port_, this->path_.c_str());
+  for (size_t i = 0; i < this->route_count_; i++) {
+    const Route &route = this->routes_[i];
+    if (route.node == 0) {
+      ESP_LOGCONFIG(TAG, "    %s <- %s of the sensor node", this->batcher_.uuid(route.channel),
+                    FIELD_NAMES[route.field]);
+    } else {
+      ESP_LOGCONFIG(TAG, "    %s <- %s of node %04X", this->batcher_.uuid(route.channel), FIELD_NAMES[route.field],
+                    route.node);
+    }
+  }
+  ESP_LOGCONFIG(TAG, "    %u sent in %u requests, %u failed, %u dropped, %u pending", (unsigned) this->sent_,
+                (unsigned) this->requests_, (unsigned) this->failed_, (unsigned) this->batcher_.dropped(),
+                (unsigned) this->batcher_.pending());
+}
+
+}  // namespace lora_receiver
+}  // namespace esphome
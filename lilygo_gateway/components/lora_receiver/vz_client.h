@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "vz_batcher.h"
+
+namespace esphome {
+namespace lora_receiver {
+
+// Meter fields a Volkszähler channel can follow
+enum VzField : uint8_t {
+  VZ_FIELD_POWER,        // W
+  VZ_FIELD_CONSUMPTION,  // Wh
+  VZ_FIELD_GENERATION,   // Wh
+};
+
+// Volkszähler middleware output of the gateway: one keep-alive
+// connection with one request in flight, polled from loop() with
+// non-blocking lwIP sockets so a slow middleware never stalls RX.
+class VzClient {
+ public:
+  static constexpr size_t MAX_CHANNELS = 8;
+  static constexpr size_t DEPTH = 64;  // Readings kept per channel while the middleware is away
+
+  VzClient(const std::string &host, uint16_t port, const std::string &path)
+      : host_(host), port_(port), path_(path), backoff_(1000, 60000) {}
+
+  // node 0 follows the node set here, the one the gateway's sensors show;
+  // interleaving the totals of several meters would corrupt the channel
+  bool add_channel(const char *uuid, VzField field, uint16_t node);
+  void set_default_node(uint16_t node) { this->default_node_ = node; }
+  void set_batching(size_t batch_size, uint32_t max_delay_ms) { this->batcher_.set_batching(batch_size, max_delay_ms); }
+
+  void on_reading(uint16_t node, uint64_t timestamp_ms, int32_t power_mw, int64_t consumption_mwh,
+                  int64_t generation_mwh);
+  void loop();
+  void dump_config();
+
+ protected:
+  enum State : uint8_t { DISCONNECTED, CONNECTING, SENDING, WAIT_RESPONSE, IDLE_CONNECTED };
+
+  struct Route {
+    uint8_t channel;
+    VzField field;
+    uint16_t node;
+  };
+
+  static constexpr uint32_t RESPONSE_TIMEOUT_MS = 10000;
+  static constexpr size_t RESPONSE_SIZE = 512;
+
+  bool resolve();
+  void connect();
+  void start_request();
+  void send_pending();
+  void receive();
+  void drop();
+  void disconnect();
+
+  std::string host_;
+  uint16_t port_;
+  std::string path_;
+  uint32_t address_{0};  // Resolved once; again after a failed connect
+  int fd_{-1};
+  State state_{DISCONNECTED};
+  VzBatcher<MAX_CHANNELS, DEPTH> batcher_;
+  Route routes_[MAX_CHANNELS];
+  size_t route_count_{0};
+  uint16_t default_node_{0};  // 0: none yet
+  RetryBackoff backoff_;
+  uint32_t retry_at_{0};
+  uint32_t deadline_{0};
+  int in_flight_{-1};
+  char request_[VZ_REQUEST_SIZE];
+  size_t request_len_{0};
+  size_t request_sent_{0};
+  char response_[RESPONSE_SIZE];
+  size_t response_len_{0};
+  uint32_t sent_{0};
+  uint32_t requests_{0};
+  uint32_t failed_{0};
+};
+
+}  // namespace lora_receiver
+}  // namespace esphome
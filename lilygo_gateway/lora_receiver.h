@@ -8,23 +8,14 @@
 #include "esphome.h"
 #include <RadioLib.h>
 #include <SPI.h>
+#include "packet_queue.h"
+#include "publish_filter.h"
+#include "link_stats.h"
 
-// Include the shared data structure
-struct MeterData {
-  float power_watts;
-  float total_consumption_kwh;
-  float total_generation_kwh;
-  float battery_voltage;
-  uint32_t packet_counter;
-} __attribute__((packed));
-
-// LoRa Configuration (must match transmitter)
-#define LORA_FREQUENCY      868.0      // MHz
-#define LORA_BANDWIDTH      125.0       // kHz
-#define LORA_SPREADING_FACTOR 7
-#define LORA_CODING_RATE    5           // 4/5
-#define LORA_SYNC_WORD      0x34
-#define LORA_PREAMBLE_LENGTH 8
+// Payload and LoRa configuration shared with the transmitter (src/)
+#include "lora_data.h"
+#include "lora_airtime.h"
+#include "lora_payload.h"
 
 // LilyGo LoRa32 V2.1 pins (adjust for your board)
 #define LORA_SCK    5
@@ -35,13 +26,28 @@ struct MeterData {
 #define LORA_RST    23
 #define LORA_BUSY   32
 
+using esphome::lora_receiver::PacketQueue;
+using esphome::lora_receiver::PublishFilter;
+using esphome::lora_receiver::PublishPolicy;
+using esphome::lora_receiver::RxPacket;
+using esphome::lora_receiver::SequenceTracker;
+
+#define LORA_RX_QUEUE_SLOTS 16
+#define LORA_RX_BATCH       8   // Packets handled per loop() call
+
 class LoRaReceiver : public Component, public CustomAPIDevice {
  private:
   SPIClass spi;
   SX1262 radio = nullptr;
   
+  // RX path: DIO1 ISR -> RX task on core 0 -> rxQueue -> loop().
+  // Only the RX task touches the radio after setup().
+  static LoRaReceiver *instance;
+  PacketQueue<LORA_RX_QUEUE_SLOTS> rxQueue;
+  TaskHandle_t rxTaskHandle = nullptr;
+  
   MeterData lastData;
-  uint32_t lastPacketCounter = 0;
+  SequenceTracker sequence;
   uint32_t missedPackets = 0;
   unsigned long lastPacketTime = 0;
   int16_t lastRSSI = 0;
@@ -54,6 +60,7 @@ class LoRaReceiver : public Component, public CustomAPIDevice {
   
   void setup() override {
     ESP_LOGD("lora_receiver", "Setting up LoRa receiver...");
+    setupPublishPolicies();
     
     // Initialize SPI
     spi.begin(LORA_SCK, LORA_MISO, LORA_MOSI, LORA_CS);
@@ -64,10 +71,10 @@ class LoRaReceiver : public Component, public CustomAPIDevice {
     // Initialize SX1262
     ESP_LOGD("lora_receiver", "Initializing SX1262...");
     int state = radio.begin(
-      LORA_FREQUENCY,
-      LORA_BANDWIDTH,
+      LORA_FREQUENCY / 1000000.0,                 // MHz
+      loraBandwidthHz(LORA_BANDWIDTH) / 1000.0,   // kHz
       LORA_SPREADING_FACTOR,
-      LORA_CODING_RATE,
+      LORA_CODING_RATE + 4,                       // 4/5 .. 4/8
       LORA_SYNC_WORD,
       10,  // Output power (dBm)
       LORA_PREAMBLE_LENGTH
@@ -77,10 +84,13 @@ class LoRaReceiver : public Component, public CustomAPIDevice {
       ESP_LOGI("lora_receiver", "SX1262 initialized successfully!");
       loraInitialized = true;
       
-      // Set to receive mode
+      // Set to receive mode, drained by the RX task from now on
+      instance = this;
+      xTaskCreatePinnedToCore(rxTask, "lora_rx", 4096, this, configMAX_PRIORITIES - 2, &rxTaskHandle, 0);
+      radio.setDio1Action(onDio1);
       state = radio.startReceive();
       if (state == RADIOLIB_ERR_NONE) {
-        ESP_LOGI("lora_receiver", "Started receiving on %.1f MHz", LORA_FREQUENCY);
+        ESP_LOGI("lora_receiver", "Started receiving on %.1f MHz", LORA_FREQUENCY / 1000000.0);
       } else {
         ESP_LOGE("lora_receiver", "Failed to start receive mode: %d", state);
       }
@@ -90,101 +100,143 @@ class LoRaReceiver : public Component, public CustomAPIDevice {
     }
   }
   
-  void loop() override {
-    if (!loraInitialized) return;
-    
-    // Check if packet was received
-    int state = radio.checkReceive();
-    
-    if (state == RADIOLIB_ERR_NONE) {
-      // Packet received successfully
-      uint8_t buffer[sizeof(MeterData)];
-      size_t len = sizeof(buffer);
-      
-      state = radio.readData(buffer, len);
+  static void IRAM_ATTR onDio1() {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(instance->rxTaskHandle, &woken);
+    if (woken) portYIELD_FROM_ISR();
+  }
+  
+  // Copy each packet into a preallocated slot and restart RX right away
+  static void rxTask(void *arg) {
+    LoRaReceiver *self = static_cast<LoRaReceiver *>(arg);
+    while (true) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
       
-      if (state == RADIOLIB_ERR_NONE && len == sizeof(MeterData)) {
-        // Valid packet received
-        memcpy(&lastData, buffer, sizeof(MeterData));
-        
-        // Get signal quality
-        lastRSSI = radio.getRSSI();
-        lastSNR = radio.getSNR();
-        lastPacketTime = millis();
-        
-        // Check for missed packets
-        if (lastPacketCounter > 0) {
-          uint32_t expected = lastPacketCounter + 1;
-          if (lastData.packet_counter > expected) {
-            missedPackets += (lastData.packet_counter - expected);
-            ESP_LOGW("lora_receiver", "Missed %d packets", 
-                     lastData.packet_counter - expected);
-          }
-        }
-        lastPacketCounter = lastData.packet_counter;
-        
-        // Log received data
-        ESP_LOGI("lora_receiver", "Packet #%d received: Power=%.1fW, Consumption=%.3fkWh, "
-                 "Generation=%.3fkWh, Battery=%.2fV, RSSI=%ddBm, SNR=%.1fdB",
-                 lastData.packet_counter,
-                 lastData.power_watts,
-                 lastData.total_consumption_kwh,
-                 lastData.total_generation_kwh,
-                 lastData.battery_voltage,
-                 lastRSSI,
-                 lastSNR);
-        
-        // Publish to Home Assistant sensors
-        publishData();
-        
-        // Restart receive mode
-        radio.startReceive();
-      } else {
-        ESP_LOGW("lora_receiver", "Invalid packet received (len=%d, expected=%d)", 
-                 len, sizeof(MeterData));
+      size_t len = self->radio.getPacketLength();
+      RxPacket *packet = self->rxQueue.acquire();
+      if (packet != nullptr && self->radio.readData(packet->data, len) == RADIOLIB_ERR_NONE) {
+        packet->length = len;
+        packet->rssi = self->radio.getRSSI();
+        packet->snr = self->radio.getSNR();
+        packet->timestamp_ms = millis();
+        self->rxQueue.commit();
       }
-    } else if (state == RADIOLIB_ERR_RX_TIMEOUT) {
-      // No packet received (normal condition)
-    } else if (state != RADIOLIB_ERR_NONE) {
-      // Some error occurred
-      ESP_LOGW("lora_receiver", "Receive error: %d", state);
+      self->radio.startReceive();
     }
   }
   
-  void publishData() {
-    // Find sensor components and publish states
-    auto power = id(meter_power);
-    if (power) power->publish_state(lastData.power_watts);
-    
-    auto consumption = id(meter_consumption);
-    if (consumption) consumption->publish_state(lastData.total_consumption_kwh);
-    
-    auto generation = id(meter_generation);
-    if (generation) generation->publish_state(lastData.total_generation_kwh);
+  void loop() override {
+    if (!loraInitialized) return;
     
-    auto battery = id(meter_battery);
-    if (battery) battery->publish_state(lastData.battery_voltage);
+    for (int i = 0; i < LORA_RX_BATCH; i++) {
+      const RxPacket *packet = rxQueue.peek();
+      if (packet == nullptr) break;
+      handlePacket(*packet);
+      rxQueue.release();
+    }
     
-    auto rssi = id(lora_rssi);
-    if (rssi) rssi->publish_state(lastRSSI);
+    // Rate-limited values still waiting
+    if (publisher.dirty()) flushPublisher();
+  }
+  
+  void handlePacket(const RxPacket &packet) {
+    MeterPayloadView view;
+    PayloadStatus status = MeterPayloadView::parse(packet.data, packet.length, view);
+    if (status != PAYLOAD_OK) {
+      ESP_LOGW("lora_receiver", "Dropped %d byte packet: %s", packet.length, payloadStatusName(status));
+      return;
+    }
     
-    auto snr = id(lora_snr);
-    if (snr) snr->publish_state(lastSNR);
+    // Valid packet received
+    view.copyTo(lastData);
+    lastRSSI = packet.rssi;
+    lastSNR = packet.snr;
+    lastPacketTime = packet.timestamp_ms;
     
-    auto counter = id(packet_counter);
-    if (counter) counter->publish_state(lastData.packet_counter);
+    // Check for missed packets (wrap and node reboot aware)
+    uint32_t lost;
+    if (sequence.update(lastData.packet_counter, lost) == SequenceTracker::SEQ_RESET) {
+      ESP_LOGI("lora_receiver", "Packet counter restarted at %u", (unsigned) lastData.packet_counter);
+    }
+    if (lost > 0) {
+      missedPackets += lost;
+      ESP_LOGW("lora_receiver", "Missed %u packets", (unsigned) lost);
+    }
     
-    auto missed = id(missed_packets);
-    if (missed) missed->publish_state(missedPackets);
+    // Log received data
+    ESP_LOGI("lora_receiver", "Packet #%d received: Power=%.1fW, Consumption=%.3fkWh, "
+             "Generation=%.3fkWh, Battery=%.2fV, RSSI=%ddBm, SNR=%.1fdB",
+             lastData.packet_counter,
+             power_watts(),
+             energy_kwh(lastData.total_consumption_mwh),
+             energy_kwh(lastData.total_generation_mwh),
+             lastData.battery_mv / 1000.0f,
+             lastRSSI,
+             lastSNR);
     
-    // Update last packet time
-    auto last_time = id(last_packet_time);
-    if (last_time && id(homeassistant_time).has_state()) {
-      auto time = id(homeassistant_time).now();
-      char buffer[32];
-      strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", time.as_local());
-      last_time->publish_state(std::string(buffer));
-    }
+    // Publish to Home Assistant sensors
+    publishData();
+  }
+  
+  // Sensors in publish channel order, see setupPublishPolicies()
+  enum { CH_POWER, CH_CONSUMPTION, CH_GENERATION, CH_BATTERY, CH_RSSI, CH_SNR, CH_COUNTER, CH_MISSED, CH_COUNT };
+  PublishFilter<CH_COUNT> publisher;
+  
+  void setupPublishPolicies() {
+    // deadband, min interval ms, forced refresh ms
+    static const PublishPolicy policies[CH_COUNT] = {
+      {1.0f, 0, 600000},      // Power W
+      {0.001f, 0, 600000},    // Consumption kWh
+      {0.001f, 0, 600000},    // Generation kWh
+      {0.02f, 0, 600000},     // Battery V
+      {2.0f, 0, 600000},      // RSSI dBm
+      {1.0f, 0, 600000},      // SNR dB
+      {0.0f, 60000, 600000},  // Packet counter: changes every packet
+      {0.0f, 0, 600000},      // Missed packets
+    };
+    for (int i = 0; i < CH_COUNT; i++) publisher.set_policy(i, policies[i]);
+  }
+  
+  void publishData() {
+    // Fixed-point payload is converted to float only here, at the HA boundary.
+    // Unchanged values are suppressed, the rest goes out as one batch.
+    publisher.update(CH_POWER, power_watts());
+    publisher.update(CH_CONSUMPTION, energy_kwh(lastData.total_consumption_mwh));
+    publisher.update(CH_GENERATION, energy_kwh(lastData.total_generation_mwh));
+    publisher.update(CH_BATTERY, lastData.battery_mv / 1000.0f);
+    publisher.update(CH_RSSI, lastRSSI);
+    publisher.update(CH_SNR, lastSNR);
+    publisher.update(CH_COUNTER, lastData.packet_counter);
+    publisher.update(CH_MISSED, missedPackets);
+    flushPublisher();
+  }
+  
+  void flushPublisher() {
+    publisher.flush(millis(), [](size_t channel, float value) {
+      sensor::Sensor *sensors[CH_COUNT] = {
+        id(meter_power), id(meter_consumption), id(meter_generation), id(meter_battery),
+        id(lora_rssi), id(lora_snr), id(packet_counter), id(missed_packets),
+      };
+      if (sensors[channel]) sensors[channel]->publish_state(value);
+      
+      // Last packet time follows the (rate-limited) packet counter
+      auto last_time = id(last_packet_time);
+      if (channel == CH_COUNTER && last_time && id(homeassistant_time).has_state()) {
+        auto time = id(homeassistant_time).now();
+        char buffer[32];
+        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", time.as_local());
+        last_time->publish_state(std::string(buffer));
+      }
+    });
+  }
+  
+  float power_watts() const {
+    return lastData.power_mw / 1000.0f;
+  }
+  
+  // Split whole and fractional kWh so large counters keep their resolution
+  static float energy_kwh(int64_t mwh) {
+    return (float)(mwh / 1000000) + (float)(mwh % 1000000) / 1000000.0f;
   }
   
   unsigned long seconds_since_last_packet() {
@@ -196,4 +248,6 @@ class LoRaReceiver : public Component, public CustomAPIDevice {
     missedPackets = 0;
     ESP_LOGI("lora_receiver", "Missed packet counter reset");
   }
-};
\ No newline at end of file
+};
+
+LoRaReceiver *LoRaReceiver::instance = nullptr;
@@ -0,0 +1,202 @@
+/*
+ * AES-128 and AES-CMAC (RFC 4493)
+ * Message authentication for frames between the CubeCell and the gateway
+ *
+ * Byte-oriented AES with only the 256-byte S-box as a table (no T-tables),
+ * so it fits the CubeCell flash, whose ASR650x core exposes no AES block.
+ * On the ESP32 (ESP_PLATFORM) blocks go through mbedtls instead, which
+ * ESP-IDF and Arduino-ESP32 route to the AES accelerator. Only
+ * encryption is needed: CMAC never decrypts. Tags may be truncated (RFC 4493 sec. 2.4);
+ * verify() compares them in constant time, so the time does not leak the
+ * first differing byte. Header only, no Arduino dependencies (host
+ * benchmarks build it with plain g++).
+ */
+
+#ifndef AES_CMAC_H
+#define AES_CMAC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef ESP_PLATFORM
+#include "mbedtls/aes.h"
+#endif
+
+#define AES_BLOCK_SIZE 16
+#define AES_KEY_SIZE   16
+
+static const uint8_t aesSbox[256] = {
+  0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+  0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+  0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+  0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+  0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+  0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+  0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+  0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+  0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+  0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+  0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+  0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+  0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+  0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+  0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+  0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+// Multiply by x in GF(2^8)
+inline uint8_t aesXtime(uint8_t b) {
+  return (uint8_t)((b << 1) ^ ((b >> 7) * 0x1b));
+}
+
+#ifdef ESP_PLATFORM
+// AES-128 encryption on the hardware accelerator
+class Aes128 {
+ public:
+  Aes128() { mbedtls_aes_init(&ctx_); }
+
+  void setKey(const uint8_t key[AES_KEY_SIZE]) { mbedtls_aes_setkey_enc(&ctx_, key, AES_KEY_SIZE * 8); }
+
+  void encrypt(uint8_t block[AES_BLOCK_SIZE]) const {
+    uint8_t out[AES_BLOCK_SIZE];
+    mbedtls_aes_crypt_ecb(&ctx_, MBEDTLS_AES_ENCRYPT, block, out);
+    memcpy(block, out, AES_BLOCK_SIZE);
+  }
+
+ private:
+  mutable mbedtls_aes_context ctx_;
+};
+#else
+// AES-128 encryption with the key schedule expanded once
+class Aes128 {
+ public:
+  void setKey(const uint8_t key[AES_KEY_SIZE]) {
+    memcpy(roundKeys_, key, AES_KEY_SIZE);
+    uint8_t rcon = 0x01;
+    for(uint8_t i = AES_KEY_SIZE; i < sizeof(roundKeys_); i += 4) {
+      uint8_t t[4];
+      memcpy(t, roundKeys_ + i - 4, 4);
+      if(i % AES_KEY_SIZE == 0) {
+        uint8_t first = t[0];
+        t[0] = aesSbox[t[1]] ^ rcon;
+        t[1] = aesSbox[t[2]];
+        t[2] = aesSbox[t[3]];
+        t[3] = aesSbox[first];
+        rcon = aesXtime(rcon);
+      }
+      for(uint8_t j = 0; j < 4; j++) {
+        roundKeys_[i + j] = roundKeys_[i + j - AES_KEY_SIZE] ^ t[j];
+      }
+    }
+  }
+
+  // In place; the state is column-major as in FIPS-197
+  void encrypt(uint8_t block[AES_BLOCK_SIZE]) const {
+    addRoundKey(block, 0);
+    for(uint8_t round = 1; round < 10; round++) {
+      subBytesShiftRows(block);
+      mixColumns(block);
+      addRoundKey(block, round);
+    }
+    subBytesShiftRows(block);
+    addRoundKey(block, 10);
+  }
+
+ private:
+  void addRoundKey(uint8_t *s, uint8_t round) const {
+    const uint8_t *k = roundKeys_ + round * AES_BLOCK_SIZE;
+    for(uint8_t i = 0; i < AES_BLOCK_SIZE; i++) {
+      s[i] ^= k[i];
+    }
+  }
+
+  // Row r rotates left by r columns
+  static void subBytesShiftRows(uint8_t *s) {
+    uint8_t t[AES_BLOCK_SIZE];
+    for(uint8_t c = 0; c < 4; c++) {
+      for(uint8_t r = 0; r < 4; r++) {
+        t[c * 4 + r] = aesSbox[s[((c + r) & 3) * 4 + r]];
+      }
+    }
+    memcpy(s, t, AES_BLOCK_SIZE);
+  }
+
+  static void mixColumns(uint8_t *s) {
+    for(uint8_t c = 0; c < 4; c++) {
+      uint8_t *col = s + c * 4;
+      uint8_t all = col[0] ^ col[1] ^ col[2] ^ col[3];
+      uint8_t first = col[0];
+      col[0] ^= all ^ aesXtime(col[0] ^ col[1]);
+      col[1] ^= all ^ aesXtime(col[1] ^ col[2]);
+      col[2] ^= all ^ aesXtime(col[2] ^ col[3]);
+      col[3] ^= all ^ aesXtime(col[3] ^ first);
+    }
+  }
+
+  uint8_t roundKeys_[11 * AES_BLOCK_SIZE];
+};
+#endif
+
+// Left shift by one bit, xor Rb on carry (subkey generation)
+inline void cmacDouble(uint8_t block[AES_BLOCK_SIZE]) {
+  uint8_t carry = block[0] >> 7;
+  for(uint8_t i = 0; i < AES_BLOCK_SIZE - 1; i++) {
+    block[i] = (uint8_t)((block[i] << 1) | (block[i + 1] >> 7));
+  }
+  block[AES_BLOCK_SIZE - 1] = (uint8_t)((block[AES_BLOCK_SIZE - 1] << 1) ^ (carry * 0x87));
+}
+
+// Keyed CMAC; K1/K2 are derived once in setKey()
+class AesCmac {
+ public:
+  void setKey(const uint8_t key[AES_KEY_SIZE]) {
+    aes_.setKey(key);
+    memset(k1_, 0, AES_BLOCK_SIZE);
+    aes_.encrypt(k1_);
+    cmacDouble(k1_);
+    memcpy(k2_, k1_, AES_BLOCK_SIZE);
+    cmacDouble(k2_);
+  }
+
+  // First tagLength (1..16) bytes of the CMAC of data
+  void tag(const uint8_t *data, size_t length, uint8_t *out, size_t tagLength) const {
+    uint8_t x[AES_BLOCK_SIZE] = {0};
+    while(length > AES_BLOCK_SIZE) {
+      for(uint8_t i = 0; i < AES_BLOCK_SIZE; i++) {
+        x[i] ^= data[i];
+      }
+      aes_.encrypt(x);
+      data += AES_BLOCK_SIZE;
+      length -= AES_BLOCK_SIZE;
+    }
+    // Last block: complete ones take K1, padded ones 10..0 and K2
+    const uint8_t *subkey = length == AES_BLOCK_SIZE ? k1_ : k2_;
+    for(uint8_t i = 0; i < AES_BLOCK_SIZE; i++) {
+      uint8_t m = i < length ? data[i] : (i == length ? 0x80 : 0x00);
+      x[i] ^= m ^ subkey[i];
+    }
+    aes_.encrypt(x);
+    memcpy(out, x, tagLength);
+  }
+
+  bool verify(const uint8_t *data, size_t length, const uint8_t *expected, size_t tagLength) const {
+    uint8_t computed[AES_BLOCK_SIZE];
+    tag(data, length, computed, tagLength);
+    return tagEqual(computed, expected, tagLength);
+  }
+
+  static bool tagEqual(const uint8_t *a, const uint8_t *b, size_t length) {
+    uint8_t diff = 0;
+    for(size_t i = 0; i < length; i++) {
+      diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+  }
+
+ private:
+  Aes128 aes_;
+  uint8_t k1_[AES_BLOCK_SIZE];
+  uint8_t k2_[AES_BLOCK_SIZE];
+};
+
+#endif // AES_CMAC_H
@@ -0,0 +1,212 @@
+/*
+ * Config Downlink
+ * Authenticated node reconfiguration, shared by the CubeCell and the gateway
+ *
+ * After every meter uplink the node opens one short receive window
+ * DOWNLINK_RX_DELAY_MS after TX done (like LoRaWAN class A RX1). If the
+ * gateway holds a change for that node it sends it exactly then, on the
+ * profile the uplink arrived with:
+ *
+ *   [0]     PAYLOAD_SCHEMA_CONFIG
+ *   [1]     CONFIG_DOWNLINK_VERSION
+ *   [2..3]  node id
+ *   [4..5]  sequence           newer than the node's last one, see below
+ *   [6]     fields             CONFIG_FIELD_* bits (node_config.h)
+ *   [7..]   values             in bit order: interval_s u16, tx_power i8,
+ *                              spreading_factor u8, policy u8, obis u8
+ *   [n..]   tag                first 4 bytes of AES-CMAC over [0..n-1]
+ *
+ * The node answers DOWNLINK_ACK_DELAY_MS later, still on the old profile:
+ *
+ *   [0]     PAYLOAD_SCHEMA_CONFIG_ACK
+ *   [1]     CONFIG_DOWNLINK_VERSION
+ *   [2..3]  node id
+ *   [4..5]  sequence           see CONFIG_ACK_*
+ *   [6]     status             CONFIG_ACK_*
+ *   [7..10] tag
+ *
+ * Replay protection is the sequence: the node persists the last applied
+ * one and acks anything not newer as stale, with its own sequence, so a
+ * rebooted gateway learns where to continue. Schema ids differ per
+ * direction, so a tag never verifies for the other frame type. Header
+ * only, no Arduino dependencies.
+ */
+
+#ifndef CONFIG_DOWNLINK_H
+#define CONFIG_DOWNLINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "aes_cmac.h"
+#include "lora_payload.h"
+#include "node_config.h"
+
+#define CONFIG_DOWNLINK_VERSION   1
+#define CONFIG_TAG_SIZE           PAYLOAD_TAG_SIZE
+
+#define CONFIG_DOWNLINK_HEADER_SIZE 7
+#define CONFIG_DOWNLINK_MAX_SIZE  (CONFIG_DOWNLINK_HEADER_SIZE + 6 + CONFIG_TAG_SIZE)
+#define CONFIG_ACK_SIZE           (7 + CONFIG_TAG_SIZE)
+
+// Receive window timing, relative to the end of the uplink on both sides
+#define DOWNLINK_RX_DELAY_MS      1000  // Room for the gateway's main loop
+#define DOWNLINK_RX_MARGIN_MS     20    // Node listens from delay - margin to delay + margin
+#define DOWNLINK_ACK_DELAY_MS     50    // Gateway back in RX before the ack
+
+#define CONFIG_ACK_APPLIED   0  // sequence: the downlink's
+#define CONFIG_ACK_STALE     1  // sequence: the node's current one
+#define CONFIG_ACK_REJECTED  2  // sequence: the downlink's; values out of range, nothing applied
+
+struct ConfigDownlink {
+  uint16_t node_id;
+  uint16_t sequence;
+  ConfigChange change;
+};
+
+struct ConfigAck {
+  uint16_t node_id;
+  uint16_t sequence;
+  uint8_t status;
+};
+
+inline const char *configAckName(uint8_t status) {
+  switch(status) {
+    case CONFIG_ACK_APPLIED: return "applied";
+    case CONFIG_ACK_STALE: return "stale";
+    case CONFIG_ACK_REJECTED: return "rejected";
+  }
+  return "?";
+}
+
+inline size_t configValuesSize(uint8_t fields) {
+  return ((fields & CONFIG_FIELD_INTERVAL) ? 2 : 0) + ((fields & CONFIG_FIELD_TX_POWER) ? 1 : 0) +
+         ((fields & CONFIG_FIELD_SF) ? 1 : 0) + ((fields & CONFIG_FIELD_POLICY) ? 1 : 0) +
+         ((fields & CONFIG_FIELD_OBIS) ? 1 : 0);
+}
+
+// out must hold CONFIG_DOWNLINK_MAX_SIZE bytes
+inline size_t encodeConfigDownlink(uint8_t *out, const AesCmac &cmac, const ConfigDownlink &downlink) {
+  const ConfigChange &change = downlink.change;
+  uint8_t *p = out;
+  *p++ = PAYLOAD_SCHEMA_CONFIG;
+  *p++ = CONFIG_DOWNLINK_VERSION;
+  p = payloadStore<uint16_t>(p, downlink.node_id);
+  p = payloadStore<uint16_t>(p, downlink.sequence);
+  *p++ = change.fields;
+  if(change.fields & CONFIG_FIELD_INTERVAL) {
+    p = payloadStore<uint16_t>(p, change.interval_s);
+  }
+  if(change.fields & CONFIG_FIELD_TX_POWER) {
+    *p++ = (uint8_t)change.tx_power;
+  }
+  if(change.fields & CONFIG_FIELD_SF) {
+    *p++ = change.spreading_factor;
+  }
+  if(change.fields & CONFIG_FIELD_POLICY) {
+    *p++ = change.policy;
+  }
+  if(change.fields & CONFIG_FIELD_OBIS) {
+    *p++ = change.obis;
+  }
+  cmac.tag(out, p - out, p, CONFIG_TAG_SIZE);
+  return (p - out) + CONFIG_TAG_SIZE;
+}
+
+// Tag checked before any value is looked at
+inline PayloadStatus parseConfigDownlink(const uint8_t *data, size_t length, const AesCmac &cmac,
+                                         ConfigDownlink &downlink) {
+  if(length < CONFIG_DOWNLINK_HEADER_SIZE + CONFIG_TAG_SIZE) {
+    return PAYLOAD_TOO_SHORT;
+  }
+  if(data[0] != PAYLOAD_SCHEMA_CONFIG) {
+    return PAYLOAD_UNKNOWN_SCHEMA;
+  }
+  if(data[1] != CONFIG_DOWNLINK_VERSION) {
+    return PAYLOAD_UNSUPPORTED_VERSION;
+  }
+  uint8_t fields = data[6];
+  size_t body = CONFIG_DOWNLINK_HEADER_SIZE + configValuesSize(fields);
+  if(length != body + CONFIG_TAG_SIZE) {
+    return PAYLOAD_BAD_LENGTH;
+  }
+  if(!cmac.verify(data, body, data + body, CONFIG_TAG_SIZE)) {
+    return PAYLOAD_BAD_TAG;
+  }
+
+  downlink.node_id = payloadLoad<uint16_t>(data + 2);
+  downlink.sequence = payloadLoad<uint16_t>(data + 4);
+  ConfigChange &change = downlink.change;
+  memset(&change, 0, sizeof(change));
+  change.fields = fields;
+  const uint8_t *p = data + CONFIG_DOWNLINK_HEADER_SIZE;
+  if(fields & CONFIG_FIELD_INTERVAL) {
+    change.interval_s = payloadLoad<uint16_t>(p);
+    p += 2;
+  }
+  if(fields & CONFIG_FIELD_TX_POWER) {
+    change.tx_power = (int8_t)*p++;
+  }
+  if(fields & CONFIG_FIELD_SF) {
+    change.spreading_factor = *p++;
+  }
+  if(fields & CONFIG_FIELD_POLICY) {
+    change.policy = *p++;
+  }
+  if(fields & CONFIG_FIELD_OBIS) {
+    change.obis = *p++;
+  }
+  return PAYLOAD_OK;
+}
+
+// out must hold CONFIG_ACK_SIZE bytes
+inline size_t encodeConfigAck(uint8_t *out, const AesCmac &cmac, const ConfigAck &ack) {
+  uint8_t *p = out;
+  *p++ = PAYLOAD_SCHEMA_CONFIG_ACK;
+  *p++ = CONFIG_DOWNLINK_VERSION;
+  p = payloadStore<uint16_t>(p, ack.node_id);
+  p = payloadStore<uint16_t>(p, ack.sequence);
+  *p++ = ack.status;
+  cmac.tag(out, p - out, p, CONFIG_TAG_SIZE);
+  return CONFIG_ACK_SIZE;
+}
+
+inline PayloadStatus parseConfigAck(const uint8_t *data, size_t length, const AesCmac &cmac, ConfigAck &ack) {
+  if(length != CONFIG_ACK_SIZE) {
+    return PAYLOAD_BAD_LENGTH;
+  }
+  if(data[0] != PAYLOAD_SCHEMA_CONFIG_ACK) {
+    return PAYLOAD_UNKNOWN_SCHEMA;
+  }
+  if(data[1] != CONFIG_DOWNLINK_VERSION) {
+    return PAYLOAD_UNSUPPORTED_VERSION;
+  }
+  if(!cmac.verify(data, CONFIG_ACK_SIZE - CONFIG_TAG_SIZE, data + CONFIG_ACK_SIZE - CONFIG_TAG_SIZE,
+                  CONFIG_TAG_SIZE)) {
+    return PAYLOAD_BAD_TAG;
+  }
+  ack.node_id = payloadLoad<uint16_t>(data + 2);
+  ack.sequence = payloadLoad<uint16_t>(data + 4);
+  ack.status = data[6];
+  return PAYLOAD_OK;
+}
+
+// Node side: apply a verified downlink addressed to this node and say
+// what to ack. config is only touched when the status is APPLIED.
+inline ConfigAck applyConfigDownlink(NodeConfig &config, const ConfigDownlink &downlink) {
+  ConfigAck ack;
+  ack.node_id = downlink.node_id;
+  ack.sequence = downlink.sequence;
+  if(!configSequenceNewer(downlink.sequence, config.sequence)) {
+    ack.status = CONFIG_ACK_STALE;
+    ack.sequence = config.sequence;
+  } else if(!configChangeValid(downlink.change)) {
+    ack.status = CONFIG_ACK_REJECTED;
+  } else {
+    applyConfigChange(config, downlink.change);
+    config.sequence = downlink.sequence;
+    ack.status = CONFIG_ACK_APPLIED;
+  }
+  return ack;
+}
+
+#endif // CONFIG_DOWNLINK_H
@@ -0,0 +1,120 @@
+/*
+ * Config Stores
+ * Keep the runtime NodeConfig (node_config.h) across reboots
+ *
+ *   bool load(NodeConfig &config);         // false: config holds the defaults
+ *   void save(const NodeConfig &config);   // only called when a downlink changed it
+ *   bool loadCounter(uint32_t &bound);     // false: nothing stored
+ *   void saveCounter(uint32_t bound);      // packet counters up to bound may be in use
+ */
+
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "node_config.h"
+
+// Build without downlinks: the build flags are the whole config
+class RamConfigStore {
+ public:
+  bool load(NodeConfig &config) {
+    config = nodeConfigDefaults();
+    return false;
+  }
+
+  void save(const NodeConfig &config) { (void)config; }
+
+  // Counters start at 0 after every reset
+  bool loadCounter(uint32_t &bound) {
+    (void)bound;
+    return false;
+  }
+
+  void saveCounter(uint32_t bound) { (void)bound; }
+};
+
+// CubeCell flash-emulated EEPROM. A record from another layout or with
+// a broken checksum falls back to the build flags. The counter bound has
+// its own record, so the frequent counter writes never touch the config.
+#define CONFIG_STORE_MAGIC   0x4E43  // "CN"
+#define CONFIG_STORE_VERSION 1
+#define CONFIG_STORE_SIZE    64
+#define COUNTER_STORE_MAGIC  0x4354  // "TC"
+#define COUNTER_STORE_OFFSET 32
+
+#pragma pack(push, 1)
+struct StoredNodeConfig {
+  uint16_t magic;
+  uint8_t version;
+  NodeConfig config;
+  uint16_t checksum;
+};
+
+struct StoredCounter {
+  uint16_t magic;
+  uint32_t bound;
+  uint16_t checksum;
+};
+#pragma pack(pop)
+
+// Fletcher-16 over everything before a record's checksum
+inline uint16_t storeChecksum(const void *record, size_t length) {
+  const uint8_t *p = (const uint8_t *)record;
+  uint16_t a = 0;
+  uint16_t b = 0;
+  for(size_t i = 0; i < length; i++) {
+    a = (a + p[i]) % 255;
+    b = (b + a) % 255;
+  }
+  return (uint16_t)((b << 8) | a);
+}
+
+class EepromConfigStore {
+ public:
+  bool load(NodeConfig &config) {
+    EEPROM.begin(CONFIG_STORE_SIZE);
+    StoredNodeConfig record;
+    EEPROM.get(0, record);
+    if(record.magic != CONFIG_STORE_MAGIC || record.version != CONFIG_STORE_VERSION ||
+       record.checksum != storeChecksum(&record, offsetof(StoredNodeConfig, checksum))) {
+      config = nodeConfigDefaults();
+      return false;
+    }
+    config = record.config;
+    return true;
+  }
+
+  void save(const NodeConfig &config) {
+    StoredNodeConfig record;
+    memset(&record, 0, sizeof(record));
+    record.magic = CONFIG_STORE_MAGIC;
+    record.version = CONFIG_STORE_VERSION;
+    record.config = config;
+    record.checksum = storeChecksum(&record, offsetof(StoredNodeConfig, checksum));
+    EEPROM.put(0, record);
+    EEPROM.commit();
+  }
+
+  bool loadCounter(uint32_t &bound) {
+    StoredCounter record;
+    EEPROM.get(COUNTER_STORE_OFFSET, record);
+    if(record.magic != COUNTER_STORE_MAGIC ||
+       record.checksum != storeChecksum(&record, offsetof(StoredCounter, checksum))) {
+      return false;
+    }
+    bound = record.bound;
+    return true;
+  }
+
+  void saveCounter(uint32_t bound) {
+    StoredCounter record;
+    record.magic = COUNTER_STORE_MAGIC;
+    record.bound = bound;
+    record.checksum = storeChecksum(&record, offsetof(StoredCounter, checksum));
+    EEPROM.put(COUNTER_STORE_OFFSET, record);
+    EEPROM.commit();
+  }
+};
+
+#endif // CONFIG_STORE_H
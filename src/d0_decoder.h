@@ -0,0 +1,261 @@
+/*
+ * IEC 62056-21 (D0) Streaming Decoder
+ * Parses the ASCII data readout of optical D0 meters
+ *
+ * A mode C readout looks like:
+ *   /LOG5LK13BE803039<CR><LF>          identification, '5' = 9600 baud offer
+ *   <STX>1-0:1.8.0*255(001234.5678*kWh)<CR><LF>
+ *   1-0:2.8.0*255(000012.3456*kWh)<CR><LF>
+ *   1-0:16.7.0*255(000123*W)<CR><LF>
+ *   !<CR><LF><ETX><BCC>
+ *
+ * Push-mode (mode D) meters send the same lines without STX/ETX/BCC.
+ */
+
+#ifndef D0_DECODER_H
+#define D0_DECODER_H
+
+#include <stdint.h>
+#include "meter_registers.h"
+#include "fixed_point.h"
+
+#define D0_STX 0x02
+#define D0_ETX 0x03
+
+// Baud rate for the mode C baud rate character '0'..'6'
+inline uint32_t d0BaudRate(char z) {
+  static const uint32_t rates[] = {300, 600, 1200, 2400, 4800, 9600, 19200};
+  if(z < '0' || z > '6') {
+    return 300;
+  }
+  return rates[z - '0'];
+}
+
+// Place the even parity bit of a 7-bit character into bit 7
+inline uint8_t d0EvenParity(uint8_t c) {
+  c &= 0x7F;
+  uint8_t p = c;
+  p ^= p >> 4;
+  p ^= p >> 2;
+  p ^= p >> 1;
+  return c | ((p & 1) << 7);
+}
+
+class D0Decoder {
+ public:
+  enum Event {
+    EVENT_NONE,
+    EVENT_IDENT,                  // Identification line received, see baudChar()
+    EVENT_TELEGRAM,               // Complete data set decoded into registers()
+    EVENT_ERROR                   // Block check character mismatch
+  };
+
+  void reset() {
+    lineLength_ = 0;
+    inBlock_ = false;
+    endSeen_ = false;
+    expectBcc_ = false;
+    bcc_ = 0;
+    haveImport_ = false;
+    haveExport_ = false;
+    haveNetPower_ = false;
+  }
+
+  Event feed(uint8_t c) {
+    c &= 0x7F;  // Strip the parity bit of 7E1 characters read as 8N1
+
+    if(expectBcc_) {
+      expectBcc_ = false;
+      inBlock_ = false;
+      if(c != bcc_ || !endSeen_) {
+        return EVENT_ERROR;
+      }
+      commit();
+      return EVENT_TELEGRAM;
+    }
+
+    if(c == D0_STX) {
+      inBlock_ = true;
+      endSeen_ = false;
+      bcc_ = 0;
+      lineLength_ = 0;
+      return EVENT_NONE;
+    }
+
+    if(inBlock_) {
+      bcc_ ^= c;
+      if(c == D0_ETX) {
+        expectBcc_ = true;
+        return EVENT_NONE;
+      }
+    }
+
+    if(c == '\r') {
+      return EVENT_NONE;
+    }
+
+    if(c != '\n') {
+      if(lineLength_ < sizeof(line_) - 1) {
+        line_[lineLength_++] = (char)c;
+      }
+      return EVENT_NONE;
+    }
+
+    line_[lineLength_] = 0;
+    uint8_t length = lineLength_;
+    lineLength_ = 0;
+
+    if(length == 0) {
+      return EVENT_NONE;
+    }
+
+    if(line_[0] == '/') {
+      // "/XXXZ..." - three letter manufacturer ID, then baud rate character
+      baudChar_ = length > 4 ? line_[4] : '0';
+      haveImport_ = false;
+      haveExport_ = false;
+      haveNetPower_ = false;
+      return EVENT_IDENT;
+    }
+
+    if(line_[0] == '!') {
+      if(inBlock_) {
+        endSeen_ = true;  // Wait for ETX and BCC before accepting
+        return EVENT_NONE;
+      }
+      commit();
+      return EVENT_TELEGRAM;
+    }
+
+    parseDataLine();
+    return EVENT_NONE;
+  }
+
+  char baudChar() const { return baudChar_; }
+
+  const MeterRegisters &registers() const { return registers_; }
+
+ private:
+  // Parse "[A-B:]C.D.E[*F](value[*unit])" into the register set
+  void parseDataLine() {
+    const char *p = line_;
+    const char *colon = 0;
+    const char *open = 0;
+    for(const char *q = line_; *q; q++) {
+      if(*q == ':' && !open) {
+        colon = q;
+      } else if(*q == '(') {
+        open = q;
+        break;
+      }
+    }
+    if(!open) {
+      return;
+    }
+    if(colon) {
+      p = colon + 1;
+    }
+
+    // OBIS C.D.E groups
+    uint8_t group[3] = {0, 0, 0};
+    uint8_t groupCount = 0;
+    for(; p < open && *p != '*' && groupCount < 3; p++) {
+      if(*p >= '0' && *p <= '9') {
+        group[groupCount] = group[groupCount] * 10 + (*p - '0');
+      } else if(*p == '.') {
+        groupCount++;
+      }
+    }
+    groupCount++;
+    if(groupCount < 3) {
+      return;
+    }
+
+    // Value with optional decimal point, unit after '*'. At most 18
+    // digits fit int64_t; a longer or garbled value drops the line
+    // rather than reporting a wrong register.
+    const char *v = open + 1;
+    bool negative = false;
+    if(*v == '-') {
+      negative = true;
+      v++;
+    }
+    int64_t mantissa = 0;
+    int8_t decimals = -1;
+    uint8_t digits = 0;
+    for(; *v && *v != '*' && *v != ')'; v++) {
+      if(*v >= '0' && *v <= '9') {
+        if(++digits > POW10_MAX_EXPONENT) {
+          return;
+        }
+        mantissa = mantissa * 10 + (*v - '0');
+        if(decimals >= 0) {
+          decimals++;
+        }
+      } else if((*v == '.' || *v == ',') && decimals < 0) {
+        decimals = 0;
+      } else {
+        return;
+      }
+    }
+    if(digits == 0 || !*v) {
+      return;
+    }
+    if(decimals < 0) {
+      decimals = 0;
+    }
+    bool kilo = (*v == '*' && (v[1] == 'k' || v[1] == 'K'));
+
+    // Scale to mW / mWh: value * 10^(kilo ? 6 : 3) / 10^decimals
+    if(negative) {
+      mantissa = -mantissa;
+    }
+    mantissa = scalePow10(mantissa, (kilo ? 6 : 3) - decimals);
+
+    uint8_t c = group[0];
+    uint8_t d = group[1];
+    uint8_t e = group[2];
+
+    if(c == 1 && d == 8 && e == 0) {
+      pending_.consumption_mwh = mantissa;
+    } else if(c == 2 && d == 8 && e == 0) {
+      pending_.generation_mwh = mantissa;
+    } else if(c == 16 && d == 7 && e == 0) {
+      pending_.power_mw = mantissa;
+      haveNetPower_ = true;
+    } else if(c == 1 && d == 7 && e == 0) {
+      importPower_ = mantissa;
+      haveImport_ = true;
+    } else if(c == 2 && d == 7 && e == 0) {
+      exportPower_ = mantissa;
+      haveExport_ = true;
+    }
+  }
+
+  // Meters without 16.7.0 report import (1.7.0) and export (2.7.0) separately
+  void commit() {
+    if(!haveNetPower_ && (haveImport_ || haveExport_)) {
+      pending_.power_mw = (haveImport_ ? importPower_ : 0) - (haveExport_ ? exportPower_ : 0);
+    }
+    registers_ = pending_;
+  }
+
+  char line_[64];
+  uint8_t lineLength_ = 0;
+  bool inBlock_ = false;
+  bool endSeen_ = false;
+  bool expectBcc_ = false;
+  uint8_t bcc_ = 0;
+  char baudChar_ = '0';
+
+  int64_t importPower_ = 0;
+  int64_t exportPower_ = 0;
+  bool haveImport_ = false;
+  bool haveExport_ = false;
+  bool haveNetPower_ = false;
+
+  MeterRegisters pending_ = {0, 0, 0};
+  MeterRegisters registers_ = {0, 0, 0};
+};
+
+#endif // D0_DECODER_H
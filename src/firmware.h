@@ -0,0 +1,166 @@
+/*
+ * Firmware Core
+ * One read-send-sleep cycle shared by all CubeCell variants
+ *
+ * The core is instantiated at compile time with four policies:
+ *   MeterSourceT  - where readings come from (SML, D0, test ramp), see meter_source.h
+ *   TransportT    - where readings go (serial log, LoRa P2P), see transport.h
+ *   SleepPolicyT  - what happens between cycles (stay awake, deep sleep), see sleep_policy.h
+ *   ConfigStoreT  - where downlinked settings persist (RAM, EEPROM), see config_store.h
+ *
+ * Each cycle requests a reading, waits until the meter delivered a fresh
+ * telegram (or METER_READ_TIMEOUT passed), hands the payload to the
+ * transport and lets the sleep policy decide how to spend the rest of
+ * the interval. After each uplink the transport may return a config
+ * downlink (config_downlink.h); the core then saves the new NodeConfig
+ * and hands it to the transport and the sleep policy. No virtual calls,
+ * so unused paths never reach flash.
+ *
+ * The packet counter is the nonce of signed frames (meter_auth.h) and
+ * of the AES-CTR keystream of Meshtastic frames (meshtastic_telemetry.h),
+ * and must never repeat. The store keeps a bound COUNTER_BLOCK ahead of the
+ * counter, written once per block; after a reset counting resumes a
+ * block past the bound, a jump the gateway reads as a reboot
+ * (SequenceTracker::MAX_GAP).
+ */
+
+#ifndef FIRMWARE_H
+#define FIRMWARE_H
+
+#include "Arduino.h"
+#include "firmware_config.h"
+#include "fixed_point.h"
+#include "lora_data.h"
+#include "meter_registers.h"
+#include "node_config.h"
+
+#define COUNTER_BLOCK 1024
+
+template <class MeterSourceT, class TransportT, class SleepPolicyT, class ConfigStoreT>
+class Firmware {
+ public:
+  Firmware(MeterSourceT &meter, TransportT &transport, SleepPolicyT &sleep, ConfigStoreT &store)
+    : meter_(meter), transport_(transport), sleep_(sleep), store_(store) {}
+
+  void setup() {
+    bool stored = store_.load(config_);
+    uint32_t bound;
+    if(store_.loadCounter(bound)) {
+      packetCounter_ = bound + COUNTER_BLOCK;
+    }
+    reserveCounters();
+    meter_.begin();
+    transport_.begin();
+    transport_.configure(config_);
+    sleep_.configure(config_);
+    sleep_.begin();
+
+    // Always an output: a downlink may turn the LED on later
+    pinMode(RGB, OUTPUT);
+    digitalWrite(RGB, LOW);
+
+    Serial.print("Send interval: ");
+    Serial.print(config_.send_interval_ms / 1000);
+    Serial.print(" s, config #");
+    Serial.print(config_.sequence);
+    Serial.println(stored ? " from flash" : " from build flags");
+
+    startCycle(millis());
+  }
+
+  void loop() {
+    if(sleep_.sleeping()) {
+      sleep_.idle();
+      asleep_ = true;
+      return;
+    }
+
+    uint32_t now = millis();
+    if(asleep_) {
+      asleep_ = false;
+      startCycle(now);
+    }
+
+    if(meter_.poll(now)) {
+      freshReading_ = true;
+    }
+
+    bool timedOut = now - cycleStart_ >= METER_READ_TIMEOUT;
+    if(sleep_.sendDue(now, lastSendTime_) && (freshReading_ || timedOut)) {
+      if(!freshReading_ && debug()) {
+        Serial.println("WARNING: No fresh meter data in this cycle");
+      }
+      if(freshReading_ || !(config_.policy & CONFIG_POLICY_SKIP_STALE) || skipped_ >= CONFIG_MAX_SKIPPED) {
+        send();
+        skipped_ = 0;
+      } else {
+        skipped_++;
+      }
+      lastSendTime_ = millis();
+      sleep_.cycleDone();
+      startCycle(lastSendTime_);
+    }
+
+    sleep_.idle();
+  }
+
+ private:
+  void startCycle(uint32_t now) {
+    cycleStart_ = now;
+    freshReading_ = false;
+    meter_.requestReading(now);
+  }
+
+  bool debug() const { return (config_.policy & CONFIG_POLICY_DEBUG) != 0; }
+
+  void reserveCounters() {
+    counterBound_ = packetCounter_ + COUNTER_BLOCK;
+    store_.saveCounter(counterBound_);
+  }
+
+  void send() {
+    const MeterRegisters &reg = meter_.registers();
+
+    meterData_.power_mw = (config_.obis & CONFIG_OBIS_POWER) ? saturateInt32(reg.power_mw) : 0;
+    meterData_.total_consumption_mwh = (config_.obis & CONFIG_OBIS_CONSUMPTION) ? reg.consumption_mwh : 0;
+    meterData_.total_generation_mwh = (config_.obis & CONFIG_OBIS_GENERATION) ? reg.generation_mwh : 0;
+    meterData_.battery_mv = getBatteryVoltage();
+    meterData_.packet_counter = ++packetCounter_;
+    if(packetCounter_ >= counterBound_) {
+      reserveCounters();
+    }
+
+    bool led = (config_.policy & CONFIG_POLICY_TX_LED) != 0;
+    if(led) {
+      digitalWrite(RGB, HIGH);
+    }
+    bool sent = transport_.send(meterData_);
+    if(led) {
+      digitalWrite(RGB, LOW);
+    }
+
+    // Flash is only written when a downlink actually changed something
+    if(sent && transport_.exchangeConfig(config_)) {
+      store_.save(config_);
+      transport_.configure(config_);
+      sleep_.configure(config_);
+    }
+  }
+
+  MeterSourceT &meter_;
+  TransportT &transport_;
+  SleepPolicyT &sleep_;
+  ConfigStoreT &store_;
+
+  NodeConfig config_ = nodeConfigDefaults();
+  MeterData meterData_ = {0, 0, 0, 0, 0};
+  uint32_t packetCounter_ = 0;
+  uint32_t counterBound_ = 0;
+  uint32_t cycleStart_ = 0;
+  uint32_t lastSendTime_ = 0;
+  uint8_t skipped_ = 0;
+  bool freshReading_ = false;
+  bool asleep_ = false;
+};
+
+#endif // FIRMWARE_H
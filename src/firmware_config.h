@@ -0,0 +1,36 @@
+/*
+ * Firmware Build Configuration
+ * Defaults for the build flags set per environment in platformio.ini
+ */
+
+#ifndef FIRMWARE_CONFIG_H
+#define FIRMWARE_CONFIG_H
+
+// Verbose serial output (costs awake time on battery)
+#ifndef DEBUG_MODE
+  #define DEBUG_MODE false
+#endif
+
+// Time between two transmissions in ms
+#ifndef SEND_INTERVAL
+  #define SEND_INTERVAL 60000
+#endif
+
+// Upper bound for waiting on a meter telegram within one cycle
+#ifndef METER_READ_TIMEOUT
+  #define METER_READ_TIMEOUT 5000
+#endif
+
+// Flash the RGB LED while a payload is handed to the transport
+#ifndef TX_LED
+  #define TX_LED false
+#endif
+
+// Node id in the payload header; 0 derives it from the chip ID
+#ifndef NODE_ID
+  #define NODE_ID 0
+#endif
+
+#define DEBUG_SERIAL_BAUD 115200
+
+#endif // FIRMWARE_CONFIG_H
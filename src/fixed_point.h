@@ -0,0 +1,112 @@
+/*
+ * Fixed-Point Helpers
+ * Integer-only scaling for meter registers (milli-units in int64)
+ *
+ * The CubeCell's Cortex-M0+ has no FPU, so all register values stay
+ * integers from the decoder to the radio. Only the gateway converts
+ * to float at the Home Assistant boundary.
+ */
+
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <stdint.h>
+
+// 10^0 .. 10^18, the full range of int64_t
+static constexpr int64_t POW10[] = {
+  1LL,
+  10LL,
+  100LL,
+  1000LL,
+  10000LL,
+  100000LL,
+  1000000LL,
+  10000000LL,
+  100000000LL,
+  1000000000LL,
+  10000000000LL,
+  100000000000LL,
+  1000000000000LL,
+  10000000000000LL,
+  100000000000000LL,
+  1000000000000000LL,
+  10000000000000000LL,
+  100000000000000000LL,
+  1000000000000000000LL
+};
+
+#define POW10_MAX_EXPONENT 18
+
+// value * 10^exponent, saturating at the int64_t range
+inline int64_t scalePow10(int64_t value, int8_t exponent) {
+  if(exponent >= 0) {
+    if(exponent > POW10_MAX_EXPONENT) {
+      return value == 0 ? 0 : (value > 0 ? INT64_MAX : INT64_MIN);
+    }
+    int64_t factor = POW10[exponent];
+    if(value > INT64_MAX / factor) {
+      return INT64_MAX;
+    }
+    if(value < INT64_MIN / factor) {
+      return INT64_MIN;
+    }
+    return value * factor;
+  }
+  if(exponent < -POW10_MAX_EXPONENT) {
+    return 0;
+  }
+  return value / POW10[-exponent];
+}
+
+// int64_t to int32_t, clamped to its range; power travels on air as
+// int32 mW (about +-2.1 MW)
+inline int32_t saturateInt32(int64_t value) {
+  if(value > INT32_MAX) {
+    return INT32_MAX;
+  }
+  if(value < INT32_MIN) {
+    return INT32_MIN;
+  }
+  return (int32_t)value;
+}
+
+// Convert a raw register with decimal scaler (value * 10^scaler in the
+// base unit) to milli-units: mW, mWh
+inline int64_t toMilli(int64_t value, int8_t scaler) {
+  return scalePow10(value, scaler + 3);
+}
+
+// Print a milli-unit value in a larger unit without float, e.g.
+// printFixed(Serial, 1234567890, 1000000, 3) prints "1234.567"
+template <class Out>
+void printFixed(Out &out, int64_t value, int64_t unit, uint8_t decimals) {
+  if(value < 0) {
+    out.print("-");
+    value = -value;
+  }
+  int64_t whole = value / unit;
+  int64_t fraction = value % unit;
+  out.print((unsigned long)whole);
+  if(decimals == 0) {
+    return;
+  }
+
+  // Keep the leading digits of the fraction
+  int64_t fractionUnit = unit;
+  uint8_t digits = 0;
+  while(fractionUnit > 1) {
+    fractionUnit /= 10;
+    digits++;
+  }
+  if(decimals > digits) {
+    decimals = digits;
+  }
+  fraction /= POW10[digits - decimals];
+
+  out.print(".");
+  for(int8_t d = decimals - 1; d >= 0; d--) {
+    out.print((unsigned long)((fraction / POW10[d]) % 10));
+  }
+}
+
+#endif // FIXED_POINT_H
@@ -0,0 +1,54 @@
+/*
+ * LoRa Radio Profiles and Time-on-Air
+ * Shared between CubeCell transmitter, LilyGo receiver and host tools
+ */
+
+#ifndef LORA_AIRTIME_H
+#define LORA_AIRTIME_H
+
+#include <stdint.h>
+
+// One modulation setting; bandwidth and coding rate use the CubeCell
+// radio API codes (bandwidth 0: 125 kHz, 1: 250 kHz, 2: 500 kHz;
+// coding rate 1: 4/5 .. 4: 4/8)
+struct LoRaProfile {
+  uint8_t spreading_factor;       // 7..12
+  uint8_t bandwidth;              // 0..2
+  uint8_t coding_rate;            // 1..4
+  int8_t tx_power;                // dBm
+};
+
+inline uint32_t loraBandwidthHz(uint8_t bandwidth) {
+  return bandwidth == 2 ? 500000 : (bandwidth == 1 ? 250000 : 125000);
+}
+
+// Symbol time in microseconds
+inline uint32_t loraSymbolTimeUs(uint8_t spreadingFactor, uint8_t bandwidth) {
+  return (uint32_t)(((uint64_t)1000000 << spreadingFactor) / loraBandwidthHz(bandwidth));
+}
+
+// Time-on-air in microseconds (Semtech AN1200.13), explicit header.
+// Low data rate optimization is enabled for symbols longer than 16 ms,
+// as both radios do automatically.
+inline uint32_t loraTimeOnAirUs(uint8_t spreadingFactor, uint8_t bandwidth, uint8_t codingRate,
+                                uint8_t payloadLength, uint16_t preambleLength = 8,
+                                bool crc = true) {
+  uint32_t symbolUs = loraSymbolTimeUs(spreadingFactor, bandwidth);
+  int32_t lowDataRate = symbolUs > 16000 ? 1 : 0;
+
+  int32_t numerator = 8 * (int32_t)payloadLength - 4 * (int32_t)spreadingFactor + 28 + (crc ? 16 : 0);
+  int32_t denominator = 4 * ((int32_t)spreadingFactor - 2 * lowDataRate);
+  int32_t blocks = numerator > 0 ? (numerator + denominator - 1) / denominator : 0;
+  uint32_t payloadSymbols = 8 + (uint32_t)blocks * (codingRate + 4);
+
+  // Preamble takes n + 4.25 symbols
+  uint32_t preambleUs = ((uint32_t)preambleLength * 4 + 17) * symbolUs / 4;
+  return preambleUs + payloadSymbols * symbolUs;
+}
+
+inline uint32_t loraTimeOnAirUs(const LoRaProfile &profile, uint8_t payloadLength) {
+  return loraTimeOnAirUs(profile.spreading_factor, profile.bandwidth, profile.coding_rate,
+                         payloadLength);
+}
+
+#endif // LORA_AIRTIME_H
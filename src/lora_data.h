@@ -11,12 +11,15 @@
 // Pack struct to ensure no padding bytes
 #pragma pack(push, 1)
 
-// Main meter data payload - 20 bytes total
+// Main meter data payload - 26 bytes total
+// Fixed-point milli-units end to end: the CubeCell has no FPU and the
+// energy counters must not lose resolution as they grow. Power fits
+// int32 (+/- 2.1 MW); the gateway converts to float only for Home Assistant.
 struct MeterData {
-  float power_watts;              // Current power in watts (can be negative for generation)
-  float total_consumption_kwh;    // Total consumption in kWh (OBIS 1.8.0)
-  float total_generation_kwh;     // Total generation in kWh (OBIS 2.8.0)
-  float battery_voltage;          // Battery voltage in volts
+  int32_t power_mw;               // Current power in mW (negative for generation)
+  int64_t total_consumption_mwh;  // Total consumption in mWh (OBIS 1.8.0)
+  int64_t total_generation_mwh;   // Total generation in mWh (OBIS 2.8.0)
+  uint16_t battery_mv;            // Battery voltage in mV
   uint32_t packet_counter;        // Packet counter to detect missed transmissions
 };
 
@@ -30,10 +33,30 @@ struct MeterDataWithLink {
 
 #pragma pack(pop)
 
+// Float conversions for the Home Assistant boundary and the Meshtastic
+// telemetry fields (meshtastic_telemetry.h).
+// Split into whole and fractional part so large counters keep their
+// resolution until the final float.
+inline float meterPowerWatts(int32_t power_mw) {
+  return power_mw / 1000.0f;
+}
+
+inline float meterEnergyKwh(int64_t energy_mwh) {
+  return (float)(energy_mwh / 1000000) + (float)(energy_mwh % 1000000) / 1000000.0f;
+}
+
+inline float meterBatteryVolts(uint16_t battery_mv) {
+  return battery_mv / 1000.0f;
+}
+
 // LoRa Configuration Parameters (must match on both devices)
 #define LORA_FREQUENCY      433000000  // 433 MHz (matching LilyGo hardware)
 #define LORA_BANDWIDTH      0           // 0: 125 kHz (good balance)
-#define LORA_SPREADING_FACTOR 7        // SF7 - back to working config
+// Nodes for a CAD-scanning gateway (scan_profiles) are built with their
+// own -D LORA_SPREADING_FACTOR and a longer -D LORA_PREAMBLE_LENGTH
+#ifndef LORA_SPREADING_FACTOR
+  #define LORA_SPREADING_FACTOR 7      // SF7 - back to working config
+#endif
 #define LORA_CODING_RATE    1          // 4/5 coding rate
 #define LORA_SYNC_WORD      0x12       // Default LoRa sync word (ESPHome limitation)
 
@@ -44,7 +67,9 @@ struct MeterDataWithLink {
   #define LORA_TX_POWER     20         // Default: Max power for international waters
 #endif
 
-#define LORA_PREAMBLE_LENGTH 8         // Standard preamble
+#ifndef LORA_PREAMBLE_LENGTH
+  #define LORA_PREAMBLE_LENGTH 8       // Standard preamble
+#endif
 
 // Timing Configuration
 #define LORA_TX_TIMEOUT     3000       // TX timeout in ms
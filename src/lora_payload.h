@@ -0,0 +1,162 @@
+/*
+ * LoRa Payload Framing
+ * Shared encoder/decoder for the CubeCell and every gateway variant
+ *
+ * Frame layout (little endian, no padding):
+ *   [0]     schema id          PAYLOAD_SCHEMA_*
+ *   [1]     schema version
+ *   [2..3]  node id            NODE_ID or derived from the chip ID
+ *   [4..]   body               MeterData for PAYLOAD_SCHEMA_METER v1 and v2
+ *   [n..]   tag                v2 only: 4-byte AES-CMAC, see meter_auth.h
+ *
+ * Every meter frame carries this header; a bare MeterData struct is not
+ * a reading, so no packet of the right length gets in without one.
+ *
+ * Every frame type starts with its schema id, and all but the range-test
+ * frames follow it with a version. Gateways pick the decoder by schema id
+ * (lora_receiver/payload_registry.h) and drop schemas and versions they
+ * do not know, so a new frame type or version never needs the existing
+ * nodes or gateways reflashed at the same time. Ids in use:
+ *   0x01        meter reading                this file
+ *   0x02, 0x03  config downlink and ack      config_downlink.h
+ *   0x04        node statistics block        reserved
+ *   0x05        batched meter samples        reserved
+ *   0x06        energy telemetry             reserved
+ *   0xA5, 0xA6  range-test announce, probe   range_sweep.h, no version
+ *   0xFF        Meshtastic broadcast         meshtastic_telemetry.h, no version
+ *
+ * Decoding never copies the frame: MeterPayloadView points into the
+ * receive buffer and reads each field with memcpy, so it is safe on any
+ * alignment. Header only, no Arduino dependencies (host benchmarks build
+ * it with plain g++).
+ */
+
+#ifndef LORA_PAYLOAD_H
+#define LORA_PAYLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "lora_data.h"
+
+#define PAYLOAD_SCHEMA_METER         0x01
+#define PAYLOAD_SCHEMA_CONFIG        0x02  // Gateway to node, config_downlink.h
+#define PAYLOAD_SCHEMA_CONFIG_ACK    0x03  // Node to gateway, config_downlink.h
+#define PAYLOAD_SCHEMA_NODE_STATS    0x04  // Reserved
+#define PAYLOAD_SCHEMA_METER_BATCH   0x05  // Reserved
+#define PAYLOAD_SCHEMA_TELEMETRY     0x06  // Reserved
+#define PAYLOAD_SCHEMA_MESHTASTIC    0xFF  // First byte of the broadcast address
+#define PAYLOAD_METER_VERSION        1
+#define PAYLOAD_METER_SIGNED_VERSION 2     // v1 plus a tag
+
+#define PAYLOAD_HEADER_SIZE    4
+#define PAYLOAD_METER_SIZE     (PAYLOAD_HEADER_SIZE + sizeof(MeterData))
+#define PAYLOAD_TAG_SIZE       4
+#define PAYLOAD_SIGNED_SIZE    (PAYLOAD_METER_SIZE + PAYLOAD_TAG_SIZE)
+#define PAYLOAD_MAX_SIZE       255
+
+enum PayloadStatus {
+  PAYLOAD_OK = 0,
+  PAYLOAD_TOO_SHORT,
+  PAYLOAD_UNKNOWN_SCHEMA,
+  PAYLOAD_UNSUPPORTED_VERSION,
+  PAYLOAD_BAD_LENGTH,
+  PAYLOAD_BAD_TAG,
+  PAYLOAD_UNKNOWN_KEY,
+  PAYLOAD_REPLAYED,
+  PAYLOAD_UNSIGNED,
+  PAYLOAD_MALFORMED,
+  PAYLOAD_UNKNOWN_NODE
+};
+
+inline const char *payloadStatusName(PayloadStatus status) {
+  switch(status) {
+    case PAYLOAD_OK: return "ok";
+    case PAYLOAD_TOO_SHORT: return "too short";
+    case PAYLOAD_UNKNOWN_SCHEMA: return "unknown schema";
+    case PAYLOAD_UNSUPPORTED_VERSION: return "unsupported version";
+    case PAYLOAD_BAD_LENGTH: return "bad length";
+    case PAYLOAD_BAD_TAG: return "bad tag";
+    case PAYLOAD_UNKNOWN_KEY: return "no key for node";
+    case PAYLOAD_REPLAYED: return "replayed counter";
+    case PAYLOAD_UNSIGNED: return "unsigned";
+    case PAYLOAD_MALFORMED: return "malformed";
+    case PAYLOAD_UNKNOWN_NODE: return "sender not listed";
+  }
+  return "?";
+}
+
+// Frame well-formed but not to be trusted
+inline bool payloadAuthError(PayloadStatus status) {
+  return status == PAYLOAD_BAD_TAG || status == PAYLOAD_UNKNOWN_KEY || status == PAYLOAD_REPLAYED ||
+         status == PAYLOAD_UNSIGNED || status == PAYLOAD_UNKNOWN_NODE;
+}
+
+// Unaligned little-endian loads/stores (both MCUs and x86 are little endian)
+template <class T>
+inline T payloadLoad(const uint8_t *p) {
+  T value;
+  memcpy(&value, p, sizeof(T));
+  return value;
+}
+
+template <class T>
+inline uint8_t *payloadStore(uint8_t *p, T value) {
+  memcpy(p, &value, sizeof(T));
+  return p + sizeof(T);
+}
+
+// Read-only view of a validated meter frame inside a receive buffer. A
+// signed frame parses like any other; its tag is checked separately
+// (meter_auth.h) because that needs the node's key.
+class MeterPayloadView {
+ public:
+  static PayloadStatus parse(const uint8_t *data, size_t length, MeterPayloadView &view) {
+    if(length < PAYLOAD_HEADER_SIZE) {
+      return PAYLOAD_TOO_SHORT;
+    }
+    if(data[0] != PAYLOAD_SCHEMA_METER) {
+      return PAYLOAD_UNKNOWN_SCHEMA;
+    }
+    if(data[1] != PAYLOAD_METER_VERSION && data[1] != PAYLOAD_METER_SIGNED_VERSION) {
+      return PAYLOAD_UNSUPPORTED_VERSION;
+    }
+    if(length != (data[1] == PAYLOAD_METER_SIGNED_VERSION ? PAYLOAD_SIGNED_SIZE : PAYLOAD_METER_SIZE)) {
+      return PAYLOAD_BAD_LENGTH;
+    }
+    view.body_ = data + PAYLOAD_HEADER_SIZE;
+    view.version_ = data[1];
+    view.nodeId_ = payloadLoad<uint16_t>(data + 2);
+    return PAYLOAD_OK;
+  }
+
+  uint8_t version() const { return version_; }
+  bool isSigned() const { return version_ == PAYLOAD_METER_SIGNED_VERSION; }
+  uint16_t nodeId() const { return nodeId_; }
+
+  int32_t powerMw() const { return payloadLoad<int32_t>(body_ + offsetof(MeterData, power_mw)); }
+  int64_t consumptionMwh() const { return payloadLoad<int64_t>(body_ + offsetof(MeterData, total_consumption_mwh)); }
+  int64_t generationMwh() const { return payloadLoad<int64_t>(body_ + offsetof(MeterData, total_generation_mwh)); }
+  uint16_t batteryMv() const { return payloadLoad<uint16_t>(body_ + offsetof(MeterData, battery_mv)); }
+  uint32_t packetCounter() const { return payloadLoad<uint32_t>(body_ + offsetof(MeterData, packet_counter)); }
+
+  // Copy out, e.g. to keep the last reading after the buffer is reused
+  void copyTo(MeterData &data) const { memcpy(&data, body_, sizeof(MeterData)); }
+
+ private:
+  const uint8_t *body_ = nullptr;
+  uint8_t version_ = 0;
+  uint16_t nodeId_ = 0;
+};
+
+// Encode a meter frame; out must hold PAYLOAD_METER_SIZE bytes
+inline size_t encodeMeterPayload(uint8_t *out, uint16_t nodeId, const MeterData &data) {
+  uint8_t *p = out;
+  *p++ = PAYLOAD_SCHEMA_METER;
+  *p++ = PAYLOAD_METER_VERSION;
+  p = payloadStore<uint16_t>(p, nodeId);
+  memcpy(p, &data, sizeof(MeterData));
+  return PAYLOAD_METER_SIZE;
+}
+
+#endif // LORA_PAYLOAD_H
@@ -0,0 +1,399 @@
+/*
+ * Meshtastic Telemetry Frames
+ * MeterData as a Meshtastic telemetry packet, shared by the CubeCell and
+ * the gateways
+ *
+ * Frame layout, as a Meshtastic node puts it on air:
+ *   [0..3]    to                 MESHTASTIC_BROADCAST
+ *   [4..7]    from               node number: the node id
+ *   [8..11]   packet id          packet counter, persisted: with the
+ *                                sender it is the CTR nonce
+ *   [12]      flags              hop limit, hop start
+ *   [13]      channel hash       xor of channel name and key bytes
+ *   [14..15]  next hop, relay    0
+ *   [16..]    Data protobuf      AES-128-CTR with the channel key
+ *
+ * Data is {portnum: TELEMETRY_APP, payload: Telemetry}, and Telemetry
+ * carries one PowerMetrics. Meshtastic has no meter fields, so the
+ * readings ride in its channels, all floats:
+ *   ch1_voltage  battery in V        ch1_current  power in W
+ *   ch2_voltage  consumption in kWh  ch2_current  generation in kWh
+ * A float keeps 24 bits, so energy counters above 16 777 kWh lose Wh
+ * resolution (bench_meshtastic reports the error). The channel key only
+ * hides the readings from whoever lacks it; CTR has no tag, so unlike
+ * meter_auth.h nothing here proves where a frame came from.
+ *
+ * Encoding is hand-rolled protobuf into the caller's buffer: no heap, no
+ * nanopb, nested lengths back-filled since none exceeds 127 bytes. The
+ * decoder skips fields it does not know. Radio settings stay those of
+ * lora_data.h; talking to Meshtastic nodes also takes their modem preset
+ * and sync word 0x2B. Header only, no Arduino dependencies.
+ */
+
+#ifndef MESHTASTIC_TELEMETRY_H
+#define MESHTASTIC_TELEMETRY_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "aes_cmac.h"
+#include "lora_data.h"
+#include "lora_payload.h"
+
+#define MESHTASTIC_HEADER_SIZE     16
+#define MESHTASTIC_BROADCAST       0xFFFFFFFFu
+#define MESHTASTIC_MAX_SIZE        64     // Header and Data of one reading, with room
+#define MESHTASTIC_PORT_TELEMETRY  67     // PortNum.TELEMETRY_APP
+
+// "LongFast" with the default key (PSK "AQ==")
+#define MESHTASTIC_DEFAULT_CHANNEL "LongFast"
+#define MESHTASTIC_DEFAULT_KEY \
+  0xd4, 0xf1, 0xbb, 0x3a, 0x20, 0x29, 0x07, 0x59, 0xf0, 0xbc, 0xff, 0xab, 0xcf, 0x4e, 0x69, 0x01
+
+// Field numbers of meshtastic/protobufs mesh.proto and telemetry.proto
+#define PB_DATA_PORTNUM            1
+#define PB_DATA_PAYLOAD            2
+#define PB_TELEMETRY_POWER_METRICS 5
+#define PB_POWER_CH1_VOLTAGE       1
+#define PB_POWER_CH1_CURRENT       2
+#define PB_POWER_CH2_VOLTAGE       3
+#define PB_POWER_CH2_CURRENT       4
+
+#define PB_WIRE_VARINT  0
+#define PB_WIRE_FIXED64 1
+#define PB_WIRE_BYTES   2
+#define PB_WIRE_FIXED32 5
+
+// Protobuf writer over a fixed buffer; ok() turns false once a write
+// did not fit, and stays false
+class PbWriter {
+ public:
+  PbWriter(uint8_t *out, size_t size) : p_(out), start_(out), end_(out + size) {}
+
+  void varint(uint32_t value) {
+    while(value >= 0x80) {
+      put((uint8_t)(value | 0x80));
+      value >>= 7;
+    }
+    put((uint8_t)value);
+  }
+
+  void tag(uint8_t field, uint8_t wireType) { varint((uint32_t)(field << 3 | wireType)); }
+
+  void fixed32(uint8_t field, uint32_t value) {
+    tag(field, PB_WIRE_FIXED32);
+    if(end_ - p_ < 4) {
+      ok_ = false;
+      return;
+    }
+    p_ = payloadStore<uint32_t>(p_, value);
+  }
+
+  void floatField(uint8_t field, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    fixed32(field, bits);
+  }
+
+  // Nested message or bytes: begin() returns the mark for end(), which
+  // fills in the length
+  uint8_t *begin(uint8_t field) {
+    tag(field, PB_WIRE_BYTES);
+    uint8_t *mark = p_;
+    put(0);
+    return mark;
+  }
+
+  void end(uint8_t *mark) {
+    size_t length = p_ - mark - 1;
+    if(length > 127) {
+      ok_ = false;
+      return;
+    }
+    if(ok_) {
+      *mark = (uint8_t)length;
+    }
+  }
+
+  bool ok() const { return ok_; }
+  size_t length() const { return p_ - start_; }
+
+ private:
+  void put(uint8_t byte) {
+    if(p_ >= end_) {
+      ok_ = false;
+      return;
+    }
+    *p_++ = byte;
+  }
+
+  uint8_t *p_;
+  uint8_t *start_;
+  uint8_t *end_;
+  bool ok_ = true;
+};
+
+// Protobuf reader over a received message; next() false at the end or
+// on a malformed field, see ok()
+class PbReader {
+ public:
+  PbReader(const uint8_t *data, size_t length) : p_(data), end_(data + length) {}
+
+  bool next(uint8_t &field, uint8_t &wireType) {
+    if(p_ >= end_) {
+      return false;
+    }
+    uint32_t key;
+    if(!readVarint(key) || (key >> 3) == 0 || (key >> 3) > 255) {
+      ok_ = false;
+      return false;
+    }
+    field = (uint8_t)(key >> 3);
+    wireType = (uint8_t)(key & 7);
+    return true;
+  }
+
+  bool varint(uint32_t &value) { return readVarint(value) || fail(); }
+
+  bool fixed32(uint32_t &value) {
+    if(end_ - p_ < 4) {
+      return fail();
+    }
+    value = payloadLoad<uint32_t>(p_);
+    p_ += 4;
+    return true;
+  }
+
+  bool floatValue(float &value) {
+    uint32_t bits;
+    if(!fixed32(bits)) {
+      return false;
+    }
+    memcpy(&value, &bits, sizeof(value));
+    return true;
+  }
+
+  // Length-delimited field as its own reader
+  bool bytes(PbReader &inner) {
+    uint32_t length;
+    if(!readVarint(length) || length > (uint32_t)(end_ - p_)) {
+      return fail();
+    }
+    inner = PbReader(p_, length);
+    p_ += length;
+    return true;
+  }
+
+  bool skip(uint8_t wireType) {
+    uint32_t value;
+    PbReader inner(nullptr, 0);
+    switch(wireType) {
+      case PB_WIRE_VARINT: return varint(value);
+      case PB_WIRE_FIXED32: return fixed32(value);
+      case PB_WIRE_FIXED64: return fixed32(value) && fixed32(value);
+      case PB_WIRE_BYTES: return bytes(inner);
+    }
+    return fail();
+  }
+
+  bool ok() const { return ok_; }
+
+ private:
+  bool readVarint(uint32_t &value) {
+    value = 0;
+    for(uint8_t shift = 0; shift < 35 && p_ < end_; shift += 7) {
+      uint8_t byte = *p_++;
+      value |= (uint32_t)(byte & 0x7F) << shift;
+      if(!(byte & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool fail() {
+    ok_ = false;
+    return false;
+  }
+
+  const uint8_t *p_;
+  const uint8_t *end_;
+  bool ok_ = true;
+};
+
+// Channel key and hash; the key schedule is expanded once
+class MeshtasticChannel {
+ public:
+  void set(const char *name, const uint8_t key[AES_KEY_SIZE]) {
+    aes_.setKey(key);
+    hash_ = 0;
+    for(const char *c = name; *c != '\0'; c++) {
+      hash_ ^= (uint8_t)*c;
+    }
+    for(uint8_t i = 0; i < AES_KEY_SIZE; i++) {
+      hash_ ^= key[i];
+    }
+  }
+
+  uint8_t hash() const { return hash_; }
+
+  // Both directions. Nonce: packet id as 64 bit, sender, then a 32-bit
+  // big-endian block counter
+  void crypt(uint32_t packetId, uint32_t from, uint8_t *data, size_t length) const {
+    uint8_t nonce[AES_BLOCK_SIZE] = {0};
+    payloadStore<uint32_t>(nonce, packetId);
+    payloadStore<uint32_t>(nonce + 8, from);
+    for(size_t offset = 0; offset < length; offset += AES_BLOCK_SIZE) {
+      uint8_t stream[AES_BLOCK_SIZE];
+      memcpy(stream, nonce, AES_BLOCK_SIZE);
+      aes_.encrypt(stream);
+      for(size_t i = 0; i < AES_BLOCK_SIZE && offset + i < length; i++) {
+        data[offset + i] ^= stream[i];
+      }
+      for(uint8_t i = AES_BLOCK_SIZE - 1; i >= AES_BLOCK_SIZE - 4; i--) {
+        if(++nonce[i] != 0) {
+          break;
+        }
+      }
+    }
+  }
+
+ private:
+  Aes128 aes_;
+  uint8_t hash_ = 0;
+};
+
+// What a telemetry frame carries, back in the units of MeterData
+struct MeshtasticReading {
+  uint32_t from;
+  MeterData data;
+};
+
+// Decrypted garbage rarely parses, but when it does the floats are wild
+inline bool meshtasticValuesValid(const float values[4]) {
+  for(uint8_t i = 0; i < 4; i++) {
+    if(!isfinite(values[i])) {
+      return false;
+    }
+  }
+  return values[0] >= 0.0f && values[0] < 65.0f && fabsf(values[1]) < 2147483.0f && values[2] >= 0.0f &&
+         values[2] < 1e12f && values[3] >= 0.0f && values[3] < 1e12f;
+}
+
+// out must hold MESHTASTIC_MAX_SIZE bytes; 0 if the message did not fit
+inline size_t encodeMeshtasticTelemetry(uint8_t *out, const MeshtasticChannel &channel, uint32_t from,
+                                        uint8_t hopLimit, const MeterData &data) {
+  uint8_t *p = out;
+  p = payloadStore<uint32_t>(p, MESHTASTIC_BROADCAST);
+  p = payloadStore<uint32_t>(p, from);
+  p = payloadStore<uint32_t>(p, data.packet_counter);
+  *p++ = (uint8_t)((hopLimit & 7) | (hopLimit & 7) << 5);
+  *p++ = channel.hash();
+  *p++ = 0;
+  *p++ = 0;
+
+  PbWriter pb(p, MESHTASTIC_MAX_SIZE - MESHTASTIC_HEADER_SIZE);
+  pb.tag(PB_DATA_PORTNUM, PB_WIRE_VARINT);
+  pb.varint(MESHTASTIC_PORT_TELEMETRY);
+  uint8_t *telemetry = pb.begin(PB_DATA_PAYLOAD);
+  uint8_t *power = pb.begin(PB_TELEMETRY_POWER_METRICS);
+  pb.floatField(PB_POWER_CH1_VOLTAGE, meterBatteryVolts(data.battery_mv));
+  pb.floatField(PB_POWER_CH1_CURRENT, meterPowerWatts(data.power_mw));
+  pb.floatField(PB_POWER_CH2_VOLTAGE, meterEnergyKwh(data.total_consumption_mwh));
+  pb.floatField(PB_POWER_CH2_CURRENT, meterEnergyKwh(data.total_generation_mwh));
+  pb.end(power);
+  pb.end(telemetry);
+  if(!pb.ok()) {
+    return 0;
+  }
+  channel.crypt(data.packet_counter, from, p, pb.length());
+  return MESHTASTIC_HEADER_SIZE + pb.length();
+}
+
+// Node number of a frame of more than MESHTASTIC_HEADER_SIZE bytes, in
+// the clear
+inline uint32_t meshtasticSender(const uint8_t *frame) { return payloadLoad<uint32_t>(frame + 4); }
+
+// Broadcasts on the channel with a PowerMetrics telemetry payload;
+// anything else is PAYLOAD_UNKNOWN_SCHEMA. A key with a colliding channel
+// hash decrypts to garbage, which fails as PAYLOAD_MALFORMED.
+inline PayloadStatus parseMeshtasticTelemetry(const uint8_t *frame, size_t length, const MeshtasticChannel &channel,
+                                              MeshtasticReading &reading) {
+  if(length <= MESHTASTIC_HEADER_SIZE) {
+    return PAYLOAD_TOO_SHORT;
+  }
+  if(length > MESHTASTIC_MAX_SIZE) {
+    return PAYLOAD_BAD_LENGTH;
+  }
+  if(payloadLoad<uint32_t>(frame) != MESHTASTIC_BROADCAST || frame[13] != channel.hash()) {
+    return PAYLOAD_UNKNOWN_SCHEMA;
+  }
+  uint32_t from = meshtasticSender(frame);
+  uint32_t packetId = payloadLoad<uint32_t>(frame + 8);
+  uint8_t plain[MESHTASTIC_MAX_SIZE];
+  size_t plainLength = length - MESHTASTIC_HEADER_SIZE;
+  memcpy(plain, frame + MESHTASTIC_HEADER_SIZE, plainLength);
+  channel.crypt(packetId, from, plain, plainLength);
+
+  uint32_t port = 0;
+  PbReader telemetry(nullptr, 0);
+  bool hasPayload = false;
+  PbReader data(plain, plainLength);
+  uint8_t field;
+  uint8_t wireType;
+  while(data.next(field, wireType)) {
+    if(field == PB_DATA_PORTNUM && wireType == PB_WIRE_VARINT) {
+      data.varint(port);
+    } else if(field == PB_DATA_PAYLOAD && wireType == PB_WIRE_BYTES) {
+      hasPayload = data.bytes(telemetry);
+    } else {
+      data.skip(wireType);
+    }
+  }
+  if(!data.ok()) {
+    return PAYLOAD_MALFORMED;
+  }
+  if(port != MESHTASTIC_PORT_TELEMETRY || !hasPayload) {
+    return PAYLOAD_UNKNOWN_SCHEMA;
+  }
+
+  PbReader power(nullptr, 0);
+  bool hasPower = false;
+  while(telemetry.next(field, wireType)) {
+    if(field == PB_TELEMETRY_POWER_METRICS && wireType == PB_WIRE_BYTES) {
+      hasPower = telemetry.bytes(power);
+    } else {
+      telemetry.skip(wireType);
+    }
+  }
+  if(!telemetry.ok()) {
+    return PAYLOAD_MALFORMED;
+  }
+  if(!hasPower) {
+    return PAYLOAD_UNKNOWN_SCHEMA;  // Device or environment metrics of a Meshtastic node
+  }
+
+  float values[4] = {0, 0, 0, 0};
+  while(power.next(field, wireType)) {
+    if(field >= PB_POWER_CH1_VOLTAGE && field <= PB_POWER_CH2_CURRENT && wireType == PB_WIRE_FIXED32) {
+      power.floatValue(values[field - PB_POWER_CH1_VOLTAGE]);
+    } else {
+      power.skip(wireType);
+    }
+  }
+  if(!power.ok() || !meshtasticValuesValid(values)) {
+    return PAYLOAD_MALFORMED;
+  }
+
+  reading.from = from;
+  MeterData &out = reading.data;
+  out.battery_mv = (uint16_t)lroundf(values[0] * 1000.0f);
+  out.power_mw = (int32_t)lroundf(values[1] * 1000.0f);
+  out.total_consumption_mwh = llround((double)values[2] * 1000000.0);
+  out.total_generation_mwh = llround((double)values[3] * 1000000.0);
+  out.packet_counter = packetId;
+  return PAYLOAD_OK;
+}
+
+#endif // MESHTASTIC_TELEMETRY_H
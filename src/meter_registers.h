@@ -0,0 +1,20 @@
+/*
+ * Meter Register Set
+ * Common result of all meter protocol decoders (SML, IEC 62056-21 D0)
+ *
+ * Values are fixed-point integers in milli-units so cumulative counters
+ * keep full meter resolution however large they grow.
+ */
+
+#ifndef METER_REGISTERS_H
+#define METER_REGISTERS_H
+
+#include <stdint.h>
+
+struct MeterRegisters {
+  int64_t power_mw;               // OBIS 16.7.0 in mW (negative for generation)
+  int64_t consumption_mwh;        // OBIS 1.8.0 in mWh
+  int64_t generation_mwh;         // OBIS 2.8.0 in mWh
+};
+
+#endif // METER_REGISTERS_H
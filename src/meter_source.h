@@ -0,0 +1,212 @@
+/*
+ * Meter Source Interface
+ * Couples a serial port with a streaming protocol decoder
+ *
+ * Every meter source provides the same duck-typed interface so the
+ * firmware can switch protocols without virtual dispatch:
+ *
+ *   void begin();                          // open the optical port
+ *   void requestReading(uint32_t now);     // start a readout (no-op for push meters)
+ *   bool poll(uint32_t now);               // true once a complete telegram was decoded
+ *   const MeterRegisters &registers() const;
+ *
+ * Port is any Arduino-style serial class (softSerial, HardwareSerial)
+ * providing begin(baud), available(), read(), write(byte) and flush().
+ */
+
+#ifndef METER_SOURCE_H
+#define METER_SOURCE_H
+
+#include <stdint.h>
+#include "meter_registers.h"
+#include "sml_decoder.h"
+#include "d0_decoder.h"
+
+#define METER_PROTOCOL_SML       0
+#define METER_PROTOCOL_D0        1
+#define METER_PROTOCOL_TEST_RAMP 2
+
+// SML meters push a telegram every 1-4 seconds at a fixed 9600 baud
+#define SML_BAUD 9600
+
+// IEC 62056-21 mode C: sign-on at 300 baud, then switch to the rate the
+// meter offers in its identification message, capped at D0_MAX_BAUD_CHAR
+#define D0_SIGNON_BAUD      300
+#ifndef D0_MAX_BAUD_CHAR
+  #define D0_MAX_BAUD_CHAR  '5'        // '5' = 9600 baud (softSerial limit)
+#endif
+
+// Timeouts follow from the characters on the wire: 7E1 is 10 bits per
+// character, about 30 characters/s at 300 baud
+#define D0_CHAR_BITS        10
+#define D0_TRANSFER_MS(chars, baud) ((chars) * D0_CHAR_BITS * 1000L / (baud))
+#define D0_RESPONSE_TIME    1500       // Meter answers within 1.5 s (t_r max)
+#define D0_SIGNON_CHARS     5          // "/?!<CR><LF>"
+#define D0_IDENT_CHARS      23         // "/XXXZ", 16 identification characters, CR LF
+#define D0_ACK_CHARS        6          // "<ACK>0Z0<CR><LF>", sent at the sign-on rate
+#ifndef D0_READOUT_CHARS
+  #define D0_READOUT_CHARS  400        // Expected data block, a dozen OBIS lines
+#endif
+// From the sign-on request until the identification is in
+#define D0_IDENT_TIMEOUT \
+  (D0_RESPONSE_TIME + D0_TRANSFER_MS(D0_SIGNON_CHARS + D0_IDENT_CHARS, D0_SIGNON_BAUD))
+// From the identification until the data block is in at the negotiated
+// rate, 15 s at 300 baud for mode A/B meters, 2.1 s at 9600
+#define D0_READOUT_TIMEOUT(baud) \
+  (D0_TRANSFER_MS(D0_ACK_CHARS, D0_SIGNON_BAUD) + D0_RESPONSE_TIME + D0_TRANSFER_MS(D0_READOUT_CHARS, baud))
+// Sign-on to telegram for a meter that stays at 300 baud; the firmware's
+// METER_READ_TIMEOUT must not be shorter
+#define D0_CYCLE_TIMEOUT    (D0_IDENT_TIMEOUT + D0_READOUT_TIMEOUT(D0_SIGNON_BAUD))
+
+template <class Port>
+class SmlMeterSource {
+ public:
+  explicit SmlMeterSource(Port &port) : port_(port) {}
+
+  void begin() { port_.begin(SML_BAUD); }
+
+  // SML meters transmit on their own, nothing to request
+  void requestReading(uint32_t now) { (void)now; }
+
+  bool poll(uint32_t now) {
+    (void)now;
+    bool complete = false;
+    while(port_.available()) {
+      if(decoder_.feed((uint8_t)port_.read())) {
+        complete = true;
+      }
+    }
+    return complete;
+  }
+
+  const MeterRegisters &registers() const { return decoder_.registers(); }
+
+ private:
+  Port &port_;
+  SmlDecoder decoder_;
+};
+
+template <class Port>
+class D0MeterSource {
+ public:
+  explicit D0MeterSource(Port &port) : port_(port) {}
+
+  void begin() { port_.begin(D0_SIGNON_BAUD); }
+
+  // Send the mode C sign-on request "/?!<CR><LF>" at 300 baud
+  void requestReading(uint32_t now) {
+    if(state_ != IDLE) {
+      return;
+    }
+    port_.begin(D0_SIGNON_BAUD);
+    decoder_.reset();
+    writeString("/?!\r\n");
+    state_ = WAIT_IDENT;
+    stateStart_ = now;
+  }
+
+  bool poll(uint32_t now) {
+    while(port_.available()) {
+      D0Decoder::Event event = decoder_.feed((uint8_t)port_.read());
+
+      if(event == D0Decoder::EVENT_IDENT && state_ == WAIT_IDENT) {
+        acknowledge();
+        state_ = READOUT;
+        stateStart_ = now;
+      } else if(event == D0Decoder::EVENT_TELEGRAM) {
+        state_ = IDLE;
+        return true;
+      } else if(event == D0Decoder::EVENT_ERROR) {
+        state_ = IDLE;
+        return false;
+      }
+    }
+
+    if(state_ == WAIT_IDENT && now - stateStart_ > D0_IDENT_TIMEOUT) {
+      state_ = IDLE;
+    } else if(state_ == READOUT && now - stateStart_ > D0_READOUT_TIMEOUT(baudRate_)) {
+      state_ = IDLE;
+    }
+    return false;
+  }
+
+  const MeterRegisters &registers() const { return decoder_.registers(); }
+
+  // Baud rate negotiated in the last readout (300 if the meter offered none)
+  uint32_t baudRate() const { return baudRate_; }
+
+ private:
+  enum State { IDLE, WAIT_IDENT, READOUT };
+
+  // Acknowledge with "<ACK>0Z0<CR><LF>": normal protocol, baud char Z,
+  // data readout mode. Both sides switch baud rate after the ACK.
+  void acknowledge() {
+    char z = decoder_.baudChar();
+    if(z < '0' || z > '6') {
+      z = '0';  // Mode A/B meter or unknown, stay at 300 baud
+    }
+    if(z > D0_MAX_BAUD_CHAR) {
+      z = D0_MAX_BAUD_CHAR;
+    }
+
+    const char ack[] = {0x06, '0', z, '0', '\r', '\n', 0};
+    writeString(ack);
+    port_.flush();
+
+    baudRate_ = d0BaudRate(z);
+    port_.begin(baudRate_);
+  }
+
+  // D0 uses 7E1 framing; an 8N1 port sends the same bits when the
+  // even parity bit is placed in bit 7
+  void writeString(const char *s) {
+    while(*s) {
+      port_.write(d0EvenParity((uint8_t)*s++));
+    }
+  }
+
+  Port &port_;
+  D0Decoder decoder_;
+  State state_ = IDLE;
+  uint32_t stateStart_ = 0;
+  uint32_t baudRate_ = D0_SIGNON_BAUD;
+};
+
+// Synthetic readings for range and bench tests: 0.0 -> 10.0 in 0.5 steps,
+// then wrap. Each requested reading advances the ramp by one step.
+class TestRampSource {
+ public:
+  void begin() {}
+
+  void requestReading(uint32_t now) {
+    (void)now;
+    pending_ = true;
+  }
+
+  bool poll(uint32_t now) {
+    (void)now;
+    if(!pending_) {
+      return false;
+    }
+    pending_ = false;
+
+    registers_.power_mw = step_ * 50000LL;            // 0-1000 W
+    registers_.consumption_mwh = step_ * 500000LL;    // 0-10 kWh
+    registers_.generation_mwh = step_ * 250000LL;     // 0-5 kWh
+
+    step_++;
+    if(step_ > 20) {
+      step_ = 0;
+    }
+    return true;
+  }
+
+  const MeterRegisters &registers() const { return registers_; }
+
+ private:
+  MeterRegisters registers_ = {0, 0, 0};
+  uint8_t step_ = 0;
+  bool pending_ = false;
+};
+
+#endif // METER_SOURCE_H
@@ -0,0 +1,143 @@
+/*
+ * Node Runtime Configuration
+ * Settings the gateway can change over the air (config_downlink.h)
+ *
+ * The build flags in firmware_config.h and lora_data.h are the defaults;
+ * a downlink overrides single fields and the node keeps the result in
+ * its config store across reboots. Header only, no Arduino dependencies
+ * (the gateway and the host tools build it too).
+ */
+
+#ifndef NODE_CONFIG_H
+#define NODE_CONFIG_H
+
+#include <stdint.h>
+#include "firmware_config.h"
+#include "lora_data.h"
+
+// Send policy flags
+#define CONFIG_POLICY_DEBUG      0x01  // Verbose serial output
+#define CONFIG_POLICY_TX_LED     0x02  // Flash the RGB LED while sending
+#define CONFIG_POLICY_SKIP_STALE 0x04  // No uplink in cycles without a fresh telegram
+#define CONFIG_POLICY_ALL        0x07
+
+// Registers copied into the meter payload; the others are sent as 0,
+// e.g. 2.8.0 on a meter without generation
+#define CONFIG_OBIS_POWER        0x01  // 16.7.0
+#define CONFIG_OBIS_CONSUMPTION  0x02  // 1.8.0
+#define CONFIG_OBIS_GENERATION   0x04  // 2.8.0
+#define CONFIG_OBIS_ALL          0x07
+
+// A node skipping stale cycles still sends every CONFIG_MAX_SKIPPED + 1
+// cycles, so a broken meter cannot make it unreachable for downlinks
+#define CONFIG_MAX_SKIPPED 9
+
+#define CONFIG_INTERVAL_MIN_S  10
+#define CONFIG_TX_POWER_MIN    -9     // SX1262 low power PA
+#define CONFIG_TX_POWER_MAX    22
+
+struct NodeConfig {
+  uint32_t send_interval_ms;
+  int8_t tx_power;                // dBm
+  uint8_t spreading_factor;
+  uint8_t policy;                 // CONFIG_POLICY_* flags
+  uint8_t obis;                   // CONFIG_OBIS_* registers
+  uint16_t sequence;              // Last applied downlink, 0 before the first
+};
+
+inline NodeConfig nodeConfigDefaults() {
+  NodeConfig config;
+  config.send_interval_ms = SEND_INTERVAL;
+  config.tx_power = LORA_TX_POWER;
+  config.spreading_factor = LORA_SPREADING_FACTOR;
+  config.policy = (DEBUG_MODE ? CONFIG_POLICY_DEBUG : 0) | (TX_LED ? CONFIG_POLICY_TX_LED : 0);
+  config.obis = CONFIG_OBIS_ALL;
+  config.sequence = 0;
+  return config;
+}
+
+// Fields of a ConfigChange
+#define CONFIG_FIELD_INTERVAL    0x01
+#define CONFIG_FIELD_TX_POWER    0x02
+#define CONFIG_FIELD_SF          0x04
+#define CONFIG_FIELD_POLICY      0x08
+#define CONFIG_FIELD_OBIS        0x10
+#define CONFIG_FIELD_ALL         0x1F
+
+// Subset of NodeConfig sent in one downlink; unset fields keep their value
+struct ConfigChange {
+  uint8_t fields;                 // CONFIG_FIELD_* present
+  uint16_t interval_s;
+  int8_t tx_power;
+  uint8_t spreading_factor;
+  uint8_t policy;
+  uint8_t obis;
+};
+
+inline bool configChangeValid(const ConfigChange &change) {
+  if(change.fields == 0 || (change.fields & ~CONFIG_FIELD_ALL) != 0) {
+    return false;
+  }
+  if((change.fields & CONFIG_FIELD_INTERVAL) && change.interval_s < CONFIG_INTERVAL_MIN_S) {
+    return false;
+  }
+  if((change.fields & CONFIG_FIELD_TX_POWER) &&
+     (change.tx_power < CONFIG_TX_POWER_MIN || change.tx_power > CONFIG_TX_POWER_MAX)) {
+    return false;
+  }
+  if((change.fields & CONFIG_FIELD_SF) && (change.spreading_factor < 7 || change.spreading_factor > 12)) {
+    return false;
+  }
+  if((change.fields & CONFIG_FIELD_POLICY) && (change.policy & ~CONFIG_POLICY_ALL) != 0) {
+    return false;
+  }
+  if((change.fields & CONFIG_FIELD_OBIS) && (change.obis & ~CONFIG_OBIS_ALL) != 0) {
+    return false;
+  }
+  return true;
+}
+
+// Later fields win; used by the gateway to fold queued changes together
+inline void mergeConfigChange(ConfigChange &into, const ConfigChange &change) {
+  if(change.fields & CONFIG_FIELD_INTERVAL) {
+    into.interval_s = change.interval_s;
+  }
+  if(change.fields & CONFIG_FIELD_TX_POWER) {
+    into.tx_power = change.tx_power;
+  }
+  if(change.fields & CONFIG_FIELD_SF) {
+    into.spreading_factor = change.spreading_factor;
+  }
+  if(change.fields & CONFIG_FIELD_POLICY) {
+    into.policy = change.policy;
+  }
+  if(change.fields & CONFIG_FIELD_OBIS) {
+    into.obis = change.obis;
+  }
+  into.fields |= change.fields;
+}
+
+inline void applyConfigChange(NodeConfig &config, const ConfigChange &change) {
+  if(change.fields & CONFIG_FIELD_INTERVAL) {
+    config.send_interval_ms = (uint32_t)change.interval_s * 1000;
+  }
+  if(change.fields & CONFIG_FIELD_TX_POWER) {
+    config.tx_power = change.tx_power;
+  }
+  if(change.fields & CONFIG_FIELD_SF) {
+    config.spreading_factor = change.spreading_factor;
+  }
+  if(change.fields & CONFIG_FIELD_POLICY) {
+    config.policy = change.policy;
+  }
+  if(change.fields & CONFIG_FIELD_OBIS) {
+    config.obis = change.obis;
+  }
+}
+
+// Sequence numbers wrap; a is newer than b within half the range
+inline bool configSequenceNewer(uint16_t a, uint16_t b) {
+  return (int16_t)(a - b) > 0;
+}
+
+#endif // NODE_CONFIG_H
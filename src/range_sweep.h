@@ -0,0 +1,111 @@
+/*
+ * Range / Link-Profile Sweep Protocol
+ * Shared between the CubeCell sweep transmitter and the gateway
+ *
+ * The node walks a grid of spreading factor x bandwidth x coding rate x
+ * TX power. For every profile it:
+ *   1. sends SWEEP_ANNOUNCE_REPEATS announce frames on the base profile
+ *      (lora_data.h), naming the profile and the number of probes,
+ *   2. waits SWEEP_SETTLE_MS for the gateway to retune,
+ *   3. sends SweepAnnounce::probes probe frames on the announced profile,
+ *      SweepAnnounce::interval_ms apart.
+ * The gateway follows the announce, counts the probes and returns to the
+ * base profile once the probe window has passed.
+ */
+
+#ifndef RANGE_SWEEP_H
+#define RANGE_SWEEP_H
+
+#include <stdint.h>
+#include "lora_airtime.h"
+#include "lora_payload.h"
+
+// Grid axes, overridable as comma separated build flags
+#ifndef SWEEP_SPREADING_FACTORS
+  #define SWEEP_SPREADING_FACTORS 7, 9, 12
+#endif
+#ifndef SWEEP_BANDWIDTHS
+  #define SWEEP_BANDWIDTHS 0, 1      // 125 kHz, 250 kHz
+#endif
+#ifndef SWEEP_CODING_RATES
+  #define SWEEP_CODING_RATES 1, 4    // 4/5, 4/8
+#endif
+#ifndef SWEEP_TX_POWERS
+  #define SWEEP_TX_POWERS 2, 14, 20
+#endif
+
+#ifndef SWEEP_PROBES_PER_PROFILE
+  #define SWEEP_PROBES_PER_PROFILE 20
+#endif
+
+#define SWEEP_ANNOUNCE_REPEATS 3
+#define SWEEP_ANNOUNCE_GAP_MS  250     // Between announce repeats
+#define SWEEP_SETTLE_MS        300     // Gateway retune time after the last announce
+#define SWEEP_GUARD_MS         2000    // Extra listening time on the gateway
+
+// Schema ids (lora_payload.h) without a version byte
+#define SWEEP_FRAME_ANNOUNCE 0xA5
+#define SWEEP_FRAME_PROBE    0xA6
+
+#pragma pack(push, 1)
+
+struct SweepAnnounce {
+  uint8_t frame_type;             // SWEEP_FRAME_ANNOUNCE
+  uint8_t sweep_id;               // Increments with every full pass over the grid
+  uint8_t profile_id;             // Index into the grid
+  uint8_t repeat;                 // 0..SWEEP_ANNOUNCE_REPEATS-1
+  LoRaProfile profile;            // Profile the probes will use
+  uint16_t probes;                // Number of probe frames that follow
+  uint16_t interval_ms;           // Spacing of the probe frames
+};
+
+#define SWEEP_PROBE_HEADER_SIZE 6
+
+// Padded to the unsigned meter frame so airtime and PER match production
+struct SweepProbe {
+  uint8_t frame_type;             // SWEEP_FRAME_PROBE
+  uint8_t sweep_id;
+  uint8_t profile_id;
+  uint8_t reserved;
+  uint16_t sequence;              // 0..probes-1
+  uint8_t padding[PAYLOAD_METER_SIZE - SWEEP_PROBE_HEADER_SIZE];
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(SweepProbe) == PAYLOAD_METER_SIZE, "SweepProbe must be as long as a meter frame");
+
+static const uint8_t sweepSpreadingFactors[] = {SWEEP_SPREADING_FACTORS};
+static const uint8_t sweepBandwidths[] = {SWEEP_BANDWIDTHS};
+static const uint8_t sweepCodingRates[] = {SWEEP_CODING_RATES};
+static const int8_t sweepTxPowers[] = {SWEEP_TX_POWERS};
+
+#define SWEEP_COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+inline uint16_t sweepProfileCount() {
+  return SWEEP_COUNT(sweepSpreadingFactors) * SWEEP_COUNT(sweepBandwidths) *
+         SWEEP_COUNT(sweepCodingRates) * SWEEP_COUNT(sweepTxPowers);
+}
+
+// Profile for a grid index; TX power varies fastest so the gateway's
+// receive configuration changes as rarely as possible
+inline LoRaProfile sweepProfile(uint16_t index) {
+  LoRaProfile profile;
+  profile.tx_power = sweepTxPowers[index % SWEEP_COUNT(sweepTxPowers)];
+  index /= SWEEP_COUNT(sweepTxPowers);
+  profile.coding_rate = sweepCodingRates[index % SWEEP_COUNT(sweepCodingRates)];
+  index /= SWEEP_COUNT(sweepCodingRates);
+  profile.bandwidth = sweepBandwidths[index % SWEEP_COUNT(sweepBandwidths)];
+  index /= SWEEP_COUNT(sweepBandwidths);
+  profile.spreading_factor = sweepSpreadingFactors[index % SWEEP_COUNT(sweepSpreadingFactors)];
+  return profile;
+}
+
+// Probe spacing: airtime plus margin, at least 200 ms
+inline uint16_t sweepProbeInterval(const LoRaProfile &profile) {
+  uint32_t airtimeMs = loraTimeOnAirUs(profile, sizeof(SweepProbe)) / 1000;
+  uint32_t interval = airtimeMs * 2 + 50;
+  return interval < 200 ? 200 : (uint16_t)interval;
+}
+
+#endif // RANGE_SWEEP_H
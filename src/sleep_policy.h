@@ -0,0 +1,93 @@
+/*
+ * Sleep Policies
+ * Decide when a cycle is due and how the CubeCell idles in between
+ *
+ *   void configure(const NodeConfig &config);    // send interval, debug output
+ *   void begin();
+ *   bool sleeping();                             // true while in low power
+ *   bool sendDue(uint32_t now, uint32_t last);   // may the current cycle send
+ *   void cycleDone();                            // called after each send
+ *   void idle();                                 // called on every loop pass
+ */
+
+#ifndef SLEEP_POLICY_H
+#define SLEEP_POLICY_H
+
+#include "Arduino.h"
+#include "firmware_config.h"
+#include "node_config.h"
+
+// USB powered: stay awake and send every send interval
+class AwakePolicy {
+ public:
+  void configure(const NodeConfig &config) { intervalMs_ = config.send_interval_ms; }
+
+  void begin() {}
+
+  bool sleeping() const { return false; }
+
+  bool sendDue(uint32_t now, uint32_t lastSend) const {
+    return now - lastSend >= intervalMs_;
+  }
+
+  void cycleDone() {}
+
+  void idle() { delay(10); }
+
+ private:
+  uint32_t intervalMs_ = SEND_INTERVAL;
+};
+
+// Battery powered: one cycle per wake-up, deep sleep until the timer fires
+static volatile bool deepSleepLowPower = false;
+static TimerEvent_t deepSleepTimer;
+static uint32_t deepSleepIntervalMs = SEND_INTERVAL;
+
+// A new interval takes effect when the running period ends
+static void onDeepSleepTimer() {
+  deepSleepLowPower = false;
+  TimerSetValue(&deepSleepTimer, deepSleepIntervalMs);
+  TimerStart(&deepSleepTimer);
+}
+
+class DeepSleepPolicy {
+ public:
+  void configure(const NodeConfig &config) {
+    deepSleepIntervalMs = config.send_interval_ms;
+    debug_ = (config.policy & CONFIG_POLICY_DEBUG) != 0;
+  }
+
+  void begin() {
+    TimerInit(&deepSleepTimer, onDeepSleepTimer);
+    TimerSetValue(&deepSleepTimer, deepSleepIntervalMs);
+    TimerStart(&deepSleepTimer);
+  }
+
+  bool sleeping() const { return deepSleepLowPower; }
+
+  // Woken by the timer, so every awake cycle sends
+  bool sendDue(uint32_t now, uint32_t lastSend) const {
+    (void)now;
+    (void)lastSend;
+    return true;
+  }
+
+  void cycleDone() {
+    if(debug_) {
+      Serial.println("Entering deep sleep...");
+      delay(10);
+    }
+    deepSleepLowPower = true;
+  }
+
+  void idle() {
+    if(deepSleepLowPower) {
+      lowPowerHandler();
+    }
+  }
+
+ private:
+  bool debug_ = DEBUG_MODE;
+};
+
+#endif // SLEEP_POLICY_H
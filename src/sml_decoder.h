@@ -0,0 +1,195 @@
+/*
+ * SML Streaming Decoder
+ * Collects one SML telegram byte by byte and extracts the OBIS registers
+ *
+ * Each register is an SML_ListEntry:
+ *   77                      list of 7 elements
+ *     07 01 00 01 08 00 FF  objName (OBIS 1-0:1.8.0*255)
+ *     65 00 00 01 82        status (optional)
+ *     01                    valTime (optional)
+ *     62 1E                 unit (30 = Wh, 27 = W)
+ *     52 FF                 scaler (int8, -1)
+ *     59 00 .. 00           value (int/uint, 1..8 bytes)
+ *     01                    valueSignature (optional)
+ */
+
+#ifndef SML_DECODER_H
+#define SML_DECODER_H
+
+#include <stdint.h>
+#include "meter_registers.h"
+#include "fixed_point.h"
+
+static const uint8_t SML_END[] = {0x1B, 0x1B, 0x1B, 0x1B, 0x1A};
+
+// objName octet strings including their TL byte
+static const uint8_t POWER_OBIS[] = {0x07, 0x01, 0x00, 0x10, 0x07, 0x00, 0xFF};
+static const uint8_t CONSUMPTION_OBIS[] = {0x07, 0x01, 0x00, 0x01, 0x08, 0x00, 0xFF};
+static const uint8_t GENERATION_OBIS[] = {0x07, 0x01, 0x00, 0x02, 0x08, 0x00, 0xFF};
+
+#define SML_TYPE_OCTET_STRING 0x0
+#define SML_TYPE_INTEGER      0x5
+#define SML_TYPE_UNSIGNED     0x6
+#define SML_TYPE_LIST         0x7
+
+class SmlDecoder {
+ public:
+  // Returns true when a complete telegram was decoded into registers()
+  bool feed(uint8_t inByte) {
+    if(bufferIndex_ < sizeof(buffer_)) {
+      buffer_[bufferIndex_++] = inByte;
+    }
+
+    if(!checkForEnd()) {
+      return false;
+    }
+
+    extractRegister(POWER_OBIS, registers_.power_mw);
+    extractRegister(CONSUMPTION_OBIS, registers_.consumption_mwh);
+    extractRegister(GENERATION_OBIS, registers_.generation_mwh);
+    bufferIndex_ = 0;
+    return true;
+  }
+
+  const MeterRegisters &registers() const { return registers_; }
+
+ private:
+  struct Tl {
+    uint8_t type;
+    uint16_t length;              // Total element length, or element count for lists
+    uint8_t headerLength;         // Number of TL bytes
+  };
+
+  bool checkForEnd() const {
+    if(bufferIndex_ < sizeof(SML_END)) {
+      return false;
+    }
+
+    for(uint8_t i = 0; i < sizeof(SML_END); i++) {
+      if(buffer_[bufferIndex_ - sizeof(SML_END) + i] != SML_END[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Parse a type-length field; multi-byte TL fields chain via bit 7
+  bool readTl(uint16_t pos, Tl &tl) const {
+    if(pos >= bufferIndex_) {
+      return false;
+    }
+    uint8_t b = buffer_[pos];
+    tl.type = (b >> 4) & 0x07;
+    tl.length = b & 0x0F;
+    tl.headerLength = 1;
+    while(b & 0x80) {
+      if(pos + tl.headerLength >= bufferIndex_ || tl.headerLength > 3) {
+        return false;
+      }
+      b = buffer_[pos + tl.headerLength];
+      tl.length = (tl.length << 4) | (b & 0x0F);
+      tl.headerLength++;
+    }
+    return true;
+  }
+
+  // Position after the element at pos, or 0 on malformed input
+  uint16_t skipElement(uint16_t pos, uint8_t depth = 0) const {
+    Tl tl;
+    if(depth > 4 || !readTl(pos, tl)) {
+      return 0;
+    }
+    if(tl.type == SML_TYPE_LIST) {
+      pos += tl.headerLength;
+      for(uint16_t i = 0; i < tl.length; i++) {
+        pos = skipElement(pos, depth + 1);
+        if(pos == 0) {
+          return 0;
+        }
+      }
+      return pos;
+    }
+    if(tl.length < tl.headerLength || pos + tl.length > bufferIndex_) {
+      return 0;
+    }
+    return pos + tl.length;
+  }
+
+  // Read a signed or unsigned integer of up to 8 bytes
+  bool readInteger(uint16_t pos, int64_t &value) const {
+    Tl tl;
+    if(!readTl(pos, tl)) {
+      return false;
+    }
+    if(tl.type != SML_TYPE_INTEGER && tl.type != SML_TYPE_UNSIGNED) {
+      return false;
+    }
+    uint8_t size = tl.length - tl.headerLength;
+    if(size == 0 || size > 8 || pos + tl.length > bufferIndex_) {
+      return false;
+    }
+
+    const uint8_t *p = &buffer_[pos + tl.headerLength];
+    uint64_t raw = 0;
+    for(uint8_t k = 0; k < size; k++) {
+      raw = (raw << 8) | p[k];
+    }
+
+    if(tl.type == SML_TYPE_INTEGER && (p[0] & 0x80) && size < 8) {
+      raw |= ~0ULL << (size * 8);  // Sign extension
+    } else if(tl.type == SML_TYPE_UNSIGNED && size == 8 && (raw >> 63)) {
+      raw = INT64_MAX;             // Beyond any real meter reading
+    }
+    value = (int64_t)raw;
+    return true;
+  }
+
+  // Find objName in the telegram, walk the list entry and store
+  // value * 10^scaler in milli-units. Keeps the old value if absent.
+  bool extractRegister(const uint8_t *obis, int64_t &out) const {
+    for(uint16_t i = 0; i + 7 < bufferIndex_; i++) {
+      bool found = true;
+      for(uint8_t j = 0; j < 7; j++) {
+        if(buffer_[i + j] != obis[j]) {
+          found = false;
+          break;
+        }
+      }
+      if(!found) {
+        continue;
+      }
+
+      uint16_t pos = i + 7;
+      pos = skipElement(pos);                  // status
+      if(pos) pos = skipElement(pos);          // valTime
+      if(pos) pos = skipElement(pos);          // unit
+      if(pos == 0) {
+        return false;
+      }
+
+      int64_t scaler = 0;
+      if(buffer_[pos] != 0x01 && !readInteger(pos, scaler)) {
+        return false;
+      }
+      pos = skipElement(pos);
+      if(pos == 0) {
+        return false;
+      }
+
+      int64_t value;
+      if(!readInteger(pos, value)) {
+        return false;
+      }
+
+      out = toMilli(value, (int8_t)scaler);
+      return true;
+    }
+    return false;
+  }
+
+  uint8_t buffer_[512];
+  uint16_t bufferIndex_ = 0;
+  MeterRegisters registers_ = {0, 0, 0};
+};
+
+#endif // SML_DECODER_H
@@ -0,0 +1,501 @@
+/*
+ * Transports
+ * Deliver one MeterData payload per cycle
+ *
+ *   void begin();
+ *   void configure(const NodeConfig &config);   // TX profile and debug output
+ *   bool send(const MeterData &data);   // true once the payload left the node
+ *   bool exchangeConfig(NodeConfig &config);    // after send(): true when a downlink changed config
+ */
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "Arduino.h"
+#include "LoRaWan_APP.h"
+#include "firmware_config.h"
+#include "lora_data.h"
+#include "lora_payload.h"
+#include "config_downlink.h"
+#include "meter_auth.h"
+#include "meshtastic_telemetry.h"
+#include "node_config.h"
+#include "fixed_point.h"
+#include "lora_airtime.h"
+#include "range_sweep.h"
+
+// Print a payload in human readable units (integer formatting only)
+inline void printMeterData(const MeterData &data) {
+  Serial.print("Packet #");
+  Serial.println(data.packet_counter);
+  Serial.print("Power: ");
+  if(data.power_mw < 0) {
+    Serial.print("Generating ");
+    printFixed(Serial, -(int64_t)data.power_mw, 1000, 1);
+  } else {
+    Serial.print("Consuming ");
+    printFixed(Serial, data.power_mw, 1000, 1);
+  }
+  Serial.println(" W");
+  Serial.print("Consumption (1.8.0): ");
+  printFixed(Serial, data.total_consumption_mwh, 1000000, 3);
+  Serial.println(" kWh");
+  Serial.print("Generation (2.8.0): ");
+  printFixed(Serial, data.total_generation_mwh, 1000000, 3);
+  Serial.println(" kWh");
+  Serial.print("Battery: ");
+  printFixed(Serial, data.battery_mv, 1000, 2);
+  Serial.println(" V");
+}
+
+// Serial-only output, e.g. to verify the IR head wiring
+class SerialTransport {
+ public:
+  void begin() {
+    Serial.println("Transport: serial only");
+  }
+
+  void configure(const NodeConfig &config) { (void)config; }
+
+  bool send(const MeterData &data) {
+    Serial.println("=== Meter Data ===");
+    printMeterData(data);
+    Serial.println("==================");
+    return true;
+  }
+
+  bool exchangeConfig(NodeConfig &config) {
+    (void)config;
+    return false;
+  }
+};
+
+// LoRa P2P uplink on the internal SX1262
+static RadioEvents_t loraRadioEvents;
+static volatile bool loraTxDone = false;
+static volatile bool loraTxTimeout = false;
+static uint32_t loraTxDoneAt = 0;
+
+static void onLoRaTxDone() {
+  loraTxDoneAt = millis();
+  loraTxDone = true;
+}
+
+static void onLoRaTxTimeout() {
+  loraTxTimeout = true;
+}
+
+// Downlink receive window (config_downlink.h)
+static volatile bool loraRxDone = false;
+static volatile bool loraRxEnded = false;
+static uint8_t loraRxFrame[CONFIG_DOWNLINK_MAX_SIZE];
+static uint8_t loraRxLength = 0;
+static TimerEvent_t loraWindowTimer;
+static volatile bool loraWindowOpen = false;
+
+// Longer frames are not downlinks; they end the window empty
+static void onLoRaRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr) {
+  (void)rssi;
+  (void)snr;
+  loraRxLength = size <= sizeof(loraRxFrame) ? (uint8_t)size : 0;
+  memcpy(loraRxFrame, payload, loraRxLength);
+  loraRxDone = true;
+}
+
+static void onLoRaRxEnded() {
+  loraRxEnded = true;
+}
+
+static void onLoRaWindowTimer() {
+  loraWindowOpen = true;
+}
+
+// Profile from lora_data.h that the gateway listens on by default
+static const LoRaProfile loraBaseProfile = {
+  LORA_SPREADING_FACTOR, LORA_BANDWIDTH, LORA_CODING_RATE, LORA_TX_POWER
+};
+
+static void configureLoRaTx(const LoRaProfile &profile) {
+  Radio.SetTxConfig(
+    MODEM_LORA,                // Modem type
+    profile.tx_power,          // TX power
+    0,                         // FSK frequency deviation (not used for LoRa)
+    profile.bandwidth,         // Bandwidth
+    profile.spreading_factor,  // Spreading factor
+    profile.coding_rate,       // Coding rate
+    LORA_PREAMBLE_LENGTH,      // Preamble length
+    false,                     // Fixed length packets
+    true,                      // CRC on
+    0,                         // Frequency hopping off
+    0,                         // Hop period (not used)
+    false,                     // IQ inversion off
+    LORA_TX_TIMEOUT            // TX timeout
+  );
+}
+
+static void initLoRaRadio() {
+  loraRadioEvents.TxDone = onLoRaTxDone;
+  loraRadioEvents.TxTimeout = onLoRaTxTimeout;
+  loraRadioEvents.RxDone = onLoRaRxDone;
+  loraRadioEvents.RxTimeout = onLoRaRxEnded;
+  loraRadioEvents.RxError = onLoRaRxEnded;
+  Radio.Init(&loraRadioEvents);
+  TimerInit(&loraWindowTimer, onLoRaWindowTimer);
+  Radio.SetChannel(LORA_FREQUENCY);
+  configureLoRaTx(loraBaseProfile);
+
+  // Sync word for private network
+  Radio.SetPublicNetwork(false);
+  Radio.Sleep();
+}
+
+// Send one frame and block until TX done or timeout; radio sleeps afterwards
+static bool loraSendBlocking(const uint8_t *data, uint8_t length) {
+  loraTxDone = false;
+  loraTxTimeout = false;
+  Radio.Send((uint8_t *)data, length);
+
+  uint32_t startTime = millis();
+  while(!loraTxDone && !loraTxTimeout && (millis() - startTime < LORA_TX_TIMEOUT + 1000)) {
+    Radio.IrqProcess();
+    delay(1);
+  }
+
+  Radio.Sleep();
+  return loraTxDone;
+}
+
+// The receive window DOWNLINK_RX_DELAY_MS after the last TX done, on the
+// profile of that TX. The MCU sleeps until it opens; the radio gives up
+// when no preamble starts within the margin. Returns the frame length,
+// 0 when nothing arrived.
+static uint8_t loraReceiveWindow(const LoRaProfile &profile) {
+  uint32_t elapsed = millis() - loraTxDoneAt;
+  if(elapsed < DOWNLINK_RX_DELAY_MS - DOWNLINK_RX_MARGIN_MS) {
+    loraWindowOpen = false;
+    TimerSetValue(&loraWindowTimer, DOWNLINK_RX_DELAY_MS - DOWNLINK_RX_MARGIN_MS - elapsed);
+    TimerStart(&loraWindowTimer);
+    while(!loraWindowOpen) {
+      lowPowerHandler();
+    }
+  }
+
+  uint32_t symbolUs = loraSymbolTimeUs(profile.spreading_factor, profile.bandwidth);
+  uint32_t symbols = (2 * DOWNLINK_RX_MARGIN_MS * 1000 + symbolUs - 1) / symbolUs + LORA_PREAMBLE_LENGTH;
+  Radio.SetRxConfig(
+    MODEM_LORA,                // Modem type
+    profile.bandwidth,         // Bandwidth
+    profile.spreading_factor,  // Spreading factor
+    profile.coding_rate,       // Coding rate
+    0,                         // AFC bandwidth (FSK only)
+    LORA_PREAMBLE_LENGTH,      // Preamble length
+    symbols > 255 ? 255 : symbols,  // Symbol timeout
+    false,                     // Fixed length packets
+    0,                         // Payload length (fixed length only)
+    true,                      // CRC on
+    0,                         // Frequency hopping off
+    0,                         // Hop period (not used)
+    false,                     // IQ inversion off
+    false                      // Single reception
+  );
+
+  loraRxDone = false;
+  loraRxEnded = false;
+  uint32_t guardMs = 2 * DOWNLINK_RX_MARGIN_MS + loraTimeOnAirUs(profile, CONFIG_DOWNLINK_MAX_SIZE) / 1000 + 100;
+  Radio.Rx(guardMs);
+  uint32_t startTime = millis();
+  while(!loraRxDone && !loraRxEnded && (millis() - startTime < guardMs)) {
+    Radio.IrqProcess();
+    delay(1);
+  }
+
+  Radio.Sleep();
+  return loraRxDone ? loraRxLength : 0;
+}
+
+// NODE_ID build flag, or the 64-bit chip ID folded to 16 bits
+inline uint16_t loraNodeId() {
+  if(NODE_ID != 0) {
+    return (uint16_t)NODE_ID;
+  }
+  uint64_t chipId = getID();
+  return (uint16_t)(chipId ^ (chipId >> 16) ^ (chipId >> 32) ^ (chipId >> 48));
+}
+
+// Key of this node as comma separated bytes, e.g. -D NODE_KEY=0x2b,0x7e,...
+// It signs every meter frame and verifies config downlinks; without it
+// frames go out unsigned and the node never opens a receive window.
+#ifdef NODE_KEY
+static const uint8_t nodeKey[AES_KEY_SIZE] = {NODE_KEY};
+#endif
+
+class LoRaP2PTransport {
+ public:
+  void begin() {
+    initLoRaRadio();
+    nodeId_ = loraNodeId();
+#ifdef NODE_KEY
+    cmac_.setKey(nodeKey);
+#endif
+
+    Serial.print("Transport: LoRa P2P ");
+    Serial.print(LORA_FREQUENCY / 1000000);
+    Serial.print(" MHz, node ");
+    Serial.print(nodeId_, HEX);
+#ifdef NODE_KEY
+    Serial.println(", signed, config downlink on");
+#else
+    Serial.println();
+#endif
+  }
+
+  void configure(const NodeConfig &config) {
+    profile_ = loraBaseProfile;
+    profile_.spreading_factor = config.spreading_factor;
+    profile_.tx_power = config.tx_power;
+    configureLoRaTx(profile_);
+    debug_ = (config.policy & CONFIG_POLICY_DEBUG) != 0;
+
+    Serial.print("LoRa: SF");
+    Serial.print(profile_.spreading_factor);
+    Serial.print(", ");
+    Serial.print(profile_.tx_power);
+    Serial.println(" dBm");
+  }
+
+  bool send(const MeterData &data) {
+    if(debug_) {
+      Serial.println("=== Sending LoRa Data ===");
+      printMeterData(data);
+    }
+
+#ifdef NODE_KEY
+    uint8_t frame[PAYLOAD_SIGNED_SIZE];
+    size_t length = encodeSignedMeterPayload(frame, nodeId_, data, cmac_);
+#else
+    uint8_t frame[PAYLOAD_METER_SIZE];
+    size_t length = encodeMeterPayload(frame, nodeId_, data);
+#endif
+    if(!loraSendBlocking(frame, length)) {
+      Serial.println("ERROR: Failed to send LoRa packet");
+      return false;
+    }
+    if(debug_) {
+      Serial.print("Packet sent successfully (");
+      Serial.print(length);
+      Serial.println(" bytes)");
+    }
+    return true;
+  }
+
+  // Listens once after a successful send(). A verified downlink for this
+  // node is applied to config and acked on the old profile; the caller
+  // persists config and reconfigures when this returns true.
+  bool exchangeConfig(NodeConfig &config) {
+#ifdef NODE_KEY
+    uint8_t length = loraReceiveWindow(profile_);
+    if(length == 0) {
+      return false;
+    }
+    ConfigDownlink downlink;
+    PayloadStatus status = parseConfigDownlink(loraRxFrame, length, cmac_, downlink);
+    if(status != PAYLOAD_OK || downlink.node_id != nodeId_) {
+      Serial.print("Downlink dropped: ");
+      Serial.println(status != PAYLOAD_OK ? payloadStatusName(status) : "other node");
+      return false;
+    }
+
+    ConfigAck ack = applyConfigDownlink(config, downlink);
+    Serial.print("Config #");
+    Serial.print(downlink.sequence);
+    Serial.print(": ");
+    Serial.println(configAckName(ack.status));
+
+    uint8_t frame[CONFIG_ACK_SIZE];
+    encodeConfigAck(frame, cmac_, ack);
+    delay(DOWNLINK_ACK_DELAY_MS);
+    configureLoRaTx(profile_);
+    if(!loraSendBlocking(frame, sizeof(frame))) {
+      Serial.println("ERROR: Failed to send config ack");
+    }
+    return ack.status == CONFIG_ACK_APPLIED;
+#else
+    (void)config;
+    return false;
+#endif
+  }
+
+ private:
+  uint16_t nodeId_ = 0;
+  LoRaProfile profile_ = loraBaseProfile;
+  bool debug_ = false;
+#ifdef NODE_KEY
+  AesCmac cmac_;
+#endif
+};
+
+// Channel and key the telemetry is encrypted with, e.g.
+// -D MESHTASTIC_CHANNEL='"Meter"' -D MESHTASTIC_KEY=0x2b,0x7e,...
+#ifndef MESHTASTIC_CHANNEL
+  #define MESHTASTIC_CHANNEL MESHTASTIC_DEFAULT_CHANNEL
+#endif
+#ifndef MESHTASTIC_KEY
+  #define MESHTASTIC_KEY MESHTASTIC_DEFAULT_KEY
+#endif
+#ifndef MESHTASTIC_HOP_LIMIT
+  #define MESHTASTIC_HOP_LIMIT 0  // The gateway hears the node directly; meshes would repeat it
+#endif
+static const uint8_t meshtasticKey[AES_KEY_SIZE] = {MESHTASTIC_KEY};
+
+// The same uplink as LoRaP2PTransport, framed as Meshtastic telemetry
+// (meshtastic_telemetry.h). Frames are not signed and the node never
+// listens for downlinks.
+class LoRaMeshtasticTransport {
+ public:
+  void begin() {
+    initLoRaRadio();
+    nodeId_ = loraNodeId();
+    channel_.set(MESHTASTIC_CHANNEL, meshtasticKey);
+
+    Serial.print("Transport: Meshtastic telemetry on ");
+    Serial.print(MESHTASTIC_CHANNEL);
+    Serial.print(", ");
+    Serial.print(LORA_FREQUENCY / 1000000);
+    Serial.print(" MHz, node ");
+    Serial.println(nodeId_, HEX);
+  }
+
+  void configure(const NodeConfig &config) {
+    LoRaProfile profile = loraBaseProfile;
+    profile.spreading_factor = config.spreading_factor;
+    profile.tx_power = config.tx_power;
+    configureLoRaTx(profile);
+    debug_ = (config.policy & CONFIG_POLICY_DEBUG) != 0;
+
+    Serial.print("LoRa: SF");
+    Serial.print(profile.spreading_factor);
+    Serial.print(", ");
+    Serial.print(profile.tx_power);
+    Serial.println(" dBm");
+  }
+
+  bool send(const MeterData &data) {
+    if(debug_) {
+      Serial.println("=== Sending Meshtastic Telemetry ===");
+      printMeterData(data);
+    }
+    uint8_t frame[MESHTASTIC_MAX_SIZE];
+    size_t length = encodeMeshtasticTelemetry(frame, channel_, nodeId_, MESHTASTIC_HOP_LIMIT, data);
+    if(!loraSendBlocking(frame, length)) {
+      Serial.println("ERROR: Failed to send LoRa packet");
+      return false;
+    }
+    if(debug_) {
+      Serial.print("Packet sent successfully (");
+      Serial.print(length);
+      Serial.println(" bytes)");
+    }
+    return true;
+  }
+
+  bool exchangeConfig(NodeConfig &config) {
+    (void)config;
+    return false;
+  }
+
+ private:
+  uint16_t nodeId_ = 0;
+  MeshtasticChannel channel_;
+  bool debug_ = false;
+};
+
+// Link-profile sweep (range_sweep.h): every send() covers one grid profile,
+// the meter payload itself is not transmitted
+class LoRaSweepTransport {
+ public:
+  void begin() {
+    initLoRaRadio();
+
+    Serial.print("Transport: LoRa sweep over ");
+    Serial.print(sweepProfileCount());
+    Serial.print(" profiles, ");
+    Serial.print(SWEEP_PROBES_PER_PROFILE);
+    Serial.println(" probes each");
+  }
+
+  // The grid sets every profile; the sweep never listens for downlinks
+  void configure(const NodeConfig &config) { (void)config; }
+
+  bool exchangeConfig(NodeConfig &config) {
+    (void)config;
+    return false;
+  }
+
+  bool send(const MeterData &data) {
+    (void)data;
+    LoRaProfile profile = sweepProfile(profileIndex_);
+
+    SweepAnnounce announce;
+    announce.frame_type = SWEEP_FRAME_ANNOUNCE;
+    announce.sweep_id = sweepId_;
+    announce.profile_id = (uint8_t)profileIndex_;
+    announce.profile = profile;
+    announce.probes = SWEEP_PROBES_PER_PROFILE;
+    announce.interval_ms = sweepProbeInterval(profile);
+
+    Serial.print("Sweep profile ");
+    Serial.print(profileIndex_);
+    Serial.print(": SF");
+    Serial.print(profile.spreading_factor);
+    Serial.print(" BW");
+    Serial.print(loraBandwidthHz(profile.bandwidth) / 1000);
+    Serial.print(" CR4/");
+    Serial.print(profile.coding_rate + 4);
+    Serial.print(" ");
+    Serial.print(profile.tx_power);
+    Serial.println(" dBm");
+
+    // Announce on the base profile so the gateway can follow
+    configureLoRaTx(loraBaseProfile);
+    for(uint8_t r = 0; r < SWEEP_ANNOUNCE_REPEATS; r++) {
+      announce.repeat = r;
+      loraSendBlocking((const uint8_t *)&announce, sizeof(announce));
+      delay(SWEEP_ANNOUNCE_GAP_MS);
+    }
+    delay(SWEEP_SETTLE_MS);
+
+    SweepProbe probe;
+    memset(&probe, 0, sizeof(probe));
+    probe.frame_type = SWEEP_FRAME_PROBE;
+    probe.sweep_id = sweepId_;
+    probe.profile_id = (uint8_t)profileIndex_;
+
+    configureLoRaTx(profile);
+    uint16_t sent = 0;
+    for(uint16_t seq = 0; seq < announce.probes; seq++) {
+      uint32_t start = millis();
+      probe.sequence = seq;
+      if(loraSendBlocking((const uint8_t *)&probe, sizeof(probe))) {
+        sent++;
+      }
+      uint32_t elapsed = millis() - start;
+      if(elapsed < announce.interval_ms) {
+        delay(announce.interval_ms - elapsed);
+      }
+    }
+    configureLoRaTx(loraBaseProfile);
+
+    profileIndex_++;
+    if(profileIndex_ >= sweepProfileCount()) {
+      profileIndex_ = 0;
+      sweepId_++;
+    }
+    return sent == announce.probes;
+  }
+
+ private:
+  uint16_t profileIndex_ = 0;
+  uint8_t sweepId_ = 0;
+};
+
+#endif // TRANSPORT_H